@@ -70,7 +70,7 @@ LOCAL_CPP_EXTENSION := .cc
 LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
 LOCAL_STRIP_MODULE := $(LIBTEXTCLASSIFIER_STRIP_OPTS)
 
-LOCAL_SRC_FILES := $(filter-out tests/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
+LOCAL_SRC_FILES := $(filter-out tests/% tools/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
 
 LOCAL_C_INCLUDES := $(TOP)/external/zlib
 LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
@@ -113,7 +113,7 @@ LOCAL_TEST_DATA := $(call find-test-data-in-subdirs, $(LOCAL_PATH), *, test_data
 LOCAL_CPPFLAGS_32 += -DLIBTEXTCLASSIFIER_TEST_DATA_DIR="\"/data/nativetest/libtextclassifier_tests/test_data/\""
 LOCAL_CPPFLAGS_64 += -DLIBTEXTCLASSIFIER_TEST_DATA_DIR="\"/data/nativetest64/libtextclassifier_tests/test_data/\""
 
-LOCAL_SRC_FILES := $(call all-subdir-cpp-files)
+LOCAL_SRC_FILES := $(filter-out %_main.cc,$(call all-subdir-cpp-files))
 
 LOCAL_C_INCLUDES := $(TOP)/external/zlib
 LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
@@ -130,6 +130,209 @@ LOCAL_STATIC_LIBRARIES += flatbuffers
 
 include $(BUILD_NATIVE_TEST)
 
+# -----------------------------
+# textclassifier_load_generator
+# -----------------------------
+
+# The library only exports its JNI entry points, so the command-line tools
+# compile the library sources in directly.
+include $(CLEAR_VARS)
+LOCAL_MODULE := textclassifier_load_generator
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
+LOCAL_STRIP_MODULE := $(LIBTEXTCLASSIFIER_STRIP_OPTS)
+
+LOCAL_SRC_FILES := $(filter-out tests/% tools/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
+LOCAL_SRC_FILES += tools/json.cc
+LOCAL_SRC_FILES += tools/latency-histogram.cc
+LOCAL_SRC_FILES += tools/load-generator_main.cc
+
+LOCAL_C_INCLUDES := $(TOP)/external/zlib
+LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
+LOCAL_C_INCLUDES += $(TOP)/external/flatbuffers/include
+
+LOCAL_SHARED_LIBRARIES += liblog
+LOCAL_SHARED_LIBRARIES += libicuuc
+LOCAL_SHARED_LIBRARIES += libicui18n
+LOCAL_SHARED_LIBRARIES += libtflite
+LOCAL_SHARED_LIBRARIES += libz
+
+LOCAL_STATIC_LIBRARIES += flatbuffers
+
+include $(BUILD_EXECUTABLE)
+
+# ----------------------------
+# textclassifier_bulk_annotator
+# ----------------------------
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := textclassifier_bulk_annotator
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
+LOCAL_STRIP_MODULE := $(LIBTEXTCLASSIFIER_STRIP_OPTS)
+
+LOCAL_SRC_FILES := $(filter-out tests/% tools/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
+LOCAL_SRC_FILES += tools/json.cc
+LOCAL_SRC_FILES += tools/bulk-annotator_main.cc
+
+LOCAL_C_INCLUDES := $(TOP)/external/zlib
+LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
+LOCAL_C_INCLUDES += $(TOP)/external/flatbuffers/include
+
+LOCAL_SHARED_LIBRARIES += liblog
+LOCAL_SHARED_LIBRARIES += libicuuc
+LOCAL_SHARED_LIBRARIES += libicui18n
+LOCAL_SHARED_LIBRARIES += libtflite
+LOCAL_SHARED_LIBRARIES += libz
+
+LOCAL_STATIC_LIBRARIES += flatbuffers
+
+include $(BUILD_EXECUTABLE)
+
+# --------------------
+# textclassifier_server
+# --------------------
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := textclassifier_server
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
+LOCAL_STRIP_MODULE := $(LIBTEXTCLASSIFIER_STRIP_OPTS)
+
+LOCAL_SRC_FILES := $(filter-out tests/% tools/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
+LOCAL_SRC_FILES += tools/ipc-protocol.cc
+LOCAL_SRC_FILES += tools/classifier-server_main.cc
+
+LOCAL_C_INCLUDES := $(TOP)/external/zlib
+LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
+LOCAL_C_INCLUDES += $(TOP)/external/flatbuffers/include
+
+LOCAL_SHARED_LIBRARIES += liblog
+LOCAL_SHARED_LIBRARIES += libicuuc
+LOCAL_SHARED_LIBRARIES += libicui18n
+LOCAL_SHARED_LIBRARIES += libtflite
+LOCAL_SHARED_LIBRARIES += libz
+
+LOCAL_STATIC_LIBRARIES += flatbuffers
+
+include $(BUILD_EXECUTABLE)
+
+# ------------------------
+# textclassifier_slim_model
+# ------------------------
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := textclassifier_slim_model
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
+LOCAL_STRIP_MODULE := $(LIBTEXTCLASSIFIER_STRIP_OPTS)
+
+LOCAL_SRC_FILES := $(filter-out tests/% tools/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
+LOCAL_SRC_FILES += tools/model-slimmer.cc
+LOCAL_SRC_FILES += tools/model-tables.cc
+LOCAL_SRC_FILES += tools/slim-model_main.cc
+
+LOCAL_C_INCLUDES := $(TOP)/external/zlib
+LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
+LOCAL_C_INCLUDES += $(TOP)/external/flatbuffers/include
+
+LOCAL_SHARED_LIBRARIES += liblog
+LOCAL_SHARED_LIBRARIES += libicuuc
+LOCAL_SHARED_LIBRARIES += libicui18n
+LOCAL_SHARED_LIBRARIES += libtflite
+LOCAL_SHARED_LIBRARIES += libz
+
+LOCAL_STATIC_LIBRARIES += flatbuffers
+
+include $(BUILD_EXECUTABLE)
+
+# ---------------------------------
+# textclassifier_reorder_embeddings
+# ---------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := textclassifier_reorder_embeddings
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
+LOCAL_STRIP_MODULE := $(LIBTEXTCLASSIFIER_STRIP_OPTS)
+
+LOCAL_SRC_FILES := $(filter-out tests/% tools/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
+LOCAL_SRC_FILES += tools/embedding-reorderer.cc
+LOCAL_SRC_FILES += tools/json.cc
+LOCAL_SRC_FILES += tools/reorder-embeddings_main.cc
+
+LOCAL_C_INCLUDES := $(TOP)/external/zlib
+LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
+LOCAL_C_INCLUDES += $(TOP)/external/flatbuffers/include
+
+LOCAL_SHARED_LIBRARIES += liblog
+LOCAL_SHARED_LIBRARIES += libicuuc
+LOCAL_SHARED_LIBRARIES += libicui18n
+LOCAL_SHARED_LIBRARIES += libtflite
+LOCAL_SHARED_LIBRARIES += libz
+
+LOCAL_STATIC_LIBRARIES += flatbuffers
+
+include $(BUILD_EXECUTABLE)
+
+# -------------------------------
+# textclassifier_add_model_tables
+# -------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := textclassifier_add_model_tables
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
+LOCAL_STRIP_MODULE := $(LIBTEXTCLASSIFIER_STRIP_OPTS)
+
+LOCAL_SRC_FILES := $(filter-out tests/% tools/% %_test.cc test-util.%,$(call all-subdir-cpp-files))
+LOCAL_SRC_FILES += tools/model-tables.cc
+LOCAL_SRC_FILES += tools/add-model-tables_main.cc
+
+LOCAL_C_INCLUDES := $(TOP)/external/zlib
+LOCAL_C_INCLUDES += $(TOP)/external/tensorflow
+LOCAL_C_INCLUDES += $(TOP)/external/flatbuffers/include
+
+LOCAL_SHARED_LIBRARIES += liblog
+LOCAL_SHARED_LIBRARIES += libicuuc
+LOCAL_SHARED_LIBRARIES += libicui18n
+LOCAL_SHARED_LIBRARIES += libtflite
+LOCAL_SHARED_LIBRARIES += libz
+
+LOCAL_STATIC_LIBRARIES += flatbuffers
+
+include $(BUILD_EXECUTABLE)
+
+# -------------------------------------
+# textclassifier_generate_char_properties
+# -------------------------------------
+
+# Regenerates util/utf8/char-properties-data.cc from ICU.
+include $(CLEAR_VARS)
+LOCAL_MODULE := textclassifier_generate_char_properties
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_CFLAGS += $(MY_LIBTEXTCLASSIFIER_CFLAGS)
+
+LOCAL_SRC_FILES := tools/generate-char-properties_main.cc
+
+LOCAL_SHARED_LIBRARIES += libicuuc
+
+include $(BUILD_HOST_EXECUTABLE)
+
 # ----------------------
 # Smart Selection models
 # ----------------------
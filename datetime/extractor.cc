@@ -148,17 +148,12 @@ bool DatetimeExtractor::Extract(DateParseData* result,
 
 bool DatetimeExtractor::RuleIdForType(DatetimeExtractorType type,
                                       int* rule_id) const {
-  auto type_it = type_and_locale_to_rule_.find(type);
-  if (type_it == type_and_locale_to_rule_.end()) {
+  if (type < DatetimeExtractorType_MIN || type > DatetimeExtractorType_MAX ||
+      locale_id_ < 0 || locale_id_ >= num_locales_) {
     return false;
   }
-
-  auto locale_it = type_it->second.find(locale_id_);
-  if (locale_it == type_it->second.end()) {
-    return false;
-  }
-  *rule_id = locale_it->second;
-  return true;
+  *rule_id = type_and_locale_to_rule_[type * num_locales_ + locale_id_];
+  return *rule_id >= 0;
 }
 
 bool DatetimeExtractor::ExtractType(const UnicodeText& input,
@@ -18,11 +18,11 @@
 #define LIBTEXTCLASSIFIER_DATETIME_EXTRACTOR_H_
 
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "model_generated.h"
 #include "types.h"
+#include "util/flatbuffers.h"
 #include "util/strings/stringpiece.h"
 #include "util/utf8/unicodetext.h"
 #include "util/utf8/unilib.h"
@@ -49,15 +49,15 @@ class DatetimeExtractor {
       int locale_id, const UniLib& unilib,
       const std::vector<std::unique_ptr<const UniLib::RegexPattern>>&
           extractor_rules,
-      const std::unordered_map<DatetimeExtractorType,
-                               std::unordered_map<int, int>>&
-          type_and_locale_to_extractor_rule)
+      const IntTable& type_and_locale_to_extractor_rule,
+      int num_extractor_locales)
       : rule_(rule),
         matcher_(matcher),
         locale_id_(locale_id),
         unilib_(unilib),
         rules_(extractor_rules),
-        type_and_locale_to_rule_(type_and_locale_to_extractor_rule) {}
+        type_and_locale_to_rule_(type_and_locale_to_extractor_rule),
+        num_locales_(num_extractor_locales) {}
   bool Extract(DateParseData* result, CodepointSpan* result_span) const;
 
  private:
@@ -102,8 +102,8 @@ class DatetimeExtractor {
   int locale_id_;
   const UniLib& unilib_;
   const std::vector<std::unique_ptr<const UniLib::RegexPattern>>& rules_;
-  const std::unordered_map<DatetimeExtractorType, std::unordered_map<int, int>>&
-      type_and_locale_to_rule_;
+  const IntTable& type_and_locale_to_rule_;
+  const int num_locales_;
 };
 
 }  // namespace libtextclassifier2
@@ -16,8 +16,11 @@
 
 #include "datetime/parser.h"
 
+#include <algorithm>
+#include <functional>
 #include <set>
 #include <unordered_set>
+#include <utility>
 
 #include "datetime/extractor.h"
 #include "util/calendar/calendar.h"
@@ -27,17 +30,161 @@
 namespace libtextclassifier2 {
 std::unique_ptr<DatetimeParser> DatetimeParser::Instance(
     const DatetimeModel* model, const UniLib& unilib,
-    ZlibDecompressor* decompressor) {
+    ZlibDecompressor* decompressor, const UniLib::RegexLimits& regex_limits,
+    const std::string& locales) {
   std::unique_ptr<DatetimeParser> result(
-      new DatetimeParser(model, unilib, decompressor));
+      new DatetimeParser(model, unilib, decompressor, regex_limits, locales));
   if (!result->initialized_) {
     result.reset();
   }
   return result;
 }
 
+namespace {
+// Orders the ids of the locales in the model by their names, and compares them
+// with names.
+class LocaleIdLess {
+ public:
+  explicit LocaleIdLess(
+      const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*
+          locales)
+      : locales_(locales) {}
+
+  bool operator()(int a, int b) const {
+    return Less(*locales_->Get(a), *locales_->Get(b));
+  }
+  bool operator()(int a, const std::string& b) const {
+    return Less(*locales_->Get(a), b);
+  }
+  bool operator()(const std::string& a, int b) const {
+    return Less(a, *locales_->Get(b));
+  }
+
+ private:
+  template <typename A, typename B>
+  static bool Less(const A& a, const B& b) {
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(),
+                                        b.end());
+  }
+
+  const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>* locales_;
+};
+
+// Whether all values of 'table' are in [min_value, max_value).
+bool AllInRange(const flatbuffers::Vector<int32_t>& table, int min_value,
+                int max_value) {
+  for (const int32 value : table) {
+    if (value < min_value || value >= max_value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether 'table' holds non-decreasing offsets into a table of 'size'
+// entries, starting at 0 and ending at 'size'.
+bool IsValidOffsetTable(const flatbuffers::Vector<int32_t>& table, int size) {
+  if (table.size() == 0 || table.Get(0) != 0 ||
+      table.Get(table.size() - 1) != size) {
+    return false;
+  }
+  for (int i = 1; i < table.size(); ++i) {
+    if (table.Get(i) < table.Get(i - 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Decompresses a pattern that is not loaded, if it is part of a single stream,
+// so that the decompressor stays in sync with the stream.
+bool SkipCompressedPattern(const CompressedBuffer* compressed_pattern,
+                           ZlibDecompressor* decompressor) {
+  if (compressed_pattern == nullptr ||
+      compressed_pattern->buffer() == nullptr ||
+      compressed_pattern->independent()) {
+    return true;
+  }
+  std::string skipped_pattern;
+  return decompressor != nullptr &&
+         decompressor->Decompress(compressed_pattern, &skipped_pattern);
+}
+}  // namespace
+
+namespace internal {
+
+std::vector<int32> SortLocaleIds(
+    const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>&
+        locales) {
+  std::vector<int32> sorted_locale_ids(locales.size());
+  for (int i = 0; i < sorted_locale_ids.size(); ++i) {
+    sorted_locale_ids[i] = i;
+  }
+  std::stable_sort(sorted_locale_ids.begin(), sorted_locale_ids.end(),
+                   LocaleIdLess(&locales));
+  return sorted_locale_ids;
+}
+
+void BuildLocaleRules(
+    const std::vector<const DatetimeModelPattern*>& rule_patterns,
+    const std::function<bool(int)>& is_loaded,
+    std::vector<int32>* locale_rules_start, std::vector<int32>* locale_rules) {
+  // The rules of every locale, as (locale, rule) pairs in rule order.
+  std::vector<std::pair<int, int>> locale_and_rule;
+  for (int rule = 0; rule < rule_patterns.size(); ++rule) {
+    if (rule_patterns[rule]->locales()) {
+      for (int locale : *rule_patterns[rule]->locales()) {
+        if (is_loaded(locale)) {
+          locale_and_rule.push_back({locale, rule});
+        }
+      }
+    }
+  }
+
+  std::stable_sort(
+      locale_and_rule.begin(), locale_and_rule.end(),
+      [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+        return a.first < b.first;
+      });
+  locale_rules_start->assign(
+      locale_and_rule.empty() ? 1 : locale_and_rule.back().first + 2, 0);
+  locale_rules->clear();
+  locale_rules->reserve(locale_and_rule.size());
+  for (const std::pair<int, int>& entry : locale_and_rule) {
+    ++(*locale_rules_start)[entry.first + 1];
+    locale_rules->push_back(entry.second);
+  }
+  for (int i = 1; i < locale_rules_start->size(); ++i) {
+    (*locale_rules_start)[i] += (*locale_rules_start)[i - 1];
+  }
+}
+
+std::vector<int32> BuildExtractorRules(
+    const std::vector<const DatetimeModelExtractor*>& extractors,
+    const std::function<bool(int)>& is_loaded, int num_locales) {
+  std::vector<int32> extractor_rules(
+      (DatetimeExtractorType_MAX + 1) * num_locales, -1);
+  for (int i = 0; i < extractors.size(); ++i) {
+    const DatetimeModelExtractor* extractor = extractors[i];
+    if (extractor->locales() &&
+        extractor->extractor() >= DatetimeExtractorType_MIN &&
+        extractor->extractor() <= DatetimeExtractorType_MAX) {
+      for (int locale : *extractor->locales()) {
+        if (locale < num_locales && is_loaded(locale)) {
+          extractor_rules[extractor->extractor() * num_locales + locale] = i;
+        }
+      }
+    }
+  }
+  return extractor_rules;
+}
+
+}  // namespace internal
+
 DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
-                               ZlibDecompressor* decompressor)
+                               ZlibDecompressor* decompressor,
+                               const UniLib::RegexLimits& regex_limits,
+                               const std::string& locales)
     : unilib_(unilib) {
   initialized_ = false;
 
@@ -45,10 +192,66 @@ DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
     return;
   }
 
+  if (model->locales() != nullptr) {
+    locales_ = model->locales();
+    const flatbuffers::Vector<int32_t>* sorted_locale_ids =
+        model->sorted_locale_ids();
+    if (sorted_locale_ids != nullptr &&
+        sorted_locale_ids->size() == locales_->size() &&
+        AllInRange(*sorted_locale_ids, 0, locales_->size())) {
+      sorted_locale_ids_.Reset(sorted_locale_ids);
+    } else {
+      sorted_locale_ids_.Reset(internal::SortLocaleIds(*locales_));
+    }
+  }
+
+  if (model->default_locales() != nullptr) {
+    for (const int locale : *model->default_locales()) {
+      default_locale_ids_.push_back(locale);
+    }
+  }
+
+  // The locales whose rules are loaded, all of them if 'locales' is empty.
+  std::unordered_set<int> loaded_locales;
+  if (!locales.empty()) {
+    std::string reference_locale;
+    for (const int locale : ParseAndExpandLocales(locales, &reference_locale)) {
+      loaded_locales.insert(locale);
+    }
+  }
+  const std::function<bool(int)> is_loaded = [&locales,
+                                              &loaded_locales](int locale) {
+    return locale >= 0 && (locales.empty() || loaded_locales.count(locale));
+  };
+  const auto is_any_loaded =
+      [&locales, &is_loaded](const flatbuffers::Vector<int32_t>* ids) {
+        if (locales.empty()) {
+          return true;
+        }
+        if (ids != nullptr) {
+          for (const int locale : *ids) {
+            if (is_loaded(locale)) {
+              return true;
+            }
+          }
+        }
+        return false;
+      };
+
+  std::vector<const DatetimeModelPattern*> rule_patterns;
   if (model->patterns() != nullptr) {
     for (const DatetimeModelPattern* pattern : *model->patterns()) {
+      const bool load = is_any_loaded(pattern->locales());
       if (pattern->regexes()) {
         for (const DatetimeModelPattern_::Regex* regex : *pattern->regexes()) {
+          if (!load) {
+            if (!SkipCompressedPattern(regex->compressed_pattern(),
+                                       decompressor)) {
+              TC_LOG(ERROR) << "Couldn't skip rule pattern.";
+              return;
+            }
+            continue;
+          }
           std::unique_ptr<UniLib::RegexPattern> regex_pattern =
               UncompressMakeRegexPattern(unilib, regex->pattern(),
                                          regex->compressed_pattern(),
@@ -57,19 +260,44 @@ DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
             TC_LOG(ERROR) << "Couldn't create rule pattern.";
             return;
           }
+          regex_pattern->set_limits(regex_limits);
           rules_.push_back({std::move(regex_pattern), regex, pattern});
-          if (pattern->locales()) {
-            for (int locale : *pattern->locales()) {
-              locale_to_rules_[locale].push_back(rules_.size() - 1);
-            }
-          }
+          rule_patterns.push_back(pattern);
         }
       }
     }
   }
 
+  // The precomputed tables number the rules and extractors of the whole
+  // model, so they only apply if all of them are loaded.
+  const flatbuffers::Vector<int32_t>* locale_rules_start =
+      model->locale_rules_start();
+  const flatbuffers::Vector<int32_t>* locale_rules = model->locale_rules();
+  if (locales.empty() && locale_rules_start != nullptr &&
+      locale_rules != nullptr &&
+      IsValidOffsetTable(*locale_rules_start, locale_rules->size()) &&
+      AllInRange(*locale_rules, 0, rules_.size())) {
+    locale_rules_start_.Reset(locale_rules_start);
+    locale_rules_.Reset(locale_rules);
+  } else {
+    std::vector<int32> start;
+    std::vector<int32> rules;
+    internal::BuildLocaleRules(rule_patterns, is_loaded, &start, &rules);
+    locale_rules_start_.Reset(std::move(start));
+    locale_rules_.Reset(std::move(rules));
+  }
+
+  std::vector<const DatetimeModelExtractor*> loaded_extractors;
   if (model->extractors() != nullptr) {
     for (const DatetimeModelExtractor* extractor : *model->extractors()) {
+      if (!is_any_loaded(extractor->locales())) {
+        if (!SkipCompressedPattern(extractor->compressed_pattern(),
+                                   decompressor)) {
+          TC_LOG(ERROR) << "Couldn't skip extractor pattern.";
+          return;
+        }
+        continue;
+      }
       std::unique_ptr<UniLib::RegexPattern> regex_pattern =
           UncompressMakeRegexPattern(unilib, extractor->pattern(),
                                      extractor->compressed_pattern(),
@@ -79,26 +307,34 @@ DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
         return;
       }
       extractor_rules_.push_back(std::move(regex_pattern));
+      loaded_extractors.push_back(extractor);
+    }
+  }
 
+  const flatbuffers::Vector<int32_t>* extractor_rules =
+      model->extractor_rules();
+  const int num_locales = locales_ != nullptr ? locales_->size() : 0;
+  if (locales.empty() && extractor_rules != nullptr &&
+      extractor_rules->size() ==
+          (DatetimeExtractorType_MAX + 1) * num_locales &&
+      AllInRange(*extractor_rules, -1, extractor_rules_.size())) {
+    type_and_locale_to_extractor_rule_.Reset(extractor_rules);
+    num_extractor_locales_ = num_locales;
+  } else {
+    // Only as many locales as the extractors refer to.
+    num_extractor_locales_ = 0;
+    for (const DatetimeModelExtractor* extractor : loaded_extractors) {
       if (extractor->locales()) {
         for (int locale : *extractor->locales()) {
-          type_and_locale_to_extractor_rule_[extractor->extractor()][locale] =
-              extractor_rules_.size() - 1;
+          if (is_loaded(locale)) {
+            num_extractor_locales_ =
+                std::max(num_extractor_locales_, locale + 1);
+          }
         }
       }
     }
-  }
-
-  if (model->locales() != nullptr) {
-    for (int i = 0; i < model->locales()->Length(); ++i) {
-      locale_string_to_id_[model->locales()->Get(i)->str()] = i;
-    }
-  }
-
-  if (model->default_locales() != nullptr) {
-    for (const int locale : *model->default_locales()) {
-      default_locale_ids_.push_back(locale);
-    }
+    type_and_locale_to_extractor_rule_.Reset(internal::BuildExtractorRules(
+        loaded_extractors, is_loaded, num_extractor_locales_));
   }
 
   use_extractors_for_locating_ = model->use_extractors_for_locating();
@@ -110,25 +346,26 @@ bool DatetimeParser::Parse(
     const std::string& input, const int64 reference_time_ms_utc,
     const std::string& reference_timezone, const std::string& locales,
     ModeFlag mode, bool anchor_start_end,
-    std::vector<DatetimeParseResultSpan>* results) const {
+    std::vector<DatetimeParseResultSpan>* results, RegexBudget* budget) const {
   return Parse(UTF8ToUnicodeText(input, /*do_copy=*/false),
                reference_time_ms_utc, reference_timezone, locales, mode,
-               anchor_start_end, results);
+               anchor_start_end, results, budget);
 }
 
 bool DatetimeParser::FindSpansUsingLocales(
     const std::vector<int>& locale_ids, const UnicodeText& input,
     const int64 reference_time_ms_utc, const std::string& reference_timezone,
     ModeFlag mode, bool anchor_start_end, const std::string& reference_locale,
-    std::unordered_set<int>* executed_rules,
+    std::unordered_set<int>* executed_rules, RegexBudget* budget,
     std::vector<DatetimeParseResultSpan>* found_spans) const {
   for (const int locale_id : locale_ids) {
-    auto rules_it = locale_to_rules_.find(locale_id);
-    if (rules_it == locale_to_rules_.end()) {
+    if (locale_id < 0 || locale_id + 1 >= locale_rules_start_.size()) {
       continue;
     }
 
-    for (const int rule_id : rules_it->second) {
+    for (int i = locale_rules_start_[locale_id];
+         i < locale_rules_start_[locale_id + 1]; ++i) {
+      const int rule_id = locale_rules_[i];
       // Skip rules that were already executed in previous locales.
       if (executed_rules->find(rule_id) != executed_rules->end()) {
         continue;
@@ -138,13 +375,25 @@ bool DatetimeParser::FindSpansUsingLocales(
         continue;
       }
 
+      if (budget != nullptr && budget->Exhausted()) {
+        return true;
+      }
+
       executed_rules->insert(rule_id);
 
+      bool limit_exceeded = false;
       if (!ParseWithRule(rules_[rule_id], input, reference_time_ms_utc,
                          reference_timezone, reference_locale, locale_id,
-                         anchor_start_end, found_spans)) {
+                         anchor_start_end, found_spans, &limit_exceeded)) {
         return false;
       }
+      if (limit_exceeded) {
+        TC_LOG(WARNING) << "Datetime rule " << rule_id
+                        << " ran over the regex limits, skipping it.";
+        if (budget != nullptr) {
+          budget->AddDatetimeOverrun(rule_id);
+        }
+      }
     }
   }
   return true;
@@ -154,7 +403,7 @@ bool DatetimeParser::Parse(
     const UnicodeText& input, const int64 reference_time_ms_utc,
     const std::string& reference_timezone, const std::string& locales,
     ModeFlag mode, bool anchor_start_end,
-    std::vector<DatetimeParseResultSpan>* results) const {
+    std::vector<DatetimeParseResultSpan>* results, RegexBudget* budget) const {
   std::vector<DatetimeParseResultSpan> found_spans;
   std::unordered_set<int> executed_rules;
   std::string reference_locale;
@@ -162,7 +411,8 @@ bool DatetimeParser::Parse(
       ParseAndExpandLocales(locales, &reference_locale);
   if (!FindSpansUsingLocales(requested_locales, input, reference_time_ms_utc,
                              reference_timezone, mode, anchor_start_end,
-                             reference_locale, &executed_rules, &found_spans)) {
+                             reference_locale, &executed_rules, budget,
+                             &found_spans)) {
     return false;
   }
 
@@ -245,9 +495,11 @@ bool DatetimeParser::ParseWithRule(
     const CompiledRule& rule, const UnicodeText& input,
     const int64 reference_time_ms_utc, const std::string& reference_timezone,
     const std::string& reference_locale, const int locale_id,
-    bool anchor_start_end, std::vector<DatetimeParseResultSpan>* result) const {
+    bool anchor_start_end, std::vector<DatetimeParseResultSpan>* result,
+    bool* limit_exceeded) const {
   std::unique_ptr<UniLib::RegexMatcher> matcher =
       rule.compiled_regex->Matcher(input);
+  const int num_results = result->size();
   int status = UniLib::RegexMatcher::kNoError;
   if (anchor_start_end) {
     if (matcher->Matches(&status) && status == UniLib::RegexMatcher::kNoError) {
@@ -266,6 +518,23 @@ bool DatetimeParser::ParseWithRule(
       }
     }
   }
+  *limit_exceeded = status == UniLib::RegexMatcher::kLimitExceeded;
+  if (*limit_exceeded) {
+    result->erase(result->begin() + num_results, result->end());
+  }
+  return true;
+}
+
+bool DatetimeParser::FindLocaleId(const std::string& locale,
+                                  int* locale_id) const {
+  const auto range =
+      std::equal_range(sorted_locale_ids_.begin(), sorted_locale_ids_.end(),
+                       locale, LocaleIdLess(locales_));
+  if (range.first == range.second) {
+    return false;
+  }
+  // The last one wins if a locale is listed twice.
+  *locale_id = *(range.second - 1);
   return true;
 }
 
@@ -279,10 +548,10 @@ std::vector<int> DatetimeParser::ParseAndExpandLocales(
   }
 
   std::vector<int> result;
+  int locale_id;
   for (const StringPiece& locale_str : split_locales) {
-    auto locale_it = locale_string_to_id_.find(locale_str.ToString());
-    if (locale_it != locale_string_to_id_.end()) {
-      result.push_back(locale_it->second);
+    if (FindLocaleId(locale_str.ToString(), &locale_id)) {
+      result.push_back(locale_id);
     }
 
     const Locale locale = Locale::FromBCP47(locale_str.ToString());
@@ -296,23 +565,20 @@ std::vector<int> DatetimeParser::ParseAndExpandLocales(
 
     // First, try adding *-region locale.
     if (!region.empty()) {
-      locale_it = locale_string_to_id_.find("*-" + region);
-      if (locale_it != locale_string_to_id_.end()) {
-        result.push_back(locale_it->second);
+      if (FindLocaleId("*-" + region, &locale_id)) {
+        result.push_back(locale_id);
       }
     }
     // Second, try adding language-script-* locale.
     if (!script.empty()) {
-      locale_it = locale_string_to_id_.find(language + "-" + script + "-*");
-      if (locale_it != locale_string_to_id_.end()) {
-        result.push_back(locale_it->second);
+      if (FindLocaleId(language + "-" + script + "-*", &locale_id)) {
+        result.push_back(locale_id);
       }
     }
     // Third, try adding language-* locale.
     if (!language.empty()) {
-      locale_it = locale_string_to_id_.find(language + "-*");
-      if (locale_it != locale_string_to_id_.end()) {
-        result.push_back(locale_it->second);
+      if (FindLocaleId(language + "-*", &locale_id)) {
+        result.push_back(locale_id);
       }
     }
   }
@@ -386,7 +652,8 @@ bool DatetimeParser::ExtractDatetime(const CompiledRule& rule,
   DateParseData parse;
   DatetimeExtractor extractor(rule, matcher, locale_id, unilib_,
                               extractor_rules_,
-                              type_and_locale_to_extractor_rule_);
+                              type_and_locale_to_extractor_rule_,
+                              num_extractor_locales_);
   if (!extractor.Extract(&parse, result_span)) {
     return false;
   }
@@ -17,69 +17,117 @@
 #ifndef LIBTEXTCLASSIFIER_DATETIME_PARSER_H_
 #define LIBTEXTCLASSIFIER_DATETIME_PARSER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "datetime/extractor.h"
 #include "model_generated.h"
+#include "regex-budget.h"
 #include "types.h"
 #include "util/base/integral_types.h"
 #include "util/calendar/calendar.h"
+#include "util/flatbuffers.h"
 #include "util/utf8/unilib.h"
 #include "zlib-utils.h"
 
 namespace libtextclassifier2 {
 
+namespace internal {
+
+// Builders of the lookup tables of the parser, shared with the tool that
+// precomputes them in the model (see tools/model-tables.h).
+
+// Returns the ids of 'locales' sorted by name, keeping equal names in order.
+std::vector<int32> SortLocaleIds(
+    const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>&
+        locales);
+
+// Lays out the rules by locale: the ids of the rules of locale i are in
+// 'locale_rules', from 'locale_rules_start'[i] to 'locale_rules_start'[i + 1].
+// Rule i belongs to 'rule_patterns'[i]; only the loaded locales are listed.
+void BuildLocaleRules(
+    const std::vector<const DatetimeModelPattern*>& rule_patterns,
+    const std::function<bool(int)>& is_loaded,
+    std::vector<int32>* locale_rules_start, std::vector<int32>* locale_rules);
+
+// Returns the index into 'extractors' for each extractor type and loaded
+// locale below 'num_locales', at type * num_locales + locale, or -1.
+std::vector<int32> BuildExtractorRules(
+    const std::vector<const DatetimeModelExtractor*>& extractors,
+    const std::function<bool(int)>& is_loaded, int num_locales);
+
+}  // namespace internal
+
 // Parses datetime expressions in the input and resolves them to actual absolute
 // time.
 class DatetimeParser {
  public:
+  // The 'regex_limits' apply to every match of the rules that locate the
+  // datetimes in the input.
+  // If 'locales' is not empty, only the rules and extractors of these
+  // locales (comma-separated, expanded as in Parse) and of the default
+  // locales of the model are loaded. Other locales find no datetimes then.
   static std::unique_ptr<DatetimeParser> Instance(
       const DatetimeModel* model, const UniLib& unilib,
-      ZlibDecompressor* decompressor);
+      ZlibDecompressor* decompressor,
+      const UniLib::RegexLimits& regex_limits = UniLib::RegexLimits(),
+      const std::string& locales = "");
 
   // Parses the dates in 'input' and fills result. Makes sure that the results
   // do not overlap.
   // If 'anchor_start_end' is true the extracted results need to start at the
   // beginning of 'input' and end at the end of it.
+  // If 'budget' is given, the rules are skipped once it is exhausted, and the
+  // rules that ran over the regex limits are recorded in it. Such rules don't
+  // contribute any results.
   bool Parse(const std::string& input, int64 reference_time_ms_utc,
              const std::string& reference_timezone, const std::string& locales,
              ModeFlag mode, bool anchor_start_end,
-             std::vector<DatetimeParseResultSpan>* results) const;
+             std::vector<DatetimeParseResultSpan>* results,
+             RegexBudget* budget = nullptr) const;
 
   // Same as above but takes UnicodeText.
   bool Parse(const UnicodeText& input, int64 reference_time_ms_utc,
              const std::string& reference_timezone, const std::string& locales,
              ModeFlag mode, bool anchor_start_end,
-             std::vector<DatetimeParseResultSpan>* results) const;
+             std::vector<DatetimeParseResultSpan>* results,
+             RegexBudget* budget = nullptr) const;
 
  protected:
   DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
-                 ZlibDecompressor* decompressor);
+                 ZlibDecompressor* decompressor,
+                 const UniLib::RegexLimits& regex_limits,
+                 const std::string& locales);
 
   // Returns a list of locale ids for given locale spec string (comma-separated
   // locale names). Assigns the first parsed locale to reference_locale.
   std::vector<int> ParseAndExpandLocales(const std::string& locales,
                                          std::string* reference_locale) const;
 
+  // Finds the id of the locale with the given name in the model.
+  bool FindLocaleId(const std::string& locale, int* locale_id) const;
+
   // Helper function that finds datetime spans, only using the rules associated
   // with the given locales.
   bool FindSpansUsingLocales(
       const std::vector<int>& locale_ids, const UnicodeText& input,
       const int64 reference_time_ms_utc, const std::string& reference_timezone,
       ModeFlag mode, bool anchor_start_end, const std::string& reference_locale,
-      std::unordered_set<int>* executed_rules,
+      std::unordered_set<int>* executed_rules, RegexBudget* budget,
       std::vector<DatetimeParseResultSpan>* found_spans) const;
 
+  // Sets 'limit_exceeded' and leaves 'result' unchanged if the rule ran over
+  // the regex limits.
   bool ParseWithRule(const CompiledRule& rule, const UnicodeText& input,
                      int64 reference_time_ms_utc,
                      const std::string& reference_timezone,
                      const std::string& reference_locale, const int locale_id,
                      bool anchor_start_end,
-                     std::vector<DatetimeParseResultSpan>* result) const;
+                     std::vector<DatetimeParseResultSpan>* result,
+                     bool* limit_exceeded) const;
 
   // Converts the current match in 'matcher' into DatetimeParseResult.
   bool ExtractDatetime(const CompiledRule& rule,
@@ -102,11 +150,24 @@ class DatetimeParser {
   bool initialized_;
   const UniLib& unilib_;
   std::vector<CompiledRule> rules_;
-  std::unordered_map<int, std::vector<int>> locale_to_rules_;
+
+  // The ids of the rules of locale i are in locale_rules_, from index
+  // locale_rules_start_[i] to locale_rules_start_[i + 1]. Read from the model
+  // if it has them, else built at load time, as the tables below.
+  IntTable locale_rules_start_;
+  IntTable locale_rules_;
+
   std::vector<std::unique_ptr<const UniLib::RegexPattern>> extractor_rules_;
-  std::unordered_map<DatetimeExtractorType, std::unordered_map<int, int>>
-      type_and_locale_to_extractor_rule_;
-  std::unordered_map<std::string, int> locale_string_to_id_;
+
+  // Index into extractor_rules_ for each extractor type and locale, at
+  // type * num_extractor_locales_ + locale, or -1.
+  IntTable type_and_locale_to_extractor_rule_;
+  int num_extractor_locales_ = 0;
+
+  // The locale names in the model, and their ids sorted by name.
+  const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*
+      locales_ = nullptr;
+  IntTable sorted_locale_ids_;
   std::vector<int> default_locale_ids_;
   CalendarLib calendar_lib_;
   bool use_extractors_for_locating_;
@@ -27,6 +27,7 @@
 #include "model_generated.h"
 #include "text-classifier.h"
 #include "types-test-util.h"
+#include "zlib-utils.h"
 
 using testing::ElementsAreArray;
 
@@ -453,5 +454,33 @@ TEST_F(ParserLocaleTest, SwissEnglish) {
   EXPECT_TRUE(HasResult("default", /*locales=*/"en-CH"));
 }
 
+TEST_F(ParserLocaleTest, LoadsRulesOfLocales) {
+  ModelT model;
+  model.datetime_model.reset(
+      flatbuffers::GetRoot<DatetimeModel>(builder_.GetBufferPointer())
+          ->UnPack());
+  // Compress the rules into a single stream, so that the rules that are not
+  // loaded still have to be decompressed in order.
+  ASSERT_TRUE(CompressModel(&model));
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(DatetimeModel::Pack(builder, model.datetime_model.get()));
+  std::unique_ptr<ZlibDecompressor> decompressor = ZlibDecompressor::Instance();
+  parser_ = DatetimeParser::Instance(
+      flatbuffers::GetRoot<DatetimeModel>(builder.GetBufferPointer()), unilib_,
+      decompressor.get(), UniLib::RegexLimits(), /*locales=*/"en-CH");
+  ASSERT_TRUE(parser_);
+
+  EXPECT_TRUE(HasResult("en-CH", /*locales=*/"en-CH"));
+  EXPECT_TRUE(HasResult("en-all", /*locales=*/"en-CH"));
+  EXPECT_TRUE(HasResult("all-CH", /*locales=*/"en-CH"));
+  EXPECT_TRUE(HasResult("default", /*locales=*/"en-CH"));
+
+  // The rules of other locales are not loaded.
+  EXPECT_FALSE(HasResult("en-US", /*locales=*/"en-US"));
+  EXPECT_FALSE(HasResult("zh-Hant-all", /*locales=*/"zh-Hant"));
+  EXPECT_TRUE(HasResult("en-all", /*locales=*/"en-US"));
+  EXPECT_TRUE(HasResult("default", /*locales=*/"zh-Hant"));
+}
+
 }  // namespace
 }  // namespace libtextclassifier2
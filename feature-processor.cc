@@ -16,11 +16,13 @@
 
 #include "feature-processor.h"
 
+#include <algorithm>
 #include <iterator>
 #include <set>
 #include <vector>
 
 #include "util/base/logging.h"
+#include "util/hash/farmhash.h"
 #include "util/strings/utf8.h"
 #include "util/utf8/unicodetext.h"
 
@@ -121,6 +123,64 @@ const UniLib* MaybeCreateUnilib(const UniLib* unilib,
   }
 }
 
+bool HaveCompatibleTokenFeatures(const FeatureProcessorOptions* options1,
+                                 const FeatureProcessorOptions* options2) {
+  if (options1->embedding_size() != options2->embedding_size() ||
+      options1->embedding_quantization_bits() !=
+          options2->embedding_quantization_bits()) {
+    return false;
+  }
+
+  // The embeddings are computed from the sparse features, so everything that
+  // influences their extraction needs to match, and so do the dense features.
+  const TokenFeatureExtractorOptions extractor_options1 =
+      BuildTokenFeatureExtractorOptions(options1);
+  const TokenFeatureExtractorOptions extractor_options2 =
+      BuildTokenFeatureExtractorOptions(options2);
+  return extractor_options1.num_buckets == extractor_options2.num_buckets &&
+         extractor_options1.chargram_orders ==
+             extractor_options2.chargram_orders &&
+         extractor_options1.extract_case_feature ==
+             extractor_options2.extract_case_feature &&
+         extractor_options1.unicode_aware_features ==
+             extractor_options2.unicode_aware_features &&
+         extractor_options1.extract_selection_mask_feature ==
+             extractor_options2.extract_selection_mask_feature &&
+         extractor_options1.regexp_features ==
+             extractor_options2.regexp_features &&
+         extractor_options1.remap_digits == extractor_options2.remap_digits &&
+         extractor_options1.lowercase_tokens ==
+             extractor_options2.lowercase_tokens &&
+         extractor_options1.max_word_length ==
+             extractor_options2.max_word_length &&
+         extractor_options1.allowed_chargrams ==
+             extractor_options2.allowed_chargrams;
+}
+
+int CachedTokenFeaturesSize(const FeatureProcessorOptions* options) {
+  const TokenFeatureExtractorOptions extractor_options =
+      BuildTokenFeatureExtractorOptions(options);
+  return options->embedding_size() + extractor_options.extract_case_feature +
+         extractor_options.extract_selection_mask_feature +
+         extractor_options.regexp_features.size();
+}
+
+std::vector<int32> MakeSelectionLabelSpans(int max_selection_span,
+                                           bool reduced_output_space) {
+  std::vector<int32> selection_label_spans;
+  selection_label_spans.reserve(2 * (max_selection_span + 1) *
+                                (max_selection_span + 1));
+  for (int l = 0; l < (max_selection_span + 1); ++l) {
+    for (int r = 0; r < (max_selection_span + 1); ++r) {
+      if (!reduced_output_space || r + l <= max_selection_span) {
+        selection_label_spans.push_back(l);
+        selection_label_spans.push_back(r);
+      }
+    }
+  }
+  return selection_label_spans;
+}
+
 }  // namespace internal
 
 void FeatureProcessor::StripTokensFromOtherLines(
@@ -257,8 +317,9 @@ bool FeatureProcessor::LabelToSpan(
 
 bool FeatureProcessor::LabelToTokenSpan(const int label,
                                         TokenSpan* token_span) const {
-  if (label >= 0 && label < label_to_selection_.size()) {
-    *token_span = label_to_selection_[label];
+  if (label >= 0 && label < GetSelectionLabelCount()) {
+    *token_span = {label_to_selection_[2 * label],
+                   label_to_selection_[2 * label + 1]};
     return true;
   } else {
     return false;
@@ -331,12 +392,21 @@ bool FeatureProcessor::SpanToLabel(
 }
 
 int FeatureProcessor::TokenSpanToLabel(const TokenSpan& span) const {
-  auto it = selection_to_label_.find(span);
-  if (it != selection_to_label_.end()) {
-    return it->second;
-  } else {
+  const int max_selection_span = options_->max_selection_span();
+  if (span.first < 0 || span.second < 0 || span.first > max_selection_span ||
+      span.second > max_selection_span) {
     return kInvalidLabel;
   }
+  if (!options_->selection_reduced_output_space()) {
+    return span.first * (max_selection_span + 1) + span.second;
+  }
+  if (span.first + span.second > max_selection_span) {
+    return kInvalidLabel;
+  }
+  // In the reduced output space, the labels with span.first == l come after
+  // the max_selection_span + 1 - k labels of every k < l.
+  return span.first * (max_selection_span + 1) -
+         span.first * (span.first - 1) / 2 + span.second;
 }
 
 TokenSpan CodepointSpanToTokenSpan(const std::vector<Token>& selectable_tokens,
@@ -470,7 +540,7 @@ int FeatureProcessor::FindCenterToken(CodepointSpan span,
 bool FeatureProcessor::SelectionLabelSpans(
     const VectorSpan<Token> tokens,
     std::vector<CodepointSpan>* selection_label_spans) const {
-  for (int i = 0; i < label_to_selection_.size(); ++i) {
+  for (int i = 0; i < GetSelectionLabelCount(); ++i) {
     CodepointSpan span;
     if (!LabelToSpan(i, tokens, &span)) {
       TC_LOG(ERROR) << "Could not convert label to span: " << i;
@@ -493,17 +563,29 @@ void FeatureProcessor::PrepareCodepointRanges(
         CodepointRange(range->start(), range->end()));
   }
 
-  std::sort(prepared_codepoint_ranges->begin(),
-            prepared_codepoint_ranges->end(),
-            [](const CodepointRange& a, const CodepointRange& b) {
-              return a.start < b.start;
-            });
+  // Models are usually built with sorted ranges, and the model builder marks
+  // them as such.
+  if (options_->sorted_codepoint_tables()) {
+    return;
+  }
+  const auto start_less = [](const CodepointRange& a, const CodepointRange& b) {
+    return a.start < b.start;
+  };
+  if (!std::is_sorted(prepared_codepoint_ranges->begin(),
+                      prepared_codepoint_ranges->end(), start_less)) {
+    std::sort(prepared_codepoint_ranges->begin(),
+              prepared_codepoint_ranges->end(), start_less);
+  }
 }
 
 void FeatureProcessor::PrepareIgnoredSpanBoundaryCodepoints() {
   if (options_->ignored_span_boundary_codepoints() != nullptr) {
-    for (const int codepoint : *options_->ignored_span_boundary_codepoints()) {
-      ignored_span_boundary_codepoints_.insert(codepoint);
+    ignored_span_boundary_codepoints_.assign(
+        options_->ignored_span_boundary_codepoints()->begin(),
+        options_->ignored_span_boundary_codepoints()->end());
+    if (!options_->sorted_codepoint_tables()) {
+      std::sort(ignored_span_boundary_codepoints_.begin(),
+                ignored_span_boundary_codepoints_.end());
     }
   }
 }
@@ -534,8 +616,8 @@ int FeatureProcessor::CountIgnoredSpanBoundaryCodepoints(
 
   // Move until we encounter a non-ignored character.
   int num_ignored = 0;
-  while (ignored_span_boundary_codepoints_.find(*it) !=
-         ignored_span_boundary_codepoints_.end()) {
+  while (std::binary_search(ignored_span_boundary_codepoints_.begin(),
+                            ignored_span_boundary_codepoints_.end(), *it)) {
     ++num_ignored;
 
     if (it == it_last) {
@@ -659,16 +741,21 @@ bool FeatureProcessor::IsCodepointInRanges(
 }
 
 int FeatureProcessor::CollectionToLabel(const std::string& collection) const {
-  const auto it = collection_to_label_.find(collection);
-  if (it == collection_to_label_.end()) {
-    return options_->default_collection();
-  } else {
-    return it->second;
+  // There are only a few collections, so they are searched in place. The last
+  // one wins if a collection is listed twice.
+  for (int i = NumCollections() - 1; i >= 0; --i) {
+    const flatbuffers::String* name = (*options_->collections())[i];
+    if (name->size() == collection.size() &&
+        collection.compare(0, collection.size(), name->c_str(),
+                           name->size()) == 0) {
+      return i;
+    }
   }
+  return options_->default_collection();
 }
 
 std::string FeatureProcessor::LabelToCollection(int label) const {
-  if (label >= 0 && label < collection_to_label_.size()) {
+  if (label >= 0 && label < NumCollections()) {
     return (*options_->collections())[label]->str();
   } else {
     return GetDefaultCollection();
@@ -676,24 +763,30 @@ std::string FeatureProcessor::LabelToCollection(int label) const {
 }
 
 void FeatureProcessor::MakeLabelMaps() {
-  if (options_->collections() != nullptr) {
-    for (int i = 0; i < options_->collections()->size(); ++i) {
-      collection_to_label_[(*options_->collections())[i]->str()] = i;
+  const int max_selection_span = options_->max_selection_span();
+  const int num_labels =
+      options_->selection_reduced_output_space()
+          ? (max_selection_span + 1) * (max_selection_span + 2) / 2
+          : (max_selection_span + 1) * (max_selection_span + 1);
+
+  // The model has the mapping if the label of every span in it is its index.
+  const flatbuffers::Vector<int32_t>* selection_label_spans =
+      options_->selection_label_spans();
+  if (selection_label_spans != nullptr &&
+      selection_label_spans->size() == 2 * num_labels) {
+    bool valid = true;
+    for (int i = 0; valid && i < num_labels; ++i) {
+      valid = TokenSpanToLabel({selection_label_spans->Get(2 * i),
+                                selection_label_spans->Get(2 * i + 1)}) == i;
     }
-  }
-
-  int selection_label_id = 0;
-  for (int l = 0; l < (options_->max_selection_span() + 1); ++l) {
-    for (int r = 0; r < (options_->max_selection_span() + 1); ++r) {
-      if (!options_->selection_reduced_output_space() ||
-          r + l <= options_->max_selection_span()) {
-        TokenSpan token_span{l, r};
-        selection_to_label_[token_span] = selection_label_id;
-        label_to_selection_.push_back(token_span);
-        ++selection_label_id;
-      }
+    if (valid) {
+      label_to_selection_.Reset(selection_label_spans);
+      return;
     }
   }
+
+  label_to_selection_.Reset(internal::MakeSelectionLabelSpans(
+      max_selection_span, options_->selection_reduced_output_space()));
 }
 
 void FeatureProcessor::RetokenizeAndFindClick(const std::string& context,
@@ -930,68 +1023,117 @@ void FeatureProcessor::TokenizeSubstring(const UnicodeText& unicode_text,
   }
 }
 
+void FeatureProcessor::EmbeddingCache::Reset(const std::vector<Token>& tokens) {
+  token_spans_.clear();
+  token_spans_.reserve(tokens.size());
+  for (const Token& token : tokens) {
+    token_spans_.push_back({token.start, token.end});
+  }
+  other_rows_.clear();
+  rows_.assign(tokens.size() * row_size_, 0.0);
+  valid_.assign(tokens.size(), false);
+  num_cached_ = 0;
+}
+
+int FeatureProcessor::EmbeddingCache::FindRow(CodepointSpan span) const {
+  const auto token_it =
+      std::lower_bound(token_spans_.begin(), token_spans_.end(), span);
+  if (token_it != token_spans_.end() && *token_it == span) {
+    return token_it - token_spans_.begin();
+  }
+  const auto other_it = std::lower_bound(
+      other_rows_.begin(), other_rows_.end(), std::make_pair(span, -1));
+  if (other_it != other_rows_.end() && other_it->first == span) {
+    return other_it->second;
+  }
+  return -1;
+}
+
+const float* FeatureProcessor::EmbeddingCache::Find(const Token& token) const {
+  const int row = FindRow({token.start, token.end});
+  if (row < 0 || !valid_[row]) {
+    return nullptr;
+  }
+  return rows_.data() + row * row_size_;
+}
+
+void FeatureProcessor::EmbeddingCache::Insert(const Token& token,
+                                              const float* features) {
+  const CodepointSpan span = {token.start, token.end};
+  int row = FindRow(span);
+  if (row < 0) {
+    row = valid_.size();
+    other_rows_.insert(std::lower_bound(other_rows_.begin(), other_rows_.end(),
+                                        std::make_pair(span, -1)),
+                       std::make_pair(span, row));
+    rows_.resize(rows_.size() + row_size_);
+    valid_.push_back(false);
+  }
+  if (!valid_[row]) {
+    valid_[row] = true;
+    ++num_cached_;
+  }
+  std::copy(features, features + row_size_, rows_.begin() + row * row_size_);
+}
+
 bool FeatureProcessor::AppendTokenFeaturesWithCache(
     const Token& token, CodepointSpan selection_span_for_feature,
     const EmbeddingExecutor* embedding_executor,
     EmbeddingCache* embedding_cache,
     std::vector<float>* output_features) const {
-  // Look for the embedded features for the token in the cache, if there is one.
+  // The features are written directly to the output: the embedding followed
+  // by the dense features.
+  const int embedding_size = EmbeddingSize();
+  const int features_size = CachedTokenFeaturesSize();
+  output_features->resize(output_features->size() + features_size);
+  float* features =
+      output_features->data() + output_features->size() - features_size;
+  float* dense_features = features + embedding_size;
+  const bool is_in_span = token.IsContainedInSpan(selection_span_for_feature);
+
+  // Look for the token features in the cache, if there is one.
   if (embedding_cache) {
-    const auto it = embedding_cache->find({token.start, token.end});
-    if (it != embedding_cache->end()) {
-      // The embedded features were found in the cache, extract only the dense
-      // features.
-      std::vector<float> dense_features;
-      if (!feature_extractor_.Extract(
-              token, token.IsContainedInSpan(selection_span_for_feature),
-              /*sparse_features=*/nullptr, &dense_features)) {
-        TC_LOG(ERROR) << "Could not extract token's dense features.";
-        return false;
-      }
-
-      // Append both embedded and dense features to the output and return.
-      output_features->insert(output_features->end(), it->second.begin(),
-                              it->second.end());
-      output_features->insert(output_features->end(), dense_features.begin(),
-                              dense_features.end());
+    const float* cached_features = embedding_cache->Find(token);
+    if (cached_features != nullptr) {
+      std::copy(cached_features, cached_features + features_size, features);
+      feature_extractor_.SetSelectionMaskFeature(is_in_span, dense_features);
       return true;
     }
   }
 
-  // Extract the sparse and dense features.
-  std::vector<int> sparse_features;
-  std::vector<float> dense_features;
-  if (!feature_extractor_.Extract(
-          token, token.IsContainedInSpan(selection_span_for_feature),
-          &sparse_features, &dense_features)) {
-    TC_LOG(ERROR) << "Could not extract token's features.";
-    return false;
+  // Look for them in the shared cache, if there is one. The cached features
+  // depend only on the token text.
+  uint64 token_key = 0;
+  bool cached = false;
+  if (token_embedding_cache_) {
+    token_key = tc2farmhash::Fingerprint64(token.value);
+    cached = token_embedding_cache_->Lookup(token_key, features);
   }
 
-  // Embed the sparse features, appending them directly to the output.
-  const int embedding_size = GetOptions()->embedding_size();
-  output_features->resize(output_features->size() + embedding_size);
-  float* output_features_end =
-      output_features->data() + output_features->size();
-  if (!embedding_executor->AddEmbedding(
-          TensorView<int>(sparse_features.data(),
-                          {static_cast<int>(sparse_features.size())}),
-          /*dest=*/output_features_end - embedding_size,
-          /*dest_size=*/embedding_size)) {
-    TC_LOG(ERROR) << "Cound not embed token's sparse features.";
-    return false;
+  if (cached) {
+    feature_extractor_.SetSelectionMaskFeature(is_in_span, dense_features);
+  } else {
+    // Embed the sparse features, writing them directly to the output.
+    std::vector<int> sparse_features =
+        feature_extractor_.ExtractCharactergramFeatures(token);
+    if (!embedding_executor->AddEmbedding(
+            TensorView<int>(sparse_features.data(),
+                            {static_cast<int>(sparse_features.size())}),
+            /*dest=*/features, /*dest_size=*/embedding_size)) {
+      TC_LOG(ERROR) << "Cound not embed token's sparse features.";
+      return false;
+    }
+    feature_extractor_.ExtractDenseFeatures(token, is_in_span, dense_features);
+    if (token_embedding_cache_) {
+      token_embedding_cache_->Insert(token_key, features);
+    }
   }
 
-  // If there is a cache, the embedded features for the token were not in it,
-  // so insert them.
+  // If there is a cache, the features for the token were not in it, so insert
+  // them.
   if (embedding_cache) {
-    (*embedding_cache)[{token.start, token.end}] = std::vector<float>(
-        output_features_end - embedding_size, output_features_end);
+    embedding_cache->Insert(token, features);
   }
-
-  // Append the dense features to the output.
-  output_features->insert(output_features->end(), dense_features.begin(),
-                          dense_features.end());
   return true;
 }
 
@@ -19,19 +19,19 @@
 #ifndef LIBTEXTCLASSIFIER_FEATURE_PROCESSOR_H_
 #define LIBTEXTCLASSIFIER_FEATURE_PROCESSOR_H_
 
-#include <map>
 #include <memory>
-#include <set>
 #include <string>
 #include <vector>
 
 #include "cached-features.h"
 #include "model_generated.h"
+#include "token-embedding-cache.h"
 #include "token-feature-extractor.h"
 #include "tokenizer.h"
 #include "types.h"
 #include "util/base/integral_types.h"
 #include "util/base/logging.h"
+#include "util/flatbuffers.h"
 #include "util/utf8/unicodetext.h"
 #include "util/utf8/unilib.h"
 
@@ -69,6 +69,22 @@ void StripOrPadTokens(TokenSpan relative_click_span, int context_size,
 const UniLib* MaybeCreateUnilib(const UniLib* unilib,
                                 std::unique_ptr<UniLib>* owned_unilib);
 
+// Returns true if the two feature processors compute the same features for
+// every token, i.e. they extract the same sparse and dense features and use
+// embeddings of the same size and quantization. Then they can share embedding
+// caches.
+bool HaveCompatibleTokenFeatures(const FeatureProcessorOptions* options1,
+                                 const FeatureProcessorOptions* options2);
+
+// Returns the number of floats the embedding caches hold per token: the
+// embedding followed by the dense features.
+int CachedTokenFeaturesSize(const FeatureProcessorOptions* options);
+
+// Returns the token selection spans of all labels, as (left, right) pairs in
+// label order.
+std::vector<int32> MakeSelectionLabelSpans(int max_selection_span,
+                                           bool reduced_output_space);
+
 }  // namespace internal
 
 // Converts a codepoint span to a token span in the given list of tokens.
@@ -86,27 +102,73 @@ CodepointSpan TokenSpanToCodepointSpan(
 // Takes care of preparing features for the span prediction model.
 class FeatureProcessor {
  public:
-  // A cache mapping codepoint spans to embedded tokens features. An instance
-  // can be provided to multiple calls to ExtractFeatures() operating on the
-  // same context (the same codepoint spans corresponding to the same tokens),
-  // as an optimization. Note that the tokenizations do not have to be
-  // identical.
-  typedef std::map<CodepointSpan, std::vector<float>> EmbeddingCache;
+  // A cache of embedded token features. An instance can be provided to
+  // multiple calls to ExtractFeatures() operating on the same context (the
+  // same codepoint spans corresponding to the same tokens), as an
+  // optimization, also by different feature processors with compatible token
+  // features. A row holds the embedding of a token followed by its dense
+  // features (see CachedTokenFeaturesSize()). The rows are stored in one
+  // contiguous matrix with a row for every token passed to Reset(). The
+  // tokenizations do not have to be identical: tokens with other spans, e.g.
+  // from splitting tokens on the selection boundaries, get additional rows.
+  class EmbeddingCache {
+   public:
+    explicit EmbeddingCache(int row_size)
+        : row_size_(row_size), num_cached_(0) {}
+
+    // Drops all cached embeddings and prepares rows for the given tokens,
+    // which must be sorted by position.
+    void Reset(const std::vector<Token>& tokens);
+
+    // Returns the cached row of the token, or nullptr.
+    const float* Find(const Token& token) const;
+
+    // Caches the row of the token, which has row_size() floats.
+    void Insert(const Token& token, const float* row);
+
+    // Returns the number of cached embeddings.
+    int size() const { return num_cached_; }
+
+    int row_size() const { return row_size_; }
+
+   private:
+    // Returns the row of the span, or -1.
+    int FindRow(CodepointSpan span) const;
+
+    const int row_size_;
+    int num_cached_;
+
+    // Spans of the tokens passed to Reset(), whose rows come first.
+    std::vector<CodepointSpan> token_spans_;
+
+    // Spans of the tokens that were inserted later with their rows, sorted.
+    std::vector<std::pair<CodepointSpan, int>> other_rows_;
+
+    // The row matrix and whether each row holds cached features.
+    std::vector<float> rows_;
+    std::vector<bool> valid_;
+  };
 
   // If unilib is nullptr, will create and own an instance of a UniLib,
   // otherwise will use what's passed in.
-  explicit FeatureProcessor(const FeatureProcessorOptions* options,
-                            const UniLib* unilib = nullptr)
+  // If token_embedding_cache is not nullptr, token features are looked up in
+  // and added to it, with rows of CachedTokenFeaturesSize() floats. It is not
+  // owned and must outlive the feature processor.
+  explicit FeatureProcessor(
+      const FeatureProcessorOptions* options, const UniLib* unilib = nullptr,
+      TokenEmbeddingCache* token_embedding_cache = nullptr)
       : owned_unilib_(nullptr),
         unilib_(internal::MaybeCreateUnilib(unilib, &owned_unilib_)),
         feature_extractor_(internal::BuildTokenFeatureExtractorOptions(options),
                            *unilib_),
+        token_embedding_cache_(token_embedding_cache),
         options_(options),
         tokenizer_(
             options->tokenization_codepoint_config() != nullptr
                 ? Tokenizer({options->tokenization_codepoint_config()->begin(),
                              options->tokenization_codepoint_config()->end()},
-                            options->tokenize_on_script_change())
+                            options->tokenize_on_script_change(),
+                            options->sorted_codepoint_tables())
                 : Tokenizer({}, /*split_on_script_change=*/false)) {
     MakeLabelMaps();
     if (options->supported_codepoint_ranges() != nullptr) {
@@ -133,13 +195,16 @@ class FeatureProcessor {
   bool LabelToTokenSpan(int label, TokenSpan* token_span) const;
 
   // Gets the total number of selection labels.
-  int GetSelectionLabelCount() const { return label_to_selection_.size(); }
+  int GetSelectionLabelCount() const { return label_to_selection_.size() / 2; }
 
   // Gets the string value for given collection label.
   std::string LabelToCollection(int label) const;
 
   // Gets the total number of collections of the model.
-  int NumCollections() const { return collection_to_label_.size(); }
+  int NumCollections() const {
+    return options_->collections() != nullptr ? options_->collections()->size()
+                                              : 0;
+  }
 
   // Gets the name of the default collection.
   std::string GetDefaultCollection() const;
@@ -185,6 +250,12 @@ class FeatureProcessor {
 
   int EmbeddingSize() const { return options_->embedding_size(); }
 
+  // Returns the row size of the embedding caches used with this feature
+  // processor.
+  int CachedTokenFeaturesSize() const {
+    return EmbeddingSize() + DenseFeaturesCount();
+  }
+
   // Splits context to several segments.
   std::vector<UnicodeTextRange> SplitContext(
       const UnicodeText& context_unicode) const;
@@ -214,7 +285,8 @@ class FeatureProcessor {
   // unknown collections.
   int CollectionToLabel(const std::string& collection) const;
 
-  // Prepares mapping from collection names to labels.
+  // Prepares the mapping from labels to token selection spans, read from the
+  // model if it has it.
   void MakeLabelMaps();
 
   // Gets the number of spannable tokens for the model.
@@ -294,8 +366,10 @@ class FeatureProcessor {
                                  std::vector<Token>* tokens) const;
 
   // Extracts the features of a token and appends them to the output vector.
-  // Uses the embedding cache to to avoid re-extracting the re-embedding the
-  // sparse features for the same token.
+  // Uses the embedding caches to avoid re-extracting and re-embedding the
+  // features of the same token. Only the selection mask feature is recomputed
+  // on a cache hit, as it is the only one that doesn't depend on the token
+  // value alone.
   bool AppendTokenFeaturesWithCache(const Token& token,
                                     CodepointSpan selection_span_for_feature,
                                     const EmbeddingExecutor* embedding_executor,
@@ -309,6 +383,8 @@ class FeatureProcessor {
  protected:
   const TokenFeatureExtractor feature_extractor_;
 
+  TokenEmbeddingCache* const token_embedding_cache_;
+
   // Codepoint ranges that define what codepoints are supported by the model.
   // NOTE: Must be sorted.
   std::vector<CodepointRange> supported_codepoint_ranges_;
@@ -320,18 +396,16 @@ class FeatureProcessor {
   std::vector<CodepointRange> internal_tokenizer_codepoint_ranges_;
 
  private:
-  // Set of codepoints that will be stripped from beginning and end of
+  // Sorted codepoints that will be stripped from beginning and end of
   // predicted spans.
-  std::set<int32> ignored_span_boundary_codepoints_;
+  std::vector<int32> ignored_span_boundary_codepoints_;
 
   const FeatureProcessorOptions* const options_;
 
-  // Mapping between token selection spans and labels ids.
-  std::map<TokenSpan, int> selection_to_label_;
-  std::vector<TokenSpan> label_to_selection_;
-
-  // Mapping between collections and labels.
-  std::map<std::string, int> collection_to_label_;
+  // Mapping from label ids to token selection spans, as (left, right) pairs in
+  // label order. The inverse is computed by TokenSpanToLabel, and collections
+  // are looked up in the options.
+  IntTable label_to_selection_;
 
   Tokenizer tokenizer_;
 };
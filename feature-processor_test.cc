@@ -49,6 +49,17 @@ Matcher<std::vector<float>> ElementsAreFloat(const std::vector<float>& values) {
   return ElementsAreArray(matchers);
 }
 
+std::vector<float> CachedEmbedding(
+    const FeatureProcessor::EmbeddingCache& embedding_cache,
+    const Token& token) {
+  const float* embedding = embedding_cache.Find(token);
+  if (embedding == nullptr) {
+    return {};
+  }
+  return std::vector<float>(embedding,
+                            embedding + embedding_cache.row_size());
+}
+
 class TestingFeatureProcessor : public FeatureProcessor {
  public:
   using FeatureProcessor::CountIgnoredSpanBoundaryCodepoints;
@@ -59,6 +70,7 @@ class TestingFeatureProcessor : public FeatureProcessor {
   using FeatureProcessor::StripTokensFromOtherLines;
   using FeatureProcessor::supported_codepoint_ranges_;
   using FeatureProcessor::SupportedCodepointsRatio;
+  using FeatureProcessor::TokenSpanToLabel;
 };
 
 // EmbeddingExecutor that always returns features based on
@@ -442,6 +454,40 @@ TEST(FeatureProcessorTest, SpanToLabelIgnoresPunctuation) {
   EXPECT_EQ(label2, label3);
 }
 
+TEST(FeatureProcessorTest, TokenSpanToLabelInvertsLabelToTokenSpan) {
+  CREATE_UNILIB_FOR_TESTING;
+  for (const bool reduced_output_space : {false, true}) {
+    for (const bool precomputed_spans : {false, true}) {
+      FeatureProcessorOptionsT options;
+      options.max_selection_span = 5;
+      options.selection_reduced_output_space = reduced_output_space;
+      if (precomputed_spans) {
+        // As stored by the model builder, read in place.
+        options.selection_label_spans =
+            internal::MakeSelectionLabelSpans(5, reduced_output_space);
+      }
+      flatbuffers::DetachedBuffer options_fb =
+          PackFeatureProcessorOptions(options);
+      TestingFeatureProcessor feature_processor(
+          flatbuffers::GetRoot<FeatureProcessorOptions>(options_fb.data()),
+          &unilib);
+
+      EXPECT_EQ(feature_processor.GetSelectionLabelCount(),
+                reduced_output_space ? 21 : 36);
+      for (int label = 0; label < feature_processor.GetSelectionLabelCount();
+           ++label) {
+        TokenSpan token_span;
+        ASSERT_TRUE(feature_processor.LabelToTokenSpan(label, &token_span));
+        EXPECT_EQ(feature_processor.TokenSpanToLabel(token_span), label);
+      }
+      EXPECT_EQ(feature_processor.TokenSpanToLabel({6, 0}), kInvalidLabel);
+      EXPECT_EQ(feature_processor.TokenSpanToLabel({0, -1}), kInvalidLabel);
+      EXPECT_EQ(feature_processor.TokenSpanToLabel({3, 3}),
+                reduced_output_space ? kInvalidLabel : 21);
+    }
+  }
+}
+
 TEST(FeatureProcessorTest, CenterTokenFromClick) {
   int token_index;
 
@@ -690,11 +736,11 @@ TEST(FeatureProcessorTest, EmbeddingCache) {
   const std::vector<float> cached_padding_features = {10.0, -10.0, 10.0, -10.0};
   const std::vector<float> cached_features1 = {1.0, 2.0, 3.0, 4.0};
   const std::vector<float> cached_features2 = {5.0, 6.0, 7.0, 8.0};
-  FeatureProcessor::EmbeddingCache embedding_cache = {
-      {{kInvalidIndex, kInvalidIndex}, cached_padding_features},
-      {{4, 7}, cached_features1},
-      {{12, 15}, cached_features2},
-  };
+  FeatureProcessor::EmbeddingCache embedding_cache(/*row_size=*/4);
+  embedding_cache.Reset(tokens);
+  embedding_cache.Insert(Token(), cached_padding_features.data());
+  embedding_cache.Insert(tokens[1], cached_features1.data());
+  embedding_cache.Insert(tokens[3], cached_features2.data());
 
   EXPECT_TRUE(feature_processor.ExtractFeatures(
       tokens, /*token_span=*/{0, 6},
@@ -715,17 +761,175 @@ TEST(FeatureProcessorTest, EmbeddingCache) {
   // Check that the real embeddings were cached.
   EXPECT_EQ(embedding_cache.size(), 7);
   EXPECT_THAT(Subvector(features, 4, 8),
-              ElementsAreFloat(embedding_cache.at({0, 3})));
+              ElementsAreFloat(CachedEmbedding(embedding_cache, tokens[0])));
   EXPECT_THAT(Subvector(features, 12, 16),
-              ElementsAreFloat(embedding_cache.at({8, 11})));
+              ElementsAreFloat(CachedEmbedding(embedding_cache, tokens[2])));
   EXPECT_THAT(Subvector(features, 20, 24),
-              ElementsAreFloat(embedding_cache.at({8, 11})));
+              ElementsAreFloat(CachedEmbedding(embedding_cache, tokens[2])));
   EXPECT_THAT(Subvector(features, 28, 32),
-              ElementsAreFloat(embedding_cache.at({16, 19})));
+              ElementsAreFloat(CachedEmbedding(embedding_cache, tokens[4])));
   EXPECT_THAT(Subvector(features, 32, 36),
-              ElementsAreFloat(embedding_cache.at({20, 23})));
+              ElementsAreFloat(CachedEmbedding(embedding_cache, tokens[5])));
 }
 
+TEST(FeatureProcessorTest, EmbeddingCacheBridgesRetokenization) {
+  const std::vector<Token> tokens = {Token("aaa", 0, 3),
+                                     Token("bbbccc", 4, 10)};
+  FeatureProcessor::EmbeddingCache embedding_cache(/*row_size=*/2);
+  embedding_cache.Reset(tokens);
+  EXPECT_EQ(embedding_cache.Find(tokens[0]), nullptr);
+
+  const std::vector<float> embedding1 = {1.0, 2.0};
+  const std::vector<float> embedding2 = {3.0, 4.0};
+  const std::vector<float> embedding3 = {5.0, 6.0};
+  embedding_cache.Insert(tokens[0], embedding1.data());
+  // Tokens that were not passed to Reset(), e.g. from splitting "bbbccc" on a
+  // selection boundary, are cached by their span.
+  embedding_cache.Insert(Token("ccc", 7, 10), embedding2.data());
+  embedding_cache.Insert(Token("bbb", 4, 7), embedding3.data());
+
+  EXPECT_EQ(embedding_cache.size(), 3);
+  EXPECT_THAT(CachedEmbedding(embedding_cache, Token("aaa", 0, 3)),
+              ElementsAreFloat(embedding1));
+  EXPECT_THAT(CachedEmbedding(embedding_cache, Token("ccc", 7, 10)),
+              ElementsAreFloat(embedding2));
+  EXPECT_THAT(CachedEmbedding(embedding_cache, Token("bbb", 4, 7)),
+              ElementsAreFloat(embedding3));
+  EXPECT_EQ(embedding_cache.Find(tokens[1]), nullptr);
+
+  embedding_cache.Reset(tokens);
+  EXPECT_EQ(embedding_cache.size(), 0);
+  EXPECT_EQ(embedding_cache.Find(tokens[0]), nullptr);
+  EXPECT_EQ(embedding_cache.Find(Token("ccc", 7, 10)), nullptr);
+}
+
+// FakeEmbeddingExecutor that counts the number of embedded tokens.
+class CountingEmbeddingExecutor : public FakeEmbeddingExecutor {
+ public:
+  bool AddEmbedding(const TensorView<int>& sparse_features, float* dest,
+                    int dest_size) const override {
+    ++num_calls;
+    return FakeEmbeddingExecutor::AddEmbedding(sparse_features, dest,
+                                               dest_size);
+  }
+
+  mutable int num_calls = 0;
+};
+
+TEST(FeatureProcessorTest, TokenEmbeddingCache) {
+  FeatureProcessorOptionsT options;
+  options.context_size = 2;
+  options.max_selection_span = 2;
+  options.snap_label_span_boundaries_to_containing_tokens = false;
+  options.feature_version = 2;
+  options.embedding_size = 4;
+
+  flatbuffers::DetachedBuffer options_fb = PackFeatureProcessorOptions(options);
+  CREATE_UNILIB_FOR_TESTING;
+  TokenEmbeddingCache token_embedding_cache(/*capacity=*/16,
+                                            /*embedding_size=*/4);
+  TestingFeatureProcessor feature_processor(
+      flatbuffers::GetRoot<FeatureProcessorOptions>(options_fb.data()),
+      &unilib, &token_embedding_cache);
+  CountingEmbeddingExecutor embedding_executor;
+
+  // The first call embeds the three distinct tokens and the padding.
+  const std::vector<Token> tokens = {Token("aaa", 0, 3), Token("bbb", 4, 7),
+                                     Token("aaa", 8, 11)};
+  std::unique_ptr<CachedFeatures> cached_features;
+  ASSERT_TRUE(feature_processor.ExtractFeatures(
+      tokens, /*token_span=*/{0, 3},
+      /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
+      &embedding_executor, /*embedding_cache=*/nullptr,
+      /*feature_vector_size=*/4, &cached_features));
+  EXPECT_EQ(embedding_executor.num_calls, 3);
+  std::vector<float> features;
+  cached_features->AppendClickContextFeaturesForClick(1, &features);
+
+  // The same tokens at other positions in another call are all cache hits and
+  // produce the same features.
+  const std::vector<Token> shifted_tokens = {
+      Token("aaa", 10, 13), Token("bbb", 14, 17), Token("aaa", 18, 21)};
+  ASSERT_TRUE(feature_processor.ExtractFeatures(
+      shifted_tokens, /*token_span=*/{0, 3},
+      /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
+      &embedding_executor, /*embedding_cache=*/nullptr,
+      /*feature_vector_size=*/4, &cached_features));
+  EXPECT_EQ(embedding_executor.num_calls, 3);
+  std::vector<float> shifted_features;
+  cached_features->AppendClickContextFeaturesForClick(1, &shifted_features);
+  EXPECT_THAT(shifted_features, ElementsAreFloat(features));
+
+  const TokenEmbeddingCache::Stats stats = token_embedding_cache.GetStats();
+  EXPECT_EQ(stats.size, 3);
+  EXPECT_EQ(stats.hits, 5);
+  EXPECT_EQ(stats.misses, 3);
+}
+
+#ifdef LIBTEXTCLASSIFIER_TEST_ICU
+TEST(FeatureProcessorTest, EmbeddingCachesHoldDenseFeatures) {
+  FeatureProcessorOptionsT options;
+  options.context_size = 1;
+  options.max_selection_span = 1;
+  options.snap_label_span_boundaries_to_containing_tokens = false;
+  options.feature_version = 2;
+  options.embedding_size = 4;
+  options.extract_case_feature = true;
+  options.extract_selection_mask_feature = true;
+  options.regexp_feature.push_back("^[a-z]+$");
+
+  flatbuffers::DetachedBuffer options_fb = PackFeatureProcessorOptions(options);
+  CREATE_UNILIB_FOR_TESTING;
+  TokenEmbeddingCache token_embedding_cache(/*capacity=*/16,
+                                            /*embedding_size=*/7);
+  TestingFeatureProcessor feature_processor(
+      flatbuffers::GetRoot<FeatureProcessorOptions>(options_fb.data()),
+      &unilib, &token_embedding_cache);
+  TestingFeatureProcessor uncached_feature_processor(
+      flatbuffers::GetRoot<FeatureProcessorOptions>(options_fb.data()),
+      &unilib);
+  ASSERT_EQ(feature_processor.CachedTokenFeaturesSize(), 7);
+  CountingEmbeddingExecutor embedding_executor;
+
+  const std::vector<Token> tokens = {Token("Aaa", 0, 3), Token("bbb", 4, 7),
+                                     Token("Ccc", 8, 11)};
+  FeatureProcessor::EmbeddingCache embedding_cache(
+      feature_processor.CachedTokenFeaturesSize());
+  embedding_cache.Reset(tokens);
+  std::unique_ptr<CachedFeatures> cached_features;
+  ASSERT_TRUE(feature_processor.ExtractFeatures(
+      tokens, /*token_span=*/{0, 3},
+      /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
+      &embedding_executor, &embedding_cache, /*feature_vector_size=*/7,
+      &cached_features));
+  EXPECT_EQ(embedding_executor.num_calls, 4);
+
+  // Cache hits reuse the case and regexp features, but not the selection mask
+  // feature.
+  for (FeatureProcessor::EmbeddingCache* cache :
+       {&embedding_cache,
+        static_cast<FeatureProcessor::EmbeddingCache*>(nullptr)}) {
+    ASSERT_TRUE(feature_processor.ExtractFeatures(
+        tokens, /*token_span=*/{0, 3}, /*selection_span_for_feature=*/{4, 7},
+        &embedding_executor, cache, /*feature_vector_size=*/7,
+        &cached_features));
+    std::vector<float> features;
+    cached_features->AppendClickContextFeaturesForClick(1, &features);
+
+    ASSERT_TRUE(uncached_feature_processor.ExtractFeatures(
+        tokens, /*token_span=*/{0, 3}, /*selection_span_for_feature=*/{4, 7},
+        &embedding_executor, /*embedding_cache=*/nullptr,
+        /*feature_vector_size=*/7, &cached_features));
+    std::vector<float> expected_features;
+    cached_features->AppendClickContextFeaturesForClick(1, &expected_features);
+    EXPECT_THAT(features, ElementsAreFloat(expected_features));
+    EXPECT_THAT(Subvector(features, 11, 14),
+                ElementsAreFloat({-1.0, 1.0, 1.0}));
+  }
+  EXPECT_EQ(embedding_executor.num_calls, 12);
+}
+#endif
+
 TEST(FeatureProcessorTest, StripUnusedTokensWithNoRelativeClick) {
   std::vector<Token> tokens_orig{
       Token("0", 0, 0), Token("1", 0, 0), Token("2", 0, 0),  Token("3", 0, 0),
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "incremental-annotator.h"
+
+#include <iterator>
+
+#include "util/utf8/unicodetext.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+// Returns the byte offset of the codepoint with the given index.
+int CodepointToByteOffset(const std::string& text, int codepoint_index) {
+  const UnicodeText text_unicode = UTF8ToUnicodeText(text, /*do_copy=*/false);
+  auto it = text_unicode.begin();
+  std::advance(it, codepoint_index);
+  return it.utf8_data() - text_unicode.data();
+}
+
+}  // namespace
+
+IncrementalAnnotator::IncrementalAnnotator(const TextClassifier* classifier,
+                                           const AnnotationOptions& options)
+    : classifier_(classifier), options_(options) {}
+
+std::vector<IncrementalAnnotator::Line> IncrementalAnnotator::SplitLines(
+    const std::string& text) {
+  std::vector<Line> lines;
+  int line_start = 0;
+  while (line_start < text.size()) {
+    size_t line_end = text.find('\n', line_start);
+    line_end = line_end == std::string::npos ? text.size() : line_end + 1;
+    Line line;
+    line.text = text.substr(line_start, line_end - line_start);
+    line.num_codepoints =
+        UTF8ToUnicodeText(line.text, /*do_copy=*/false).size_codepoints();
+    lines.push_back(std::move(line));
+    line_start = line_end;
+  }
+  return lines;
+}
+
+bool IncrementalAnnotator::SetText(const std::string& text) {
+  return Edit({0, num_codepoints_}, text);
+}
+
+bool IncrementalAnnotator::Edit(CodepointSpan span,
+                                const std::string& replacement) {
+  if (span.first < 0 || span.first > span.second ||
+      span.second > num_codepoints_) {
+    return false;
+  }
+  const UnicodeText replacement_unicode =
+      UTF8ToUnicodeText(replacement, /*do_copy=*/false);
+  if (!replacement_unicode.is_valid()) {
+    return false;
+  }
+
+  // Find the lines that contain the ends of the span. The line that starts at
+  // the end of the span is included too, since the replacement might join it
+  // with the previous one.
+  int first_line = lines_.size();
+  int last_line = lines_.size();
+  int lines_start = 0;
+  int line_start = 0;
+  for (int i = 0; i < lines_.size(); ++i) {
+    const int line_end = line_start + lines_[i].num_codepoints;
+    if (first_line == lines_.size() &&
+        (span.first < line_end || i == lines_.size() - 1)) {
+      first_line = i;
+      lines_start = line_start;
+    }
+    if (span.second < line_end || i == lines_.size() - 1) {
+      last_line = i;
+      break;
+    }
+    line_start = line_end;
+  }
+
+  // Apply the edit to the text of these lines, and split it again.
+  std::string text;
+  for (int i = first_line; i < last_line + 1 && i < lines_.size(); ++i) {
+    text += lines_[i].text;
+  }
+  const int edit_begin = CodepointToByteOffset(text, span.first - lines_start);
+  const int edit_end = CodepointToByteOffset(text, span.second - lines_start);
+  text.replace(edit_begin, edit_end - edit_begin, replacement);
+  std::vector<Line> new_lines = SplitLines(text);
+
+  // Keep the annotations of lines whose text did not change.
+  for (Line& new_line : new_lines) {
+    for (int i = first_line; i < last_line + 1 && i < lines_.size(); ++i) {
+      if (lines_[i].annotated && lines_[i].text == new_line.text) {
+        new_line.annotated = true;
+        new_line.annotations = std::move(lines_[i].annotations);
+        lines_[i].annotated = false;
+        break;
+      }
+    }
+  }
+
+  const auto erase_begin = lines_.begin() + first_line;
+  const auto erase_end =
+      last_line < lines_.size() ? lines_.begin() + last_line + 1 : lines_.end();
+  const auto insert_position = lines_.erase(erase_begin, erase_end);
+  lines_.insert(insert_position, std::make_move_iterator(new_lines.begin()),
+                std::make_move_iterator(new_lines.end()));
+
+  num_codepoints_ +=
+      replacement_unicode.size_codepoints() - (span.second - span.first);
+  dirty_ = true;
+  return true;
+}
+
+const std::vector<AnnotatedSpan>& IncrementalAnnotator::Annotate() {
+  if (!dirty_) {
+    return annotations_;
+  }
+  annotations_.clear();
+  int line_start = 0;
+  for (Line& line : lines_) {
+    if (line.annotated) {
+      ++stats_.reused_lines;
+    } else {
+      std::string line_text = line.text;
+      if (!line_text.empty() && line_text.back() == '\n') {
+        line_text.pop_back();
+      }
+      line.annotations = classifier_->Annotate(line_text, options_);
+      line.annotated = true;
+      ++stats_.annotated_lines;
+    }
+    for (const AnnotatedSpan& annotation : line.annotations) {
+      annotations_.push_back(annotation);
+      annotations_.back().span.first += line_start;
+      annotations_.back().span.second += line_start;
+    }
+    line_start += line.num_codepoints;
+  }
+  dirty_ = false;
+  return annotations_;
+}
+
+std::string IncrementalAnnotator::text() const {
+  std::string result;
+  for (const Line& line : lines_) {
+    result += line.text;
+  }
+  return result;
+}
+
+}  // namespace libtextclassifier2
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Annotation of text that is edited repeatedly, e.g. in an editor.
+
+#ifndef LIBTEXTCLASSIFIER_INCREMENTAL_ANNOTATOR_H_
+#define LIBTEXTCLASSIFIER_INCREMENTAL_ANNOTATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "text-classifier.h"
+#include "types.h"
+#include "util/base/integral_types.h"
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+// Keeps the annotations of a text across edits, and re-annotates only the
+// lines an edit touched. The annotations of the other lines are reused, with
+// their offsets shifted.
+//
+// Every line is annotated on its own, so annotations never cross a line
+// break. This gives the same result as TextClassifier::Annotate on the whole
+// text for models that only use the line with the click, as long as no regex
+// or datetime match spans several lines.
+//
+// NOTE: Not thread-safe. The classifier must outlive the annotator.
+class IncrementalAnnotator {
+ public:
+  // Counts of annotated and reused lines, for tests and evaluations.
+  struct Stats {
+    int64 annotated_lines = 0;
+    int64 reused_lines = 0;
+  };
+
+  IncrementalAnnotator(const TextClassifier* classifier,
+                       const AnnotationOptions& options);
+
+  // Replaces the whole text.
+  bool SetText(const std::string& text);
+
+  // Replaces the codepoints in 'span' with the UTF-8 'replacement'. Returns
+  // false and leaves the text unchanged if the span is out of bounds or the
+  // replacement is not valid UTF-8.
+  bool Edit(CodepointSpan span, const std::string& replacement);
+
+  // Returns the annotations of the current text, with spans in codepoints.
+  // Annotates the lines that changed since the previous call.
+  const std::vector<AnnotatedSpan>& Annotate();
+
+  // Returns the current text.
+  std::string text() const;
+
+  int num_codepoints() const { return num_codepoints_; }
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Line {
+    // The text of the line, including the line break at the end, if any.
+    std::string text;
+    int num_codepoints = 0;
+
+    bool annotated = false;
+
+    // Annotations, with spans relative to the start of the line.
+    std::vector<AnnotatedSpan> annotations;
+  };
+
+  // Splits the text into lines that end after each line break.
+  static std::vector<Line> SplitLines(const std::string& text);
+
+  const TextClassifier* classifier_;
+  const AnnotationOptions options_;
+
+  std::vector<Line> lines_;
+  int num_codepoints_ = 0;
+
+  // The annotations of the whole text, valid if !dirty_.
+  std::vector<AnnotatedSpan> annotations_;
+  bool dirty_ = true;
+
+  Stats stats_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(IncrementalAnnotator);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_INCREMENTAL_ANNOTATOR_H_
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "incremental-annotator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+using testing::Values;
+
+std::string GetModelPath() { return LIBTEXTCLASSIFIER_TEST_DATA_DIR; }
+
+std::string FirstResult(const std::vector<ClassificationResult>& results) {
+  if (results.empty()) {
+    return "<INVALID RESULTS>";
+  }
+  return results[0].collection;
+}
+
+void ExpectSameAnnotations(const std::vector<AnnotatedSpan>& annotations,
+                           const std::vector<AnnotatedSpan>& expected) {
+  ASSERT_EQ(annotations.size(), expected.size());
+  for (int i = 0; i < annotations.size(); ++i) {
+    EXPECT_EQ(annotations[i].span, expected[i].span);
+    EXPECT_EQ(FirstResult(annotations[i].classification),
+              FirstResult(expected[i].classification));
+  }
+}
+
+class IncrementalAnnotatorTest : public ::testing::TestWithParam<const char*> {
+};
+
+INSTANTIATE_TEST_CASE_P(ClickContext, IncrementalAnnotatorTest,
+                        Values("test_model_cc.fb"));
+INSTANTIATE_TEST_CASE_P(BoundsSensitive, IncrementalAnnotatorTest,
+                        Values("test_model.fb"));
+
+TEST_P(IncrementalAnnotatorTest, ReannotatesOnlyEditedLines) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+
+  IncrementalAnnotator annotator(classifier.get(),
+                                 AnnotationOptions::Default());
+  ASSERT_TRUE(annotator.SetText(
+      "& saw Barack Obama today .. 350 Third Street, Cambridge\n"
+      "and my phone number is 853 225 3556\n"
+      "see you in Zürich\n"));
+  const std::vector<AnnotatedSpan> initial = annotator.Annotate();
+  ASSERT_FALSE(initial.empty());
+  EXPECT_EQ(annotator.stats().annotated_lines, 3);
+  // The test models only use the line with the click, so every result is the
+  // same as annotating the whole current text.
+  ExpectSameAnnotations(initial, classifier->Annotate(annotator.text()));
+
+  // Replace the phone number. Only the second line is annotated again.
+  ASSERT_TRUE(annotator.Edit({79, 91}, "(800) 123-4567"));
+  const std::vector<AnnotatedSpan> edited = annotator.Annotate();
+  EXPECT_EQ(annotator.stats().annotated_lines, 4);
+  EXPECT_EQ(annotator.stats().reused_lines, 2);
+  ExpectSameAnnotations(edited, classifier->Annotate(annotator.text()));
+
+  // The result is the same as annotating the edited text from scratch.
+  IncrementalAnnotator fresh_annotator(classifier.get(),
+                                       AnnotationOptions::Default());
+  ASSERT_TRUE(fresh_annotator.SetText(annotator.text()));
+  ExpectSameAnnotations(edited, fresh_annotator.Annotate());
+  EXPECT_EQ(annotator.text(),
+            "& saw Barack Obama today .. 350 Third Street, Cambridge\n"
+            "and my phone number is (800) 123-4567\n"
+            "see you in Zürich\n");
+
+  // Inserting a line shifts the annotations of the following lines.
+  ASSERT_TRUE(annotator.Edit({0, 0}, "Hello\n"));
+  const std::vector<AnnotatedSpan> shifted = annotator.Annotate();
+  EXPECT_EQ(annotator.stats().annotated_lines, 5);
+  ExpectSameAnnotations(shifted, classifier->Annotate(annotator.text()));
+  ASSERT_EQ(shifted.size(), edited.size());
+  for (int i = 0; i < shifted.size(); ++i) {
+    EXPECT_EQ(shifted[i].span,
+              CodepointSpan(edited[i].span.first + 6,
+                            edited[i].span.second + 6));
+  }
+
+  // Undoing the edits gives the initial annotations.
+  ASSERT_TRUE(annotator.Edit({0, 6}, ""));
+  ExpectSameAnnotations(annotator.Annotate(),
+                        classifier->Annotate(annotator.text()));
+  ASSERT_TRUE(annotator.Edit({79, 93}, "853 225 3556"));
+  ExpectSameAnnotations(annotator.Annotate(),
+                        classifier->Annotate(annotator.text()));
+  ExpectSameAnnotations(annotator.Annotate(), initial);
+}
+
+TEST_P(IncrementalAnnotatorTest, RejectsInvalidEdits) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+
+  IncrementalAnnotator annotator(classifier.get(),
+                                 AnnotationOptions::Default());
+  ASSERT_TRUE(annotator.SetText("Zürich"));
+  EXPECT_FALSE(annotator.Edit({3, 7}, "x"));
+  EXPECT_FALSE(annotator.Edit({4, 3}, "x"));
+  EXPECT_FALSE(annotator.Edit({0, 0}, "\xFF"));
+  EXPECT_EQ(annotator.text(), "Zürich");
+  EXPECT_EQ(annotator.num_codepoints(), 6);
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
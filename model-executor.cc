@@ -16,6 +16,8 @@
 
 #include "model-executor.h"
 
+#include <cstdint>
+
 #include "quantization.h"
 #include "util/base/logging.h"
 
@@ -32,15 +34,45 @@ bool FromModelSpec(const tflite::Model* model_spec,
 }
 }  // namespace internal
 
-std::unique_ptr<tflite::Interpreter> ModelExecutor::CreateInterpreter() const {
+namespace {
+class TFLiteExecutionContext : public ExecutionContext {
+ public:
+  explicit TFLiteExecutionContext(
+      std::unique_ptr<tflite::Interpreter> interpreter)
+      : interpreter_(std::move(interpreter)) {}
+
+  tflite::Interpreter* interpreter() const { return interpreter_.get(); }
+
+ private:
+  std::unique_ptr<tflite::Interpreter> interpreter_;
+};
+}  // namespace
+
+std::unique_ptr<ExecutionContext> TFLiteModelExecutor::CreateContext() const {
   std::unique_ptr<tflite::Interpreter> interpreter;
   tflite::InterpreterBuilder(*model_, builtins_)(&interpreter);
-  return interpreter;
+  if (!interpreter) {
+    TC_LOG(ERROR) << "Could not build TFLite interpreter.";
+    return nullptr;
+  }
+  return std::unique_ptr<ExecutionContext>(
+      new TFLiteExecutionContext(std::move(interpreter)));
+}
+
+TensorView<float> TFLiteModelExecutor::ComputeLogits(
+    const TensorView<float>& features, ExecutionContext* context) const {
+  if (context == nullptr) {
+    return TensorView<float>::Invalid();
+  }
+  return ComputeLogitsHelper(
+      kInputIndexFeatures, kOutputIndexLogits, features,
+      static_cast<TFLiteExecutionContext*>(context)->interpreter());
 }
 
 std::unique_ptr<TFLiteEmbeddingExecutor> TFLiteEmbeddingExecutor::Instance(
     const flatbuffers::Vector<uint8_t>* model_spec_buffer, int embedding_size,
-    int quantization_bits) {
+    int quantization_bits, bool unpack_embeddings,
+    const flatbuffers::Vector<int32_t>* bucket_rows) {
   const tflite::Model* model_spec =
       flatbuffers::GetRoot<tflite::Model>(model_spec_buffer->data());
   flatbuffers::Verifier verifier(model_spec_buffer->data(),
@@ -79,16 +111,34 @@ std::unique_ptr<TFLiteEmbeddingExecutor> TFLiteEmbeddingExecutor::Instance(
     TC_LOG(ERROR) << "Mismatch in quantization parameters.";
     return nullptr;
   }
+  if (bucket_rows != nullptr) {
+    if (static_cast<int>(bucket_rows->size()) != num_buckets) {
+      TC_LOG(ERROR) << "Mismatch in the number of embedding rows.";
+      return nullptr;
+    }
+    for (const int row : *bucket_rows) {
+      if (row < 0 || row >= num_buckets) {
+        TC_LOG(ERROR) << "Invalid embedding row: " << row;
+        return nullptr;
+      }
+    }
+  }
 
-  return std::unique_ptr<TFLiteEmbeddingExecutor>(new TFLiteEmbeddingExecutor(
+  std::unique_ptr<TFLiteEmbeddingExecutor> executor(new TFLiteEmbeddingExecutor(
       std::move(model), quantization_bits, num_buckets, bytes_per_embedding,
-      embedding_size, scales, embeddings, std::move(interpreter)));
+      embedding_size, scales, embeddings, bucket_rows,
+      std::move(interpreter)));
+  if (unpack_embeddings) {
+    executor->UnpackEmbeddings();
+  }
+  return executor;
 }
 
 TFLiteEmbeddingExecutor::TFLiteEmbeddingExecutor(
     std::unique_ptr<const tflite::FlatBufferModel> model, int quantization_bits,
     int num_buckets, int bytes_per_embedding, int output_embedding_size,
     const TfLiteTensor* scales, const TfLiteTensor* embeddings,
+    const flatbuffers::Vector<int32_t>* bucket_rows,
     std::unique_ptr<tflite::Interpreter> interpreter)
     : model_(std::move(model)),
       quantization_bits_(quantization_bits),
@@ -97,8 +147,28 @@ TFLiteEmbeddingExecutor::TFLiteEmbeddingExecutor(
       output_embedding_size_(output_embedding_size),
       scales_(scales),
       embeddings_(embeddings),
+      bucket_rows_(bucket_rows),
       interpreter_(std::move(interpreter)) {}
 
+void TFLiteEmbeddingExecutor::UnpackEmbeddings() {
+  static const int kCacheLineSize = 64;
+  unpacked_stride_ = UnpackedEmbeddingStride(output_embedding_size_);
+  unpacked_storage_.assign(
+      static_cast<size_t>(num_buckets_) * unpacked_stride_ + kCacheLineSize - 1,
+      0);
+  int8* table = unpacked_storage_.data();
+  table += (kCacheLineSize -
+            reinterpret_cast<uintptr_t>(table) % kCacheLineSize) %
+           kCacheLineSize;
+  for (int bucket_id = 0; bucket_id < num_buckets_; ++bucket_id) {
+    UnpackEmbedding(embeddings_->data.uint8, bytes_per_embedding_,
+                    quantization_bits_, bucket_id,
+                    table + static_cast<size_t>(bucket_id) * unpacked_stride_,
+                    output_embedding_size_);
+  }
+  unpacked_embeddings_ = table;
+}
+
 bool TFLiteEmbeddingExecutor::AddEmbedding(
     const TensorView<int>& sparse_features, float* dest, int dest_size) const {
   if (dest_size != output_embedding_size_) {
@@ -112,10 +182,17 @@ bool TFLiteEmbeddingExecutor::AddEmbedding(
     if (bucket_id >= num_buckets_) {
       return false;
     }
-
-    if (!DequantizeAdd(scales_->data.f, embeddings_->data.uint8,
-                       bytes_per_embedding_, num_sparse_features,
-                       quantization_bits_, bucket_id, dest, dest_size)) {
+    const int row =
+        bucket_rows_ != nullptr ? bucket_rows_->Get(bucket_id) : bucket_id;
+
+    if (unpacked_embeddings_ != nullptr) {
+      DequantizeAddUnpacked(
+          scales_->data.f,
+          unpacked_embeddings_ + static_cast<size_t>(row) * unpacked_stride_,
+          num_sparse_features, row, dest, dest_size);
+    } else if (!DequantizeAdd(scales_->data.f, embeddings_->data.uint8,
+                              bytes_per_embedding_, num_sparse_features,
+                              quantization_bits_, row, dest, dest_size)) {
       return false;
     }
   }
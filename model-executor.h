@@ -19,7 +19,9 @@
 #ifndef LIBTEXTCLASSIFIER_MODEL_EXECUTOR_H_
 #define LIBTEXTCLASSIFIER_MODEL_EXECUTOR_H_
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "tensor-view.h"
 #include "types.h"
@@ -42,10 +44,42 @@ TensorView<float> ComputeLogitsHelper(const int input_index_features,
                                       const TensorView<float>& features,
                                       tflite::Interpreter* interpreter);
 
-// Executor for the text selection prediction and classification models.
+// Per-thread state of a ModelExecutor, e.g. the tensors of an interpreter.
+// NOT thread-safe.
+class ExecutionContext {
+ public:
+  virtual ~ExecutionContext() {}
+};
+
+// Executor for the text selection prediction and classification models. An
+// implementation wraps one inference engine. The executor itself is read-only
+// and can be shared across threads, the mutable state of the inference lives
+// in the contexts it creates.
 class ModelExecutor {
  public:
-  static std::unique_ptr<const ModelExecutor> Instance(
+  virtual ~ModelExecutor() {}
+
+  // Creates a context that serves as a scratch-pad for the inference. Returns
+  // nullptr on failure.
+  virtual std::unique_ptr<ExecutionContext> CreateContext() const = 0;
+
+  // Computes the logits for a batch of features of shape {batch size, features
+  // size}. The result points into the context, and is valid until the context
+  // is used again.
+  virtual TensorView<float> ComputeLogits(const TensorView<float>& features,
+                                          ExecutionContext* context) const = 0;
+};
+
+// Creates the executor of a model section from its serialized model, or
+// returns nullptr on failure. Allows to choose the inference engine of each
+// section at load time.
+using ModelExecutorFactory = std::function<std::unique_ptr<const ModelExecutor>(
+    const flatbuffers::Vector<uint8_t>* model_spec_buffer)>;
+
+// Executes the models with the TFLite interpreter.
+class TFLiteModelExecutor : public ModelExecutor {
+ public:
+  static std::unique_ptr<const TFLiteModelExecutor> Instance(
       const flatbuffers::Vector<uint8_t>* model_spec_buffer) {
     const tflite::Model* model =
         flatbuffers::GetRoot<tflite::Model>(model_spec_buffer->data());
@@ -57,27 +91,25 @@ class ModelExecutor {
     return Instance(model);
   }
 
-  static std::unique_ptr<const ModelExecutor> Instance(
+  static std::unique_ptr<const TFLiteModelExecutor> Instance(
       const tflite::Model* model_spec) {
     std::unique_ptr<const tflite::FlatBufferModel> model;
     if (!internal::FromModelSpec(model_spec, &model)) {
       return nullptr;
     }
-    return std::unique_ptr<ModelExecutor>(new ModelExecutor(std::move(model)));
+    return std::unique_ptr<TFLiteModelExecutor>(
+        new TFLiteModelExecutor(std::move(model)));
   }
 
-  // Creates an Interpreter for the model that serves as a scratch-pad for the
-  // inference. The Interpreter is NOT thread-safe.
-  std::unique_ptr<tflite::Interpreter> CreateInterpreter() const;
+  // Creates a context holding an Interpreter for the model.
+  std::unique_ptr<ExecutionContext> CreateContext() const override;
 
   TensorView<float> ComputeLogits(const TensorView<float>& features,
-                                  tflite::Interpreter* interpreter) const {
-    return ComputeLogitsHelper(kInputIndexFeatures, kOutputIndexLogits,
-                               features, interpreter);
-  }
+                                  ExecutionContext* context) const override;
 
  protected:
-  explicit ModelExecutor(std::unique_ptr<const tflite::FlatBufferModel> model)
+  explicit TFLiteModelExecutor(
+      std::unique_ptr<const tflite::FlatBufferModel> model)
       : model_(std::move(model)) {}
 
   static const int kInputIndexFeatures = 0;
@@ -103,21 +135,34 @@ class EmbeddingExecutor {
 
 class TFLiteEmbeddingExecutor : public EmbeddingExecutor {
  public:
+  // If 'unpack_embeddings' is true, the quantized embedding table is unpacked
+  // to one byte per value at load time, trading memory for lookup speed.
+  // If 'bucket_rows' is not nullptr, it gives the row of the embedding table
+  // of every bucket. It is not copied and must outlive the executor.
   static std::unique_ptr<TFLiteEmbeddingExecutor> Instance(
       const flatbuffers::Vector<uint8_t>* model_spec_buffer, int embedding_size,
-      int quantization_bits);
+      int quantization_bits, bool unpack_embeddings = false,
+      const flatbuffers::Vector<int32_t>* bucket_rows = nullptr);
 
   bool AddEmbedding(const TensorView<int>& sparse_features, float* dest,
                     int dest_size) const override;
 
+  // Returns the number of bytes allocated for the unpacked embedding table, or
+  // 0 if the table is not unpacked.
+  int64 UnpackedEmbeddingsBytes() const { return unpacked_storage_.size(); }
+
  protected:
   explicit TFLiteEmbeddingExecutor(
       std::unique_ptr<const tflite::FlatBufferModel> model,
       int quantization_bits, int num_buckets, int bytes_per_embedding,
       int output_embedding_size, const TfLiteTensor* scales,
       const TfLiteTensor* embeddings,
+      const flatbuffers::Vector<int32_t>* bucket_rows,
       std::unique_ptr<tflite::Interpreter> interpreter);
 
+  // Fills unpacked_embeddings_ from the quantized embeddings tensor.
+  void UnpackEmbeddings();
+
   std::unique_ptr<const tflite::FlatBufferModel> model_;
 
   int quantization_bits_;
@@ -127,9 +172,19 @@ class TFLiteEmbeddingExecutor : public EmbeddingExecutor {
   const TfLiteTensor* scales_ = nullptr;
   const TfLiteTensor* embeddings_ = nullptr;
 
+  // The row of every bucket, or nullptr if the rows are in bucket order.
+  const flatbuffers::Vector<int32_t>* bucket_rows_ = nullptr;
+
   // NOTE: This interpreter is used in a read-only way (as a storage for the
   // model params), thus is still thread-safe.
   std::unique_ptr<tflite::Interpreter> interpreter_;
+
+  // Unpacked embedding table, with rows unpacked_stride_ bytes apart. Points
+  // to the first cache line aligned byte of unpacked_storage_, or nullptr if
+  // the table is not unpacked.
+  std::vector<int8> unpacked_storage_;
+  const int8* unpacked_embeddings_ = nullptr;
+  int unpacked_stride_ = 0;
 };
 
 }  // namespace libtextclassifier2
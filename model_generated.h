@@ -573,8 +573,10 @@ struct CompressedBufferT : public flatbuffers::NativeTable {
   typedef CompressedBuffer TableType;
   std::vector<uint8_t> buffer;
   int32_t uncompressed_size;
+  bool independent;
   CompressedBufferT()
-      : uncompressed_size(0) {
+      : uncompressed_size(0),
+        independent(false) {
   }
 };
 
@@ -582,7 +584,8 @@ struct CompressedBuffer FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   typedef CompressedBufferT NativeTableType;
   enum {
     VT_BUFFER = 4,
-    VT_UNCOMPRESSED_SIZE = 6
+    VT_UNCOMPRESSED_SIZE = 6,
+    VT_INDEPENDENT = 8
   };
   const flatbuffers::Vector<uint8_t> *buffer() const {
     return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_BUFFER);
@@ -590,11 +593,15 @@ struct CompressedBuffer FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   int32_t uncompressed_size() const {
     return GetField<int32_t>(VT_UNCOMPRESSED_SIZE, 0);
   }
+  bool independent() const {
+    return GetField<uint8_t>(VT_INDEPENDENT, 0) != 0;
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_BUFFER) &&
            verifier.Verify(buffer()) &&
            VerifyField<int32_t>(verifier, VT_UNCOMPRESSED_SIZE) &&
+           VerifyField<uint8_t>(verifier, VT_INDEPENDENT) &&
            verifier.EndTable();
   }
   CompressedBufferT *UnPack(const flatbuffers::resolver_function_t *_resolver = nullptr) const;
@@ -611,6 +618,9 @@ struct CompressedBufferBuilder {
   void add_uncompressed_size(int32_t uncompressed_size) {
     fbb_.AddElement<int32_t>(CompressedBuffer::VT_UNCOMPRESSED_SIZE, uncompressed_size, 0);
   }
+  void add_independent(bool independent) {
+    fbb_.AddElement<uint8_t>(CompressedBuffer::VT_INDEPENDENT, static_cast<uint8_t>(independent), 0);
+  }
   explicit CompressedBufferBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -626,21 +636,25 @@ struct CompressedBufferBuilder {
 inline flatbuffers::Offset<CompressedBuffer> CreateCompressedBuffer(
     flatbuffers::FlatBufferBuilder &_fbb,
     flatbuffers::Offset<flatbuffers::Vector<uint8_t>> buffer = 0,
-    int32_t uncompressed_size = 0) {
+    int32_t uncompressed_size = 0,
+    bool independent = false) {
   CompressedBufferBuilder builder_(_fbb);
   builder_.add_uncompressed_size(uncompressed_size);
   builder_.add_buffer(buffer);
+  builder_.add_independent(independent);
   return builder_.Finish();
 }
 
 inline flatbuffers::Offset<CompressedBuffer> CreateCompressedBufferDirect(
     flatbuffers::FlatBufferBuilder &_fbb,
     const std::vector<uint8_t> *buffer = nullptr,
-    int32_t uncompressed_size = 0) {
+    int32_t uncompressed_size = 0,
+    bool independent = false) {
   return libtextclassifier2::CreateCompressedBuffer(
       _fbb,
       buffer ? _fbb.CreateVector<uint8_t>(*buffer) : 0,
-      uncompressed_size);
+      uncompressed_size,
+      independent);
 }
 
 flatbuffers::Offset<CompressedBuffer> CreateCompressedBuffer(flatbuffers::FlatBufferBuilder &_fbb, const CompressedBufferT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
@@ -978,6 +992,7 @@ flatbuffers::Offset<Pattern> CreatePattern(flatbuffers::FlatBufferBuilder &_fbb,
 struct RegexModelT : public flatbuffers::NativeTable {
   typedef RegexModel TableType;
   std::vector<std::unique_ptr<libtextclassifier2::RegexModel_::PatternT>> patterns;
+  std::vector<uint8_t> compression_dictionary;
   RegexModelT() {
   }
 };
@@ -985,16 +1000,22 @@ struct RegexModelT : public flatbuffers::NativeTable {
 struct RegexModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   typedef RegexModelT NativeTableType;
   enum {
-    VT_PATTERNS = 4
+    VT_PATTERNS = 4,
+    VT_COMPRESSION_DICTIONARY = 6
   };
   const flatbuffers::Vector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>> *patterns() const {
     return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>> *>(VT_PATTERNS);
   }
+  const flatbuffers::Vector<uint8_t> *compression_dictionary() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_COMPRESSION_DICTIONARY);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_PATTERNS) &&
            verifier.Verify(patterns()) &&
            verifier.VerifyVectorOfTables(patterns()) &&
+           VerifyOffset(verifier, VT_COMPRESSION_DICTIONARY) &&
+           verifier.Verify(compression_dictionary()) &&
            verifier.EndTable();
   }
   RegexModelT *UnPack(const flatbuffers::resolver_function_t *_resolver = nullptr) const;
@@ -1008,6 +1029,9 @@ struct RegexModelBuilder {
   void add_patterns(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>>> patterns) {
     fbb_.AddOffset(RegexModel::VT_PATTERNS, patterns);
   }
+  void add_compression_dictionary(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> compression_dictionary) {
+    fbb_.AddOffset(RegexModel::VT_COMPRESSION_DICTIONARY, compression_dictionary);
+  }
   explicit RegexModelBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -1022,18 +1046,22 @@ struct RegexModelBuilder {
 
 inline flatbuffers::Offset<RegexModel> CreateRegexModel(
     flatbuffers::FlatBufferBuilder &_fbb,
-    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>>> patterns = 0) {
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>>> patterns = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> compression_dictionary = 0) {
   RegexModelBuilder builder_(_fbb);
+  builder_.add_compression_dictionary(compression_dictionary);
   builder_.add_patterns(patterns);
   return builder_.Finish();
 }
 
 inline flatbuffers::Offset<RegexModel> CreateRegexModelDirect(
     flatbuffers::FlatBufferBuilder &_fbb,
-    const std::vector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>> *patterns = nullptr) {
+    const std::vector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>> *patterns = nullptr,
+    const std::vector<uint8_t> *compression_dictionary = nullptr) {
   return libtextclassifier2::CreateRegexModel(
       _fbb,
-      patterns ? _fbb.CreateVector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>>(*patterns) : 0);
+      patterns ? _fbb.CreateVector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>>(*patterns) : 0,
+      compression_dictionary ? _fbb.CreateVector<uint8_t>(*compression_dictionary) : 0);
 }
 
 flatbuffers::Offset<RegexModel> CreateRegexModel(flatbuffers::FlatBufferBuilder &_fbb, const RegexModelT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
@@ -1362,6 +1390,11 @@ struct DatetimeModelT : public flatbuffers::NativeTable {
   std::vector<std::unique_ptr<DatetimeModelExtractorT>> extractors;
   bool use_extractors_for_locating;
   std::vector<int32_t> default_locales;
+  std::vector<uint8_t> compression_dictionary;
+  std::vector<int32_t> sorted_locale_ids;
+  std::vector<int32_t> locale_rules_start;
+  std::vector<int32_t> locale_rules;
+  std::vector<int32_t> extractor_rules;
   DatetimeModelT()
       : use_extractors_for_locating(true) {
   }
@@ -1374,7 +1407,12 @@ struct DatetimeModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_PATTERNS = 6,
     VT_EXTRACTORS = 8,
     VT_USE_EXTRACTORS_FOR_LOCATING = 10,
-    VT_DEFAULT_LOCALES = 12
+    VT_DEFAULT_LOCALES = 12,
+    VT_COMPRESSION_DICTIONARY = 14,
+    VT_SORTED_LOCALE_IDS = 16,
+    VT_LOCALE_RULES_START = 18,
+    VT_LOCALE_RULES = 20,
+    VT_EXTRACTOR_RULES = 22
   };
   const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>> *locales() const {
     return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>> *>(VT_LOCALES);
@@ -1391,6 +1429,21 @@ struct DatetimeModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const flatbuffers::Vector<int32_t> *default_locales() const {
     return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_DEFAULT_LOCALES);
   }
+  const flatbuffers::Vector<uint8_t> *compression_dictionary() const {
+    return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_COMPRESSION_DICTIONARY);
+  }
+  const flatbuffers::Vector<int32_t> *sorted_locale_ids() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_SORTED_LOCALE_IDS);
+  }
+  const flatbuffers::Vector<int32_t> *locale_rules_start() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_LOCALE_RULES_START);
+  }
+  const flatbuffers::Vector<int32_t> *locale_rules() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_LOCALE_RULES);
+  }
+  const flatbuffers::Vector<int32_t> *extractor_rules() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_EXTRACTOR_RULES);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_LOCALES) &&
@@ -1405,6 +1458,16 @@ struct DatetimeModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyField<uint8_t>(verifier, VT_USE_EXTRACTORS_FOR_LOCATING) &&
            VerifyOffset(verifier, VT_DEFAULT_LOCALES) &&
            verifier.Verify(default_locales()) &&
+           VerifyOffset(verifier, VT_COMPRESSION_DICTIONARY) &&
+           verifier.Verify(compression_dictionary()) &&
+           VerifyOffset(verifier, VT_SORTED_LOCALE_IDS) &&
+           verifier.Verify(sorted_locale_ids()) &&
+           VerifyOffset(verifier, VT_LOCALE_RULES_START) &&
+           verifier.Verify(locale_rules_start()) &&
+           VerifyOffset(verifier, VT_LOCALE_RULES) &&
+           verifier.Verify(locale_rules()) &&
+           VerifyOffset(verifier, VT_EXTRACTOR_RULES) &&
+           verifier.Verify(extractor_rules()) &&
            verifier.EndTable();
   }
   DatetimeModelT *UnPack(const flatbuffers::resolver_function_t *_resolver = nullptr) const;
@@ -1430,6 +1493,21 @@ struct DatetimeModelBuilder {
   void add_default_locales(flatbuffers::Offset<flatbuffers::Vector<int32_t>> default_locales) {
     fbb_.AddOffset(DatetimeModel::VT_DEFAULT_LOCALES, default_locales);
   }
+  void add_compression_dictionary(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> compression_dictionary) {
+    fbb_.AddOffset(DatetimeModel::VT_COMPRESSION_DICTIONARY, compression_dictionary);
+  }
+  void add_sorted_locale_ids(flatbuffers::Offset<flatbuffers::Vector<int32_t>> sorted_locale_ids) {
+    fbb_.AddOffset(DatetimeModel::VT_SORTED_LOCALE_IDS, sorted_locale_ids);
+  }
+  void add_locale_rules_start(flatbuffers::Offset<flatbuffers::Vector<int32_t>> locale_rules_start) {
+    fbb_.AddOffset(DatetimeModel::VT_LOCALE_RULES_START, locale_rules_start);
+  }
+  void add_locale_rules(flatbuffers::Offset<flatbuffers::Vector<int32_t>> locale_rules) {
+    fbb_.AddOffset(DatetimeModel::VT_LOCALE_RULES, locale_rules);
+  }
+  void add_extractor_rules(flatbuffers::Offset<flatbuffers::Vector<int32_t>> extractor_rules) {
+    fbb_.AddOffset(DatetimeModel::VT_EXTRACTOR_RULES, extractor_rules);
+  }
   explicit DatetimeModelBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -1448,8 +1526,18 @@ inline flatbuffers::Offset<DatetimeModel> CreateDatetimeModel(
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<DatetimeModelPattern>>> patterns = 0,
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<DatetimeModelExtractor>>> extractors = 0,
     bool use_extractors_for_locating = true,
-    flatbuffers::Offset<flatbuffers::Vector<int32_t>> default_locales = 0) {
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> default_locales = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> compression_dictionary = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> sorted_locale_ids = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> locale_rules_start = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> locale_rules = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> extractor_rules = 0) {
   DatetimeModelBuilder builder_(_fbb);
+  builder_.add_extractor_rules(extractor_rules);
+  builder_.add_locale_rules(locale_rules);
+  builder_.add_locale_rules_start(locale_rules_start);
+  builder_.add_sorted_locale_ids(sorted_locale_ids);
+  builder_.add_compression_dictionary(compression_dictionary);
   builder_.add_default_locales(default_locales);
   builder_.add_extractors(extractors);
   builder_.add_patterns(patterns);
@@ -1464,14 +1552,24 @@ inline flatbuffers::Offset<DatetimeModel> CreateDatetimeModelDirect(
     const std::vector<flatbuffers::Offset<DatetimeModelPattern>> *patterns = nullptr,
     const std::vector<flatbuffers::Offset<DatetimeModelExtractor>> *extractors = nullptr,
     bool use_extractors_for_locating = true,
-    const std::vector<int32_t> *default_locales = nullptr) {
+    const std::vector<int32_t> *default_locales = nullptr,
+    const std::vector<uint8_t> *compression_dictionary = nullptr,
+    const std::vector<int32_t> *sorted_locale_ids = nullptr,
+    const std::vector<int32_t> *locale_rules_start = nullptr,
+    const std::vector<int32_t> *locale_rules = nullptr,
+    const std::vector<int32_t> *extractor_rules = nullptr) {
   return libtextclassifier2::CreateDatetimeModel(
       _fbb,
       locales ? _fbb.CreateVector<flatbuffers::Offset<flatbuffers::String>>(*locales) : 0,
       patterns ? _fbb.CreateVector<flatbuffers::Offset<DatetimeModelPattern>>(*patterns) : 0,
       extractors ? _fbb.CreateVector<flatbuffers::Offset<DatetimeModelExtractor>>(*extractors) : 0,
       use_extractors_for_locating,
-      default_locales ? _fbb.CreateVector<int32_t>(*default_locales) : 0);
+      default_locales ? _fbb.CreateVector<int32_t>(*default_locales) : 0,
+      compression_dictionary ? _fbb.CreateVector<uint8_t>(*compression_dictionary) : 0,
+      sorted_locale_ids ? _fbb.CreateVector<int32_t>(*sorted_locale_ids) : 0,
+      locale_rules_start ? _fbb.CreateVector<int32_t>(*locale_rules_start) : 0,
+      locale_rules ? _fbb.CreateVector<int32_t>(*locale_rules) : 0,
+      extractor_rules ? _fbb.CreateVector<int32_t>(*extractor_rules) : 0);
 }
 
 flatbuffers::Offset<DatetimeModel> CreateDatetimeModel(flatbuffers::FlatBufferBuilder &_fbb, const DatetimeModelT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
@@ -1796,6 +1894,7 @@ struct ModelT : public flatbuffers::NativeTable {
   ModeFlag enabled_modes;
   bool snap_whitespace_selections;
   std::unique_ptr<OutputOptionsT> output_options;
+  std::vector<int32_t> embedding_bucket_rows;
   ModelT()
       : version(0),
         enabled_modes(ModeFlag_ALL),
@@ -1821,7 +1920,8 @@ struct Model FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_TRIGGERING_OPTIONS = 28,
     VT_ENABLED_MODES = 30,
     VT_SNAP_WHITESPACE_SELECTIONS = 32,
-    VT_OUTPUT_OPTIONS = 34
+    VT_OUTPUT_OPTIONS = 34,
+    VT_EMBEDDING_BUCKET_ROWS = 36
   };
   const flatbuffers::String *locales() const {
     return GetPointer<const flatbuffers::String *>(VT_LOCALES);
@@ -1871,6 +1971,9 @@ struct Model FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const OutputOptions *output_options() const {
     return GetPointer<const OutputOptions *>(VT_OUTPUT_OPTIONS);
   }
+  const flatbuffers::Vector<int32_t> *embedding_bucket_rows() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_EMBEDDING_BUCKET_ROWS);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_LOCALES) &&
@@ -1902,6 +2005,8 @@ struct Model FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyField<uint8_t>(verifier, VT_SNAP_WHITESPACE_SELECTIONS) &&
            VerifyOffset(verifier, VT_OUTPUT_OPTIONS) &&
            verifier.VerifyTable(output_options()) &&
+           VerifyOffset(verifier, VT_EMBEDDING_BUCKET_ROWS) &&
+           verifier.Verify(embedding_bucket_rows()) &&
            verifier.EndTable();
   }
   ModelT *UnPack(const flatbuffers::resolver_function_t *_resolver = nullptr) const;
@@ -1960,6 +2065,9 @@ struct ModelBuilder {
   void add_output_options(flatbuffers::Offset<OutputOptions> output_options) {
     fbb_.AddOffset(Model::VT_OUTPUT_OPTIONS, output_options);
   }
+  void add_embedding_bucket_rows(flatbuffers::Offset<flatbuffers::Vector<int32_t>> embedding_bucket_rows) {
+    fbb_.AddOffset(Model::VT_EMBEDDING_BUCKET_ROWS, embedding_bucket_rows);
+  }
   explicit ModelBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -1989,8 +2097,10 @@ inline flatbuffers::Offset<Model> CreateModel(
     flatbuffers::Offset<ModelTriggeringOptions> triggering_options = 0,
     ModeFlag enabled_modes = ModeFlag_ALL,
     bool snap_whitespace_selections = true,
-    flatbuffers::Offset<OutputOptions> output_options = 0) {
+    flatbuffers::Offset<OutputOptions> output_options = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> embedding_bucket_rows = 0) {
   ModelBuilder builder_(_fbb);
+  builder_.add_embedding_bucket_rows(embedding_bucket_rows);
   builder_.add_output_options(output_options);
   builder_.add_enabled_modes(enabled_modes);
   builder_.add_triggering_options(triggering_options);
@@ -2027,7 +2137,8 @@ inline flatbuffers::Offset<Model> CreateModelDirect(
     flatbuffers::Offset<ModelTriggeringOptions> triggering_options = 0,
     ModeFlag enabled_modes = ModeFlag_ALL,
     bool snap_whitespace_selections = true,
-    flatbuffers::Offset<OutputOptions> output_options = 0) {
+    flatbuffers::Offset<OutputOptions> output_options = 0,
+    const std::vector<int32_t> *embedding_bucket_rows = nullptr) {
   return libtextclassifier2::CreateModel(
       _fbb,
       locales ? _fbb.CreateString(locales) : 0,
@@ -2045,7 +2156,8 @@ inline flatbuffers::Offset<Model> CreateModelDirect(
       triggering_options,
       enabled_modes,
       snap_whitespace_selections,
-      output_options);
+      output_options,
+      embedding_bucket_rows ? _fbb.CreateVector<int32_t>(*embedding_bucket_rows) : 0);
 }
 
 flatbuffers::Offset<Model> CreateModel(flatbuffers::FlatBufferBuilder &_fbb, const ModelT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
@@ -2457,6 +2569,8 @@ struct FeatureProcessorOptionsT : public flatbuffers::NativeTable {
   std::unique_ptr<libtextclassifier2::FeatureProcessorOptions_::BoundsSensitiveFeaturesT> bounds_sensitive_features;
   std::vector<std::string> allowed_chargrams;
   bool tokenize_on_script_change;
+  std::vector<int32_t> selection_label_spans;
+  bool sorted_codepoint_tables;
   FeatureProcessorOptionsT()
       : num_buckets(-1),
         embedding_size(-1),
@@ -2479,7 +2593,8 @@ struct FeatureProcessorOptionsT : public flatbuffers::NativeTable {
         feature_version(0),
         tokenization_type(libtextclassifier2::FeatureProcessorOptions_::TokenizationType_INTERNAL_TOKENIZER),
         icu_preserve_whitespace_tokens(false),
-        tokenize_on_script_change(false) {
+        tokenize_on_script_change(false),
+        sorted_codepoint_tables(false) {
   }
 };
 
@@ -2516,7 +2631,9 @@ struct FeatureProcessorOptions FLATBUFFERS_FINAL_CLASS : private flatbuffers::Ta
     VT_IGNORED_SPAN_BOUNDARY_CODEPOINTS = 58,
     VT_BOUNDS_SENSITIVE_FEATURES = 60,
     VT_ALLOWED_CHARGRAMS = 62,
-    VT_TOKENIZE_ON_SCRIPT_CHANGE = 64
+    VT_TOKENIZE_ON_SCRIPT_CHANGE = 64,
+    VT_SELECTION_LABEL_SPANS = 66,
+    VT_SORTED_CODEPOINT_TABLES = 68
   };
   int32_t num_buckets() const {
     return GetField<int32_t>(VT_NUM_BUCKETS, -1);
@@ -2611,6 +2728,12 @@ struct FeatureProcessorOptions FLATBUFFERS_FINAL_CLASS : private flatbuffers::Ta
   bool tokenize_on_script_change() const {
     return GetField<uint8_t>(VT_TOKENIZE_ON_SCRIPT_CHANGE, 0) != 0;
   }
+  const flatbuffers::Vector<int32_t> *selection_label_spans() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_SELECTION_LABEL_SPANS);
+  }
+  bool sorted_codepoint_tables() const {
+    return GetField<uint8_t>(VT_SORTED_CODEPOINT_TABLES, 0) != 0;
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int32_t>(verifier, VT_NUM_BUCKETS) &&
@@ -2659,6 +2782,9 @@ struct FeatureProcessorOptions FLATBUFFERS_FINAL_CLASS : private flatbuffers::Ta
            verifier.Verify(allowed_chargrams()) &&
            verifier.VerifyVectorOfStrings(allowed_chargrams()) &&
            VerifyField<uint8_t>(verifier, VT_TOKENIZE_ON_SCRIPT_CHANGE) &&
+           VerifyOffset(verifier, VT_SELECTION_LABEL_SPANS) &&
+           verifier.Verify(selection_label_spans()) &&
+           VerifyField<uint8_t>(verifier, VT_SORTED_CODEPOINT_TABLES) &&
            verifier.EndTable();
   }
   FeatureProcessorOptionsT *UnPack(const flatbuffers::resolver_function_t *_resolver = nullptr) const;
@@ -2762,6 +2888,12 @@ struct FeatureProcessorOptionsBuilder {
   void add_tokenize_on_script_change(bool tokenize_on_script_change) {
     fbb_.AddElement<uint8_t>(FeatureProcessorOptions::VT_TOKENIZE_ON_SCRIPT_CHANGE, static_cast<uint8_t>(tokenize_on_script_change), 0);
   }
+  void add_selection_label_spans(flatbuffers::Offset<flatbuffers::Vector<int32_t>> selection_label_spans) {
+    fbb_.AddOffset(FeatureProcessorOptions::VT_SELECTION_LABEL_SPANS, selection_label_spans);
+  }
+  void add_sorted_codepoint_tables(bool sorted_codepoint_tables) {
+    fbb_.AddElement<uint8_t>(FeatureProcessorOptions::VT_SORTED_CODEPOINT_TABLES, static_cast<uint8_t>(sorted_codepoint_tables), 0);
+  }
   explicit FeatureProcessorOptionsBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -2806,8 +2938,11 @@ inline flatbuffers::Offset<FeatureProcessorOptions> CreateFeatureProcessorOption
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> ignored_span_boundary_codepoints = 0,
     flatbuffers::Offset<libtextclassifier2::FeatureProcessorOptions_::BoundsSensitiveFeatures> bounds_sensitive_features = 0,
     flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>> allowed_chargrams = 0,
-    bool tokenize_on_script_change = false) {
+    bool tokenize_on_script_change = false,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> selection_label_spans = 0,
+    bool sorted_codepoint_tables = false) {
   FeatureProcessorOptionsBuilder builder_(_fbb);
+  builder_.add_selection_label_spans(selection_label_spans);
   builder_.add_allowed_chargrams(allowed_chargrams);
   builder_.add_bounds_sensitive_features(bounds_sensitive_features);
   builder_.add_ignored_span_boundary_codepoints(ignored_span_boundary_codepoints);
@@ -2828,6 +2963,7 @@ inline flatbuffers::Offset<FeatureProcessorOptions> CreateFeatureProcessorOption
   builder_.add_embedding_quantization_bits(embedding_quantization_bits);
   builder_.add_embedding_size(embedding_size);
   builder_.add_num_buckets(num_buckets);
+  builder_.add_sorted_codepoint_tables(sorted_codepoint_tables);
   builder_.add_tokenize_on_script_change(tokenize_on_script_change);
   builder_.add_icu_preserve_whitespace_tokens(icu_preserve_whitespace_tokens);
   builder_.add_snap_label_span_boundaries_to_containing_tokens(snap_label_span_boundaries_to_containing_tokens);
@@ -2874,7 +3010,9 @@ inline flatbuffers::Offset<FeatureProcessorOptions> CreateFeatureProcessorOption
     const std::vector<int32_t> *ignored_span_boundary_codepoints = nullptr,
     flatbuffers::Offset<libtextclassifier2::FeatureProcessorOptions_::BoundsSensitiveFeatures> bounds_sensitive_features = 0,
     const std::vector<flatbuffers::Offset<flatbuffers::String>> *allowed_chargrams = nullptr,
-    bool tokenize_on_script_change = false) {
+    bool tokenize_on_script_change = false,
+    const std::vector<int32_t> *selection_label_spans = nullptr,
+    bool sorted_codepoint_tables = false) {
   return libtextclassifier2::CreateFeatureProcessorOptions(
       _fbb,
       num_buckets,
@@ -2907,7 +3045,9 @@ inline flatbuffers::Offset<FeatureProcessorOptions> CreateFeatureProcessorOption
       ignored_span_boundary_codepoints ? _fbb.CreateVector<int32_t>(*ignored_span_boundary_codepoints) : 0,
       bounds_sensitive_features,
       allowed_chargrams ? _fbb.CreateVector<flatbuffers::Offset<flatbuffers::String>>(*allowed_chargrams) : 0,
-      tokenize_on_script_change);
+      tokenize_on_script_change,
+      selection_label_spans ? _fbb.CreateVector<int32_t>(*selection_label_spans) : 0,
+      sorted_codepoint_tables);
 }
 
 flatbuffers::Offset<FeatureProcessorOptions> CreateFeatureProcessorOptions(flatbuffers::FlatBufferBuilder &_fbb, const FeatureProcessorOptionsT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
@@ -2923,6 +3063,7 @@ inline void CompressedBuffer::UnPackTo(CompressedBufferT *_o, const flatbuffers:
   (void)_resolver;
   { auto _e = buffer(); if (_e) { _o->buffer.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->buffer[_i] = _e->Get(_i); } } };
   { auto _e = uncompressed_size(); _o->uncompressed_size = _e; };
+  { auto _e = independent(); _o->independent = _e; };
 }
 
 inline flatbuffers::Offset<CompressedBuffer> CompressedBuffer::Pack(flatbuffers::FlatBufferBuilder &_fbb, const CompressedBufferT* _o, const flatbuffers::rehasher_function_t *_rehasher) {
@@ -2935,10 +3076,12 @@ inline flatbuffers::Offset<CompressedBuffer> CreateCompressedBuffer(flatbuffers:
   struct _VectorArgs { flatbuffers::FlatBufferBuilder *__fbb; const CompressedBufferT* __o; const flatbuffers::rehasher_function_t *__rehasher; } _va = { &_fbb, _o, _rehasher}; (void)_va;
   auto _buffer = _o->buffer.size() ? _fbb.CreateVector(_o->buffer) : 0;
   auto _uncompressed_size = _o->uncompressed_size;
+  auto _independent = _o->independent;
   return libtextclassifier2::CreateCompressedBuffer(
       _fbb,
       _buffer,
-      _uncompressed_size);
+      _uncompressed_size,
+      _independent);
 }
 
 inline SelectionModelOptionsT *SelectionModelOptions::UnPack(const flatbuffers::resolver_function_t *_resolver) const {
@@ -3069,6 +3212,7 @@ inline void RegexModel::UnPackTo(RegexModelT *_o, const flatbuffers::resolver_fu
   (void)_o;
   (void)_resolver;
   { auto _e = patterns(); if (_e) { _o->patterns.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->patterns[_i] = std::unique_ptr<libtextclassifier2::RegexModel_::PatternT>(_e->Get(_i)->UnPack(_resolver)); } } };
+  { auto _e = compression_dictionary(); if (_e) { _o->compression_dictionary.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->compression_dictionary[_i] = _e->Get(_i); } } };
 }
 
 inline flatbuffers::Offset<RegexModel> RegexModel::Pack(flatbuffers::FlatBufferBuilder &_fbb, const RegexModelT* _o, const flatbuffers::rehasher_function_t *_rehasher) {
@@ -3080,9 +3224,11 @@ inline flatbuffers::Offset<RegexModel> CreateRegexModel(flatbuffers::FlatBufferB
   (void)_o;
   struct _VectorArgs { flatbuffers::FlatBufferBuilder *__fbb; const RegexModelT* __o; const flatbuffers::rehasher_function_t *__rehasher; } _va = { &_fbb, _o, _rehasher}; (void)_va;
   auto _patterns = _o->patterns.size() ? _fbb.CreateVector<flatbuffers::Offset<libtextclassifier2::RegexModel_::Pattern>> (_o->patterns.size(), [](size_t i, _VectorArgs *__va) { return CreatePattern(*__va->__fbb, __va->__o->patterns[i].get(), __va->__rehasher); }, &_va ) : 0;
+  auto _compression_dictionary = _o->compression_dictionary.size() ? _fbb.CreateVector(_o->compression_dictionary) : 0;
   return libtextclassifier2::CreateRegexModel(
       _fbb,
-      _patterns);
+      _patterns,
+      _compression_dictionary);
 }
 
 namespace DatetimeModelPattern_ {
@@ -3208,6 +3354,11 @@ inline void DatetimeModel::UnPackTo(DatetimeModelT *_o, const flatbuffers::resol
   { auto _e = extractors(); if (_e) { _o->extractors.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->extractors[_i] = std::unique_ptr<DatetimeModelExtractorT>(_e->Get(_i)->UnPack(_resolver)); } } };
   { auto _e = use_extractors_for_locating(); _o->use_extractors_for_locating = _e; };
   { auto _e = default_locales(); if (_e) { _o->default_locales.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->default_locales[_i] = _e->Get(_i); } } };
+  { auto _e = compression_dictionary(); if (_e) { _o->compression_dictionary.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->compression_dictionary[_i] = _e->Get(_i); } } };
+  { auto _e = sorted_locale_ids(); if (_e) { _o->sorted_locale_ids.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->sorted_locale_ids[_i] = _e->Get(_i); } } };
+  { auto _e = locale_rules_start(); if (_e) { _o->locale_rules_start.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->locale_rules_start[_i] = _e->Get(_i); } } };
+  { auto _e = locale_rules(); if (_e) { _o->locale_rules.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->locale_rules[_i] = _e->Get(_i); } } };
+  { auto _e = extractor_rules(); if (_e) { _o->extractor_rules.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->extractor_rules[_i] = _e->Get(_i); } } };
 }
 
 inline flatbuffers::Offset<DatetimeModel> DatetimeModel::Pack(flatbuffers::FlatBufferBuilder &_fbb, const DatetimeModelT* _o, const flatbuffers::rehasher_function_t *_rehasher) {
@@ -3223,13 +3374,23 @@ inline flatbuffers::Offset<DatetimeModel> CreateDatetimeModel(flatbuffers::FlatB
   auto _extractors = _o->extractors.size() ? _fbb.CreateVector<flatbuffers::Offset<DatetimeModelExtractor>> (_o->extractors.size(), [](size_t i, _VectorArgs *__va) { return CreateDatetimeModelExtractor(*__va->__fbb, __va->__o->extractors[i].get(), __va->__rehasher); }, &_va ) : 0;
   auto _use_extractors_for_locating = _o->use_extractors_for_locating;
   auto _default_locales = _o->default_locales.size() ? _fbb.CreateVector(_o->default_locales) : 0;
+  auto _compression_dictionary = _o->compression_dictionary.size() ? _fbb.CreateVector(_o->compression_dictionary) : 0;
+  auto _sorted_locale_ids = _o->sorted_locale_ids.size() ? _fbb.CreateVector(_o->sorted_locale_ids) : 0;
+  auto _locale_rules_start = _o->locale_rules_start.size() ? _fbb.CreateVector(_o->locale_rules_start) : 0;
+  auto _locale_rules = _o->locale_rules.size() ? _fbb.CreateVector(_o->locale_rules) : 0;
+  auto _extractor_rules = _o->extractor_rules.size() ? _fbb.CreateVector(_o->extractor_rules) : 0;
   return libtextclassifier2::CreateDatetimeModel(
       _fbb,
       _locales,
       _patterns,
       _extractors,
       _use_extractors_for_locating,
-      _default_locales);
+      _default_locales,
+      _compression_dictionary,
+      _sorted_locale_ids,
+      _locale_rules_start,
+      _locale_rules,
+      _extractor_rules);
 }
 
 namespace DatetimeModelLibrary_ {
@@ -3377,6 +3538,7 @@ inline void Model::UnPackTo(ModelT *_o, const flatbuffers::resolver_function_t *
   { auto _e = enabled_modes(); _o->enabled_modes = _e; };
   { auto _e = snap_whitespace_selections(); _o->snap_whitespace_selections = _e; };
   { auto _e = output_options(); if (_e) _o->output_options = std::unique_ptr<OutputOptionsT>(_e->UnPack(_resolver)); };
+  { auto _e = embedding_bucket_rows(); if (_e) { _o->embedding_bucket_rows.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->embedding_bucket_rows[_i] = _e->Get(_i); } } };
 }
 
 inline flatbuffers::Offset<Model> Model::Pack(flatbuffers::FlatBufferBuilder &_fbb, const ModelT* _o, const flatbuffers::rehasher_function_t *_rehasher) {
@@ -3403,6 +3565,7 @@ inline flatbuffers::Offset<Model> CreateModel(flatbuffers::FlatBufferBuilder &_f
   auto _enabled_modes = _o->enabled_modes;
   auto _snap_whitespace_selections = _o->snap_whitespace_selections;
   auto _output_options = _o->output_options ? CreateOutputOptions(_fbb, _o->output_options.get(), _rehasher) : 0;
+  auto _embedding_bucket_rows = _o->embedding_bucket_rows.size() ? _fbb.CreateVector(_o->embedding_bucket_rows) : 0;
   return libtextclassifier2::CreateModel(
       _fbb,
       _locales,
@@ -3420,7 +3583,8 @@ inline flatbuffers::Offset<Model> CreateModel(flatbuffers::FlatBufferBuilder &_f
       _triggering_options,
       _enabled_modes,
       _snap_whitespace_selections,
-      _output_options);
+      _output_options,
+      _embedding_bucket_rows);
 }
 
 inline TokenizationCodepointRangeT *TokenizationCodepointRange::UnPack(const flatbuffers::resolver_function_t *_resolver) const {
@@ -3607,6 +3771,8 @@ inline void FeatureProcessorOptions::UnPackTo(FeatureProcessorOptionsT *_o, cons
   { auto _e = bounds_sensitive_features(); if (_e) _o->bounds_sensitive_features = std::unique_ptr<libtextclassifier2::FeatureProcessorOptions_::BoundsSensitiveFeaturesT>(_e->UnPack(_resolver)); };
   { auto _e = allowed_chargrams(); if (_e) { _o->allowed_chargrams.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->allowed_chargrams[_i] = _e->Get(_i)->str(); } } };
   { auto _e = tokenize_on_script_change(); _o->tokenize_on_script_change = _e; };
+  { auto _e = selection_label_spans(); if (_e) { _o->selection_label_spans.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->selection_label_spans[_i] = _e->Get(_i); } } };
+  { auto _e = sorted_codepoint_tables(); _o->sorted_codepoint_tables = _e; };
 }
 
 inline flatbuffers::Offset<FeatureProcessorOptions> FeatureProcessorOptions::Pack(flatbuffers::FlatBufferBuilder &_fbb, const FeatureProcessorOptionsT* _o, const flatbuffers::rehasher_function_t *_rehasher) {
@@ -3648,6 +3814,8 @@ inline flatbuffers::Offset<FeatureProcessorOptions> CreateFeatureProcessorOption
   auto _bounds_sensitive_features = _o->bounds_sensitive_features ? CreateBoundsSensitiveFeatures(_fbb, _o->bounds_sensitive_features.get(), _rehasher) : 0;
   auto _allowed_chargrams = _o->allowed_chargrams.size() ? _fbb.CreateVectorOfStrings(_o->allowed_chargrams) : 0;
   auto _tokenize_on_script_change = _o->tokenize_on_script_change;
+  auto _selection_label_spans = _o->selection_label_spans.size() ? _fbb.CreateVector(_o->selection_label_spans) : 0;
+  auto _sorted_codepoint_tables = _o->sorted_codepoint_tables;
   return libtextclassifier2::CreateFeatureProcessorOptions(
       _fbb,
       _num_buckets,
@@ -3680,7 +3848,9 @@ inline flatbuffers::Offset<FeatureProcessorOptions> CreateFeatureProcessorOption
       _ignored_span_boundary_codepoints,
       _bounds_sensitive_features,
       _allowed_chargrams,
-      _tokenize_on_script_change);
+      _tokenize_on_script_change,
+      _selection_label_spans,
+      _sorted_codepoint_tables);
 }
 
 inline const libtextclassifier2::Model *GetModel(const void *buf) {
@@ -37,6 +37,21 @@ void DequantizeAdd8bit(const float* scales, const uint8* embeddings,
   }
 }
 
+int ReadQuantizedValue(const uint8* embeddings, int bytes_per_embedding,
+                       int quantization_bits, int bucket_id, int i) {
+  const int bit_offset = i * quantization_bits;
+  const int read16_offset = bit_offset / 8;
+
+  uint16 data = embeddings[bucket_id * bytes_per_embedding + read16_offset];
+  // If we are not at the end of the embedding row, we can read 2-byte uint16,
+  // but if we are, we need to only read uint8.
+  if (read16_offset < bytes_per_embedding - 1) {
+    data |= embeddings[bucket_id * bytes_per_embedding + read16_offset + 1]
+            << 8;
+  }
+  return (data >> (bit_offset % 8)) & ((1 << quantization_bits) - 1);
+}
+
 void DequantizeAddNBit(const float* scales, const uint8* embeddings,
                        int bytes_per_embedding, int num_sparse_features,
                        int quantization_bits, int bucket_id, float* dest,
@@ -44,17 +59,8 @@ void DequantizeAddNBit(const float* scales, const uint8* embeddings,
   const int quantization_bias = 1 << (quantization_bits - 1);
   const float multiplier = scales[bucket_id];
   for (int i = 0; i < dest_size; ++i) {
-    const int bit_offset = i * quantization_bits;
-    const int read16_offset = bit_offset / 8;
-
-    uint16 data = embeddings[bucket_id * bytes_per_embedding + read16_offset];
-    // If we are not at the end of the embedding row, we can read 2-byte uint16,
-    // but if we are, we need to only read uint8.
-    if (read16_offset < bytes_per_embedding - 1) {
-      data |= embeddings[bucket_id * bytes_per_embedding + read16_offset + 1]
-              << 8;
-    }
-    int value = (data >> (bit_offset % 8)) & ((1 << quantization_bits) - 1);
+    const int value = ReadQuantizedValue(embeddings, bytes_per_embedding,
+                                         quantization_bits, bucket_id, i);
     dest[i] += DequantizeValue(num_sparse_features, quantization_bias,
                                multiplier, value);
   }
@@ -89,4 +95,43 @@ bool DequantizeAdd(const float* scales, const uint8* embeddings,
   return true;
 }
 
+int UnpackedEmbeddingStride(int embedding_size) {
+  static const int kCacheLineSize = 64;
+  if (embedding_size > kCacheLineSize) {
+    return (embedding_size + kCacheLineSize - 1) / kCacheLineSize *
+           kCacheLineSize;
+  }
+  int stride = 1;
+  while (stride < embedding_size) {
+    stride *= 2;
+  }
+  return stride;
+}
+
+void UnpackEmbedding(const uint8* embeddings, int bytes_per_embedding,
+                     int quantization_bits, int bucket_id, int8* dest,
+                     int dest_size) {
+  const int quantization_bias = 1 << (quantization_bits - 1);
+  for (int i = 0; i < dest_size; ++i) {
+    const int value =
+        quantization_bits == 8
+            ? embeddings[bucket_id * bytes_per_embedding + i]
+            : ReadQuantizedValue(embeddings, bytes_per_embedding,
+                                 quantization_bits, bucket_id, i);
+    dest[i] = static_cast<int8>(value - quantization_bias);
+  }
+}
+
+void DequantizeAddUnpacked(const float* scales, const int8* row,
+                           int num_sparse_features, int bucket_id, float* dest,
+                           int dest_size) {
+  const float multiplier = scales[bucket_id];
+  for (int k = 0; k < dest_size; ++k) {
+    // The bias is already subtracted, and the arithmetic is otherwise the same
+    // as in DequantizeAdd.
+    dest[k] += DequantizeValue(num_sparse_features, /*quantization_bias=*/0,
+                               multiplier, row[k]);
+  }
+}
+
 }  // namespace libtextclassifier2
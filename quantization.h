@@ -34,6 +34,24 @@ bool DequantizeAdd(const float* scales, const uint8* embeddings,
                    int quantization_bits, int bucket_id, float* dest,
                    int dest_size);
 
+// Returns the number of bytes between the rows of an unpacked embedding table
+// with 'embedding_size' values per row. Rows are padded to a power of two (or
+// a multiple of the cache line size), so that if the table is cache line
+// aligned, no row straddles two cache lines.
+int UnpackedEmbeddingStride(int embedding_size);
+
+// Unpacks the quantized values of 'bucket_id' into 'dest', one signed byte per
+// value, with the quantization bias already subtracted.
+void UnpackEmbedding(const uint8* embeddings, int bytes_per_embedding,
+                     int quantization_bits, int bucket_id, int8* dest,
+                     int dest_size);
+
+// Same as DequantizeAdd, but reads a row unpacked by UnpackEmbedding, which
+// avoids the bit manipulation. The result is bit-identical to DequantizeAdd.
+void DequantizeAddUnpacked(const float* scales, const int8* row,
+                           int num_sparse_features, int bucket_id, float* dest,
+                           int dest_size);
+
 }  // namespace libtextclassifier2
 
 #endif  // LIBTEXTCLASSIFIER_QUANTIZATION_H_
@@ -16,6 +16,7 @@
 
 #include "quantization.h"
 
+#include <random>
 #include <vector>
 
 #include "gmock/gmock.h"
@@ -159,5 +160,60 @@ TEST(QuantizationTest, DequantizeAdd3bit) {
   EXPECT_THAT(dest, ElementsAreFloat(expected));
 }
 
+TEST(QuantizationTest, UnpackedEmbeddingStride) {
+  EXPECT_EQ(UnpackedEmbeddingStride(1), 1);
+  EXPECT_EQ(UnpackedEmbeddingStride(10), 16);
+  EXPECT_EQ(UnpackedEmbeddingStride(32), 32);
+  EXPECT_EQ(UnpackedEmbeddingStride(33), 64);
+  EXPECT_EQ(UnpackedEmbeddingStride(64), 64);
+  EXPECT_EQ(UnpackedEmbeddingStride(65), 128);
+  EXPECT_EQ(UnpackedEmbeddingStride(200), 256);
+}
+
+TEST(QuantizationTest, DequantizeAddUnpackedIsBitIdentical) {
+  const int embedding_size = 10;
+  const int num_buckets = 5;
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> random_byte(0, 255);
+  std::uniform_real_distribution<float> random_float(-10, 10);
+  std::vector<float> scales(num_buckets);
+  for (float& scale : scales) {
+    scale = random_float(random);
+  }
+
+  for (int quantization_bits = 1; quantization_bits <= 8;
+       ++quantization_bits) {
+    const int bytes_per_embedding =
+        (embedding_size * quantization_bits + 7) / 8;
+    ASSERT_TRUE(CheckQuantizationParams(bytes_per_embedding, quantization_bits,
+                                        embedding_size));
+    std::vector<uint8> embeddings(bytes_per_embedding * num_buckets);
+    for (uint8& byte : embeddings) {
+      byte = random_byte(random);
+    }
+
+    for (int num_sparse_features = 1; num_sparse_features <= 7;
+         num_sparse_features += 3) {
+      std::vector<float> expected(embedding_size);
+      std::vector<float> dest(embedding_size);
+      for (int i = 0; i < embedding_size; ++i) {
+        expected[i] = dest[i] = random_float(random);
+      }
+      std::vector<int8> row(embedding_size);
+      for (int bucket_id = 0; bucket_id < num_buckets; ++bucket_id) {
+        DequantizeAdd(scales.data(), embeddings.data(), bytes_per_embedding,
+                      num_sparse_features, quantization_bits, bucket_id,
+                      expected.data(), expected.size());
+        UnpackEmbedding(embeddings.data(), bytes_per_embedding,
+                        quantization_bits, bucket_id, row.data(), row.size());
+        DequantizeAddUnpacked(scales.data(), row.data(), num_sparse_features,
+                              bucket_id, dest.data(), dest.size());
+      }
+      // Exact comparison, the unpacked path must not change any bits.
+      EXPECT_EQ(dest, expected) << "quantization_bits=" << quantization_bits;
+    }
+  }
+}
+
 }  // namespace
 }  // namespace libtextclassifier2
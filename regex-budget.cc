@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "regex-budget.h"
+
+namespace libtextclassifier2 {
+
+RegexBudget::RegexBudget(int64 budget_ms)
+    : limited_(budget_ms > 0),
+      deadline_(std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(budget_ms)) {}
+
+bool RegexBudget::Exhausted() {
+  if (!limited_ || exhausted_) {
+    return exhausted_;
+  }
+  exhausted_ = std::chrono::steady_clock::now() >= deadline_;
+  return exhausted_;
+}
+
+}  // namespace libtextclassifier2
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Time budget of the regex and datetime patterns in one call.
+
+#ifndef LIBTEXTCLASSIFIER_REGEX_BUDGET_H_
+#define LIBTEXTCLASSIFIER_REGEX_BUDGET_H_
+
+#include <chrono>
+#include <vector>
+
+#include "util/base/integral_types.h"
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+// Limits the wall time that all patterns of one call take together, and
+// records the patterns whose matches ran over the UniLib::RegexLimits, so that
+// the classifier can report them.
+// NOTE: Not thread-safe, meant to live for a single call.
+class RegexBudget {
+ public:
+  // A budget of zero milliseconds or less is unlimited.
+  explicit RegexBudget(int64 budget_ms);
+
+  // Returns whether the budget is spent. The remaining patterns should be
+  // skipped then.
+  bool Exhausted();
+
+  // Whether Exhausted() has returned true.
+  bool exhausted() const { return exhausted_; }
+
+  // Records that a pattern of the regex model, or a rule of the datetime
+  // model, ran over the limits.
+  void AddRegexOverrun(int pattern_id) {
+    regex_overruns_.push_back(pattern_id);
+  }
+  void AddDatetimeOverrun(int rule_id) {
+    datetime_overruns_.push_back(rule_id);
+  }
+
+  // Whether patterns were skipped, or matches dropped because of an overrun,
+  // so that the results of the call may be incomplete.
+  bool truncated() const {
+    return exhausted_ || !regex_overruns_.empty() ||
+           !datetime_overruns_.empty();
+  }
+
+  const std::vector<int>& regex_overruns() const { return regex_overruns_; }
+  const std::vector<int>& datetime_overruns() const {
+    return datetime_overruns_;
+  }
+
+ private:
+  const bool limited_;
+  const std::chrono::steady_clock::time_point deadline_;
+  bool exhausted_ = false;
+
+  std::vector<int> regex_overruns_;
+  std::vector<int> datetime_overruns_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(RegexBudget);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_REGEX_BUDGET_H_
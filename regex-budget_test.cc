@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "regex-budget.h"
+
+#include <chrono>
+#include <thread>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+using testing::ElementsAre;
+
+TEST(RegexBudgetTest, Unlimited) {
+  RegexBudget budget(/*budget_ms=*/0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  EXPECT_FALSE(budget.Exhausted());
+  EXPECT_FALSE(budget.exhausted());
+}
+
+TEST(RegexBudgetTest, Exhausted) {
+  RegexBudget budget(/*budget_ms=*/1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  EXPECT_TRUE(budget.Exhausted());
+  EXPECT_TRUE(budget.exhausted());
+  EXPECT_TRUE(budget.truncated());
+}
+
+TEST(RegexBudgetTest, RecordsOverruns) {
+  RegexBudget budget(/*budget_ms=*/1000);
+  EXPECT_FALSE(budget.Exhausted());
+  EXPECT_FALSE(budget.truncated());
+  budget.AddRegexOverrun(3);
+  budget.AddDatetimeOverrun(1);
+  budget.AddRegexOverrun(0);
+  EXPECT_THAT(budget.regex_overruns(), ElementsAre(3, 0));
+  EXPECT_THAT(budget.datetime_overruns(), ElementsAre(1));
+  EXPECT_TRUE(budget.truncated());
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
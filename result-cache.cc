@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "result-cache.h"
+
+#include <algorithm>
+
+#include "util/hash/farmhash.h"
+
+namespace libtextclassifier2 {
+
+ResultCache::ResultCache(int capacity) : capacity_(std::max(1, capacity)) {
+  entry_for_key_.reserve(capacity_);
+}
+
+uint64 ResultCache::Key(int mode, const std::string& context,
+                        CodepointSpan span, const std::string& locales) {
+  // The fixed size fields come first, so that different locales can't produce
+  // the same bytes.
+  const uint64 context_fingerprint = tc2farmhash::Fingerprint64(context);
+  const int32 fields[] = {mode, span.first, span.second};
+  std::string key_data(reinterpret_cast<const char*>(&context_fingerprint),
+                       sizeof(context_fingerprint));
+  key_data.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+  key_data.append(locales);
+  return tc2farmhash::Fingerprint64(key_data);
+}
+
+bool ResultCache::Lookup(uint64 key, Entry* entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = entry_for_key_.find(key);
+  if (it == entry_for_key_.end()) {
+    ++stats_.misses;
+    return false;
+  }
+  ++stats_.hits;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  *entry = it->second->second;
+  return true;
+}
+
+void ResultCache::Insert(uint64 key, Entry entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = entry_for_key_.find(key);
+  if (it != entry_for_key_.end()) {
+    // Another thread inserted it in the meantime, or the datetime results
+    // were resolved against a different reference time.
+    it->second->second = std::move(entry);
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+
+  if (static_cast<int>(entries_.size()) >= capacity_) {
+    entry_for_key_.erase(entries_.back().first);
+    entries_.pop_back();
+    ++stats_.evictions;
+  }
+  entries_.emplace_front(key, std::move(entry));
+  entry_for_key_[key] = entries_.begin();
+}
+
+ResultCache::Stats ResultCache::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats result = stats_;
+  result.size = entries_.size();
+  return result;
+}
+
+}  // namespace libtextclassifier2
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cache of whole results of the text classifier, shared across requests.
+
+#ifndef LIBTEXTCLASSIFIER_RESULT_CACHE_H_
+#define LIBTEXTCLASSIFIER_RESULT_CACHE_H_
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+#include "util/base/integral_types.h"
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+// A bounded, thread-safe cache from fingerprints of the inputs of a call
+// (context, span, locales and mode) to its result, with least recently used
+// eviction. Meant for inputs that repeat often, like notification templates.
+class ResultCache {
+ public:
+  struct Entry {
+    // Only the field matching the mode of the key is used.
+    CodepointSpan selection = {kInvalidIndex, kInvalidIndex};
+    std::vector<ClassificationResult> classification;
+    std::vector<AnnotatedSpan> annotations;
+
+    // The reference time and timezone that the datetime results were resolved
+    // against. These are not part of the key, so the datetime results need to
+    // be resolved again if the caller's differ.
+    int64 reference_time_ms_utc = 0;
+    std::string reference_timezone;
+  };
+
+  struct Stats {
+    int64 hits = 0;
+    int64 misses = 0;
+    int64 evictions = 0;
+    int size = 0;
+  };
+
+  // Holds at most 'capacity' entries.
+  explicit ResultCache(int capacity);
+
+  // Returns the key for a call in 'mode' (a ModeFlag) on the given inputs.
+  static uint64 Key(int mode, const std::string& context, CodepointSpan span,
+                    const std::string& locales);
+
+  // Copies the entry for 'key' to 'entry'. Returns false if the key is not in
+  // the cache.
+  bool Lookup(uint64 key, Entry* entry);
+
+  // Adds the entry for 'key', evicting the least recently used entry if the
+  // cache is full.
+  void Insert(uint64 key, Entry entry);
+
+  Stats GetStats() const;
+
+ private:
+  using EntryList = std::list<std::pair<uint64, Entry>>;
+
+  const int capacity_;
+
+  mutable std::mutex mutex_;
+
+  // Entries ordered from the most to the least recently used.
+  EntryList entries_;
+  std::unordered_map<uint64, EntryList::iterator> entry_for_key_;
+  Stats stats_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(ResultCache);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_RESULT_CACHE_H_
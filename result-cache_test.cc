@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "result-cache.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+ResultCache::Entry SelectionEntry(int begin, int end) {
+  ResultCache::Entry entry;
+  entry.selection = {begin, end};
+  return entry;
+}
+
+TEST(ResultCacheTest, LookupAndInsert) {
+  ResultCache cache(/*capacity=*/4);
+  ResultCache::Entry entry;
+  EXPECT_FALSE(cache.Lookup(1, &entry));
+
+  ResultCache::Entry value;
+  value.classification = {{"phone", 0.5}};
+  value.reference_time_ms_utc = 1000;
+  value.reference_timezone = "Europe/Zurich";
+  cache.Insert(1, value);
+  ASSERT_TRUE(cache.Lookup(1, &entry));
+  ASSERT_EQ(entry.classification.size(), 1);
+  EXPECT_EQ(entry.classification[0].collection, "phone");
+  EXPECT_EQ(entry.reference_time_ms_utc, 1000);
+  EXPECT_EQ(entry.reference_timezone, "Europe/Zurich");
+
+  const ResultCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_EQ(stats.size, 1);
+}
+
+TEST(ResultCacheTest, EvictsLeastRecentlyUsed) {
+  ResultCache cache(/*capacity=*/2);
+  ResultCache::Entry entry;
+  cache.Insert(1, SelectionEntry(0, 1));
+  cache.Insert(2, SelectionEntry(0, 2));
+
+  // Key 1 is used, so key 2 is the one evicted when key 3 is added.
+  EXPECT_TRUE(cache.Lookup(1, &entry));
+  cache.Insert(3, SelectionEntry(0, 3));
+  EXPECT_TRUE(cache.Lookup(1, &entry));
+  EXPECT_FALSE(cache.Lookup(2, &entry));
+  ASSERT_TRUE(cache.Lookup(3, &entry));
+  EXPECT_EQ(entry.selection, std::make_pair(0, 3));
+
+  // Inserting an existing key replaces its entry.
+  cache.Insert(3, SelectionEntry(1, 3));
+  ASSERT_TRUE(cache.Lookup(3, &entry));
+  EXPECT_EQ(entry.selection, std::make_pair(1, 3));
+
+  const ResultCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_EQ(stats.size, 2);
+}
+
+TEST(ResultCacheTest, KeyDependsOnAllInputs) {
+  const uint64 key = ResultCache::Key(1, "call 123", {5, 8}, "en");
+  EXPECT_EQ(key, ResultCache::Key(1, "call 123", {5, 8}, "en"));
+  EXPECT_NE(key, ResultCache::Key(2, "call 123", {5, 8}, "en"));
+  EXPECT_NE(key, ResultCache::Key(1, "call 124", {5, 8}, "en"));
+  EXPECT_NE(key, ResultCache::Key(1, "call 123", {4, 8}, "en"));
+  EXPECT_NE(key, ResultCache::Key(1, "call 123", {5, 7}, "en"));
+  EXPECT_NE(key, ResultCache::Key(1, "call 123", {5, 8}, "de"));
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "streaming-annotator.h"
+
+#include <algorithm>
+
+#include "util/base/logging.h"
+#include "util/strings/utf8.h"
+#include "util/utf8/unicodetext.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+// Returns the size of the longest prefix of 'src' that is valid UTF-8.
+int ValidUTF8PrefixSize(const char* src, int size) {
+  int valid_size = 0;
+  while (valid_size < size) {
+    const int num_codepoint_bytes =
+        IsTrailByte(src[valid_size])
+            ? 0
+            : GetNumBytesForUTF8Char(&src[valid_size]);
+    if (num_codepoint_bytes <= 0 || valid_size + num_codepoint_bytes > size ||
+        !IsValidUTF8(&src[valid_size], num_codepoint_bytes)) {
+      break;
+    }
+    valid_size += num_codepoint_bytes;
+  }
+  return valid_size;
+}
+
+}  // namespace
+
+std::unique_ptr<StreamingAnnotator> StreamingAnnotator::Create(
+    const TextClassifier* classifier, const StreamingAnnotationOptions& options,
+    Callback callback) {
+  if (options.window_size <= 0 || options.min_overlap < 0) {
+    TC_LOG(ERROR) << "Invalid streaming options: window_size "
+                  << options.window_size << ", min_overlap "
+                  << options.min_overlap;
+    return nullptr;
+  }
+  return std::unique_ptr<StreamingAnnotator>(
+      new StreamingAnnotator(classifier, options, std::move(callback)));
+}
+
+StreamingAnnotator::StreamingAnnotator(
+    const TextClassifier* classifier, const StreamingAnnotationOptions& options,
+    Callback callback)
+    : classifier_(classifier),
+      options_(options),
+      callback_(std::move(callback)),
+      context_words_(classifier->AnnotationContextTokens()) {}
+
+bool StreamingAnnotator::Push(const std::string& chunk) {
+  pending_bytes_.append(chunk);
+
+  // Find the end of the last complete codepoint.
+  int complete_size = pending_bytes_.size();
+  int lead = complete_size - 1;
+  while (lead >= 0 && lead > complete_size - 4 &&
+         IsTrailByte(pending_bytes_[lead])) {
+    --lead;
+  }
+  if (lead >= 0 && !IsTrailByte(pending_bytes_[lead]) &&
+      lead + GetNumBytesForNonZeroUTF8Char(&pending_bytes_[lead]) >
+          complete_size) {
+    complete_size = lead;
+  }
+
+  // Keep the text up to an invalid sequence, and drop the rest of the chunk.
+  const bool valid = IsValidUTF8(pending_bytes_.data(), complete_size);
+  if (!valid) {
+    TC_LOG(ERROR) << "Invalid UTF-8 input.";
+    complete_size = ValidUTF8PrefixSize(pending_bytes_.data(), complete_size);
+  }
+  const UnicodeText text = UTF8ToUnicodeText(
+      pending_bytes_.data(), complete_size, /*do_copy=*/false);
+  buffer_.insert(buffer_.end(), text.begin(), text.end());
+  if (valid) {
+    pending_bytes_.erase(0, complete_size);
+  } else {
+    pending_bytes_.clear();
+  }
+
+  while (static_cast<int>(buffer_.size()) >= options_.window_size) {
+    AnnotateWindow(options_.window_size, /*is_last=*/false);
+  }
+  return valid;
+}
+
+bool StreamingAnnotator::Finish() {
+  const bool complete = pending_bytes_.empty();
+  if (!buffer_.empty()) {
+    AnnotateWindow(buffer_.size(), /*is_last=*/true);
+  }
+  pending_bytes_.clear();
+  buffer_.clear();
+  buffer_begin_ = 0;
+  finalized_end_ = 0;
+  return complete;
+}
+
+int StreamingAnnotator::WordsStart(int end, int num_words) const {
+  const UniLib& unilib = classifier_->GetUniLib();
+  int start = end;
+  for (int i = 0; i < num_words && start > 0; ++i) {
+    while (start > 0 && unilib.IsWhitespace(buffer_[start - 1])) {
+      --start;
+    }
+    while (start > 0 && !unilib.IsWhitespace(buffer_[start - 1])) {
+      --start;
+    }
+  }
+  return start;
+}
+
+void StreamingAnnotator::AnnotateWindow(int window_size, bool is_last) {
+  const int max_overlap = window_size / 4;
+
+  // Annotations that start before 'commit' (relative to the buffer) are final.
+  int commit = window_size;
+  if (!is_last) {
+    commit = std::min(WordsStart(window_size, context_words_),
+                      window_size - options_.min_overlap);
+    commit = std::max(commit, window_size - max_overlap);
+  }
+
+  UnicodeText window_text;
+  for (int i = 0; i < window_size; ++i) {
+    window_text.AppendCodepoint(buffer_[i]);
+  }
+  const std::vector<AnnotatedSpan> annotations = classifier_->Annotate(
+      window_text.ToUTF8String(), options_.annotation_options);
+
+  int reported_end = finalized_end_;
+  for (const AnnotatedSpan& annotation : annotations) {
+    AnnotatedSpan span = annotation;
+    span.span.first += buffer_begin_;
+    span.span.second += buffer_begin_;
+    if (span.span.first < finalized_end_) {
+      // Starts in the left context, and was decided by the previous window.
+      continue;
+    }
+    if (span.span.first >= buffer_begin_ + commit) {
+      break;
+    }
+    if (!is_last && annotation.span.second >= window_size &&
+        annotation.span.first > max_overlap) {
+      // Might continue past the window, leave it to the next one. It starts at
+      // most max_overlap codepoints into the next window, so the windows still
+      // advance.
+      commit = annotation.span.first;
+      break;
+    }
+    callback_(span);
+    reported_end = span.span.second;
+  }
+
+  if (is_last) {
+    return;
+  }
+  finalized_end_ = std::max(buffer_begin_ + commit, reported_end);
+
+  // Keep the left context of the next window.
+  int keep_from = std::min(WordsStart(commit, context_words_),
+                           commit - options_.min_overlap);
+  keep_from = std::max(keep_from, std::max(0, commit - max_overlap));
+  buffer_.erase(buffer_.begin(), buffer_.begin() + keep_from);
+  buffer_begin_ += keep_from;
+}
+
+}  // namespace libtextclassifier2
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Annotation of documents that arrive in chunks, with bounded memory.
+
+#ifndef LIBTEXTCLASSIFIER_STREAMING_ANNOTATOR_H_
+#define LIBTEXTCLASSIFIER_STREAMING_ANNOTATOR_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "text-classifier.h"
+#include "types.h"
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+struct StreamingAnnotationOptions {
+  AnnotationOptions annotation_options;
+
+  // Number of codepoints annotated at once. Memory use is proportional to it.
+  int window_size = 4096;
+
+  // Minimum number of codepoints of context kept on either side of the part of
+  // a window whose annotations are final, for regex and datetime matches.
+  int min_overlap = 128;
+
+  static StreamingAnnotationOptions Default() {
+    return StreamingAnnotationOptions();
+  }
+};
+
+// Annotates a document that is provided incrementally, and reports the
+// annotations through a callback as soon as they are final.
+//
+// The text is annotated in overlapping windows of options.window_size
+// codepoints. Only the annotations that start in the middle part of a window
+// are final, the ends of the window serve as context. The overlap covers
+// TextClassifier::AnnotationContextTokens() whitespace-separated words and at
+// least options.min_overlap codepoints, but at most a quarter of the window.
+// Conflicts at window seams are resolved in favor of the earlier window: an
+// annotation is dropped if it overlaps one that was already reported.
+//
+// When the overlaps cover the context the models look at, and the longest
+// regex and datetime matches, the result is identical to that of
+// TextClassifier::Annotate on the whole document.
+//
+// An annotation that reaches the end of a window is left to the next window,
+// which starts at most a quarter of a window before it. Annotations of up to
+// three quarters of options.window_size codepoints are therefore reported
+// whole; longer ones may be cut at the end of a window.
+//
+// NOTE: Not thread-safe. The classifier must outlive the annotator.
+class StreamingAnnotator {
+ public:
+  // Receives the annotations, in the order of the document, with spans in
+  // codepoints relative to the start of the document.
+  typedef std::function<void(const AnnotatedSpan&)> Callback;
+
+  // Returns nullptr if the options are invalid, i.e. the window size is not
+  // positive or the minimum overlap is negative.
+  static std::unique_ptr<StreamingAnnotator> Create(
+      const TextClassifier* classifier,
+      const StreamingAnnotationOptions& options, Callback callback);
+
+  // Appends a chunk of UTF-8 text to the document. A chunk can end in the
+  // middle of a codepoint. Returns false if the text is not valid UTF-8: the
+  // text before the invalid sequence is added to the document, and the rest of
+  // the chunk is dropped. The document can be continued with the next chunk.
+  bool Push(const std::string& chunk);
+
+  // Annotates the rest of the document. Returns false if the document ends in
+  // the middle of a codepoint. Afterwards, the annotator can be used for the
+  // next document.
+  bool Finish();
+
+ private:
+  StreamingAnnotator(const TextClassifier* classifier,
+                     const StreamingAnnotationOptions& options,
+                     Callback callback);
+
+  // Annotates the first 'window_size' buffered codepoints, reports the final
+  // annotations, and drops the text that is no longer needed.
+  void AnnotateWindow(int window_size, bool is_last);
+
+  // Returns the index of the buffered codepoint from which on there are
+  // 'num_words' whitespace-separated words before 'end'.
+  int WordsStart(int end, int num_words) const;
+
+  const TextClassifier* classifier_;
+  const StreamingAnnotationOptions options_;
+  const Callback callback_;
+  const int context_words_;
+
+  // Trailing bytes of an incomplete codepoint.
+  std::string pending_bytes_;
+
+  // The buffered codepoints, and the position of the first one in the
+  // document.
+  std::vector<char32> buffer_;
+  int buffer_begin_ = 0;
+
+  // Annotations that start before this position were reported or discarded.
+  int finalized_end_ = 0;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(StreamingAnnotator);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_STREAMING_ANNOTATOR_H_
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "streaming-annotator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+using testing::Values;
+
+std::string GetModelPath() { return LIBTEXTCLASSIFIER_TEST_DATA_DIR; }
+
+std::string FirstResult(const std::vector<ClassificationResult>& results) {
+  if (results.empty()) {
+    return "<INVALID RESULTS>";
+  }
+  return results[0].collection;
+}
+
+class StreamingAnnotatorTest : public ::testing::TestWithParam<const char*> {};
+
+INSTANTIATE_TEST_CASE_P(ClickContext, StreamingAnnotatorTest,
+                        Values("test_model_cc.fb"));
+INSTANTIATE_TEST_CASE_P(BoundsSensitive, StreamingAnnotatorTest,
+                        Values("test_model.fb"));
+
+TEST_P(StreamingAnnotatorTest, MatchesWholeDocumentAnnotation) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+
+  std::string document;
+  for (int i = 0; i < 20; ++i) {
+    document +=
+        "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my "
+        "phone number is 853 225 3556 in Zürich. ";
+  }
+  const std::vector<AnnotatedSpan> expected = classifier->Annotate(document);
+  ASSERT_FALSE(expected.empty());
+
+  StreamingAnnotationOptions options;
+  options.window_size = 512;
+  options.min_overlap = 64;
+  std::vector<AnnotatedSpan> annotations;
+  std::unique_ptr<StreamingAnnotator> annotator = StreamingAnnotator::Create(
+      classifier.get(), options, [&annotations](const AnnotatedSpan& span) {
+        annotations.push_back(span);
+      });
+  ASSERT_TRUE(annotator);
+  // Chunks of 7 bytes split some codepoints.
+  for (int i = 0; i < document.size(); i += 7) {
+    ASSERT_TRUE(annotator->Push(document.substr(i, 7)));
+  }
+  ASSERT_TRUE(annotator->Finish());
+
+  ASSERT_EQ(annotations.size(), expected.size());
+  for (int i = 0; i < annotations.size(); ++i) {
+    EXPECT_EQ(annotations[i].span, expected[i].span);
+    EXPECT_EQ(FirstResult(annotations[i].classification),
+              FirstResult(expected[i].classification));
+  }
+
+  // The annotator can be reused for the next document.
+  annotations.clear();
+  ASSERT_TRUE(annotator->Push(document));
+  ASSERT_TRUE(annotator->Finish());
+  EXPECT_EQ(annotations.size(), expected.size());
+}
+
+TEST_P(StreamingAnnotatorTest, RejectsInvalidOptions) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+  const auto callback = [](const AnnotatedSpan& span) {};
+
+  StreamingAnnotationOptions options;
+  options.window_size = 0;
+  EXPECT_FALSE(
+      StreamingAnnotator::Create(classifier.get(), options, callback));
+  options.window_size = -1;
+  EXPECT_FALSE(
+      StreamingAnnotator::Create(classifier.get(), options, callback));
+  options.window_size = 16;
+  options.min_overlap = -1;
+  EXPECT_FALSE(
+      StreamingAnnotator::Create(classifier.get(), options, callback));
+  options.min_overlap = 0;
+  EXPECT_TRUE(StreamingAnnotator::Create(classifier.get(), options, callback));
+}
+
+TEST_P(StreamingAnnotatorTest, RejectsInvalidUTF8) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+  std::vector<AnnotatedSpan> annotations;
+  std::unique_ptr<StreamingAnnotator> annotator = StreamingAnnotator::Create(
+      classifier.get(), StreamingAnnotationOptions::Default(),
+      [&annotations](const AnnotatedSpan& span) {
+        annotations.push_back(span);
+      });
+  ASSERT_TRUE(annotator);
+
+  // A document can't end in the middle of a codepoint.
+  EXPECT_TRUE(annotator->Push("Z\xC3"));
+  EXPECT_FALSE(annotator->Finish());
+
+  // The text before an invalid sequence is kept, the rest of the chunk is
+  // dropped, and the document continues with the next chunk.
+  const std::string phone = "call 853 225 3556";
+  EXPECT_FALSE(annotator->Push(phone + " \xFF\xFF dropped"));
+  EXPECT_TRUE(annotator->Push(" or later"));
+  EXPECT_TRUE(annotator->Finish());
+  const std::vector<AnnotatedSpan> expected =
+      classifier->Annotate(phone + "  or later");
+  ASSERT_EQ(annotations.size(), expected.size());
+  for (int i = 0; i < annotations.size(); ++i) {
+    EXPECT_EQ(annotations[i].span, expected[i].span);
+  }
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -17,14 +17,20 @@
 #include "text-classifier.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cmath>
+#include <condition_variable>
 #include <iterator>
+#include <map>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 #include "util/base/logging.h"
 #include "util/math/softmax.h"
 #include "util/utf8/unicodetext.h"
+#include "util/utf8/utf16-text.h"
 
 namespace libtextclassifier2 {
 const std::string& TextClassifier::kOtherCollection =
@@ -49,37 +55,39 @@ const Model* LoadAndVerifyModel(const void* addr, int size) {
 }
 }  // namespace
 
-tflite::Interpreter* InterpreterManager::SelectionInterpreter() {
-  if (!selection_interpreter_) {
+ExecutionContext* InterpreterManager::SelectionContext() {
+  if (!selection_context_) {
     TC_CHECK(selection_executor_);
-    selection_interpreter_ = selection_executor_->CreateInterpreter();
-    if (!selection_interpreter_) {
-      TC_LOG(ERROR) << "Could not build TFLite interpreter.";
+    selection_context_ = selection_executor_->CreateContext();
+    if (!selection_context_) {
+      TC_LOG(ERROR) << "Could not create execution context.";
     }
   }
-  return selection_interpreter_.get();
+  return selection_context_.get();
 }
 
-tflite::Interpreter* InterpreterManager::ClassificationInterpreter() {
-  if (!classification_interpreter_) {
+ExecutionContext* InterpreterManager::ClassificationContext() {
+  if (!classification_context_) {
     TC_CHECK(classification_executor_);
-    classification_interpreter_ = classification_executor_->CreateInterpreter();
-    if (!classification_interpreter_) {
-      TC_LOG(ERROR) << "Could not build TFLite interpreter.";
+    classification_context_ = classification_executor_->CreateContext();
+    if (!classification_context_) {
+      TC_LOG(ERROR) << "Could not create execution context.";
     }
   }
-  return classification_interpreter_.get();
+  return classification_context_.get();
 }
 
 std::unique_ptr<TextClassifier> TextClassifier::FromUnownedBuffer(
-    const char* buffer, int size, const UniLib* unilib) {
+    const char* buffer, int size, const UniLib* unilib,
+    const LoadOptions& load_options) {
   const Model* model = LoadAndVerifyModel(buffer, size);
   if (model == nullptr) {
     return nullptr;
   }
 
   auto classifier =
-      std::unique_ptr<TextClassifier>(new TextClassifier(model, unilib));
+      std::unique_ptr<TextClassifier>(
+          new TextClassifier(model, unilib, load_options));
   if (!classifier->IsInitialized()) {
     return nullptr;
   }
@@ -88,7 +96,8 @@ std::unique_ptr<TextClassifier> TextClassifier::FromUnownedBuffer(
 }
 
 std::unique_ptr<TextClassifier> TextClassifier::FromScopedMmap(
-    std::unique_ptr<ScopedMmap>* mmap, const UniLib* unilib) {
+    std::unique_ptr<ScopedMmap>* mmap, const UniLib* unilib,
+    const LoadOptions& load_options) {
   if (!(*mmap)->handle().ok()) {
     TC_VLOG(1) << "Mmap failed.";
     return nullptr;
@@ -102,7 +111,8 @@ std::unique_ptr<TextClassifier> TextClassifier::FromScopedMmap(
   }
 
   auto classifier =
-      std::unique_ptr<TextClassifier>(new TextClassifier(mmap, model, unilib));
+      std::unique_ptr<TextClassifier>(
+          new TextClassifier(mmap, model, unilib, load_options));
   if (!classifier->IsInitialized()) {
     return nullptr;
   }
@@ -111,23 +121,120 @@ std::unique_ptr<TextClassifier> TextClassifier::FromScopedMmap(
 }
 
 std::unique_ptr<TextClassifier> TextClassifier::FromFileDescriptor(
-    int fd, int offset, int size, const UniLib* unilib) {
+    int fd, int offset, int size, const UniLib* unilib,
+    const LoadOptions& load_options) {
   std::unique_ptr<ScopedMmap> mmap(new ScopedMmap(fd, offset, size));
-  return FromScopedMmap(&mmap, unilib);
+  return FromScopedMmap(&mmap, unilib, load_options);
 }
 
 std::unique_ptr<TextClassifier> TextClassifier::FromFileDescriptor(
-    int fd, const UniLib* unilib) {
+    int fd, const UniLib* unilib, const LoadOptions& load_options) {
   std::unique_ptr<ScopedMmap> mmap(new ScopedMmap(fd));
-  return FromScopedMmap(&mmap, unilib);
+  return FromScopedMmap(&mmap, unilib, load_options);
 }
 
 std::unique_ptr<TextClassifier> TextClassifier::FromPath(
-    const std::string& path, const UniLib* unilib) {
+    const std::string& path, const UniLib* unilib,
+    const LoadOptions& load_options) {
   std::unique_ptr<ScopedMmap> mmap(new ScopedMmap(path));
-  return FromScopedMmap(&mmap, unilib);
+  return FromScopedMmap(&mmap, unilib, load_options);
 }
 
+namespace {
+
+// Runs the initialization tasks, as configured by LoadOptions::init_executor
+// and LoadOptions::num_init_threads, and returns whether all of them
+// succeeded.
+bool RunInitTasks(const std::vector<std::function<bool()>>& tasks,
+                  const LoadOptions& load_options) {
+  if (load_options.init_executor) {
+    std::mutex mutex;
+    std::condition_variable done;
+    int num_pending = tasks.size();
+    bool success = true;
+    for (const std::function<bool()>& task : tasks) {
+      load_options.init_executor([&task, &mutex, &done, &num_pending,
+                                  &success]() {
+        const bool task_success = task();
+        std::lock_guard<std::mutex> lock(mutex);
+        success = success && task_success;
+        if (--num_pending == 0) {
+          done.notify_all();
+        }
+      });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&num_pending]() { return num_pending == 0; });
+    return success;
+  }
+
+  const int num_threads =
+      std::min(load_options.num_init_threads, static_cast<int>(tasks.size()));
+  if (num_threads <= 1) {
+    for (const std::function<bool()>& task : tasks) {
+      if (!task()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The calling thread is one of the workers. No new task is started after
+  // one has failed.
+  std::atomic<int> next_task(0);
+  std::atomic<bool> success(true);
+  const auto run_tasks = [&tasks, &next_task, &success]() {
+    for (int i = next_task++; i < tasks.size() && success; i = next_task++) {
+      if (!tasks[i]()) {
+        success = false;
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; ++i) {
+    threads.emplace_back(run_tasks);
+  }
+  run_tasks();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return success;
+}
+
+UniLib::RegexLimits GetRegexLimits(const LoadOptions& load_options) {
+  UniLib::RegexLimits limits;
+  limits.time_limit = load_options.regex_time_limit;
+  limits.stack_limit_bytes = load_options.regex_stack_limit_bytes;
+  return limits;
+}
+
+// Whether the patterns of the regex model were compressed into a single zlib
+// stream, that continues in the datetime model.
+bool IsCompressedAsOneStream(const RegexModel* regex_model) {
+  if (regex_model->patterns() == nullptr) {
+    return false;
+  }
+  for (const RegexModel_::Pattern* pattern : *regex_model->patterns()) {
+    if (pattern->compressed_pattern() != nullptr &&
+        pattern->compressed_pattern()->buffer() != nullptr) {
+      return !pattern->compressed_pattern()->independent();
+    }
+  }
+  return false;
+}
+
+// Creates an executor with the factory if given, or with TFLite otherwise.
+std::unique_ptr<const ModelExecutor> CreateModelExecutor(
+    const ModelExecutorFactory& factory,
+    const flatbuffers::Vector<uint8_t>* model_spec_buffer) {
+  if (factory) {
+    return factory(model_spec_buffer);
+  }
+  return TFLiteModelExecutor::Instance(model_spec_buffer);
+}
+
+}  // namespace
+
 void TextClassifier::ValidateAndInitialize() {
   initialized_ = false;
 
@@ -148,7 +255,9 @@ void TextClassifier::ValidateAndInitialize() {
        (model_->triggering_options()->enabled_modes() & ModeFlag_SELECTION));
 
   // Annotation requires the selection model.
-  if (model_enabled_for_annotation || model_enabled_for_selection) {
+  const bool needs_selection_model =
+      model_enabled_for_annotation || model_enabled_for_selection;
+  if (needs_selection_model) {
     if (!model_->selection_options()) {
       TC_LOG(ERROR) << "No selection options.";
       return;
@@ -165,20 +274,17 @@ void TextClassifier::ValidateAndInitialize() {
       TC_LOG(ERROR) << "No selection model.";
       return;
     }
-    selection_executor_ = ModelExecutor::Instance(model_->selection_model());
-    if (!selection_executor_) {
-      TC_LOG(ERROR) << "Could not initialize selection executor.";
-      return;
-    }
-    selection_feature_processor_.reset(
-        new FeatureProcessor(model_->selection_feature_options(), unilib_));
   }
 
   // Annotation requires the classification model for conflict resolution and
   // scoring.
   // Selection requires the classification model for conflict resolution.
-  if (model_enabled_for_annotation || model_enabled_for_classification ||
-      model_enabled_for_selection) {
+  // The embeddings need to be specified if the model is to be used for
+  // classification or selection.
+  const bool needs_classification_model = model_enabled_for_annotation ||
+                                          model_enabled_for_classification ||
+                                          model_enabled_for_selection;
+  if (needs_classification_model) {
     if (!model_->classification_options()) {
       TC_LOG(ERROR) << "No classification options.";
       return;
@@ -199,21 +305,6 @@ void TextClassifier::ValidateAndInitialize() {
       return;
     }
 
-    classification_executor_ =
-        ModelExecutor::Instance(model_->classification_model());
-    if (!classification_executor_) {
-      TC_LOG(ERROR) << "Could not initialize classification executor.";
-      return;
-    }
-
-    classification_feature_processor_.reset(new FeatureProcessor(
-        model_->classification_feature_options(), unilib_));
-  }
-
-  // The embeddings need to be specified if the model is to be used for
-  // classification or selection.
-  if (model_enabled_for_annotation || model_enabled_for_classification ||
-      model_enabled_for_selection) {
     if (!model_->embedding_model()) {
       TC_LOG(ERROR) << "No embedding model.";
       return;
@@ -230,57 +321,197 @@ void TextClassifier::ValidateAndInitialize() {
       TC_LOG(ERROR) << "Mismatching embedding size/quantization.";
       return;
     }
+  }
 
-    embedding_executor_ = TFLiteEmbeddingExecutor::Instance(
-        model_->embedding_model(),
-        model_->classification_feature_options()->embedding_size(),
-        model_->classification_feature_options()
-            ->embedding_quantization_bits());
-    if (!embedding_executor_) {
-      TC_LOG(ERROR) << "Could not initialize embedding executor.";
-      return;
+  // The components below don't depend on each other, and are initialized by
+  // separate tasks that may run concurrently. Each task only writes its own
+  // members.
+  std::vector<std::function<bool()>> init_tasks;
+
+  if (needs_selection_model) {
+    if (load_options_.token_embedding_cache_size > 0) {
+      selection_token_embedding_cache_.reset(new TokenEmbeddingCache(
+          load_options_.token_embedding_cache_size,
+          internal::CachedTokenFeaturesSize(
+              model_->selection_feature_options())));
     }
+    init_tasks.push_back([this]() {
+      selection_executor_ =
+          CreateModelExecutor(load_options_.selection_executor_factory,
+                              model_->selection_model());
+      if (!selection_executor_) {
+        TC_LOG(ERROR) << "Could not initialize selection executor.";
+        return false;
+      }
+      return true;
+    });
+    init_tasks.push_back([this]() {
+      selection_feature_processor_.reset(new FeatureProcessor(
+          model_->selection_feature_options(), unilib_,
+          selection_token_embedding_cache_.get()));
+      return true;
+    });
+  }
+
+  if (needs_classification_model) {
+    share_embedding_cache_ =
+        needs_selection_model &&
+        internal::HaveCompatibleTokenFeatures(
+            model_->selection_feature_options(),
+            model_->classification_feature_options());
+    TokenEmbeddingCache* token_embedding_cache = nullptr;
+    if (share_embedding_cache_) {
+      token_embedding_cache = selection_token_embedding_cache_.get();
+    } else if (load_options_.token_embedding_cache_size > 0) {
+      classification_token_embedding_cache_.reset(new TokenEmbeddingCache(
+          load_options_.token_embedding_cache_size,
+          internal::CachedTokenFeaturesSize(
+              model_->classification_feature_options())));
+      token_embedding_cache = classification_token_embedding_cache_.get();
+    }
+
+    init_tasks.push_back([this]() {
+      classification_executor_ =
+          CreateModelExecutor(load_options_.classification_executor_factory,
+                              model_->classification_model());
+      if (!classification_executor_) {
+        TC_LOG(ERROR) << "Could not initialize classification executor.";
+        return false;
+      }
+      return true;
+    });
+    init_tasks.push_back([this, token_embedding_cache]() {
+      classification_feature_processor_.reset(
+          new FeatureProcessor(model_->classification_feature_options(),
+                               unilib_, token_embedding_cache));
+      return true;
+    });
+    init_tasks.push_back([this]() {
+      std::unique_ptr<TFLiteEmbeddingExecutor> embedding_executor =
+          TFLiteEmbeddingExecutor::Instance(
+              model_->embedding_model(),
+              model_->classification_feature_options()->embedding_size(),
+              model_->classification_feature_options()
+                  ->embedding_quantization_bits(),
+              load_options_.unpack_quantized_embeddings,
+              model_->embedding_bucket_rows());
+      if (!embedding_executor) {
+        TC_LOG(ERROR) << "Could not initialize embedding executor.";
+        return false;
+      }
+      unpacked_embeddings_bytes_ =
+          embedding_executor->UnpackedEmbeddingsBytes();
+      embedding_executor_ = std::move(embedding_executor);
+      return true;
+    });
   }
 
-  std::unique_ptr<ZlibDecompressor> decompressor = ZlibDecompressor::Instance();
-  if (model_->regex_model()) {
-    if (!InitializeRegexModel(decompressor.get())) {
+  const auto initialize_regex_model = [this](ZlibDecompressor* decompressor) {
+    if (!InitializeRegexModel(decompressor)) {
       TC_LOG(ERROR) << "Could not initialize regex model.";
-      return;
+      return false;
+    }
+    return true;
+  };
+  const auto initialize_datetime_parser =
+      [this](ZlibDecompressor* decompressor) {
+        datetime_parser_ = DatetimeParser::Instance(
+            model_->datetime_model(), *unilib_, decompressor,
+            GetRegexLimits(load_options_), load_options_.locales);
+        if (!datetime_parser_) {
+          TC_LOG(ERROR) << "Could not initialize datetime parser.";
+          return false;
+        }
+        return true;
+      };
+
+  // The regex model and the datetime parser use separate decompressors, so
+  // that they can be initialized concurrently. Models compressed into a single
+  // stream have to be decompressed in order, with one decompressor.
+  if (model_->regex_model() && model_->datetime_model() &&
+      IsCompressedAsOneStream(model_->regex_model())) {
+    init_tasks.push_back(
+        [initialize_regex_model, initialize_datetime_parser]() {
+          std::unique_ptr<ZlibDecompressor> decompressor =
+              ZlibDecompressor::Instance();
+          return initialize_regex_model(decompressor.get()) &&
+                 initialize_datetime_parser(decompressor.get());
+        });
+  } else {
+    if (model_->regex_model()) {
+      init_tasks.push_back([this, initialize_regex_model]() {
+        std::unique_ptr<ZlibDecompressor> decompressor =
+            ZlibDecompressor::Instance(
+                model_->regex_model()->compression_dictionary());
+        return initialize_regex_model(decompressor.get());
+      });
+    }
+    if (model_->datetime_model()) {
+      init_tasks.push_back([this, initialize_datetime_parser]() {
+        std::unique_ptr<ZlibDecompressor> decompressor =
+            ZlibDecompressor::Instance(
+                model_->datetime_model()->compression_dictionary());
+        return initialize_datetime_parser(decompressor.get());
+      });
     }
   }
 
-  if (model_->datetime_model()) {
-    datetime_parser_ = DatetimeParser::Instance(model_->datetime_model(),
-                                                *unilib_, decompressor.get());
-    if (!datetime_parser_) {
-      TC_LOG(ERROR) << "Could not initialize datetime parser.";
-      return;
-    }
+  if (!RunInitTasks(init_tasks, load_options_)) {
+    return;
   }
 
   if (model_->output_options()) {
-    if (model_->output_options()->filtered_collections_annotation()) {
-      for (const auto collection :
-           *model_->output_options()->filtered_collections_annotation()) {
-        filtered_collections_annotation_.insert(collection->str());
-      }
-    }
-    if (model_->output_options()->filtered_collections_classification()) {
-      for (const auto collection :
-           *model_->output_options()->filtered_collections_classification()) {
-        filtered_collections_classification_.insert(collection->str());
-      }
+    filtered_collections_annotation_ =
+        model_->output_options()->filtered_collections_annotation();
+    filtered_collections_classification_ =
+        model_->output_options()->filtered_collections_classification();
+    filtered_collections_selection_ =
+        model_->output_options()->filtered_collections_selection();
+  }
+
+  InitializeCollections();
+
+  if (load_options_.result_cache_size > 0) {
+    result_cache_.reset(new ResultCache(load_options_.result_cache_size));
+  }
+
+  if (needs_selection_model && load_options_.num_inference_threads > 1) {
+    // The calling thread is one of the inference threads.
+    inference_thread_pool_.reset(
+        new ThreadPool(load_options_.num_inference_threads - 1));
+  }
+
+  initialized_ = true;
+}
+
+void TextClassifier::InitializeCollections() {
+  auto add_collection = [this](const std::string& collection) {
+    if (collection_indices_.emplace(collection, collections_.size()).second) {
+      collections_.push_back(collection);
     }
-    if (model_->output_options()->filtered_collections_selection()) {
-      for (const auto collection :
-           *model_->output_options()->filtered_collections_selection()) {
-        filtered_collections_selection_.insert(collection->str());
-      }
+  };
+
+  add_collection(kOtherCollection);
+  if (classification_feature_processor_) {
+    for (int i = 0; i < classification_feature_processor_->NumCollections();
+         ++i) {
+      add_collection(classification_feature_processor_->LabelToCollection(i));
     }
   }
+  for (const CompiledRegexPattern& regex_pattern : regex_patterns_) {
+    add_collection(regex_pattern.collection_name);
+  }
+  if (datetime_parser_) {
+    add_collection(kDateCollection);
+  }
+}
 
-  initialized_ = true;
+int TextClassifier::CollectionIndex(const std::string& collection) const {
+  const auto it = collection_indices_.find(collection);
+  if (it == collection_indices_.end()) {
+    return -1;
+  }
+  return it->second;
 }
 
 bool TextClassifier::InitializeRegexModel(ZlibDecompressor* decompressor) {
@@ -299,6 +530,7 @@ bool TextClassifier::InitializeRegexModel(ZlibDecompressor* decompressor) {
       TC_LOG(INFO) << "Failed to load regex pattern";
       return false;
     }
+    compiled_pattern->set_limits(GetRegexLimits(load_options_));
 
     if (regex_pattern->enabled_modes() & ModeFlag_ANNOTATION) {
       annotation_regex_patterns_.push_back(regex_pattern_id);
@@ -390,56 +622,184 @@ CodepointSpan SnapLeftIfWhitespaceSelection(CodepointSpan span,
 }
 }  // namespace internal
 
+namespace {
+// Returns whether the collection is in the list from the model. The lists are
+// short, so they are searched in place.
+bool IsCollectionInList(const TextClassifier::CollectionList* list,
+                        const std::string& collection) {
+  if (list == nullptr) {
+    return false;
+  }
+  for (const flatbuffers::String* listed_collection : *list) {
+    if (listed_collection->size() == collection.size() &&
+        collection.compare(0, collection.size(), listed_collection->c_str(),
+                           listed_collection->size()) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
 bool TextClassifier::FilteredForAnnotation(const AnnotatedSpan& span) const {
   return !span.classification.empty() &&
-         filtered_collections_annotation_.find(
-             span.classification[0].collection) !=
-             filtered_collections_annotation_.end();
+         IsCollectionInList(filtered_collections_annotation_,
+                            span.classification[0].collection);
 }
 
 bool TextClassifier::FilteredForClassification(
     const ClassificationResult& classification) const {
-  return filtered_collections_classification_.find(classification.collection) !=
-         filtered_collections_classification_.end();
+  return IsCollectionInList(filtered_collections_classification_,
+                            classification.collection);
 }
 
 bool TextClassifier::FilteredForSelection(const AnnotatedSpan& span) const {
   return !span.classification.empty() &&
-         filtered_collections_selection_.find(
-             span.classification[0].collection) !=
-             filtered_collections_selection_.end();
+         IsCollectionInList(filtered_collections_selection_,
+                            span.classification[0].collection);
 }
 
 CodepointSpan TextClassifier::SuggestSelection(
     const std::string& context, CodepointSpan click_indices,
     const SelectionOptions& options) const {
-  CodepointSpan original_click_indices = click_indices;
+  return SuggestSelectionBatch(context, {click_indices}, options)[0];
+}
+
+std::vector<CodepointSpan> TextClassifier::SuggestSelectionBatch(
+    const std::string& context, const std::vector<CodepointSpan>& clicks,
+    const SelectionOptions& options) const {
+  std::vector<CodepointSpan> result = clicks;
   if (!initialized_) {
     TC_LOG(ERROR) << "Not initialized";
-    return original_click_indices;
+    return result;
   }
   if (!(model_->enabled_modes() & ModeFlag_SELECTION)) {
-    return original_click_indices;
+    return result;
   }
 
   const UnicodeText context_unicode = UTF8ToUnicodeText(context,
                                                         /*do_copy=*/false);
 
   if (!context_unicode.is_valid()) {
-    return original_click_indices;
+    return result;
   }
 
   const int context_codepoint_size = context_unicode.size_codepoints();
 
-  if (click_indices.first < 0 || click_indices.second < 0 ||
-      click_indices.first >= context_codepoint_size ||
-      click_indices.second > context_codepoint_size ||
-      click_indices.first >= click_indices.second) {
-    TC_VLOG(1) << "Trying to run SuggestSelection with invalid indices: "
-               << click_indices.first << " " << click_indices.second;
-    return original_click_indices;
+  std::vector<int> valid_clicks;
+  for (int i = 0; i < clicks.size(); ++i) {
+    const CodepointSpan& click_indices = clicks[i];
+    if (click_indices.first < 0 || click_indices.second < 0 ||
+        click_indices.first >= context_codepoint_size ||
+        click_indices.second > context_codepoint_size ||
+        click_indices.first >= click_indices.second) {
+      TC_VLOG(1) << "Trying to run SuggestSelection with invalid indices: "
+                 << click_indices.first << " " << click_indices.second;
+      continue;
+    }
+    valid_clicks.push_back(i);
+  }
+
+  std::vector<uint64> cache_keys;
+  if (result_cache_) {
+    cache_keys.resize(clicks.size());
+    std::vector<int> uncached_clicks;
+    for (const int i : valid_clicks) {
+      cache_keys[i] = ResultCache::Key(ModeFlag_SELECTION, context, clicks[i],
+                                       options.locales);
+      ResultCache::Entry entry;
+      if (result_cache_->Lookup(cache_keys[i], &entry)) {
+        result[i] = entry.selection;
+      } else {
+        uncached_clicks.push_back(i);
+      }
+    }
+    valid_clicks = std::move(uncached_clicks);
+  }
+  if (valid_clicks.empty()) {
+    return result;
+  }
+
+  // The regex and datetime candidates, the tokens and the token features don't
+  // depend on the click, so they are computed once for all the clicks.
+  std::vector<AnnotatedSpan> context_candidates;
+  RegexBudget regex_budget(regex_budget_ms_);
+  const bool regex_chunked =
+      RegexChunk(context_unicode, selection_regex_patterns_, &regex_budget,
+                 &context_candidates);
+  const bool datetime_chunked =
+      regex_chunked &&
+      DatetimeChunk(context_unicode,
+                    /*reference_time_ms_utc=*/0, /*reference_timezone=*/"",
+                    options.locales, ModeFlag_SELECTION, &regex_budget,
+                    &context_candidates);
+  RecordRegexBudget(regex_budget);
+  if (!regex_chunked) {
+    TC_LOG(ERROR) << "Regex suggest selection failed.";
+    return result;
+  }
+  if (!datetime_chunked) {
+    TC_LOG(ERROR) << "Datetime suggest selection failed.";
+    return result;
   }
 
+  std::vector<Token> context_tokens;
+  if (model_->triggering_options() != nullptr &&
+      (model_->triggering_options()->enabled_modes() & ModeFlag_SELECTION)) {
+    context_tokens = selection_feature_processor_->Tokenize(context_unicode);
+  }
+
+  InterpreterManager interpreter_manager(selection_executor_.get(),
+                                         classification_executor_.get());
+  // The spans of the tokens are absolute in the context, so the cached
+  // features stay valid for all the clicks, also for the tokens that were
+  // split or dropped for a particular click.
+  FeatureProcessor::EmbeddingCache embedding_cache(
+      classification_feature_processor_->CachedTokenFeaturesSize());
+  embedding_cache.Reset(context_tokens);
+
+  for (const int i : valid_clicks) {
+    result[i] = SuggestSelectionForClick(
+        context, context_unicode, clicks[i], context_tokens,
+        context_candidates, &interpreter_manager, &embedding_cache);
+    if (result_cache_ && !regex_budget.truncated()) {
+      ResultCache::Entry entry;
+      entry.selection = result[i];
+      result_cache_->Insert(cache_keys[i], std::move(entry));
+    }
+  }
+  return result;
+}
+
+namespace {
+// Helper function that returns the index of the first candidate that
+// transitively does not overlap with the candidate on 'start_index'. If the end
+// of 'candidates' is reached, it returns the index that points right behind the
+// array.
+int FirstNonOverlappingSpanIndex(const std::vector<AnnotatedSpan>& candidates,
+                                 int start_index) {
+  int first_non_overlapping = start_index + 1;
+  CodepointSpan conflicting_span = candidates[start_index].span;
+  while (
+      first_non_overlapping < candidates.size() &&
+      SpansOverlap(conflicting_span, candidates[first_non_overlapping].span)) {
+    // Grow the span to include the current one.
+    conflicting_span.second = std::max(
+        conflicting_span.second, candidates[first_non_overlapping].span.second);
+
+    ++first_non_overlapping;
+  }
+  return first_non_overlapping;
+}
+}  // namespace
+
+CodepointSpan TextClassifier::SuggestSelectionForClick(
+    const std::string& context, const UnicodeText& context_unicode,
+    CodepointSpan click_indices, const std::vector<Token>& context_tokens,
+    const std::vector<AnnotatedSpan>& context_candidates,
+    InterpreterManager* interpreter_manager,
+    FeatureProcessor::EmbeddingCache* embedding_cache) const {
+  CodepointSpan original_click_indices = click_indices;
   if (model_->snap_whitespace_selections()) {
     // We want to expand a purely white-space selection to a multi-selection it
     // would've been part of. But with this feature disabled we would do a no-
@@ -458,24 +818,15 @@ CodepointSpan TextClassifier::SuggestSelection(
   }
 
   std::vector<AnnotatedSpan> candidates;
-  InterpreterManager interpreter_manager(selection_executor_.get(),
-                                         classification_executor_.get());
   std::vector<Token> tokens;
-  if (!ModelSuggestSelection(context_unicode, click_indices,
-                             &interpreter_manager, &tokens, &candidates)) {
+  if (!ModelSuggestSelection(context_unicode, click_indices, context_tokens,
+                             interpreter_manager, embedding_cache, &tokens,
+                             &candidates)) {
     TC_LOG(ERROR) << "Model suggest selection failed.";
     return original_click_indices;
   }
-  if (!RegexChunk(context_unicode, selection_regex_patterns_, &candidates)) {
-    TC_LOG(ERROR) << "Regex suggest selection failed.";
-    return original_click_indices;
-  }
-  if (!DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
-                     /*reference_time_ms_utc=*/0, /*reference_timezone=*/"",
-                     options.locales, ModeFlag_SELECTION, &candidates)) {
-    TC_LOG(ERROR) << "Datetime suggest selection failed.";
-    return original_click_indices;
-  }
+  candidates.insert(candidates.end(), context_candidates.begin(),
+                    context_candidates.end());
 
   // Sort candidates according to their position in the input, so that the next
   // code can assume that any connected component of overlapping spans forms a
@@ -485,66 +836,65 @@ CodepointSpan TextClassifier::SuggestSelection(
               return a.span.first < b.span.first;
             });
 
+  // Only the connected components that overlap the click can give the result,
+  // so the conflicts elsewhere in the context are not resolved.
+  std::vector<AnnotatedSpan> click_candidates;
+  for (int i = 0; i < candidates.size();) {
+    const int first_non_overlapping =
+        FirstNonOverlappingSpanIndex(candidates, /*start_index=*/i);
+    CodepointSpan component_span = candidates[i].span;
+    for (int j = i + 1; j < first_non_overlapping; ++j) {
+      component_span.second =
+          std::max(component_span.second, candidates[j].span.second);
+    }
+    if (SpansOverlap(component_span, click_indices)) {
+      click_candidates.insert(click_candidates.end(), candidates.begin() + i,
+                              candidates.begin() + first_non_overlapping);
+    }
+    i = first_non_overlapping;
+  }
+
   std::vector<int> candidate_indices;
-  if (!ResolveConflicts(candidates, context, tokens, &interpreter_manager,
-                        &candidate_indices)) {
+  if (!ResolveConflicts(click_candidates, context, tokens, interpreter_manager,
+                        embedding_cache, &candidate_indices)) {
     TC_LOG(ERROR) << "Couldn't resolve conflicts.";
     return original_click_indices;
   }
 
   for (const int i : candidate_indices) {
-    if (SpansOverlap(candidates[i].span, click_indices) &&
-        SpansOverlap(candidates[i].span, original_click_indices)) {
+    if (SpansOverlap(click_candidates[i].span, click_indices) &&
+        SpansOverlap(click_candidates[i].span, original_click_indices)) {
       // Run model classification if not present but requested and there's a
       // classification collection filter specified.
-      if (candidates[i].classification.empty() &&
+      if (click_candidates[i].classification.empty() &&
           model_->selection_options()->always_classify_suggested_selection() &&
-          !filtered_collections_selection_.empty()) {
-        if (!ModelClassifyText(
-                context, candidates[i].span, &interpreter_manager,
-                /*embedding_cache=*/nullptr, &candidates[i].classification)) {
+          filtered_collections_selection_ != nullptr &&
+          filtered_collections_selection_->size() > 0) {
+        if (!ModelClassifyText(context, click_candidates[i].span,
+                               interpreter_manager, embedding_cache,
+                               &click_candidates[i].classification)) {
           return original_click_indices;
         }
       }
 
       // Ignore if span classification is filtered.
-      if (FilteredForSelection(candidates[i])) {
+      if (FilteredForSelection(click_candidates[i])) {
         return original_click_indices;
       }
 
-      return candidates[i].span;
+      return click_candidates[i].span;
     }
   }
 
   return original_click_indices;
 }
 
-namespace {
-// Helper function that returns the index of the first candidate that
-// transitively does not overlap with the candidate on 'start_index'. If the end
-// of 'candidates' is reached, it returns the index that points right behind the
-// array.
-int FirstNonOverlappingSpanIndex(const std::vector<AnnotatedSpan>& candidates,
-                                 int start_index) {
-  int first_non_overlapping = start_index + 1;
-  CodepointSpan conflicting_span = candidates[start_index].span;
-  while (
-      first_non_overlapping < candidates.size() &&
-      SpansOverlap(conflicting_span, candidates[first_non_overlapping].span)) {
-    // Grow the span to include the current one.
-    conflicting_span.second = std::max(
-        conflicting_span.second, candidates[first_non_overlapping].span.second);
-
-    ++first_non_overlapping;
-  }
-  return first_non_overlapping;
-}
-}  // namespace
-
 bool TextClassifier::ResolveConflicts(
     const std::vector<AnnotatedSpan>& candidates, const std::string& context,
     const std::vector<Token>& cached_tokens,
-    InterpreterManager* interpreter_manager, std::vector<int>* result) const {
+    InterpreterManager* interpreter_manager,
+    FeatureProcessor::EmbeddingCache* embedding_cache,
+    std::vector<int>* result) const {
   result->clear();
   result->reserve(candidates.size());
   for (int i = 0; i < candidates.size();) {
@@ -556,7 +906,7 @@ bool TextClassifier::ResolveConflicts(
       std::vector<int> candidate_indices;
       if (!ResolveConflict(context, cached_tokens, candidates, i,
                            first_non_overlapping, interpreter_manager,
-                           &candidate_indices)) {
+                           embedding_cache, &candidate_indices)) {
         return false;
       }
       result->insert(result->end(), candidate_indices.begin(),
@@ -592,6 +942,7 @@ bool TextClassifier::ResolveConflict(
     const std::string& context, const std::vector<Token>& cached_tokens,
     const std::vector<AnnotatedSpan>& candidates, int start_index,
     int end_index, InterpreterManager* interpreter_manager,
+    FeatureProcessor::EmbeddingCache* embedding_cache,
     std::vector<int>* chosen_indices) const {
   std::vector<int> conflicting_indices;
   std::unordered_map<int, float> scores;
@@ -609,8 +960,8 @@ bool TextClassifier::ResolveConflict(
     // classification to determine its priority:
     std::vector<ClassificationResult> classification;
     if (!ModelClassifyText(context, cached_tokens, candidates[i].span,
-                           interpreter_manager,
-                           /*embedding_cache=*/nullptr, &classification)) {
+                           interpreter_manager, embedding_cache,
+                           &classification)) {
       return false;
     }
 
@@ -647,15 +998,17 @@ bool TextClassifier::ResolveConflict(
 
 bool TextClassifier::ModelSuggestSelection(
     const UnicodeText& context_unicode, CodepointSpan click_indices,
-    InterpreterManager* interpreter_manager, std::vector<Token>* tokens,
-    std::vector<AnnotatedSpan>* result) const {
+    const std::vector<Token>& context_tokens,
+    InterpreterManager* interpreter_manager,
+    FeatureProcessor::EmbeddingCache* embedding_cache,
+    std::vector<Token>* tokens, std::vector<AnnotatedSpan>* result) const {
   if (model_->triggering_options() == nullptr ||
       !(model_->triggering_options()->enabled_modes() & ModeFlag_SELECTION)) {
     return true;
   }
 
   int click_pos;
-  *tokens = selection_feature_processor_->Tokenize(context_unicode);
+  *tokens = context_tokens;
   selection_feature_processor_->RetokenizeAndFindClick(
       context_unicode, click_indices,
       selection_feature_processor_->GetOptions()->only_use_line_with_click(),
@@ -715,7 +1068,7 @@ bool TextClassifier::ModelSuggestSelection(
           *tokens, extraction_span,
           /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
           embedding_executor_.get(),
-          /*embedding_cache=*/nullptr,
+          share_embedding_cache_ ? embedding_cache : nullptr,
           selection_feature_processor_->EmbeddingSize() +
               selection_feature_processor_->DenseFeaturesCount(),
           &cached_features)) {
@@ -726,7 +1079,7 @@ bool TextClassifier::ModelSuggestSelection(
   // Produce selection model candidates.
   std::vector<TokenSpan> chunks;
   if (!ModelChunk(tokens->size(), /*span_of_interest=*/symmetry_context_span,
-                  interpreter_manager->SelectionInterpreter(), *cached_features,
+                  interpreter_manager->SelectionContext(), *cached_features,
                   &chunks)) {
     TC_LOG(ERROR) << "Could not chunk.";
     return false;
@@ -907,7 +1260,7 @@ bool TextClassifier::ModelClassifyText(
   TensorView<float> logits = classification_executor_->ComputeLogits(
       TensorView<float>(features.data(),
                         {1, static_cast<int>(features.size())}),
-      interpreter_manager->ClassificationInterpreter());
+      interpreter_manager->ClassificationContext());
   if (!logits.is_valid()) {
     TC_LOG(ERROR) << "Couldn't compute logits.";
     return false;
@@ -958,7 +1311,7 @@ bool TextClassifier::ModelClassifyText(
 
 bool TextClassifier::RegexClassifyText(
     const std::string& context, CodepointSpan selection_indices,
-    ClassificationResult* classification_result) const {
+    RegexBudget* budget, ClassificationResult* classification_result) const {
   const std::string selection_text =
       ExtractSelection(context, selection_indices);
   const UnicodeText selection_text_unicode(
@@ -966,6 +1319,9 @@ bool TextClassifier::RegexClassifyText(
 
   // Check whether any of the regular expressions match.
   for (const int pattern_id : classification_regex_patterns_) {
+    if (budget->Exhausted()) {
+      break;
+    }
     const CompiledRegexPattern& regex_pattern = regex_patterns_[pattern_id];
     const std::unique_ptr<UniLib::RegexMatcher> matcher =
         regex_pattern.pattern->Matcher(selection_text_unicode);
@@ -977,6 +1333,12 @@ bool TextClassifier::RegexClassifyText(
     } else {
       matches = matcher->Matches(&status);
     }
+    if (status == UniLib::RegexMatcher::kLimitExceeded) {
+      TC_LOG(WARNING) << "Regex pattern " << pattern_id
+                      << " ran over the regex limits, skipping it.";
+      budget->AddRegexOverrun(pattern_id);
+      continue;
+    }
     if (status != UniLib::RegexMatcher::kNoError) {
       return false;
     }
@@ -996,7 +1358,7 @@ bool TextClassifier::RegexClassifyText(
 
 bool TextClassifier::DatetimeClassifyText(
     const std::string& context, CodepointSpan selection_indices,
-    const ClassificationOptions& options,
+    const ClassificationOptions& options, RegexBudget* budget,
     ClassificationResult* classification_result) const {
   if (!datetime_parser_) {
     return false;
@@ -1009,7 +1371,8 @@ bool TextClassifier::DatetimeClassifyText(
   if (!datetime_parser_->Parse(selection_text, options.reference_time_ms_utc,
                                options.reference_timezone, options.locales,
                                ModeFlag_CLASSIFICATION,
-                               /*anchor_start_end=*/true, &datetime_spans)) {
+                               /*anchor_start_end=*/true, &datetime_spans,
+                               budget)) {
     TC_LOG(ERROR) << "Error during parsing datetime.";
     return false;
   }
@@ -1028,9 +1391,83 @@ bool TextClassifier::DatetimeClassifyText(
   return false;
 }
 
+bool TextClassifier::ResolveCachedDatetimes(
+    const std::string& context, CodepointSpan span,
+    int64 reference_time_ms_utc, const std::string& reference_timezone,
+    const std::string& locales, ModeFlag mode,
+    std::vector<ClassificationResult>* classification) const {
+  for (ClassificationResult& result : *classification) {
+    if (!result.datetime_parse_result.IsSet()) {
+      continue;
+    }
+    if (!datetime_parser_) {
+      return false;
+    }
+    std::vector<DatetimeParseResultSpan> datetime_spans;
+    if (!datetime_parser_->Parse(ExtractSelection(context, span),
+                                 reference_time_ms_utc, reference_timezone,
+                                 locales, mode, /*anchor_start_end=*/true,
+                                 &datetime_spans)) {
+      return false;
+    }
+    bool found = false;
+    for (const DatetimeParseResultSpan& datetime_span : datetime_spans) {
+      if (datetime_span.span.first == 0 &&
+          datetime_span.span.second == span.second - span.first &&
+          datetime_span.data.granularity ==
+              result.datetime_parse_result.granularity) {
+        result.datetime_parse_result = datetime_span.data;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  return true;
+}
+
 std::vector<ClassificationResult> TextClassifier::ClassifyText(
     const std::string& context, CodepointSpan selection_indices,
     const ClassificationOptions& options) const {
+  if (!result_cache_) {
+    bool truncated;
+    return ClassifyTextUncached(context, selection_indices, options,
+                                &truncated);
+  }
+
+  const uint64 key = ResultCache::Key(ModeFlag_CLASSIFICATION, context,
+                                      selection_indices, options.locales);
+  ResultCache::Entry entry;
+  if (result_cache_->Lookup(key, &entry)) {
+    if ((entry.reference_time_ms_utc == options.reference_time_ms_utc &&
+         entry.reference_timezone == options.reference_timezone) ||
+        ResolveCachedDatetimes(context, selection_indices,
+                               options.reference_time_ms_utc,
+                               options.reference_timezone, options.locales,
+                               ModeFlag_CLASSIFICATION,
+                               &entry.classification)) {
+      return entry.classification;
+    }
+  }
+
+  bool truncated;
+  entry.classification =
+      ClassifyTextUncached(context, selection_indices, options, &truncated);
+  if (truncated) {
+    return entry.classification;
+  }
+  entry.reference_time_ms_utc = options.reference_time_ms_utc;
+  entry.reference_timezone = options.reference_timezone;
+  result_cache_->Insert(key, entry);
+  return entry.classification;
+}
+
+std::vector<ClassificationResult> TextClassifier::ClassifyTextUncached(
+    const std::string& context, CodepointSpan selection_indices,
+    const ClassificationOptions& options, bool* truncated) const {
+  *truncated = false;
   if (!initialized_) {
     TC_LOG(ERROR) << "Not initialized";
     return {};
@@ -1040,20 +1477,35 @@ std::vector<ClassificationResult> TextClassifier::ClassifyText(
     return {};
   }
 
-  if (!UTF8ToUnicodeText(context, /*do_copy=*/false).is_valid()) {
+  const UnicodeText context_unicode =
+      UTF8ToUnicodeText(context, /*do_copy=*/false);
+  if (!context_unicode.is_valid()) {
     return {};
   }
 
-  if (std::get<0>(selection_indices) >= std::get<1>(selection_indices)) {
+  if (std::get<0>(selection_indices) < 0 ||
+      std::get<0>(selection_indices) >= std::get<1>(selection_indices) ||
+      std::get<1>(selection_indices) > context_unicode.size_codepoints()) {
     TC_VLOG(1) << "Trying to run ClassifyText with invalid indices: "
                << std::get<0>(selection_indices) << " "
                << std::get<1>(selection_indices);
     return {};
   }
 
-  // Try the regular expression models.
+  // Try the regular expression models, then the date model.
+  RegexBudget regex_budget(regex_budget_ms_);
   ClassificationResult regex_result;
-  if (RegexClassifyText(context, selection_indices, &regex_result)) {
+  const bool regex_matched = RegexClassifyText(context, selection_indices,
+                                               &regex_budget, &regex_result);
+  ClassificationResult datetime_result;
+  const bool datetime_matched =
+      !regex_matched &&
+      DatetimeClassifyText(context, selection_indices, options, &regex_budget,
+                           &datetime_result);
+  RecordRegexBudget(regex_budget);
+  *truncated = regex_budget.truncated();
+
+  if (regex_matched) {
     if (!FilteredForClassification(regex_result)) {
       return {regex_result};
     } else {
@@ -1061,10 +1513,7 @@ std::vector<ClassificationResult> TextClassifier::ClassifyText(
     }
   }
 
-  // Try the date model.
-  ClassificationResult datetime_result;
-  if (DatetimeClassifyText(context, selection_indices, options,
-                           &datetime_result)) {
+  if (datetime_matched) {
     if (!FilteredForClassification(datetime_result)) {
       return {datetime_result};
     } else {
@@ -1114,7 +1563,10 @@ bool TextClassifier::ModelAnnotate(const std::string& context,
            ? model_->triggering_options()->min_annotate_confidence()
            : 0.f);
 
-  FeatureProcessor::EmbeddingCache embedding_cache;
+  // The token spans are relative to the line, so the cache is reset for every
+  // line.
+  FeatureProcessor::EmbeddingCache embedding_cache(
+      classification_feature_processor_->CachedTokenFeaturesSize());
   for (const UnicodeTextRange& line : lines) {
     const std::string line_str =
         UnicodeText::UTF8Substring(line.first, line.second);
@@ -1126,6 +1578,7 @@ bool TextClassifier::ModelAnnotate(const std::string& context,
         tokens,
         /*click_pos=*/nullptr);
     const TokenSpan full_line_span = {0, tokens->size()};
+    embedding_cache.Reset(*tokens);
 
     // TODO(zilka): Add support for greater granularity of this check.
     if (!selection_feature_processor_->HasEnoughSupportedCodepoints(
@@ -1138,7 +1591,7 @@ bool TextClassifier::ModelAnnotate(const std::string& context,
             *tokens, full_line_span,
             /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
             embedding_executor_.get(),
-            /*embedding_cache=*/nullptr,
+            share_embedding_cache_ ? &embedding_cache : nullptr,
             selection_feature_processor_->EmbeddingSize() +
                 selection_feature_processor_->DenseFeaturesCount(),
             &cached_features)) {
@@ -1148,7 +1601,7 @@ bool TextClassifier::ModelAnnotate(const std::string& context,
 
     std::vector<TokenSpan> local_chunks;
     if (!ModelChunk(tokens->size(), /*span_of_interest=*/full_line_span,
-                    interpreter_manager->SelectionInterpreter(),
+                    interpreter_manager->SelectionContext(),
                     *cached_features, &local_chunks)) {
       TC_LOG(ERROR) << "Could not chunk.";
       return false;
@@ -1187,6 +1640,73 @@ bool TextClassifier::ModelAnnotate(const std::string& context,
   return true;
 }
 
+TokenEmbeddingCache::Stats TextClassifier::GetTokenEmbeddingCacheStats()
+    const {
+  TokenEmbeddingCache::Stats result;
+  for (const TokenEmbeddingCache* cache :
+       {selection_token_embedding_cache_.get(),
+        classification_token_embedding_cache_.get()}) {
+    if (cache == nullptr) {
+      continue;
+    }
+    const TokenEmbeddingCache::Stats stats = cache->GetStats();
+    result.hits += stats.hits;
+    result.misses += stats.misses;
+    result.evictions += stats.evictions;
+    result.size += stats.size;
+  }
+  return result;
+}
+
+ResultCache::Stats TextClassifier::GetResultCacheStats() const {
+  if (!result_cache_) {
+    return ResultCache::Stats();
+  }
+  return result_cache_->GetStats();
+}
+
+TextClassifier::RegexLimitStats TextClassifier::GetRegexLimitStats() const {
+  std::lock_guard<std::mutex> lock(regex_limit_stats_mutex_);
+  return regex_limit_stats_;
+}
+
+void TextClassifier::RecordRegexBudget(const RegexBudget& budget) const {
+  if (!budget.truncated()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(regex_limit_stats_mutex_);
+  for (const int pattern_id : budget.regex_overruns()) {
+    ++regex_limit_stats_.regex_overruns[pattern_id];
+  }
+  for (const int rule_id : budget.datetime_overruns()) {
+    ++regex_limit_stats_.datetime_overruns[rule_id];
+  }
+  if (budget.exhausted()) {
+    ++regex_limit_stats_.exhausted_budgets;
+  }
+}
+
+int TextClassifier::AnnotationContextTokens() const {
+  int result = 0;
+  for (const FeatureProcessor* feature_processor :
+       {selection_feature_processor_.get(),
+        classification_feature_processor_.get()}) {
+    if (feature_processor == nullptr) {
+      continue;
+    }
+    const FeatureProcessorOptions* options = feature_processor->GetOptions();
+    int context_tokens = options->context_size();
+    if (options->bounds_sensitive_features() != nullptr &&
+        options->bounds_sensitive_features()->enabled()) {
+      context_tokens =
+          std::max(options->bounds_sensitive_features()->num_tokens_before(),
+                   options->bounds_sensitive_features()->num_tokens_after());
+    }
+    result = std::max(result, options->max_selection_span() + context_tokens);
+  }
+  return result;
+}
+
 const FeatureProcessor* TextClassifier::SelectionFeatureProcessorForTests()
     const {
   return selection_feature_processor_.get();
@@ -1201,8 +1721,55 @@ const DatetimeParser* TextClassifier::DatetimeParserForTests() const {
   return datetime_parser_.get();
 }
 
+void TextClassifier::SetRegexBudgetMsForTests(int regex_budget_ms) {
+  regex_budget_ms_ = regex_budget_ms;
+}
+
 std::vector<AnnotatedSpan> TextClassifier::Annotate(
     const std::string& context, const AnnotationOptions& options) const {
+  if (!result_cache_) {
+    bool truncated;
+    return AnnotateUncached(context, options, &truncated);
+  }
+
+  const uint64 key =
+      ResultCache::Key(ModeFlag_ANNOTATION, context,
+                       {kInvalidIndex, kInvalidIndex}, options.locales);
+  ResultCache::Entry entry;
+  if (result_cache_->Lookup(key, &entry)) {
+    bool resolved = true;
+    if (entry.reference_time_ms_utc != options.reference_time_ms_utc ||
+        entry.reference_timezone != options.reference_timezone) {
+      for (AnnotatedSpan& annotation : entry.annotations) {
+        if (!ResolveCachedDatetimes(
+                context, annotation.span, options.reference_time_ms_utc,
+                options.reference_timezone, options.locales,
+                ModeFlag_ANNOTATION, &annotation.classification)) {
+          resolved = false;
+          break;
+        }
+      }
+    }
+    if (resolved) {
+      return entry.annotations;
+    }
+  }
+
+  bool truncated;
+  entry.annotations = AnnotateUncached(context, options, &truncated);
+  if (truncated) {
+    return entry.annotations;
+  }
+  entry.reference_time_ms_utc = options.reference_time_ms_utc;
+  entry.reference_timezone = options.reference_timezone;
+  result_cache_->Insert(key, entry);
+  return entry.annotations;
+}
+
+std::vector<AnnotatedSpan> TextClassifier::AnnotateUncached(
+    const std::string& context, const AnnotationOptions& options,
+    bool* truncated) const {
+  *truncated = false;
   std::vector<AnnotatedSpan> candidates;
 
   if (!(model_->enabled_modes() & ModeFlag_ANNOTATION)) {
@@ -1222,17 +1789,20 @@ std::vector<AnnotatedSpan> TextClassifier::Annotate(
     return {};
   }
 
-  // Annotate with the regular expression models.
-  if (!RegexChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
-                  annotation_regex_patterns_, &candidates)) {
-    TC_LOG(ERROR) << "Couldn't run RegexChunk.";
-    return {};
-  }
-
-  // Annotate with the datetime model.
-  if (!DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
-                     options.reference_time_ms_utc, options.reference_timezone,
-                     options.locales, ModeFlag_ANNOTATION, &candidates)) {
+  // Annotate with the regular expression models, and with the datetime model.
+  RegexBudget regex_budget(regex_budget_ms_);
+  const bool regex_chunked =
+      RegexChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
+                 annotation_regex_patterns_, &regex_budget, &candidates);
+  const bool datetime_chunked =
+      regex_chunked &&
+      DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
+                    options.reference_time_ms_utc, options.reference_timezone,
+                    options.locales, ModeFlag_ANNOTATION, &regex_budget,
+                    &candidates);
+  RecordRegexBudget(regex_budget);
+  *truncated = regex_budget.truncated();
+  if (!regex_chunked || !datetime_chunked) {
     TC_LOG(ERROR) << "Couldn't run RegexChunk.";
     return {};
   }
@@ -1247,7 +1817,7 @@ std::vector<AnnotatedSpan> TextClassifier::Annotate(
 
   std::vector<int> candidate_indices;
   if (!ResolveConflicts(candidates, context, tokens, &interpreter_manager,
-                        &candidate_indices)) {
+                        /*embedding_cache=*/nullptr, &candidate_indices)) {
     TC_LOG(ERROR) << "Couldn't resolve conflicts.";
     return {};
   }
@@ -1265,10 +1835,61 @@ std::vector<AnnotatedSpan> TextClassifier::Annotate(
   return result;
 }
 
+namespace {
+
+CodepointSpan UTF16ToCodepointSpan(const UTF16Text& text, CodepointSpan span) {
+  return {text.ToCodepointIndex(span.first),
+          text.ToCodepointIndex(span.second)};
+}
+
+CodepointSpan CodepointToUTF16Span(const UTF16Text& text, CodepointSpan span) {
+  return {text.ToUTF16Index(span.first), text.ToUTF16Index(span.second)};
+}
+
+}  // namespace
+
+CodepointSpan TextClassifier::SuggestSelection(
+    const uint16* context_utf16, int context_length,
+    CodepointSpan click_indices, const SelectionOptions& options) const {
+  const UTF16Text text(context_utf16, context_length);
+  const CodepointSpan codepoint_click_indices =
+      UTF16ToCodepointSpan(text, click_indices);
+  if (codepoint_click_indices.first == kInvalidIndex ||
+      codepoint_click_indices.second == kInvalidIndex) {
+    return click_indices;
+  }
+  return CodepointToUTF16Span(
+      text, SuggestSelection(text.utf8(), codepoint_click_indices, options));
+}
+
+std::vector<ClassificationResult> TextClassifier::ClassifyText(
+    const uint16* context_utf16, int context_length,
+    CodepointSpan selection_indices,
+    const ClassificationOptions& options) const {
+  const UTF16Text text(context_utf16, context_length);
+  return ClassifyText(text.utf8(), UTF16ToCodepointSpan(text, selection_indices),
+                      options);
+}
+
+std::vector<AnnotatedSpan> TextClassifier::Annotate(
+    const uint16* context_utf16, int context_length,
+    const AnnotationOptions& options) const {
+  const UTF16Text text(context_utf16, context_length);
+  std::vector<AnnotatedSpan> annotations = Annotate(text.utf8(), options);
+  for (AnnotatedSpan& annotation : annotations) {
+    annotation.span = CodepointToUTF16Span(text, annotation.span);
+  }
+  return annotations;
+}
+
 bool TextClassifier::RegexChunk(const UnicodeText& context_unicode,
                                 const std::vector<int>& rules,
+                                RegexBudget* budget,
                                 std::vector<AnnotatedSpan>* result) const {
   for (int pattern_id : rules) {
+    if (budget->Exhausted()) {
+      break;
+    }
     const CompiledRegexPattern& regex_pattern = regex_patterns_[pattern_id];
     const auto matcher = regex_pattern.pattern->Matcher(context_unicode);
     if (!matcher) {
@@ -1277,6 +1898,7 @@ bool TextClassifier::RegexChunk(const UnicodeText& context_unicode,
       return false;
     }
 
+    const int num_results = result->size();
     int status = UniLib::RegexMatcher::kNoError;
     while (matcher->Find(&status) && status == UniLib::RegexMatcher::kNoError) {
       result->emplace_back();
@@ -1289,13 +1911,19 @@ bool TextClassifier::RegexChunk(const UnicodeText& context_unicode,
            regex_pattern.target_classification_score,
            regex_pattern.priority_score}};
     }
+    if (status == UniLib::RegexMatcher::kLimitExceeded) {
+      TC_LOG(WARNING) << "Regex pattern " << pattern_id
+                      << " ran over the regex limits, skipping it.";
+      budget->AddRegexOverrun(pattern_id);
+      result->erase(result->begin() + num_results, result->end());
+    }
   }
   return true;
 }
 
 bool TextClassifier::ModelChunk(int num_tokens,
                                 const TokenSpan& span_of_interest,
-                                tflite::Interpreter* selection_interpreter,
+                                ExecutionContext* selection_context,
                                 const CachedFeatures& cached_features,
                                 std::vector<TokenSpan>* chunks) const {
   const int max_selection_span =
@@ -1316,12 +1944,12 @@ bool TextClassifier::ModelChunk(int num_tokens,
           ->enabled()) {
     if (!ModelBoundsSensitiveScoreChunks(
             num_tokens, span_of_interest, inference_span, cached_features,
-            selection_interpreter, &scored_chunks)) {
+            selection_context, &scored_chunks)) {
       return false;
     }
   } else {
     if (!ModelClickContextScoreChunks(num_tokens, span_of_interest,
-                                      cached_features, selection_interpreter,
+                                      cached_features, selection_context,
                                       &scored_chunks)) {
       return false;
     }
@@ -1381,7 +2009,7 @@ void UpdateMax(Map* map, typename Map::key_type key,
 bool TextClassifier::ModelClickContextScoreChunks(
     int num_tokens, const TokenSpan& span_of_interest,
     const CachedFeatures& cached_features,
-    tflite::Interpreter* selection_interpreter,
+    ExecutionContext* selection_context,
     std::vector<ScoredChunk>* scored_chunks) const {
   const int max_batch_size = model_->selection_options()->batch_size();
 
@@ -1405,7 +2033,7 @@ bool TextClassifier::ModelClickContextScoreChunks(
     const int features_size = cached_features.OutputFeaturesSize();
     TensorView<float> logits = selection_executor_->ComputeLogits(
         TensorView<float>(all_features.data(), {batch_size, features_size}),
-        selection_interpreter);
+        selection_context);
     if (!logits.is_valid()) {
       TC_LOG(ERROR) << "Couldn't compute logits.";
       return false;
@@ -1452,7 +2080,7 @@ bool TextClassifier::ModelClickContextScoreChunks(
 bool TextClassifier::ModelBoundsSensitiveScoreChunks(
     int num_tokens, const TokenSpan& span_of_interest,
     const TokenSpan& inference_span, const CachedFeatures& cached_features,
-    tflite::Interpreter* selection_interpreter,
+    ExecutionContext* selection_context,
     std::vector<ScoredChunk>* scored_chunks) const {
   const int max_selection_span =
       selection_feature_processor_->GetOptions()->max_selection_span();
@@ -1495,28 +2123,34 @@ bool TextClassifier::ModelBoundsSensitiveScoreChunks(
   }
 
   const int max_batch_size = model_->selection_options()->batch_size();
-
-  std::vector<float> all_features;
-  scored_chunks->reserve(scored_chunks->size() + candidate_spans.size());
-  for (int batch_start = 0; batch_start < candidate_spans.size();
-       batch_start += max_batch_size) {
+  const int num_batches =
+      (candidate_spans.size() + max_batch_size - 1) / max_batch_size;
+  const int features_size = cached_features.OutputFeaturesSize();
+
+  // Scores the candidates of one batch into 'scores'. The features buffer is
+  // reused across batches that run on the same thread.
+  std::vector<float> scores(candidate_spans.size());
+  const auto score_batch = [this, &candidate_spans, &cached_features,
+                            max_batch_size, features_size, &scores](
+                               int batch, ExecutionContext* context,
+                               std::vector<float>* all_features) {
+    const int batch_start = batch * max_batch_size;
     const int batch_end = std::min(batch_start + max_batch_size,
                                    static_cast<int>(candidate_spans.size()));
 
     // Prepare features for the whole batch.
-    all_features.clear();
-    all_features.reserve(max_batch_size * cached_features.OutputFeaturesSize());
+    all_features->clear();
+    all_features->reserve(max_batch_size * features_size);
     for (int i = batch_start; i < batch_end; ++i) {
       cached_features.AppendBoundsSensitiveFeaturesForSpan(candidate_spans[i],
-                                                           &all_features);
+                                                           all_features);
     }
 
     // Run batched inference.
     const int batch_size = batch_end - batch_start;
-    const int features_size = cached_features.OutputFeaturesSize();
     TensorView<float> logits = selection_executor_->ComputeLogits(
-        TensorView<float>(all_features.data(), {batch_size, features_size}),
-        selection_interpreter);
+        TensorView<float>(all_features->data(), {batch_size, features_size}),
+        context);
     if (!logits.is_valid()) {
       TC_LOG(ERROR) << "Couldn't compute logits.";
       return false;
@@ -1526,21 +2160,89 @@ bool TextClassifier::ModelBoundsSensitiveScoreChunks(
       TC_LOG(ERROR) << "Mismatching output.";
       return false;
     }
-
-    // Save results.
-    for (int i = batch_start; i < batch_end; ++i) {
-      scored_chunks->push_back(
-          ScoredChunk{candidate_spans[i], logits.data()[i - batch_start]});
+    std::copy(logits.data(), logits.data() + batch_size,
+              scores.begin() + batch_start);
+    return true;
+  };
+
+  if (inference_thread_pool_ != nullptr && num_batches > 1) {
+    // The calling thread uses the given context, the threads of the pool
+    // take one from selection_contexts_ for each batch.
+    const std::thread::id calling_thread = std::this_thread::get_id();
+    std::atomic<bool> success(true);
+    inference_thread_pool_->ParallelFor(
+        num_batches, [this, &score_batch, selection_context, calling_thread,
+                      &success](int batch) {
+          if (!success) {
+            return;
+          }
+          std::vector<float> all_features;
+          if (std::this_thread::get_id() == calling_thread) {
+            if (!score_batch(batch, selection_context, &all_features)) {
+              success = false;
+            }
+            return;
+          }
+          std::unique_ptr<ExecutionContext> context = AcquireSelectionContext();
+          if (!score_batch(batch, context.get(), &all_features)) {
+            success = false;
+          }
+          ReleaseSelectionContext(std::move(context));
+        });
+    if (!success) {
+      return false;
+    }
+  } else {
+    std::vector<float> all_features;
+    for (int batch = 0; batch < num_batches; ++batch) {
+      if (!score_batch(batch, selection_context, &all_features)) {
+        return false;
+      }
     }
   }
 
+  // Save results, in the order of the candidates.
+  scored_chunks->reserve(scored_chunks->size() + candidate_spans.size());
+  for (int i = 0; i < candidate_spans.size(); ++i) {
+    scored_chunks->push_back(ScoredChunk{candidate_spans[i], scores[i]});
+  }
+
   return true;
 }
 
+std::unique_ptr<ExecutionContext>
+TextClassifier::AcquireSelectionContext() const {
+  {
+    std::lock_guard<std::mutex> lock(selection_contexts_mutex_);
+    if (!selection_contexts_.empty()) {
+      std::unique_ptr<ExecutionContext> context =
+          std::move(selection_contexts_.back());
+      selection_contexts_.pop_back();
+      return context;
+    }
+  }
+  std::unique_ptr<ExecutionContext> context =
+      selection_executor_->CreateContext();
+  if (!context) {
+    TC_LOG(ERROR) << "Could not create execution context.";
+  }
+  return context;
+}
+
+void TextClassifier::ReleaseSelectionContext(
+    std::unique_ptr<ExecutionContext> context) const {
+  if (context == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(selection_contexts_mutex_);
+  selection_contexts_.push_back(std::move(context));
+}
+
 bool TextClassifier::DatetimeChunk(const UnicodeText& context_unicode,
                                    int64 reference_time_ms_utc,
                                    const std::string& reference_timezone,
                                    const std::string& locales, ModeFlag mode,
+                                   RegexBudget* budget,
                                    std::vector<AnnotatedSpan>* result) const {
   if (!datetime_parser_) {
     return true;
@@ -1549,7 +2251,8 @@ bool TextClassifier::DatetimeChunk(const UnicodeText& context_unicode,
   std::vector<DatetimeParseResultSpan> datetime_spans;
   if (!datetime_parser_->Parse(context_unicode, reference_time_ms_utc,
                                reference_timezone, locales, mode,
-                               /*anchor_start_end=*/false, &datetime_spans)) {
+                               /*anchor_start_end=*/false, &datetime_spans,
+                               budget)) {
     return false;
   }
   for (const DatetimeParseResultSpan& datetime_span : datetime_spans) {
@@ -19,16 +19,25 @@
 #ifndef LIBTEXTCLASSIFIER_TEXT_CLASSIFIER_H_
 #define LIBTEXTCLASSIFIER_TEXT_CLASSIFIER_H_
 
+#include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "datetime/parser.h"
 #include "feature-processor.h"
 #include "model-executor.h"
 #include "model_generated.h"
+#include "regex-budget.h"
+#include "result-cache.h"
 #include "strip-unpaired-brackets.h"
+#include "thread-pool.h"
+#include "token-embedding-cache.h"
 #include "types.h"
 #include "util/memory/mmap.h"
 #include "util/utf8/unilib.h"
@@ -76,49 +85,126 @@ struct AnnotationOptions {
   static AnnotationOptions Default() { return AnnotationOptions(); }
 };
 
-// Holds TFLite interpreters for selection and classification models.
+// Options that apply to the lifetime of a loaded model.
+struct LoadOptions {
+  // Number of token embeddings that are cached across calls, per feature
+  // processor. Zero disables the cache.
+  int token_embedding_cache_size = 0;
+
+  // If true, the quantized embedding table is unpacked to one byte per value
+  // at load time. This speeds up embedding lookups, especially with fewer than
+  // 8 quantization bits, at the cost of extra memory (see
+  // TextClassifier::GetUnpackedEmbeddingsBytes). Results are unchanged.
+  bool unpack_quantized_embeddings = false;
+
+  // Number of results of SuggestSelection, ClassifyText and Annotate that are
+  // cached across calls, keyed by a fingerprint of the context, span, locales
+  // and mode. Datetime results are resolved again against the caller's
+  // reference time and timezone on a hit. Results that may be incomplete,
+  // because the call ran out of regex budget or a pattern ran over the regex
+  // limits, are not cached. Zero disables the cache.
+  int result_cache_size = 0;
+
+  // Number of threads that initialize the components of the model (executors,
+  // feature processors, regex patterns and datetime parser) concurrently. With
+  // one, they are initialized one after another on the calling thread.
+  int num_init_threads = 1;
+
+  // If set, the initialization tasks are passed to this function instead of
+  // being run on internal threads, e.g. to run them on the caller's thread
+  // pool. It has to run every task exactly once, on any thread. Loading waits
+  // until all tasks have finished.
+  std::function<void(std::function<void()>)> init_executor;
+
+  // Number of threads that run the batches of the bounds-sensitive selection
+  // model for one call concurrently, including the calling thread. Helps with
+  // long inputs to Annotate, which score many candidate spans. Every thread
+  // uses its own execution context, which is kept across calls.
+  int num_inference_threads = 1;
+
+  // Create the executors of the selection and classification models, e.g. to
+  // run them on another inference engine. If unset, the models are executed
+  // with TFLite.
+  ModelExecutorFactory selection_executor_factory;
+  ModelExecutorFactory classification_executor_factory;
+
+  // Limits of a single match of a regex model pattern or a datetime rule (see
+  // UniLib::RegexLimits). The matches of a pattern that runs over them are
+  // dropped, and the overrun is counted in TextClassifier::GetRegexLimitStats.
+  // Zero keeps the ICU default.
+  int regex_time_limit = 0;
+  int regex_stack_limit_bytes = 0;
+
+  // Time in milliseconds that the regex and datetime patterns of one call may
+  // take together. The patterns that would start after that are skipped. Zero
+  // means no limit.
+  int regex_budget_ms = 0;
+
+  // Comma-separated list of the locales that will be served (BCP 47 tags). If
+  // set, only the datetime rules of these locales and of the model's default
+  // locales are loaded, which saves load time and memory. Calls with other
+  // locales only find the datetimes of the loaded rules. The regex model has
+  // no locales and is always loaded entirely.
+  std::string locales;
+
+  static LoadOptions Default() { return LoadOptions(); }
+};
+
+// Holds the execution contexts for selection and classification models.
 // NOTE: his class is not thread-safe, thus should NOT be re-used across
 // threads.
 class InterpreterManager {
  public:
   // The constructor can be called with nullptr for any of the executors, and is
-  // a defined behavior, as long as the corresponding *Interpreter() method is
+  // a defined behavior, as long as the corresponding *Context() method is
   // not called when the executor is null.
   InterpreterManager(const ModelExecutor* selection_executor,
                      const ModelExecutor* classification_executor)
       : selection_executor_(selection_executor),
         classification_executor_(classification_executor) {}
 
-  // Gets or creates and caches an interpreter for the selection model.
-  tflite::Interpreter* SelectionInterpreter();
+  // Gets or creates and caches a context for the selection model.
+  ExecutionContext* SelectionContext();
 
-  // Gets or creates and caches an interpreter for the classification model.
-  tflite::Interpreter* ClassificationInterpreter();
+  // Gets or creates and caches a context for the classification model.
+  ExecutionContext* ClassificationContext();
 
  private:
   const ModelExecutor* selection_executor_;
   const ModelExecutor* classification_executor_;
 
-  std::unique_ptr<tflite::Interpreter> selection_interpreter_;
-  std::unique_ptr<tflite::Interpreter> classification_interpreter_;
+  std::unique_ptr<ExecutionContext> selection_context_;
+  std::unique_ptr<ExecutionContext> classification_context_;
 };
 
 // A text processing model that provides text classification, annotation,
 // selection suggestion for various types.
-// NOTE: This class is not thread-safe.
+// NOTE: The const inference methods (SuggestSelection, ClassifyText, Annotate)
+// can be called concurrently from multiple threads: every call creates its own
+// execution contexts, the contexts of the inference threads are handed out
+// under a lock, and the rest of the state is read-only after initialization.
 class TextClassifier {
  public:
+  // A list of collection names in the model.
+  using CollectionList =
+      flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>;
+
   static std::unique_ptr<TextClassifier> FromUnownedBuffer(
-      const char* buffer, int size, const UniLib* unilib = nullptr);
+      const char* buffer, int size, const UniLib* unilib = nullptr,
+      const LoadOptions& load_options = LoadOptions::Default());
   // Takes ownership of the mmap.
   static std::unique_ptr<TextClassifier> FromScopedMmap(
-      std::unique_ptr<ScopedMmap>* mmap, const UniLib* unilib = nullptr);
+      std::unique_ptr<ScopedMmap>* mmap, const UniLib* unilib = nullptr,
+      const LoadOptions& load_options = LoadOptions::Default());
   static std::unique_ptr<TextClassifier> FromFileDescriptor(
-      int fd, int offset, int size, const UniLib* unilib = nullptr);
+      int fd, int offset, int size, const UniLib* unilib = nullptr,
+      const LoadOptions& load_options = LoadOptions::Default());
   static std::unique_ptr<TextClassifier> FromFileDescriptor(
-      int fd, const UniLib* unilib = nullptr);
+      int fd, const UniLib* unilib = nullptr,
+      const LoadOptions& load_options = LoadOptions::Default());
   static std::unique_ptr<TextClassifier> FromPath(
-      const std::string& path, const UniLib* unilib = nullptr);
+      const std::string& path, const UniLib* unilib = nullptr,
+      const LoadOptions& load_options = LoadOptions::Default());
 
   // Returns true if the model is ready for use.
   bool IsInitialized() { return initialized_; }
@@ -135,6 +221,14 @@ class TextClassifier {
       const std::string& context, CodepointSpan click_indices,
       const SelectionOptions& options = SelectionOptions::Default()) const;
 
+  // Same as SuggestSelection, for several clicks in the same context. Returns
+  // one selection per click, each equal to what SuggestSelection would return
+  // for it. The context is tokenized and chunked by the regex and datetime
+  // parsers once, and the token features are shared by all the clicks.
+  std::vector<CodepointSpan> SuggestSelectionBatch(
+      const std::string& context, const std::vector<CodepointSpan>& clicks,
+      const SelectionOptions& options = SelectionOptions::Default()) const;
+
   // Classifies the selected text given the context string.
   // Returns an empty result if an error occurs.
   std::vector<ClassificationResult> ClassifyText(
@@ -148,6 +242,69 @@ class TextClassifier {
       const std::string& context,
       const AnnotationOptions& options = AnnotationOptions::Default()) const;
 
+  // Variants of the above for UTF-16 input (e.g. Java strings). All indices,
+  // both passed in and returned, are in UTF-16 code units. The context is
+  // transcoded once and the indices are mapped through lookup tables, so the
+  // caller does not need to convert the text or the indices itself.
+  CodepointSpan SuggestSelection(
+      const uint16* context_utf16, int context_length,
+      CodepointSpan click_indices,
+      const SelectionOptions& options = SelectionOptions::Default()) const;
+  std::vector<ClassificationResult> ClassifyText(
+      const uint16* context_utf16, int context_length,
+      CodepointSpan selection_indices,
+      const ClassificationOptions& options =
+          ClassificationOptions::Default()) const;
+  std::vector<AnnotatedSpan> Annotate(
+      const uint16* context_utf16, int context_length,
+      const AnnotationOptions& options = AnnotationOptions::Default()) const;
+
+  // Returns the names of all collections the model can return, in a fixed
+  // order, so that results can refer to collections by index.
+  const std::vector<std::string>& Collections() const { return collections_; }
+
+  // Returns the index of the collection in Collections(), or -1 if the model
+  // can't return it.
+  int CollectionIndex(const std::string& collection) const;
+
+  // Returns the combined statistics of the token embedding caches. All zero if
+  // LoadOptions::token_embedding_cache_size is zero.
+  TokenEmbeddingCache::Stats GetTokenEmbeddingCacheStats() const;
+
+  // Returns the statistics of the result cache. All zero if
+  // LoadOptions::result_cache_size is zero.
+  ResultCache::Stats GetResultCacheStats() const;
+
+  // The patterns that ran over the regex limits of LoadOptions, across calls.
+  struct RegexLimitStats {
+    // Number of calls in which a pattern of the regex model ran over the
+    // limits, by the index of the pattern in the model.
+    std::map<int, int64> regex_overruns;
+
+    // Same for the datetime rules, by the index of the regex among the regexes
+    // of all patterns of the datetime model.
+    std::map<int, int64> datetime_overruns;
+
+    // Number of calls that skipped patterns because the regex budget was spent.
+    int64 exhausted_budgets = 0;
+  };
+
+  // Returns the statistics of the regex limits.
+  RegexLimitStats GetRegexLimitStats() const;
+
+  // Returns the memory used by the unpacked embedding table, in bytes. Zero
+  // unless LoadOptions::unpack_quantized_embeddings is set.
+  int64 GetUnpackedEmbeddingsBytes() const {
+    return unpacked_embeddings_bytes_;
+  }
+
+  // Returns how many tokens on either side of a span can influence whether and
+  // how it is annotated. Used to size the window overlaps of streaming
+  // annotation.
+  int AnnotationContextTokens() const;
+
+  const UniLib& GetUniLib() const { return *unilib_; }
+
   // Exposes the feature processor for tests and evaluations.
   const FeatureProcessor* SelectionFeatureProcessorForTests() const;
   const FeatureProcessor* ClassificationFeatureProcessorForTests() const;
@@ -155,6 +312,9 @@ class TextClassifier {
   // Exposes the date time parser for tests and evaluations.
   const DatetimeParser* DatetimeParserForTests() const;
 
+  // Overrides LoadOptions::regex_budget_ms for the following calls.
+  void SetRegexBudgetMsForTests(int regex_budget_ms);
+
   // String collection names for various classes.
   static const std::string& kOtherCollection;
   static const std::string& kPhoneCollection;
@@ -170,8 +330,11 @@ class TextClassifier {
   // Constructs and initializes text classifier from given model.
   // Takes ownership of 'mmap', and thus owns the buffer that backs 'model'.
   TextClassifier(std::unique_ptr<ScopedMmap>* mmap, const Model* model,
-                 const UniLib* unilib)
+                 const UniLib* unilib,
+                 const LoadOptions& load_options = LoadOptions::Default())
       : model_(model),
+        load_options_(load_options),
+        regex_budget_ms_(load_options.regex_budget_ms),
         mmap_(std::move(*mmap)),
         owned_unilib_(nullptr),
         unilib_(internal::MaybeCreateUnilib(unilib, &owned_unilib_)) {
@@ -180,8 +343,12 @@ class TextClassifier {
 
   // Constructs, validates and initializes text classifier from given model.
   // Does not own the buffer that backs 'model'.
-  explicit TextClassifier(const Model* model, const UniLib* unilib)
+  explicit TextClassifier(
+      const Model* model, const UniLib* unilib,
+      const LoadOptions& load_options = LoadOptions::Default())
       : model_(model),
+        load_options_(load_options),
+        regex_budget_ms_(load_options.regex_budget_ms),
         owned_unilib_(nullptr),
         unilib_(internal::MaybeCreateUnilib(unilib, &owned_unilib_)) {
     ValidateAndInitialize();
@@ -191,6 +358,9 @@ class TextClassifier {
   // datastructures.
   void ValidateAndInitialize();
 
+  // Collects the names of the collections of all enabled sub-models.
+  void InitializeCollections();
+
   // Initializes regular expressions for the regex model.
   bool InitializeRegexModel(ZlibDecompressor* decompressor);
 
@@ -202,6 +372,7 @@ class TextClassifier {
                         const std::string& context,
                         const std::vector<Token>& cached_tokens,
                         InterpreterManager* interpreter_manager,
+                        FeatureProcessor::EmbeddingCache* embedding_cache,
                         std::vector<int>* result) const;
 
   // Resolves one conflict between candidates on indices 'start_index'
@@ -212,14 +383,27 @@ class TextClassifier {
                        const std::vector<AnnotatedSpan>& candidates,
                        int start_index, int end_index,
                        InterpreterManager* interpreter_manager,
+                       FeatureProcessor::EmbeddingCache* embedding_cache,
                        std::vector<int>* chosen_indices) const;
 
+  // Suggests the selection for one valid click, given the tokens of the
+  // context and the candidates that don't depend on the click (from the regex
+  // and datetime chunking). The embedding cache is shared between the clicks.
+  CodepointSpan SuggestSelectionForClick(
+      const std::string& context, const UnicodeText& context_unicode,
+      CodepointSpan click_indices, const std::vector<Token>& context_tokens,
+      const std::vector<AnnotatedSpan>& context_candidates,
+      InterpreterManager* interpreter_manager,
+      FeatureProcessor::EmbeddingCache* embedding_cache) const;
+
   // Gets selection candidates from the ML model.
-  // Provides the tokens produced during tokenization of the context string for
-  // reuse.
+  // Starts from the tokens of the whole context, and provides the tokens after
+  // retokenization around the click for reuse.
   bool ModelSuggestSelection(const UnicodeText& context_unicode,
                              CodepointSpan click_indices,
+                             const std::vector<Token>& context_tokens,
                              InterpreterManager* interpreter_manager,
+                             FeatureProcessor::EmbeddingCache* embedding_cache,
                              std::vector<Token>* tokens,
                              std::vector<AnnotatedSpan>* result) const;
 
@@ -246,7 +430,7 @@ class TextClassifier {
   // Classifies the selected text with the regular expressions models.
   // Returns true if any regular expression matched and the result was set.
   bool RegexClassifyText(const std::string& context,
-                         CodepointSpan selection_indices,
+                         CodepointSpan selection_indices, RegexBudget* budget,
                          ClassificationResult* classification_result) const;
 
   // Classifies the selected text with the date time model.
@@ -254,6 +438,7 @@ class TextClassifier {
   bool DatetimeClassifyText(const std::string& context,
                             CodepointSpan selection_indices,
                             const ClassificationOptions& options,
+                            RegexBudget* budget,
                             ClassificationResult* classification_result) const;
 
   // Chunks given input text with the selection model and classifies the spans
@@ -277,7 +462,7 @@ class TextClassifier {
   // completely. The first and last chunk might extend beyond it.
   // The chunks vector is cleared before filling.
   bool ModelChunk(int num_tokens, const TokenSpan& span_of_interest,
-                  tflite::Interpreter* selection_interpreter,
+                  ExecutionContext* selection_context,
                   const CachedFeatures& cached_features,
                   std::vector<TokenSpan>* chunks) const;
 
@@ -287,7 +472,7 @@ class TextClassifier {
   bool ModelClickContextScoreChunks(
       int num_tokens, const TokenSpan& span_of_interest,
       const CachedFeatures& cached_features,
-      tflite::Interpreter* selection_interpreter,
+      ExecutionContext* selection_context,
       std::vector<ScoredChunk>* scored_chunks) const;
 
   // A helper method for ModelChunk(). It generates scored chunk candidates for
@@ -296,12 +481,20 @@ class TextClassifier {
   bool ModelBoundsSensitiveScoreChunks(
       int num_tokens, const TokenSpan& span_of_interest,
       const TokenSpan& inference_span, const CachedFeatures& cached_features,
-      tflite::Interpreter* selection_interpreter,
+      ExecutionContext* selection_context,
       std::vector<ScoredChunk>* scored_chunks) const;
 
-  // Produces chunks isolated by a set of regular expressions.
+  // Takes a selection context for an inference thread from the pool, or
+  // creates one, and puts it back.
+  std::unique_ptr<ExecutionContext> AcquireSelectionContext() const;
+  void ReleaseSelectionContext(
+      std::unique_ptr<ExecutionContext> context) const;
+
+  // Produces chunks isolated by a set of regular expressions. Patterns that
+  // run over the regex limits are recorded in the budget and don't produce
+  // chunks.
   bool RegexChunk(const UnicodeText& context_unicode,
-                  const std::vector<int>& rules,
+                  const std::vector<int>& rules, RegexBudget* budget,
                   std::vector<AnnotatedSpan>* result) const;
 
   // Produces chunks from the datetime parser.
@@ -309,8 +502,32 @@ class TextClassifier {
                      int64 reference_time_ms_utc,
                      const std::string& reference_timezone,
                      const std::string& locales, ModeFlag mode,
+                     RegexBudget* budget,
                      std::vector<AnnotatedSpan>* result) const;
 
+  // Adds the overruns recorded in the budget of a call to the statistics.
+  void RecordRegexBudget(const RegexBudget& budget) const;
+
+  // The uncached versions of ClassifyText and Annotate. Set 'truncated' if the
+  // regex budget ran out or a pattern ran over the regex limits, in which case
+  // the results may be incomplete and must not be cached.
+  std::vector<ClassificationResult> ClassifyTextUncached(
+      const std::string& context, CodepointSpan selection_indices,
+      const ClassificationOptions& options, bool* truncated) const;
+  std::vector<AnnotatedSpan> AnnotateUncached(const std::string& context,
+                                              const AnnotationOptions& options,
+                                              bool* truncated) const;
+
+  // Resolves the datetime results in 'classification', which were found for
+  // 'span' of the context, against another reference time and timezone by
+  // parsing the span again. Returns false if it doesn't parse to the same
+  // datetime span any more.
+  bool ResolveCachedDatetimes(
+      const std::string& context, CodepointSpan span,
+      int64 reference_time_ms_utc, const std::string& reference_timezone,
+      const std::string& locales, ModeFlag mode,
+      std::vector<ClassificationResult>* classification) const;
+
   // Returns whether a classification should be filtered.
   bool FilteredForAnnotation(const AnnotatedSpan& span) const;
   bool FilteredForClassification(
@@ -318,10 +535,41 @@ class TextClassifier {
   bool FilteredForSelection(const AnnotatedSpan& span) const;
 
   const Model* model_;
+  const LoadOptions load_options_;
 
   std::unique_ptr<const ModelExecutor> selection_executor_;
   std::unique_ptr<const ModelExecutor> classification_executor_;
   std::unique_ptr<const EmbeddingExecutor> embedding_executor_;
+  int64 unpacked_embeddings_bytes_ = 0;
+
+  // Shared across calls, thus not const. Must outlive the feature processors.
+  std::unique_ptr<TokenEmbeddingCache> selection_token_embedding_cache_;
+  std::unique_ptr<TokenEmbeddingCache> classification_token_embedding_cache_;
+
+  // Shared across calls, thus not const. Null if disabled.
+  std::unique_ptr<ResultCache> result_cache_;
+
+  // Runs the batches of the selection model of one call, together with the
+  // calling thread. Null if LoadOptions::num_inference_threads is 1.
+  std::unique_ptr<ThreadPool> inference_thread_pool_;
+
+  // LoadOptions::regex_budget_ms, unless overridden by a test.
+  std::atomic<int> regex_budget_ms_;
+
+  // See GetRegexLimitStats.
+  mutable std::mutex regex_limit_stats_mutex_;
+  mutable RegexLimitStats regex_limit_stats_;
+
+  // Selection contexts of the threads of inference_thread_pool_.
+  mutable std::mutex selection_contexts_mutex_;
+  mutable std::vector<std::unique_ptr<ExecutionContext>>
+      selection_contexts_;
+
+  // Whether the selection and classification feature processors compute the
+  // same token features, so that the selection model can use the per-call
+  // embedding cache too. The token embedding cache is shared in that case as
+  // well.
+  bool share_embedding_cache_ = false;
 
   std::unique_ptr<const FeatureProcessor> selection_feature_processor_;
   std::unique_ptr<const FeatureProcessor> classification_feature_processor_;
@@ -341,9 +589,14 @@ class TextClassifier {
   bool enabled_for_annotation_ = false;
   bool enabled_for_classification_ = false;
   bool enabled_for_selection_ = false;
-  std::unordered_set<std::string> filtered_collections_annotation_;
-  std::unordered_set<std::string> filtered_collections_classification_;
-  std::unordered_set<std::string> filtered_collections_selection_;
+
+  // Collections filtered from the results, read from the model in place.
+  const CollectionList* filtered_collections_annotation_ = nullptr;
+  const CollectionList* filtered_collections_classification_ = nullptr;
+  const CollectionList* filtered_collections_selection_ = nullptr;
+
+  std::vector<std::string> collections_;
+  std::unordered_map<std::string, int> collection_indices_;
 
   std::vector<CompiledRegexPattern> regex_patterns_;
   std::unordered_set<int> regex_approximate_match_pattern_ids_;
@@ -16,21 +16,28 @@
 
 #include "text-classifier.h"
 
+#include <atomic>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include "model_generated.h"
 #include "types-test-util.h"
+#include "zlib-utils.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace libtextclassifier2 {
 namespace {
 
+using testing::Contains;
 using testing::ElementsAreArray;
 using testing::IsEmpty;
+using testing::Not;
 using testing::Pair;
 using testing::Values;
 
@@ -55,6 +62,55 @@ std::string GetModelPath() {
   return LIBTEXTCLASSIFIER_TEST_DATA_DIR;
 }
 
+// Delegates to another executor and counts the batches.
+class CountingModelExecutor : public ModelExecutor {
+ public:
+  CountingModelExecutor(std::unique_ptr<const ModelExecutor> executor,
+                        std::atomic<int>* num_batches)
+      : executor_(std::move(executor)), num_batches_(num_batches) {}
+
+  std::unique_ptr<ExecutionContext> CreateContext() const override {
+    return executor_->CreateContext();
+  }
+
+  TensorView<float> ComputeLogits(const TensorView<float>& features,
+                                  ExecutionContext* context) const override {
+    ++*num_batches_;
+    return executor_->ComputeLogits(features, context);
+  }
+
+ private:
+  std::unique_ptr<const ModelExecutor> executor_;
+  std::atomic<int>* num_batches_;
+};
+
+// Delegates to another executor, but fails the given batch.
+class FailingModelExecutor : public ModelExecutor {
+ public:
+  FailingModelExecutor(std::unique_ptr<const ModelExecutor> executor,
+                       int failing_batch)
+      : executor_(std::move(executor)),
+        failing_batch_(failing_batch),
+        num_batches_(0) {}
+
+  std::unique_ptr<ExecutionContext> CreateContext() const override {
+    return executor_->CreateContext();
+  }
+
+  TensorView<float> ComputeLogits(const TensorView<float>& features,
+                                  ExecutionContext* context) const override {
+    if (num_batches_++ == failing_batch_) {
+      return TensorView<float>::Invalid();
+    }
+    return executor_->ComputeLogits(features, context);
+  }
+
+ private:
+  std::unique_ptr<const ModelExecutor> executor_;
+  const int failing_batch_;
+  mutable std::atomic<int> num_batches_;
+};
+
 TEST(TextClassifierTest, EmbeddingExecutorLoadingFails) {
   CREATE_UNILIB_FOR_TESTING;
   std::unique_ptr<TextClassifier> classifier =
@@ -104,6 +160,11 @@ TEST_P(TextClassifierTest, ClassifyText) {
             FirstResult(classifier->ClassifyText("", {0, 0})));
   EXPECT_EQ("<INVALID RESULTS>", FirstResult(classifier->ClassifyText(
                                      "a\n\n\n\nx x x\n\n\n\n\n\n", {1, 5})));
+  // Spans outside of the context.
+  EXPECT_EQ("<INVALID RESULTS>",
+            FirstResult(classifier->ClassifyText("(800) 123-456", {-5, 3})));
+  EXPECT_EQ("<INVALID RESULTS>",
+            FirstResult(classifier->ClassifyText("(800) 123-456", {6, 20})));
   // Test invalid utf8 input.
   EXPECT_EQ("<INVALID RESULTS>", FirstResult(classifier->ClassifyText(
                                      "\xf0\x9f\x98\x8b\x8b", {0, 0})));
@@ -256,6 +317,136 @@ TEST_P(TextClassifierTest, ClassifyTextRegularExpression) {
 }
 #endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
 
+#ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
+TEST_P(TextClassifierTest, CompressedModel) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + GetParam());
+  std::unique_ptr<TextClassifier> uncompressed_classifier =
+      TextClassifier::FromUnownedBuffer(test_model.data(), test_model.size(),
+                                        &unilib);
+  ASSERT_TRUE(uncompressed_classifier);
+
+  const std::string test_string =
+      "Visit www.google.com on 3/4/2018 or mail me at you@android.com";
+  const std::vector<AnnotatedSpan> expected =
+      uncompressed_classifier->Annotate(test_string);
+
+  // Both formats are loaded with the regex model and the datetime parser
+  // initialized concurrently.
+  LoadOptions load_options;
+  load_options.num_init_threads = 2;
+  for (const bool independent : {false, true}) {
+    const std::string compressed_model =
+        CompressSerializedModel(test_model, independent);
+    std::unique_ptr<TextClassifier> classifier =
+        TextClassifier::FromUnownedBuffer(compressed_model.data(),
+                                          compressed_model.size(), &unilib,
+                                          load_options);
+    ASSERT_TRUE(classifier);
+    const std::vector<AnnotatedSpan> annotations =
+        classifier->Annotate(test_string);
+    ASSERT_EQ(annotations.size(), expected.size());
+    for (int i = 0; i < annotations.size(); ++i) {
+      EXPECT_EQ(annotations[i].span, expected[i].span);
+      EXPECT_EQ(FirstResult(annotations[i].classification),
+                FirstResult(expected[i].classification));
+    }
+  }
+}
+#endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
+
+#ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
+TEST_P(TextClassifierTest, RegexLimits) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + GetParam());
+  std::unique_ptr<ModelT> unpacked_model = UnPackModel(test_model.c_str());
+
+  // Add a pattern with catastrophic backtracking on inputs without a 'b'.
+  unpacked_model->regex_model->patterns.push_back(MakePattern(
+      "backtracking", "(a+)+b", /*enabled_for_classification=*/true,
+      /*enabled_for_selection=*/false, /*enabled_for_annotation=*/true, 1.0));
+  const int pattern_id = unpacked_model->regex_model->patterns.size() - 1;
+  unpacked_model->regex_model->patterns.push_back(MakePattern(
+      "person", "Barack Obama", /*enabled_for_classification=*/false,
+      /*enabled_for_selection=*/false, /*enabled_for_annotation=*/true, 1.0));
+
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(Model::Pack(builder, unpacked_model.get()));
+
+  LoadOptions load_options;
+  load_options.regex_time_limit = 10;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(
+          reinterpret_cast<const char*>(builder.GetBufferPointer()),
+          builder.GetSize(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+
+  const std::string test_string = "call me at (800) 123-456 today";
+  const std::string pathological_string =
+      std::string(40, 'a') + " call me at (800) 123-456 today";
+  EXPECT_EQ("phone", FirstResult(classifier->ClassifyText(
+                         pathological_string, {52, 65})));
+  EXPECT_EQ(classifier->Annotate(test_string).size(),
+            classifier->Annotate(pathological_string).size());
+
+  const TextClassifier::RegexLimitStats stats =
+      classifier->GetRegexLimitStats();
+  ASSERT_EQ(stats.regex_overruns.count(pattern_id), 1);
+  EXPECT_EQ(stats.regex_overruns.at(pattern_id), 1);
+  EXPECT_EQ(stats.exhausted_budgets, 0);
+
+  // A spent budget skips the remaining patterns, and is counted.
+  load_options.regex_budget_ms = 1;
+  classifier = TextClassifier::FromUnownedBuffer(
+      reinterpret_cast<const char*>(builder.GetBufferPointer()),
+      builder.GetSize(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+  classifier->Annotate(pathological_string);
+  EXPECT_EQ(classifier->GetRegexLimitStats().exhausted_budgets, 1);
+}
+#endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
+
+#ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
+TEST_P(TextClassifierTest, TruncatedResultsAreNotCached) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + GetParam());
+  std::unique_ptr<ModelT> unpacked_model = UnPackModel(test_model.c_str());
+
+  // The backtracking pattern spends the budget, so that the person pattern
+  // after it is skipped.
+  unpacked_model->regex_model->patterns.push_back(MakePattern(
+      "backtracking", "(a+)+b", /*enabled_for_classification=*/false,
+      /*enabled_for_selection=*/false, /*enabled_for_annotation=*/true, 1.0));
+  unpacked_model->regex_model->patterns.push_back(MakePattern(
+      "person", " (Barack Obama) ", /*enabled_for_classification=*/false,
+      /*enabled_for_selection=*/false, /*enabled_for_annotation=*/true, 1.0));
+
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(Model::Pack(builder, unpacked_model.get()));
+
+  LoadOptions load_options;
+  load_options.regex_time_limit = 10;
+  load_options.regex_budget_ms = 1;
+  load_options.result_cache_size = 10;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(
+          reinterpret_cast<const char*>(builder.GetBufferPointer()),
+          builder.GetSize(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+
+  const std::string test_string = std::string(40, 'a') + " Barack Obama said";
+  EXPECT_THAT(classifier->Annotate(test_string),
+              Not(Contains(IsAnnotatedSpan(41, 53, "person"))));
+  EXPECT_EQ(classifier->GetRegexLimitStats().exhausted_budgets, 1);
+
+  // A later call with enough budget doesn't get the truncated results.
+  classifier->SetRegexBudgetMsForTests(0);
+  EXPECT_THAT(classifier->Annotate(test_string),
+              Contains(IsAnnotatedSpan(41, 53, "person")));
+  EXPECT_EQ(classifier->GetResultCacheStats().size, 0);
+}
+#endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
+
 #ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
 TEST_P(TextClassifierTest, SuggestSelectionRegularExpression) {
   CREATE_UNILIB_FOR_TESTING;
@@ -560,6 +751,31 @@ TEST_P(TextClassifierTest, SuggestSelectionsAreSymmetric) {
             std::make_pair(6, 33));
 }
 
+TEST_P(TextClassifierTest, SuggestSelectionBatch) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+
+  const std::string context =
+      "350 Third Street, Cambridge\ncall me at 857 225 3556 today";
+  const std::vector<CodepointSpan> clicks = {
+      {0, 3}, {4, 9}, {39, 42}, {47, 51}, {28, 32}, {5, 5}, {-1, 2}, {50, 70}};
+  const std::vector<CodepointSpan> selections =
+      classifier->SuggestSelectionBatch(context, clicks);
+  ASSERT_EQ(selections.size(), clicks.size());
+  for (int i = 0; i < clicks.size(); ++i) {
+    EXPECT_EQ(selections[i], classifier->SuggestSelection(context, clicks[i]));
+  }
+  EXPECT_EQ(selections[0], std::make_pair(0, 27));
+  EXPECT_EQ(selections[1], std::make_pair(0, 27));
+  EXPECT_EQ(selections[2], std::make_pair(39, 51));
+  EXPECT_EQ(selections[3], std::make_pair(39, 51));
+  EXPECT_EQ(selections[5], std::make_pair(5, 5));
+
+  EXPECT_TRUE(classifier->SuggestSelectionBatch(context, {}).empty());
+}
+
 TEST_P(TextClassifierTest, SuggestSelectionWithNewLine) {
   CREATE_UNILIB_FOR_TESTING;
   std::unique_ptr<TextClassifier> classifier =
@@ -737,6 +953,275 @@ TEST_P(TextClassifierTest, Annotate) {
           .empty());
 }
 
+// Returns "😁 " followed by 'ascii' in UTF-16, so that UTF-16 indices in the
+// text are one larger than codepoint indices.
+std::vector<uint16> EmojiPrefixedUTF16(const std::string& ascii) {
+  std::vector<uint16> result = {0xD83D, 0xDE01, ' '};
+  result.insert(result.end(), ascii.begin(), ascii.end());
+  return result;
+}
+
+TEST_P(TextClassifierTest, UTF16Input) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+
+  const std::vector<uint16> context =
+      EmojiPrefixedUTF16("call me at 857 225 3556 today");
+  EXPECT_EQ(classifier->SuggestSelection(context.data(), context.size(),
+                                         {14, 17}),
+            std::make_pair(14, 26));
+  EXPECT_EQ("phone", FirstResult(classifier->ClassifyText(
+                         context.data(), context.size(), {14, 26})));
+  EXPECT_THAT(classifier->Annotate(context.data(), context.size()),
+              ElementsAreArray({IsAnnotatedSpan(14, 26, "phone")}));
+
+  // Indices inside of a surrogate pair are invalid.
+  EXPECT_EQ(classifier->SuggestSelection(context.data(), context.size(),
+                                         {1, 2}),
+            std::make_pair(1, 2));
+  EXPECT_TRUE(
+      classifier->ClassifyText(context.data(), context.size(), {1, 26})
+          .empty());
+}
+
+TEST_P(TextClassifierTest, Collections) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(classifier);
+
+  const std::vector<std::string>& collections = classifier->Collections();
+  ASSERT_FALSE(collections.empty());
+  EXPECT_EQ(collections[0], "other");
+  for (int i = 0; i < collections.size(); ++i) {
+    EXPECT_EQ(classifier->CollectionIndex(collections[i]), i);
+  }
+  EXPECT_EQ(classifier->CollectionIndex("no such collection"), -1);
+
+  // Every returned collection has an index.
+  for (const AnnotatedSpan& span : classifier->Annotate(
+           "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my "
+           "phone number is 853 225 3556")) {
+    for (const ClassificationResult& classification : span.classification) {
+      EXPECT_NE(classifier->CollectionIndex(classification.collection), -1);
+    }
+  }
+}
+
+TEST_P(TextClassifierTest, TokenEmbeddingCache) {
+  CREATE_UNILIB_FOR_TESTING;
+  LoadOptions load_options;
+  load_options.token_embedding_cache_size = 1000;
+  std::unique_ptr<TextClassifier> classifier = TextClassifier::FromPath(
+      GetModelPath() + GetParam(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+  std::unique_ptr<TextClassifier> uncached_classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(uncached_classifier);
+
+  const std::string test_string =
+      "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my phone "
+      "number is 853 225 3556";
+  const std::vector<AnnotatedSpan> expected =
+      uncached_classifier->Annotate(test_string);
+  for (int i = 0; i < 2; ++i) {
+    const std::vector<AnnotatedSpan> annotations =
+        classifier->Annotate(test_string);
+    ASSERT_EQ(annotations.size(), expected.size());
+    for (int j = 0; j < annotations.size(); ++j) {
+      EXPECT_EQ(annotations[j].span, expected[j].span);
+      EXPECT_EQ(FirstResult(annotations[j].classification),
+                FirstResult(expected[j].classification));
+    }
+  }
+
+  const TokenEmbeddingCache::Stats stats =
+      classifier->GetTokenEmbeddingCacheStats();
+  EXPECT_GT(stats.hits, 0);
+  EXPECT_GT(stats.size, 0);
+  EXPECT_EQ(uncached_classifier->GetTokenEmbeddingCacheStats().size, 0);
+}
+
+TEST_P(TextClassifierTest, ResultCache) {
+  CREATE_UNILIB_FOR_TESTING;
+  LoadOptions load_options;
+  load_options.result_cache_size = 10;
+  std::unique_ptr<TextClassifier> classifier = TextClassifier::FromPath(
+      GetModelPath() + GetParam(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+  std::unique_ptr<TextClassifier> uncached_classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(uncached_classifier);
+
+  const std::string test_string =
+      "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my phone "
+      "number is 853 225 3556";
+  const std::vector<AnnotatedSpan> expected =
+      uncached_classifier->Annotate(test_string);
+  for (int i = 0; i < 2; ++i) {
+    const std::vector<AnnotatedSpan> annotations =
+        classifier->Annotate(test_string);
+    ASSERT_EQ(annotations.size(), expected.size());
+    for (int j = 0; j < annotations.size(); ++j) {
+      EXPECT_EQ(annotations[j].span, expected[j].span);
+      EXPECT_EQ(FirstResult(annotations[j].classification),
+                FirstResult(expected[j].classification));
+    }
+
+    EXPECT_EQ(classifier->SuggestSelection(test_string, {30, 33}),
+              uncached_classifier->SuggestSelection(test_string, {30, 33}));
+    EXPECT_EQ(FirstResult(classifier->ClassifyText(test_string, {79, 91})),
+              FirstResult(
+                  uncached_classifier->ClassifyText(test_string, {79, 91})));
+  }
+
+  // Other spans and locales are not cached yet.
+  EXPECT_EQ(classifier->SuggestSelection(test_string, {28, 31}),
+            uncached_classifier->SuggestSelection(test_string, {28, 31}));
+  ClassificationOptions options;
+  options.locales = "de";
+  EXPECT_EQ(
+      FirstResult(classifier->ClassifyText(test_string, {79, 91}, options)),
+      FirstResult(
+          uncached_classifier->ClassifyText(test_string, {79, 91}, options)));
+
+  const ResultCache::Stats stats = classifier->GetResultCacheStats();
+  EXPECT_EQ(stats.hits, 3);
+  EXPECT_EQ(stats.misses, 5);
+  EXPECT_EQ(stats.size, 5);
+  EXPECT_EQ(uncached_classifier->GetResultCacheStats().size, 0);
+}
+
+TEST_P(TextClassifierTest, UnpackQuantizedEmbeddings) {
+  CREATE_UNILIB_FOR_TESTING;
+  LoadOptions load_options;
+  load_options.unpack_quantized_embeddings = true;
+  std::unique_ptr<TextClassifier> classifier = TextClassifier::FromPath(
+      GetModelPath() + GetParam(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+  std::unique_ptr<TextClassifier> packed_classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(packed_classifier);
+  EXPECT_GT(classifier->GetUnpackedEmbeddingsBytes(), 0);
+  EXPECT_EQ(packed_classifier->GetUnpackedEmbeddingsBytes(), 0);
+
+  const std::string test_string =
+      "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my phone "
+      "number is 853 225 3556";
+  EXPECT_EQ(classifier->SuggestSelection(test_string, {30, 33}),
+            packed_classifier->SuggestSelection(test_string, {30, 33}));
+  const std::vector<AnnotatedSpan> expected =
+      packed_classifier->Annotate(test_string);
+  const std::vector<AnnotatedSpan> annotations =
+      classifier->Annotate(test_string);
+  ASSERT_EQ(annotations.size(), expected.size());
+  for (int i = 0; i < annotations.size(); ++i) {
+    EXPECT_EQ(annotations[i].span, expected[i].span);
+    ASSERT_EQ(annotations[i].classification.size(),
+              expected[i].classification.size());
+    for (int j = 0; j < annotations[i].classification.size(); ++j) {
+      EXPECT_EQ(annotations[i].classification[j].collection,
+                expected[i].classification[j].collection);
+      EXPECT_EQ(annotations[i].classification[j].score,
+                expected[i].classification[j].score);
+    }
+  }
+}
+
+TEST_P(TextClassifierTest, ParallelInitialization) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> sequential_classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(sequential_classifier);
+
+  LoadOptions threads_load_options;
+  threads_load_options.num_init_threads = 4;
+
+  // Runs every task on a thread of its own.
+  std::vector<std::thread> executor_threads;
+  std::mutex executor_mutex;
+  LoadOptions executor_load_options;
+  executor_load_options.init_executor =
+      [&executor_threads, &executor_mutex](std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(executor_mutex);
+        executor_threads.emplace_back(std::move(task));
+      };
+
+  const std::string test_string =
+      "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my phone "
+      "number is 853 225 3556";
+  const std::vector<AnnotatedSpan> expected =
+      sequential_classifier->Annotate(test_string);
+  for (const LoadOptions& load_options :
+       {threads_load_options, executor_load_options}) {
+    std::unique_ptr<TextClassifier> classifier = TextClassifier::FromPath(
+        GetModelPath() + GetParam(), &unilib, load_options);
+    ASSERT_TRUE(classifier);
+    EXPECT_EQ(classifier->SuggestSelection(test_string, {30, 33}),
+              sequential_classifier->SuggestSelection(test_string, {30, 33}));
+    const std::vector<AnnotatedSpan> annotations =
+        classifier->Annotate(test_string);
+    ASSERT_EQ(annotations.size(), expected.size());
+    for (int i = 0; i < annotations.size(); ++i) {
+      EXPECT_EQ(annotations[i].span, expected[i].span);
+      EXPECT_EQ(FirstResult(annotations[i].classification),
+                FirstResult(expected[i].classification));
+    }
+  }
+  for (std::thread& thread : executor_threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(executor_threads.empty());
+}
+
+TEST_P(TextClassifierTest, ModelExecutorFactory) {
+  CREATE_UNILIB_FOR_TESTING;
+  std::atomic<int> num_selection_batches(0);
+  std::atomic<int> num_classification_batches(0);
+  LoadOptions load_options;
+  load_options.selection_executor_factory =
+      [&num_selection_batches](
+          const flatbuffers::Vector<uint8_t>* model_spec_buffer) {
+        return std::unique_ptr<const ModelExecutor>(new CountingModelExecutor(
+            TFLiteModelExecutor::Instance(model_spec_buffer),
+            &num_selection_batches));
+      };
+  load_options.classification_executor_factory =
+      [&num_classification_batches](
+          const flatbuffers::Vector<uint8_t>* model_spec_buffer) {
+        return std::unique_ptr<const ModelExecutor>(new CountingModelExecutor(
+            TFLiteModelExecutor::Instance(model_spec_buffer),
+            &num_classification_batches));
+      };
+  std::unique_ptr<TextClassifier> classifier = TextClassifier::FromPath(
+      GetModelPath() + GetParam(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+  std::unique_ptr<TextClassifier> tflite_classifier =
+      TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib);
+  ASSERT_TRUE(tflite_classifier);
+
+  const std::string test_string =
+      "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my phone "
+      "number is 853 225 3556";
+  EXPECT_EQ(classifier->SuggestSelection(test_string, {30, 33}),
+            tflite_classifier->SuggestSelection(test_string, {30, 33}));
+  EXPECT_EQ(
+      FirstResult(classifier->ClassifyText(test_string, {28, 55})),
+      FirstResult(tflite_classifier->ClassifyText(test_string, {28, 55})));
+  EXPECT_GT(num_selection_batches, 0);
+  EXPECT_GT(num_classification_batches, 0);
+
+  // The classifier can't be loaded without an executor.
+  load_options.classification_executor_factory =
+      [](const flatbuffers::Vector<uint8_t>*) {
+        return std::unique_ptr<const ModelExecutor>();
+      };
+  EXPECT_FALSE(TextClassifier::FromPath(GetModelPath() + GetParam(), &unilib,
+                                        load_options));
+}
+
 TEST_P(TextClassifierTest, AnnotateSmallBatches) {
   CREATE_UNILIB_FOR_TESTING;
   const std::string test_model = ReadFile(GetModelPath() + GetParam());
@@ -771,6 +1256,89 @@ TEST_P(TextClassifierTest, AnnotateSmallBatches) {
   EXPECT_TRUE(classifier->Annotate("853 225\n3556", options).empty());
 }
 
+TEST_P(TextClassifierTest, AnnotateParallelInference) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + GetParam());
+  std::unique_ptr<ModelT> unpacked_model = UnPackModel(test_model.c_str());
+
+  // Small batches, so that there are many of them to distribute.
+  unpacked_model->selection_options->batch_size = 4;
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(Model::Pack(builder, unpacked_model.get()));
+
+  LoadOptions load_options;
+  load_options.num_inference_threads = 4;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(
+          reinterpret_cast<const char*>(builder.GetBufferPointer()),
+          builder.GetSize(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+  std::unique_ptr<TextClassifier> sequential_classifier =
+      TextClassifier::FromUnownedBuffer(
+          reinterpret_cast<const char*>(builder.GetBufferPointer()),
+          builder.GetSize(), &unilib);
+  ASSERT_TRUE(sequential_classifier);
+
+  const std::string test_string =
+      "& saw Barack Obama today .. 350 Third Street, Cambridge\nand my phone "
+      "number is 853 225 3556";
+  EXPECT_THAT(classifier->Annotate(test_string),
+              ElementsAreArray({
+#ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
+                  IsAnnotatedSpan(19, 24, "date"),
+#endif
+                  IsAnnotatedSpan(28, 55, "address"),
+                  IsAnnotatedSpan(79, 91, "phone"),
+              }));
+
+  std::string long_string;
+  for (int i = 0; i < 10; ++i) {
+    long_string += "I live at 350 Third Street, Cambridge and my phone number ";
+    long_string += "is 853 225 3556. ";
+  }
+  const std::vector<AnnotatedSpan> expected =
+      sequential_classifier->Annotate(long_string);
+  const std::vector<AnnotatedSpan> annotations =
+      classifier->Annotate(long_string);
+  ASSERT_EQ(annotations.size(), expected.size());
+  for (int i = 0; i < annotations.size(); ++i) {
+    EXPECT_EQ(annotations[i].span, expected[i].span);
+    EXPECT_EQ(FirstResult(annotations[i].classification),
+              FirstResult(expected[i].classification));
+  }
+}
+
+TEST(TextClassifierTest, AnnotateParallelInferenceFails) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + "test_model.fb");
+  std::unique_ptr<ModelT> unpacked_model = UnPackModel(test_model.c_str());
+  unpacked_model->selection_options->batch_size = 4;
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(Model::Pack(builder, unpacked_model.get()));
+
+  // A single failing batch fails the whole call, whichever thread runs it.
+  LoadOptions load_options;
+  load_options.num_inference_threads = 4;
+  load_options.selection_executor_factory =
+      [](const flatbuffers::Vector<uint8_t>* model_spec_buffer) {
+        return std::unique_ptr<const ModelExecutor>(new FailingModelExecutor(
+            TFLiteModelExecutor::Instance(model_spec_buffer),
+            /*failing_batch=*/1));
+      };
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(
+          reinterpret_cast<const char*>(builder.GetBufferPointer()),
+          builder.GetSize(), &unilib, load_options);
+  ASSERT_TRUE(classifier);
+
+  std::string long_string;
+  for (int i = 0; i < 10; ++i) {
+    long_string += "I live at 350 Third Street, Cambridge and my phone number ";
+    long_string += "is 853 225 3556. ";
+  }
+  EXPECT_TRUE(classifier->Annotate(long_string).empty());
+}
+
 #ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
 TEST_P(TextClassifierTest, AnnotateFilteringDiscardAll) {
   CREATE_UNILIB_FOR_TESTING;
@@ -996,6 +1564,31 @@ TEST_P(TextClassifierTest, ClassifyTextDate) {
   EXPECT_EQ(result[0].datetime_parse_result.granularity,
             DatetimeGranularity::GRANULARITY_DAY);
 }
+
+TEST_P(TextClassifierTest, ResultCacheResolvesDatetimes) {
+  LoadOptions load_options;
+  load_options.result_cache_size = 10;
+  std::unique_ptr<TextClassifier> classifier = TextClassifier::FromPath(
+      GetModelPath() + GetParam(), /*unilib=*/nullptr, load_options);
+  EXPECT_TRUE(classifier);
+
+  ClassificationOptions options;
+  options.reference_timezone = "Europe/Zurich";
+  std::vector<ClassificationResult> result =
+      classifier->ClassifyText("january 1, 2017", {0, 15}, options);
+  ASSERT_EQ(result.size(), 1);
+  EXPECT_EQ(result[0].datetime_parse_result.time_ms_utc, 1483225200000);
+
+  // The cached result is resolved in the other timezone.
+  options.reference_timezone = "America/Los_Angeles";
+  result = classifier->ClassifyText("january 1, 2017", {0, 15}, options);
+  ASSERT_EQ(result.size(), 1);
+  EXPECT_THAT(result[0].collection, "date");
+  EXPECT_EQ(result[0].datetime_parse_result.time_ms_utc, 1483257600000);
+  EXPECT_EQ(result[0].datetime_parse_result.granularity,
+            DatetimeGranularity::GRANULARITY_DAY);
+  EXPECT_EQ(classifier->GetResultCacheStats().hits, 1);
+}
 #endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
 
 #ifdef LIBTEXTCLASSIFIER_CALENDAR_ICU
@@ -1085,7 +1678,8 @@ TEST(TextClassifierTest, ResolveConflictsTrivial) {
 
   std::vector<int> chosen;
   classifier.ResolveConflicts(candidates, /*context=*/"", /*cached_tokens=*/{},
-                              /*interpreter_manager=*/nullptr, &chosen);
+                              /*interpreter_manager=*/nullptr,
+                              /*embedding_cache=*/nullptr, &chosen);
   EXPECT_THAT(chosen, ElementsAreArray({0}));
 }
 
@@ -1103,7 +1697,8 @@ TEST(TextClassifierTest, ResolveConflictsSequence) {
 
   std::vector<int> chosen;
   classifier.ResolveConflicts(candidates, /*context=*/"", /*cached_tokens=*/{},
-                              /*interpreter_manager=*/nullptr, &chosen);
+                              /*interpreter_manager=*/nullptr,
+                              /*embedding_cache=*/nullptr, &chosen);
   EXPECT_THAT(chosen, ElementsAreArray({0, 1, 2, 3, 4}));
 }
 
@@ -1119,7 +1714,8 @@ TEST(TextClassifierTest, ResolveConflictsThreeSpans) {
 
   std::vector<int> chosen;
   classifier.ResolveConflicts(candidates, /*context=*/"", /*cached_tokens=*/{},
-                              /*interpreter_manager=*/nullptr, &chosen);
+                              /*interpreter_manager=*/nullptr,
+                              /*embedding_cache=*/nullptr, &chosen);
   EXPECT_THAT(chosen, ElementsAreArray({0, 2}));
 }
 
@@ -1135,7 +1731,8 @@ TEST(TextClassifierTest, ResolveConflictsThreeSpansReversed) {
 
   std::vector<int> chosen;
   classifier.ResolveConflicts(candidates, /*context=*/"", /*cached_tokens=*/{},
-                              /*interpreter_manager=*/nullptr, &chosen);
+                              /*interpreter_manager=*/nullptr,
+                              /*embedding_cache=*/nullptr, &chosen);
   EXPECT_THAT(chosen, ElementsAreArray({1}));
 }
 
@@ -1153,7 +1750,8 @@ TEST(TextClassifierTest, ResolveConflictsFiveSpans) {
 
   std::vector<int> chosen;
   classifier.ResolveConflicts(candidates, /*context=*/"", /*cached_tokens=*/{},
-                              /*interpreter_manager=*/nullptr, &chosen);
+                              /*interpreter_manager=*/nullptr,
+                              /*embedding_cache=*/nullptr, &chosen);
   EXPECT_THAT(chosen, ElementsAreArray({0, 2, 4}));
 }
 
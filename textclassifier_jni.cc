@@ -19,6 +19,8 @@
 #include "textclassifier_jni.h"
 
 #include <jni.h>
+#include <atomic>
+#include <mutex>
 #include <type_traits>
 #include <vector>
 
@@ -34,11 +36,13 @@ using libtextclassifier2::AnnotationOptions;
 using libtextclassifier2::ClassificationOptions;
 using libtextclassifier2::ClassificationResult;
 using libtextclassifier2::CodepointSpan;
+using libtextclassifier2::JStringToUTF16;
 using libtextclassifier2::JStringToUtf8String;
 using libtextclassifier2::Model;
 using libtextclassifier2::ScopedLocalRef;
 using libtextclassifier2::SelectionOptions;
 using libtextclassifier2::TextClassifier;
+using libtextclassifier2::uint16;
 #ifdef LIBTEXTCLASSIFIER_UNILIB_JAVAICU
 using libtextclassifier2::UniLib;
 #endif
@@ -55,136 +59,308 @@ std::string ToStlString(JNIEnv* env, const jstring& str) {
   return result;
 }
 
+// Java classes, constructors and methods used on every call. They are looked
+// up once, in JNI_OnLoad or on first use, instead of on every call.
+// The class references of a complete cache are global and never released, so
+// that the ids stay valid for the lifetime of the library.
+struct JniCache {
+  jclass object_class = nullptr;
+  jclass string_class = nullptr;
+
+  jclass classification_result_class = nullptr;
+  jmethodID classification_result_init = nullptr;
+
+  jclass datetime_result_class = nullptr;
+  jmethodID datetime_result_init = nullptr;
+
+  jclass annotated_span_class = nullptr;
+  jmethodID annotated_span_init = nullptr;
+
+  jclass selection_options_class = nullptr;
+  jmethodID selection_options_get_locales = nullptr;
+
+  jclass classification_options_class = nullptr;
+  jmethodID classification_options_get_locale = nullptr;
+  jmethodID classification_options_get_reference_timezone = nullptr;
+  jmethodID classification_options_get_reference_time_ms_utc = nullptr;
+
+  jclass annotation_options_class = nullptr;
+  jmethodID annotation_options_get_locale = nullptr;
+  jmethodID annotation_options_get_reference_timezone = nullptr;
+  jmethodID annotation_options_get_reference_time_ms_utc = nullptr;
+
+  // Returns nullptr if any of the classes or methods is missing. Clears the
+  // pending Java exception and releases the classes found so far in that
+  // case.
+  static std::unique_ptr<JniCache> Create(JNIEnv* env);
+
+ private:
+  static bool FindGlobalClass(JNIEnv* env, const char* name, jclass* result);
+
+  // Deletes the global references to the classes that were set.
+  void DeleteGlobalRefs(JNIEnv* env);
+};
+
+bool JniCache::FindGlobalClass(JNIEnv* env, const char* name, jclass* result) {
+  const ScopedLocalRef<jclass> local_class(env->FindClass(name), env);
+  if (!local_class) {
+    TC_LOG(ERROR) << "Couldn't find class: " << name;
+    return false;
+  }
+  *result = reinterpret_cast<jclass>(env->NewGlobalRef(local_class.get()));
+  return *result != nullptr;
+}
+
+void JniCache::DeleteGlobalRefs(JNIEnv* env) {
+  for (jclass* global_class :
+       {&object_class, &string_class, &classification_result_class,
+        &datetime_result_class, &annotated_span_class,
+        &selection_options_class, &classification_options_class,
+        &annotation_options_class}) {
+    if (*global_class != nullptr) {
+      env->DeleteGlobalRef(*global_class);
+      *global_class = nullptr;
+    }
+  }
+}
+
+std::unique_ptr<JniCache> JniCache::Create(JNIEnv* env) {
+  std::unique_ptr<JniCache> cache(new JniCache);
+  const bool found =
+      FindGlobalClass(env, "java/lang/Object", &cache->object_class) &&
+      FindGlobalClass(env, "java/lang/String", &cache->string_class) &&
+      FindGlobalClass(
+          env, TC_PACKAGE_PATH TC_CLASS_NAME_STR "$ClassificationResult",
+          &cache->classification_result_class) &&
+      (cache->classification_result_init = env->GetMethodID(
+           cache->classification_result_class, "<init>",
+           "(Ljava/lang/String;FL" TC_PACKAGE_PATH TC_CLASS_NAME_STR
+           "$DatetimeResult;)V")) &&
+      FindGlobalClass(env, TC_PACKAGE_PATH TC_CLASS_NAME_STR "$DatetimeResult",
+                      &cache->datetime_result_class) &&
+      (cache->datetime_result_init = env->GetMethodID(
+           cache->datetime_result_class, "<init>", "(JI)V")) &&
+      FindGlobalClass(env, TC_PACKAGE_PATH TC_CLASS_NAME_STR "$AnnotatedSpan",
+                      &cache->annotated_span_class) &&
+      (cache->annotated_span_init = env->GetMethodID(
+           cache->annotated_span_class, "<init>",
+           "(II[L" TC_PACKAGE_PATH TC_CLASS_NAME_STR
+           "$ClassificationResult;)V")) &&
+      FindGlobalClass(env,
+                      TC_PACKAGE_PATH TC_CLASS_NAME_STR "$SelectionOptions",
+                      &cache->selection_options_class) &&
+      (cache->selection_options_get_locales =
+           env->GetMethodID(cache->selection_options_class, "getLocales",
+                            "()Ljava/lang/String;")) &&
+      FindGlobalClass(
+          env, TC_PACKAGE_PATH TC_CLASS_NAME_STR "$ClassificationOptions",
+          &cache->classification_options_class) &&
+      (cache->classification_options_get_locale =
+           env->GetMethodID(cache->classification_options_class, "getLocale",
+                            "()Ljava/lang/String;")) &&
+      (cache->classification_options_get_reference_timezone =
+           env->GetMethodID(cache->classification_options_class,
+                            "getReferenceTimezone", "()Ljava/lang/String;")) &&
+      (cache->classification_options_get_reference_time_ms_utc =
+           env->GetMethodID(cache->classification_options_class,
+                            "getReferenceTimeMsUtc", "()J")) &&
+      FindGlobalClass(env,
+                      TC_PACKAGE_PATH TC_CLASS_NAME_STR "$AnnotationOptions",
+                      &cache->annotation_options_class) &&
+      (cache->annotation_options_get_locale =
+           env->GetMethodID(cache->annotation_options_class, "getLocale",
+                            "()Ljava/lang/String;")) &&
+      (cache->annotation_options_get_reference_timezone =
+           env->GetMethodID(cache->annotation_options_class,
+                            "getReferenceTimezone", "()Ljava/lang/String;")) &&
+      (cache->annotation_options_get_reference_time_ms_utc =
+           env->GetMethodID(cache->annotation_options_class,
+                            "getReferenceTimeMsUtc", "()J"));
+  if (!found) {
+    env->ExceptionClear();
+    cache->DeleteGlobalRefs(env);
+    return nullptr;
+  }
+  return cache;
+}
+
+std::mutex jni_cache_mutex;
+std::atomic<const JniCache*> jni_cache(nullptr);
+
+// Returns the cache, creating it if it wasn't created in JNI_OnLoad (e.g.
+// because the classes weren't visible to the class loader there). Returns
+// nullptr if the Java classes can't be resolved.
+const JniCache* GetJniCache(JNIEnv* env) {
+  const JniCache* cache = jni_cache.load(std::memory_order_acquire);
+  if (cache != nullptr) {
+    return cache;
+  }
+  std::lock_guard<std::mutex> lock(jni_cache_mutex);
+  cache = jni_cache.load(std::memory_order_relaxed);
+  if (cache == nullptr) {
+    cache = JniCache::Create(env).release();
+    jni_cache.store(cache, std::memory_order_release);
+  }
+  return cache;
+}
+
 jobjectArray ClassificationResultsToJObjectArray(
     JNIEnv* env,
     const std::vector<ClassificationResult>& classification_result) {
-  const ScopedLocalRef<jclass> result_class(
-      env->FindClass(TC_PACKAGE_PATH TC_CLASS_NAME_STR "$ClassificationResult"),
-      env);
-  if (!result_class) {
-    TC_LOG(ERROR) << "Couldn't find ClassificationResult class.";
+  const JniCache* cache = GetJniCache(env);
+  if (cache == nullptr) {
+    TC_LOG(ERROR) << "Couldn't resolve the result classes.";
     return nullptr;
   }
-  const ScopedLocalRef<jclass> datetime_parse_class(
-      env->FindClass(TC_PACKAGE_PATH TC_CLASS_NAME_STR "$DatetimeResult"), env);
-  if (!datetime_parse_class) {
-    TC_LOG(ERROR) << "Couldn't find DatetimeResult class.";
-    return nullptr;
-  }
-
-  const jmethodID result_class_constructor =
-      env->GetMethodID(result_class.get(), "<init>",
-                       "(Ljava/lang/String;FL" TC_PACKAGE_PATH TC_CLASS_NAME_STR
-                       "$DatetimeResult;)V");
-  const jmethodID datetime_parse_class_constructor =
-      env->GetMethodID(datetime_parse_class.get(), "<init>", "(JI)V");
 
-  const jobjectArray results = env->NewObjectArray(classification_result.size(),
-                                                   result_class.get(), nullptr);
+  const jobjectArray results = env->NewObjectArray(
+      classification_result.size(), cache->classification_result_class,
+      nullptr);
   for (int i = 0; i < classification_result.size(); i++) {
-    jstring row_string =
-        env->NewStringUTF(classification_result[i].collection.c_str());
-    jobject row_datetime_parse = nullptr;
+    const ScopedLocalRef<jstring> row_string(
+        env->NewStringUTF(classification_result[i].collection.c_str()), env);
+    ScopedLocalRef<jobject> row_datetime_parse(nullptr, env);
     if (classification_result[i].datetime_parse_result.IsSet()) {
-      row_datetime_parse = env->NewObject(
-          datetime_parse_class.get(), datetime_parse_class_constructor,
+      row_datetime_parse.reset(env->NewObject(
+          cache->datetime_result_class, cache->datetime_result_init,
           classification_result[i].datetime_parse_result.time_ms_utc,
-          classification_result[i].datetime_parse_result.granularity);
+          classification_result[i].datetime_parse_result.granularity));
     }
-    jobject result =
-        env->NewObject(result_class.get(), result_class_constructor, row_string,
+    const ScopedLocalRef<jobject> result(
+        env->NewObject(cache->classification_result_class,
+                       cache->classification_result_init, row_string.get(),
                        static_cast<jfloat>(classification_result[i].score),
-                       row_datetime_parse);
-    env->SetObjectArrayElement(results, i, result);
-    env->DeleteLocalRef(result);
+                       row_datetime_parse.get()),
+        env);
+    env->SetObjectArrayElement(results, i, result.get());
   }
   return results;
 }
 
-template <typename T, typename F>
-std::pair<bool, T> CallJniMethod0(JNIEnv* env, jobject object,
-                                  jclass class_object, F function,
-                                  const std::string& method_name,
-                                  const std::string& return_java_type) {
-  const jmethodID method = env->GetMethodID(class_object, method_name.c_str(),
-                                            ("()" + return_java_type).c_str());
-  if (!method) {
-    return std::make_pair(false, T());
+// Results of a batch call, see nativeAnnotateBatch for the layout.
+struct PackedResults {
+  std::vector<jint> ints;
+  std::vector<jfloat> scores;
+  std::vector<jlong> datetime_ms_utc;
+
+  void AddClassifications(
+      const TextClassifier& model,
+      const std::vector<ClassificationResult>& classifications) {
+    ints.push_back(classifications.size());
+    for (const ClassificationResult& classification : classifications) {
+      ints.push_back(model.CollectionIndex(classification.collection));
+      ints.push_back(classification.datetime_parse_result.granularity);
+      scores.push_back(classification.score);
+      datetime_ms_utc.push_back(
+          classification.datetime_parse_result.time_ms_utc);
+    }
   }
-  return std::make_pair(true, (env->*function)(object, method));
-}
+
+  void AddAnnotations(const TextClassifier& model,
+                      const std::vector<AnnotatedSpan>& annotations) {
+    ints.push_back(annotations.size());
+    for (const AnnotatedSpan& annotation : annotations) {
+      ints.push_back(annotation.span.first);
+      ints.push_back(annotation.span.second);
+      AddClassifications(model, annotation.classification);
+    }
+  }
+
+  jobjectArray ToJObjectArray(JNIEnv* env) const {
+    const JniCache* cache = GetJniCache(env);
+    if (cache == nullptr) {
+      TC_LOG(ERROR) << "Couldn't resolve the result classes.";
+      return nullptr;
+    }
+    const ScopedLocalRef<jintArray> ints_array(env->NewIntArray(ints.size()),
+                                               env);
+    const ScopedLocalRef<jfloatArray> scores_array(
+        env->NewFloatArray(scores.size()), env);
+    const ScopedLocalRef<jlongArray> datetime_array(
+        env->NewLongArray(datetime_ms_utc.size()), env);
+    if (!ints_array || !scores_array || !datetime_array) {
+      return nullptr;
+    }
+    env->SetIntArrayRegion(ints_array.get(), 0, ints.size(), ints.data());
+    env->SetFloatArrayRegion(scores_array.get(), 0, scores.size(),
+                             scores.data());
+    env->SetLongArrayRegion(datetime_array.get(), 0, datetime_ms_utc.size(),
+                            datetime_ms_utc.data());
+
+    jobjectArray result =
+        env->NewObjectArray(3, cache->object_class, nullptr);
+    if (result == nullptr) {
+      return nullptr;
+    }
+    env->SetObjectArrayElement(result, 0, ints_array.get());
+    env->SetObjectArrayElement(result, 1, scores_array.get());
+    env->SetObjectArrayElement(result, 2, datetime_array.get());
+    return result;
+  }
+};
 
 SelectionOptions FromJavaSelectionOptions(JNIEnv* env, jobject joptions) {
-  if (!joptions) {
+  const JniCache* cache = GetJniCache(env);
+  if (!joptions || cache == nullptr) {
     return {};
   }
 
-  const ScopedLocalRef<jclass> options_class(
-      env->FindClass(TC_PACKAGE_PATH TC_CLASS_NAME_STR "$SelectionOptions"),
+  const ScopedLocalRef<jstring> locales(
+      reinterpret_cast<jstring>(env->CallObjectMethod(
+          joptions, cache->selection_options_get_locales)),
       env);
-  const std::pair<bool, jobject> status_or_locales = CallJniMethod0<jobject>(
-      env, joptions, options_class.get(), &JNIEnv::CallObjectMethod,
-      "getLocales", "Ljava/lang/String;");
-  if (!status_or_locales.first) {
-    return {};
-  }
 
   SelectionOptions options;
-  options.locales =
-      ToStlString(env, reinterpret_cast<jstring>(status_or_locales.second));
-
+  options.locales = ToStlString(env, locales.get());
   return options;
 }
 
 template <typename T>
 T FromJavaOptionsInternal(JNIEnv* env, jobject joptions,
-                          const std::string& class_name) {
+                          jmethodID get_locale,
+                          jmethodID get_reference_timezone,
+                          jmethodID get_reference_time_ms_utc) {
   if (!joptions) {
     return {};
   }
 
-  const ScopedLocalRef<jclass> options_class(env->FindClass(class_name.c_str()),
-                                             env);
-  if (!options_class) {
-    return {};
-  }
-
-  const std::pair<bool, jobject> status_or_locales = CallJniMethod0<jobject>(
-      env, joptions, options_class.get(), &JNIEnv::CallObjectMethod,
-      "getLocale", "Ljava/lang/String;");
-  const std::pair<bool, jobject> status_or_reference_timezone =
-      CallJniMethod0<jobject>(env, joptions, options_class.get(),
-                              &JNIEnv::CallObjectMethod, "getReferenceTimezone",
-                              "Ljava/lang/String;");
-  const std::pair<bool, int64> status_or_reference_time_ms_utc =
-      CallJniMethod0<int64>(env, joptions, options_class.get(),
-                            &JNIEnv::CallLongMethod, "getReferenceTimeMsUtc",
-                            "J");
-
-  if (!status_or_locales.first || !status_or_reference_timezone.first ||
-      !status_or_reference_time_ms_utc.first) {
-    return {};
-  }
+  const ScopedLocalRef<jstring> locales(
+      reinterpret_cast<jstring>(env->CallObjectMethod(joptions, get_locale)),
+      env);
+  const ScopedLocalRef<jstring> reference_timezone(
+      reinterpret_cast<jstring>(
+          env->CallObjectMethod(joptions, get_reference_timezone)),
+      env);
 
   T options;
-  options.locales =
-      ToStlString(env, reinterpret_cast<jstring>(status_or_locales.second));
-  options.reference_timezone = ToStlString(
-      env, reinterpret_cast<jstring>(status_or_reference_timezone.second));
-  options.reference_time_ms_utc = status_or_reference_time_ms_utc.second;
+  options.locales = ToStlString(env, locales.get());
+  options.reference_timezone = ToStlString(env, reference_timezone.get());
+  options.reference_time_ms_utc =
+      env->CallLongMethod(joptions, get_reference_time_ms_utc);
   return options;
 }
 
 ClassificationOptions FromJavaClassificationOptions(JNIEnv* env,
                                                     jobject joptions) {
+  const JniCache* cache = GetJniCache(env);
+  if (cache == nullptr) {
+    return {};
+  }
   return FromJavaOptionsInternal<ClassificationOptions>(
-      env, joptions,
-      TC_PACKAGE_PATH TC_CLASS_NAME_STR "$ClassificationOptions");
+      env, joptions, cache->classification_options_get_locale,
+      cache->classification_options_get_reference_timezone,
+      cache->classification_options_get_reference_time_ms_utc);
 }
 
 AnnotationOptions FromJavaAnnotationOptions(JNIEnv* env, jobject joptions) {
+  const JniCache* cache = GetJniCache(env);
+  if (cache == nullptr) {
+    return {};
+  }
   return FromJavaOptionsInternal<AnnotationOptions>(
-      env, joptions, TC_PACKAGE_PATH TC_CLASS_NAME_STR "$AnnotationOptions");
+      env, joptions, cache->annotation_options_get_locale,
+      cache->annotation_options_get_reference_timezone,
+      cache->annotation_options_get_reference_time_ms_utc);
 }
 
 CodepointSpan ConvertIndicesBMPUTF8(const std::string& utf8_str,
@@ -315,15 +491,26 @@ jstring GetNameFromMmap(JNIEnv* env, libtextclassifier2::ScopedMmap* mmap) {
 }  // namespace libtextclassifier2
 
 using libtextclassifier2::ClassificationResultsToJObjectArray;
-using libtextclassifier2::ConvertIndicesBMPToUTF8;
-using libtextclassifier2::ConvertIndicesUTF8ToBMP;
 using libtextclassifier2::FromJavaAnnotationOptions;
 using libtextclassifier2::FromJavaClassificationOptions;
 using libtextclassifier2::FromJavaSelectionOptions;
+using libtextclassifier2::PackedResults;
 using libtextclassifier2::ToStlString;
 
+jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+  JNIEnv* env;
+  if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_4) != JNI_OK) {
+    return JNI_ERR;
+  }
+  // Failing to resolve the classes here is not fatal: GetJniCache() retries
+  // on first use, from a native method whose class loader sees them.
+  libtextclassifier2::GetJniCache(env);
+  return JNI_VERSION_1_4;
+}
+
 JNI_METHOD(jlong, TC_CLASS_NAME, nativeNew)
 (JNIEnv* env, jobject thiz, jint fd) {
+  libtextclassifier2::GetJniCache(env);
 #ifdef LIBTEXTCLASSIFIER_UNILIB_JAVAICU
   return reinterpret_cast<jlong>(
       TextClassifier::FromFileDescriptor(fd).release(), new UniLib(env));
@@ -335,6 +522,7 @@ JNI_METHOD(jlong, TC_CLASS_NAME, nativeNew)
 
 JNI_METHOD(jlong, TC_CLASS_NAME, nativeNewFromPath)
 (JNIEnv* env, jobject thiz, jstring path) {
+  libtextclassifier2::GetJniCache(env);
   const std::string path_str = ToStlString(env, path);
 #ifdef LIBTEXTCLASSIFIER_UNILIB_JAVAICU
   return reinterpret_cast<jlong>(
@@ -346,6 +534,7 @@ JNI_METHOD(jlong, TC_CLASS_NAME, nativeNewFromPath)
 
 JNI_METHOD(jlong, TC_CLASS_NAME, nativeNewFromAssetFileDescriptor)
 (JNIEnv* env, jobject thiz, jobject afd, jlong offset, jlong size) {
+  libtextclassifier2::GetJniCache(env);
   const jint fd = libtextclassifier2::GetFdFromAssetFileDescriptor(env, afd);
 #ifdef LIBTEXTCLASSIFIER_UNILIB_JAVAICU
   return reinterpret_cast<jlong>(
@@ -366,12 +555,11 @@ JNI_METHOD(jintArray, TC_CLASS_NAME, nativeSuggestSelection)
 
   TextClassifier* model = reinterpret_cast<TextClassifier*>(ptr);
 
-  const std::string context_utf8 = ToStlString(env, context);
-  CodepointSpan input_indices =
-      ConvertIndicesBMPToUTF8(context_utf8, {selection_begin, selection_end});
+  std::vector<uint16> context_utf16;
+  JStringToUTF16(env, context, &context_utf16);
   CodepointSpan selection = model->SuggestSelection(
-      context_utf8, input_indices, FromJavaSelectionOptions(env, options));
-  selection = ConvertIndicesUTF8ToBMP(context_utf8, selection);
+      context_utf16.data(), context_utf16.size(),
+      {selection_begin, selection_end}, FromJavaSelectionOptions(env, options));
 
   jintArray result = env->NewIntArray(2);
   env->SetIntArrayRegion(result, 0, 1, &(std::get<0>(selection)));
@@ -387,11 +575,11 @@ JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeClassifyText)
   }
   TextClassifier* ff_model = reinterpret_cast<TextClassifier*>(ptr);
 
-  const std::string context_utf8 = ToStlString(env, context);
-  const CodepointSpan input_indices =
-      ConvertIndicesBMPToUTF8(context_utf8, {selection_begin, selection_end});
+  std::vector<uint16> context_utf16;
+  JStringToUTF16(env, context, &context_utf16);
   const std::vector<ClassificationResult> classification_result =
-      ff_model->ClassifyText(context_utf8, input_indices,
+      ff_model->ClassifyText(context_utf16.data(), context_utf16.size(),
+                             {selection_begin, selection_end},
                              FromJavaClassificationOptions(env, options));
 
   return ClassificationResultsToJObjectArray(env, classification_result);
@@ -403,41 +591,129 @@ JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeAnnotate)
     return nullptr;
   }
   TextClassifier* model = reinterpret_cast<TextClassifier*>(ptr);
-  std::string context_utf8 = ToStlString(env, context);
+  std::vector<uint16> context_utf16;
+  JStringToUTF16(env, context, &context_utf16);
+  // The returned spans are already in UTF-16 code units.
   std::vector<AnnotatedSpan> annotations =
-      model->Annotate(context_utf8, FromJavaAnnotationOptions(env, options));
+      model->Annotate(context_utf16.data(), context_utf16.size(),
+                      FromJavaAnnotationOptions(env, options));
 
-  jclass result_class =
-      env->FindClass(TC_PACKAGE_PATH TC_CLASS_NAME_STR "$AnnotatedSpan");
-  if (!result_class) {
-    TC_LOG(ERROR) << "Couldn't find result class: "
-                  << TC_PACKAGE_PATH TC_CLASS_NAME_STR "$AnnotatedSpan";
+  const libtextclassifier2::JniCache* cache =
+      libtextclassifier2::GetJniCache(env);
+  if (cache == nullptr) {
+    TC_LOG(ERROR) << "Couldn't resolve the result classes.";
     return nullptr;
   }
 
-  jmethodID result_class_constructor = env->GetMethodID(
-      result_class, "<init>",
-      "(II[L" TC_PACKAGE_PATH TC_CLASS_NAME_STR "$ClassificationResult;)V");
-
-  jobjectArray results =
-      env->NewObjectArray(annotations.size(), result_class, nullptr);
+  jobjectArray results = env->NewObjectArray(
+      annotations.size(), cache->annotated_span_class, nullptr);
 
   for (int i = 0; i < annotations.size(); ++i) {
-    CodepointSpan span_bmp =
-        ConvertIndicesUTF8ToBMP(context_utf8, annotations[i].span);
-    jobject result = env->NewObject(
-        result_class, result_class_constructor,
-        static_cast<jint>(span_bmp.first), static_cast<jint>(span_bmp.second),
+    const ScopedLocalRef<jobjectArray> classification_results(
         ClassificationResultsToJObjectArray(env,
-
-                                            annotations[i].classification));
-    env->SetObjectArrayElement(results, i, result);
-    env->DeleteLocalRef(result);
+                                            annotations[i].classification),
+        env);
+    const ScopedLocalRef<jobject> result(
+        env->NewObject(cache->annotated_span_class, cache->annotated_span_init,
+                       static_cast<jint>(annotations[i].span.first),
+                       static_cast<jint>(annotations[i].span.second),
+                       classification_results.get()),
+        env);
+    env->SetObjectArrayElement(results, i, result.get());
   }
-  env->DeleteLocalRef(result_class);
   return results;
 }
 
+JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeClassifyTextBatch)
+(JNIEnv* env, jobject thiz, jlong ptr, jobjectArray contexts,
+ jintArray selection_indices, jobject options) {
+  if (!ptr) {
+    return nullptr;
+  }
+  const TextClassifier* model = reinterpret_cast<TextClassifier*>(ptr);
+  if (contexts == nullptr || selection_indices == nullptr) {
+    TC_LOG(ERROR) << "Expected contexts and selections.";
+    return nullptr;
+  }
+
+  const int num_contexts = env->GetArrayLength(contexts);
+  if (env->GetArrayLength(selection_indices) != 2 * num_contexts) {
+    TC_LOG(ERROR) << "Expected a selection for every context.";
+    return nullptr;
+  }
+  std::vector<jint> indices(2 * num_contexts);
+  env->GetIntArrayRegion(selection_indices, 0, indices.size(), indices.data());
+  const ClassificationOptions classification_options =
+      FromJavaClassificationOptions(env, options);
+
+  PackedResults packed;
+  std::vector<uint16> context_utf16;
+  for (int i = 0; i < num_contexts; ++i) {
+    const ScopedLocalRef<jstring> context(
+        reinterpret_cast<jstring>(env->GetObjectArrayElement(contexts, i)),
+        env);
+    JStringToUTF16(env, context.get(), &context_utf16);
+    packed.AddClassifications(
+        *model, model->ClassifyText(context_utf16.data(), context_utf16.size(),
+                                    {indices[2 * i], indices[2 * i + 1]},
+                                    classification_options));
+  }
+  return packed.ToJObjectArray(env);
+}
+
+JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeAnnotateBatch)
+(JNIEnv* env, jobject thiz, jlong ptr, jobjectArray contexts, jobject options) {
+  if (!ptr) {
+    return nullptr;
+  }
+  const TextClassifier* model = reinterpret_cast<TextClassifier*>(ptr);
+  if (contexts == nullptr) {
+    TC_LOG(ERROR) << "Expected contexts.";
+    return nullptr;
+  }
+  const AnnotationOptions annotation_options =
+      FromJavaAnnotationOptions(env, options);
+
+  PackedResults packed;
+  std::vector<uint16> context_utf16;
+  const int num_contexts = env->GetArrayLength(contexts);
+  for (int i = 0; i < num_contexts; ++i) {
+    const ScopedLocalRef<jstring> context(
+        reinterpret_cast<jstring>(env->GetObjectArrayElement(contexts, i)),
+        env);
+    JStringToUTF16(env, context.get(), &context_utf16);
+    packed.AddAnnotations(*model,
+                          model->Annotate(context_utf16.data(),
+                                          context_utf16.size(),
+                                          annotation_options));
+  }
+  return packed.ToJObjectArray(env);
+}
+
+JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeGetCollections)
+(JNIEnv* env, jobject thiz, jlong ptr) {
+  if (!ptr) {
+    return nullptr;
+  }
+  const TextClassifier* model = reinterpret_cast<TextClassifier*>(ptr);
+  const std::vector<std::string>& collections = model->Collections();
+
+  const libtextclassifier2::JniCache* cache =
+      libtextclassifier2::GetJniCache(env);
+  if (cache == nullptr) {
+    TC_LOG(ERROR) << "Couldn't resolve the result classes.";
+    return nullptr;
+  }
+  jobjectArray result =
+      env->NewObjectArray(collections.size(), cache->string_class, nullptr);
+  for (int i = 0; i < collections.size(); ++i) {
+    const ScopedLocalRef<jstring> collection(
+        env->NewStringUTF(collections[i].c_str()), env);
+    env->SetObjectArrayElement(result, i, collection.get());
+  }
+  return result;
+}
+
 JNI_METHOD(void, TC_CLASS_NAME, nativeClose)
 (JNIEnv* env, jobject thiz, jlong ptr) {
   TextClassifier* model = reinterpret_cast<TextClassifier*>(ptr);
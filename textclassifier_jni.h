@@ -66,6 +66,9 @@
 extern "C" {
 #endif
 
+// Resolves the Java classes and methods used by the entry points below.
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved);
+
 // SmartSelection.
 JNI_METHOD(jlong, TC_CLASS_NAME, nativeNew)
 (JNIEnv* env, jobject thiz, jint fd);
@@ -87,6 +90,30 @@ JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeClassifyText)
 JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeAnnotate)
 (JNIEnv* env, jobject thiz, jlong ptr, jstring context, jobject options);
 
+// Batch variants of nativeClassifyText and nativeAnnotate. Instead of result
+// objects they return three primitive arrays {int[] ints, float[] scores,
+// long[] datetime_ms_utc}. Classifications are stored in 'ints' as
+// (collection index into nativeGetCollections(), datetime granularity) pairs,
+// with the score and the datetime time in the other two arrays, in the same
+// order. Per context, 'ints' holds:
+// - nativeClassifyTextBatch: num_classifications, classifications.
+// - nativeAnnotateBatch: num_spans, and for every span: begin, end,
+//   num_classifications, classifications.
+// 'selection_indices' holds a (begin, end) pair for every context. All indices
+// are in UTF-16 code units. Return null if the arrays are null or their lengths
+// don't match; null contexts are treated as empty.
+JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeClassifyTextBatch)
+(JNIEnv* env, jobject thiz, jlong ptr, jobjectArray contexts,
+ jintArray selection_indices, jobject options);
+
+JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeAnnotateBatch)
+(JNIEnv* env, jobject thiz, jlong ptr, jobjectArray contexts, jobject options);
+
+// Returns the collection names that the batch results index into. The table
+// is fixed for the lifetime of the model.
+JNI_METHOD(jobjectArray, TC_CLASS_NAME, nativeGetCollections)
+(JNIEnv* env, jobject thiz, jlong ptr);
+
 JNI_METHOD(void, TC_CLASS_NAME, nativeClose)
 (JNIEnv* env, jobject thiz, jlong ptr);
 
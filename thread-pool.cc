@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace libtextclassifier2 {
+
+ThreadPool::ThreadPool(int num_threads) {
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&ThreadPool::RunTasks, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_available_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  task_available_.notify_one();
+}
+
+void ThreadPool::RunTasks() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_available_.wait(lock,
+                           [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+namespace {
+
+// The state of one ParallelFor call. It is shared with the tasks of the pool,
+// which might only start after the call has returned. Such tasks find no
+// items left and don't call 'fn'.
+struct ParallelForState {
+  std::function<void(int)> fn;
+  int num_items = 0;
+  std::atomic<int> next_item{0};
+
+  std::mutex mutex;
+  std::condition_variable all_done;
+  int num_done = 0;
+
+  void Run() {
+    for (int i = next_item++; i < num_items; i = next_item++) {
+      fn(i);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (++num_done == num_items) {
+        all_done.notify_all();
+      }
+    }
+  }
+};
+
+}  // namespace
+
+void ThreadPool::ParallelFor(int num_items,
+                             const std::function<void(int)>& fn) {
+  if (num_items <= 0) {
+    return;
+  }
+  std::shared_ptr<ParallelForState> state(new ParallelForState);
+  state->fn = fn;
+  state->num_items = num_items;
+
+  const int num_helpers = std::min(num_threads(), num_items - 1);
+  for (int i = 0; i < num_helpers; ++i) {
+    Schedule([state]() { state->Run(); });
+  }
+  state->Run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->all_done.wait(
+      lock, [&state]() { return state->num_done == state->num_items; });
+}
+
+}  // namespace libtextclassifier2
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Fixed set of worker threads for splitting the work of one request.
+
+#ifndef LIBTEXTCLASSIFIER_THREAD_POOL_H_
+#define LIBTEXTCLASSIFIER_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+// Runs tasks on a fixed number of threads. Thread-safe.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+
+  // Runs the tasks that are still queued and joins the threads.
+  ~ThreadPool();
+
+  // Queues the task to run on one of the threads.
+  void Schedule(std::function<void()> task);
+
+  // Calls fn(i) for every i in [0, num_items), on the calling thread and on up
+  // to num_threads() threads of the pool, and returns when all calls have
+  // finished. The items are handed out in increasing order. Doesn't wait for
+  // the threads of the pool if the calling thread has done all the work, so
+  // that a busy pool doesn't delay the caller.
+  //
+  // NOTE: Must not be called from a thread of the pool.
+  void ParallelFor(int num_items, const std::function<void(int)>& fn);
+
+  int num_threads() const { return threads_.size(); }
+
+ private:
+  void RunTasks();
+
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+
+  std::vector<std::thread> threads_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_THREAD_POOL_H_
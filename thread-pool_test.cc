@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "thread-pool.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+TEST(ThreadPoolTest, RunsScheduledTasks) {
+  std::atomic<int> num_runs(0);
+  {
+    ThreadPool pool(/*num_threads=*/3);
+    EXPECT_EQ(pool.num_threads(), 3);
+    for (int i = 0; i < 100; ++i) {
+      pool.Schedule([&num_runs]() { ++num_runs; });
+    }
+  }
+  // The destructor runs the queued tasks.
+  EXPECT_EQ(num_runs, 100);
+}
+
+TEST(ThreadPoolTest, ParallelForCallsEveryItemOnce) {
+  ThreadPool pool(/*num_threads=*/4);
+  for (const int num_items : {0, 1, 2, 7, 1000}) {
+    std::vector<std::atomic<int>> calls(num_items);
+    for (std::atomic<int>& num_calls : calls) {
+      num_calls = 0;
+    }
+    pool.ParallelFor(num_items, [&calls](int i) { ++calls[i]; });
+    for (int i = 0; i < num_items; ++i) {
+      EXPECT_EQ(calls[i], 1) << i;
+    }
+  }
+}
+
+TEST(ThreadPoolTest, ParallelForFromSeveralThreads) {
+  ThreadPool pool(/*num_threads=*/2);
+  std::atomic<int> total(0);
+  std::vector<std::thread> callers;
+  for (int i = 0; i < 4; ++i) {
+    callers.emplace_back([&pool, &total]() {
+      for (int j = 0; j < 10; ++j) {
+        pool.ParallelFor(50, [&total](int item) { total += item; });
+      }
+    });
+  }
+  for (std::thread& caller : callers) {
+    caller.join();
+  }
+  EXPECT_EQ(total, 4 * 10 * (49 * 50 / 2));
+}
+
+TEST(ThreadPoolTest, ParallelForWithoutThreads) {
+  ThreadPool pool(/*num_threads=*/0);
+  std::vector<int> order;
+  pool.ParallelFor(5, [&order](int i) { order.push_back(i); });
+  EXPECT_THAT(order, testing::ElementsAre(0, 1, 2, 3, 4));
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
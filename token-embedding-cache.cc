@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "token-embedding-cache.h"
+
+#include <algorithm>
+
+namespace libtextclassifier2 {
+
+TokenEmbeddingCache::TokenEmbeddingCache(int capacity, int embedding_size,
+                                         int num_shards)
+    : embedding_size_(embedding_size),
+      num_shards_(std::max(1, num_shards)),
+      shard_capacity_(std::max(1, (capacity + num_shards_ - 1) / num_shards_)),
+      shards_(num_shards_) {
+  for (Shard& shard : shards_) {
+    shard.slot_for_key.reserve(shard_capacity_);
+    shard.keys.reserve(shard_capacity_);
+    shard.referenced.reserve(shard_capacity_);
+    shard.embeddings.reserve(shard_capacity_ * embedding_size_);
+  }
+}
+
+bool TokenEmbeddingCache::Lookup(uint64 key, float* embedding) {
+  Shard* shard = ShardForKey(key);
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  const auto it = shard->slot_for_key.find(key);
+  if (it == shard->slot_for_key.end()) {
+    ++shard->stats.misses;
+    return false;
+  }
+  ++shard->stats.hits;
+  shard->referenced[it->second] = true;
+  const float* cached = shard->embeddings.data() + it->second * embedding_size_;
+  std::copy(cached, cached + embedding_size_, embedding);
+  return true;
+}
+
+void TokenEmbeddingCache::Insert(uint64 key, const float* embedding) {
+  Shard* shard = ShardForKey(key);
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  if (shard->slot_for_key.count(key)) {
+    // Another thread inserted it in the meantime.
+    return;
+  }
+
+  int slot;
+  if (static_cast<int>(shard->keys.size()) < shard_capacity_) {
+    slot = shard->keys.size();
+    shard->keys.push_back(key);
+    shard->referenced.push_back(false);
+    shard->embeddings.resize(shard->embeddings.size() + embedding_size_);
+  } else {
+    // Give every referenced entry a second chance, and evict the first one
+    // that hasn't been used since the hand last passed it.
+    while (shard->referenced[shard->clock_hand]) {
+      shard->referenced[shard->clock_hand] = false;
+      shard->clock_hand = (shard->clock_hand + 1) % shard_capacity_;
+    }
+    slot = shard->clock_hand;
+    shard->clock_hand = (shard->clock_hand + 1) % shard_capacity_;
+    shard->slot_for_key.erase(shard->keys[slot]);
+    shard->keys[slot] = key;
+    ++shard->stats.evictions;
+  }
+  shard->slot_for_key[key] = slot;
+  std::copy(embedding, embedding + embedding_size_,
+            shard->embeddings.data() + slot * embedding_size_);
+}
+
+TokenEmbeddingCache::Stats TokenEmbeddingCache::GetStats() const {
+  Stats result;
+  for (const Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    result.hits += shard.stats.hits;
+    result.misses += shard.stats.misses;
+    result.evictions += shard.stats.evictions;
+    result.size += shard.keys.size();
+  }
+  return result;
+}
+
+}  // namespace libtextclassifier2
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cache of token embeddings that is shared across requests.
+
+#ifndef LIBTEXTCLASSIFIER_TOKEN_EMBEDDING_CACHE_H_
+#define LIBTEXTCLASSIFIER_TOKEN_EMBEDDING_CACHE_H_
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "util/base/integral_types.h"
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+// A bounded, thread-safe cache from token keys (fingerprints of the token
+// text) to their embeddings. Unlike FeatureProcessor::EmbeddingCache, which is
+// keyed by position and lives for one call, it is meant to live as long as the
+// model, so that frequent tokens are embedded only once.
+//
+// The entries are split into shards with separate locks, and evicted with the
+// clock (second chance) algorithm, which approximates LRU without having to
+// reorder entries on every hit.
+class TokenEmbeddingCache {
+ public:
+  struct Stats {
+    int64 hits = 0;
+    int64 misses = 0;
+    int64 evictions = 0;
+    int size = 0;
+  };
+
+  // Holds at most 'capacity' embeddings of 'embedding_size' floats each, in
+  // 'num_shards' shards, at least one.
+  TokenEmbeddingCache(int capacity, int embedding_size, int num_shards = 16);
+
+  // Copies the embedding for 'key' to 'embedding', which must have room for
+  // embedding_size() floats. Returns false if the key is not in the cache.
+  bool Lookup(uint64 key, float* embedding);
+
+  // Adds the embedding for 'key', evicting another entry if the cache is full.
+  void Insert(uint64 key, const float* embedding);
+
+  Stats GetStats() const;
+
+  int embedding_size() const { return embedding_size_; }
+
+ private:
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<uint64, int> slot_for_key;
+    std::vector<uint64> keys;
+    std::vector<bool> referenced;
+    std::vector<float> embeddings;
+    int clock_hand = 0;
+    Stats stats;
+  };
+
+  Shard* ShardForKey(uint64 key) {
+    return &shards_[(key >> 32) % shards_.size()];
+  }
+
+  const int embedding_size_;
+  const int num_shards_;
+  const int shard_capacity_;
+  std::vector<Shard> shards_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(TokenEmbeddingCache);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOKEN_EMBEDDING_CACHE_H_
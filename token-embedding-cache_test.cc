@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "token-embedding-cache.h"
+
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+using testing::ElementsAre;
+
+TEST(TokenEmbeddingCacheTest, LookupAndInsert) {
+  TokenEmbeddingCache cache(/*capacity=*/4, /*embedding_size=*/2,
+                            /*num_shards=*/1);
+  std::vector<float> embedding(2);
+  EXPECT_FALSE(cache.Lookup(1, embedding.data()));
+
+  const std::vector<float> value = {1.0, -1.0};
+  cache.Insert(1, value.data());
+  ASSERT_TRUE(cache.Lookup(1, embedding.data()));
+  EXPECT_THAT(embedding, ElementsAre(1.0, -1.0));
+
+  const TokenEmbeddingCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_EQ(stats.size, 1);
+}
+
+TEST(TokenEmbeddingCacheTest, EvictsEntriesNotUsedRecently) {
+  TokenEmbeddingCache cache(/*capacity=*/2, /*embedding_size=*/1,
+                            /*num_shards=*/1);
+  std::vector<float> embedding(1);
+  const float one = 1.0, two = 2.0, three = 3.0;
+  cache.Insert(1, &one);
+  cache.Insert(2, &two);
+
+  // Key 1 is used, so key 2 is the one evicted when key 3 is added.
+  EXPECT_TRUE(cache.Lookup(1, embedding.data()));
+  cache.Insert(3, &three);
+  EXPECT_TRUE(cache.Lookup(1, embedding.data()));
+  EXPECT_FALSE(cache.Lookup(2, embedding.data()));
+  ASSERT_TRUE(cache.Lookup(3, embedding.data()));
+  EXPECT_EQ(embedding[0], 3.0);
+
+  const TokenEmbeddingCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_EQ(stats.size, 2);
+}
+
+TEST(TokenEmbeddingCacheTest, UsesOneShardForInvalidShardCounts) {
+  for (const int num_shards : {0, -3}) {
+    TokenEmbeddingCache cache(/*capacity=*/2, /*embedding_size=*/1,
+                              num_shards);
+    const float one = 1.0, two = 2.0, three = 3.0;
+    cache.Insert(1, &one);
+    cache.Insert(2, &two);
+    cache.Insert(3, &three);
+
+    // All keys go to the one shard, which holds the whole capacity.
+    const TokenEmbeddingCache::Stats stats = cache.GetStats();
+    EXPECT_EQ(stats.evictions, 1);
+    EXPECT_EQ(stats.size, 2);
+  }
+}
+
+TEST(TokenEmbeddingCacheTest, ConcurrentAccess) {
+  TokenEmbeddingCache cache(/*capacity=*/64, /*embedding_size=*/4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache]() {
+      std::vector<float> embedding(4);
+      for (int i = 0; i < 1000; ++i) {
+        const float value = i % 100;
+        const uint64 key = static_cast<uint64>(i % 100) << 32 | i % 100;
+        if (cache.Lookup(key, embedding.data())) {
+          EXPECT_THAT(embedding, ElementsAre(value, value, value, value));
+        } else {
+          const std::vector<float> values(4, value);
+          cache.Insert(key, values.data());
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const TokenEmbeddingCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(stats.hits + stats.misses, 4000);
+  EXPECT_LE(stats.size, 64);
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
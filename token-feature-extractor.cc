@@ -16,11 +16,13 @@
 
 #include "token-feature-extractor.h"
 
+#include <algorithm>
 #include <cctype>
 #include <string>
 
 #include "util/base/logging.h"
 #include "util/hash/farmhash.h"
+#include "util/hash/short-fingerprint.h"
 #include "util/strings/stringpiece.h"
 #include "util/utf8/unicodetext.h"
 
@@ -67,11 +69,30 @@ void RemapTokenUnicode(const std::string& token,
   }
 }
 
+// Padding and out-of-vocabulary tokens have extra buckets reserved because
+// they are special and important tokens, and we don't want them to share
+// embedding with other charactergrams.
+// TODO(zilka): Experimentally verify.
+const int kNumExtraBuckets = 2;
+
+// Returns the number of buckets that charactergrams are hashed to.
+int NumHashedBuckets(const TokenFeatureExtractorOptions& options) {
+  const int num_hashed_buckets =
+      options.allowed_chargrams.empty()
+          ? options.num_buckets
+          : options.num_buckets - kNumExtraBuckets;
+  // The number of buckets is not checked, and can be 0 in options that don't
+  // use charactergrams.
+  return std::max(num_hashed_buckets, 1);
+}
+
 }  // namespace
 
 TokenFeatureExtractor::TokenFeatureExtractor(
     const TokenFeatureExtractorOptions& options, const UniLib& unilib)
-    : options_(options), unilib_(unilib) {
+    : options_(options),
+      bucket_modulo_(NumHashedBuckets(options)),
+      unilib_(unilib) {
   for (const std::string& pattern : options.regexp_features) {
     regex_patterns_.push_back(std::unique_ptr<UniLib::RegexPattern>(
         unilib_.CreateRegexPattern(UTF8ToUnicodeText(
@@ -103,37 +124,32 @@ std::vector<int> TokenFeatureExtractor::ExtractCharactergramFeatures(
 
 std::vector<float> TokenFeatureExtractor::ExtractDenseFeatures(
     const Token& token, bool is_in_span) const {
-  std::vector<float> dense_features;
+  std::vector<float> dense_features(DenseFeaturesCount());
+  ExtractDenseFeatures(token, is_in_span, dense_features.data());
+  return dense_features;
+}
 
+void TokenFeatureExtractor::ExtractDenseFeatures(const Token& token,
+                                                 bool is_in_span,
+                                                 float* dense_features) const {
+  int index = 0;
   if (options_.extract_case_feature) {
-    if (options_.unicode_aware_features) {
-      UnicodeText token_unicode =
-          UTF8ToUnicodeText(token.value, /*do_copy=*/false);
-      const bool is_upper = unilib_.IsUpper(*token_unicode.begin());
-      if (!token.value.empty() && is_upper) {
-        dense_features.push_back(1.0);
-      } else {
-        dense_features.push_back(-1.0);
-      }
-    } else {
-      if (!token.value.empty() && isupper(*token.value.begin())) {
-        dense_features.push_back(1.0);
+    bool is_upper = false;
+    if (!token.value.empty()) {
+      if (options_.unicode_aware_features) {
+        UnicodeText token_unicode =
+            UTF8ToUnicodeText(token.value, /*do_copy=*/false);
+        is_upper = unilib_.IsUpper(*token_unicode.begin());
       } else {
-        dense_features.push_back(-1.0);
+        is_upper = isupper(*token.value.begin());
       }
     }
+    dense_features[index++] = is_upper ? 1.0 : -1.0;
   }
 
   if (options_.extract_selection_mask_feature) {
-    if (is_in_span) {
-      dense_features.push_back(1.0);
-    } else {
-      if (options_.unicode_aware_features) {
-        dense_features.push_back(-1.0);
-      } else {
-        dense_features.push_back(0.0);
-      }
-    }
+    SetSelectionMaskFeature(is_in_span, dense_features);
+    ++index;
   }
 
   // Add regexp features.
@@ -142,31 +158,41 @@ std::vector<float> TokenFeatureExtractor::ExtractDenseFeatures(
         UTF8ToUnicodeText(token.value, /*do_copy=*/false);
     for (int i = 0; i < regex_patterns_.size(); ++i) {
       if (!regex_patterns_[i].get()) {
-        dense_features.push_back(-1.0);
+        dense_features[index++] = -1.0;
         continue;
       }
       auto matcher = regex_patterns_[i]->Matcher(token_unicode);
       int status;
-      if (matcher->Matches(&status)) {
-        dense_features.push_back(1.0);
-      } else {
-        dense_features.push_back(-1.0);
-      }
+      dense_features[index++] = matcher->Matches(&status) ? 1.0 : -1.0;
     }
   }
+}
 
-  return dense_features;
+void TokenFeatureExtractor::SetSelectionMaskFeature(
+    bool is_in_span, float* dense_features) const {
+  if (!options_.extract_selection_mask_feature) {
+    return;
+  }
+  // The selection mask feature follows the case feature, if any.
+  float* feature = dense_features + options_.extract_case_feature;
+  if (is_in_span) {
+    *feature = 1.0;
+  } else if (options_.unicode_aware_features) {
+    *feature = -1.0;
+  } else {
+    *feature = 0.0;
+  }
 }
 
 int TokenFeatureExtractor::HashToken(StringPiece token) const {
+  const auto fingerprint = [&token]() -> uint64 {
+    return token.size() <= kMaxShortFingerprintSize
+               ? ShortFingerprint64(token.data(), token.size())
+               : tc2farmhash::Fingerprint64(token);
+  };
   if (options_.allowed_chargrams.empty()) {
-    return tc2farmhash::Fingerprint64(token) % options_.num_buckets;
+    return bucket_modulo_.Mod(fingerprint());
   } else {
-    // Padding and out-of-vocabulary tokens have extra buckets reserved because
-    // they are special and important tokens, and we don't want them to share
-    // embedding with other charactergrams.
-    // TODO(zilka): Experimentally verify.
-    const int kNumExtraBuckets = 2;
     const std::string token_string = token.ToString();
     if (token_string == "<PAD>") {
       return 1;
@@ -174,9 +200,31 @@ int TokenFeatureExtractor::HashToken(StringPiece token) const {
                options_.allowed_chargrams.end()) {
       return 0;  // Out-of-vocabulary.
     } else {
-      return (tc2farmhash::Fingerprint64(token) %
-              (options_.num_buckets - kNumExtraBuckets)) +
-             kNumExtraBuckets;
+      return bucket_modulo_.Mod(fingerprint()) + kNumExtraBuckets;
+    }
+  }
+}
+
+void TokenFeatureExtractor::AppendCharactergramBuckets(
+    StringPiece word, int order, std::vector<int>* buckets) const {
+  const int num_chargrams = static_cast<int>(word.size()) - order + 1;
+  if (!options_.allowed_chargrams.empty() || order < 1 ||
+      order > kMaxShortFingerprintSize) {
+    for (int i = 0; i < num_chargrams; ++i) {
+      buckets->push_back(HashToken(StringPiece(word.data() + i, order)));
+    }
+    return;
+  }
+
+  // Hashes the charactergrams in chunks that fit on the stack.
+  const int kChunkSize = 64;
+  uint64 fingerprints[kChunkSize];
+  for (int start = 0; start < num_chargrams; start += kChunkSize) {
+    const int chunk_size = std::min(kChunkSize, num_chargrams - start);
+    ShortFingerprint64Windows(word.data() + start, chunk_size + order - 1,
+                              order, fingerprints);
+    for (int i = 0; i < chunk_size; ++i) {
+      buckets->push_back(bucket_modulo_.Mod(fingerprints[i]));
     }
   }
 }
@@ -211,17 +259,12 @@ std::vector<int> TokenFeatureExtractor::ExtractCharactergramFeaturesAscii(
       // Generate the character-grams.
       for (int chargram_order : options_.chargram_orders) {
         if (chargram_order == 1) {
-          for (int i = 1; i < feature_word.size() - 1; ++i) {
-            result.push_back(
-                HashToken(StringPiece(feature_word, /*offset=*/i, /*len=*/1)));
-          }
+          AppendCharactergramBuckets(
+              StringPiece(feature_word, /*offset=*/1,
+                          /*len=*/feature_word.size() - 2),
+              /*order=*/1, &result);
         } else {
-          for (int i = 0;
-               i < static_cast<int>(feature_word.size()) - chargram_order + 1;
-               ++i) {
-            result.push_back(HashToken(StringPiece(feature_word, /*offset=*/i,
-                                                   /*len=*/chargram_order)));
-          }
+          AppendCharactergramBuckets(feature_word, chargram_order, &result);
         }
       }
     }
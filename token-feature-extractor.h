@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "types.h"
+#include "util/math/fastmod.h"
 #include "util/strings/stringpiece.h"
 #include "util/utf8/unilib.h"
 
@@ -85,6 +86,17 @@ class TokenFeatureExtractor {
   std::vector<float> ExtractDenseFeatures(const Token& token,
                                           bool is_in_span) const;
 
+  // Same as above, but writes the DenseFeaturesCount() features directly to
+  // dense_features.
+  void ExtractDenseFeatures(const Token& token, bool is_in_span,
+                            float* dense_features) const;
+
+  // Overwrites the selection mask feature, if it is extracted, in features
+  // written by ExtractDenseFeatures. All the other dense features depend only
+  // on the token value, so they can be cached and reused for a different
+  // is_in_span.
+  void SetSelectionMaskFeature(bool is_in_span, float* dense_features) const;
+
   int DenseFeaturesCount() const {
     int feature_count =
         options_.extract_case_feature + options_.extract_selection_mask_feature;
@@ -96,6 +108,10 @@ class TokenFeatureExtractor {
   // Hashes given token to given number of buckets.
   int HashToken(StringPiece token) const;
 
+  // Appends the buckets of all charactergrams of given order in the word.
+  void AppendCharactergramBuckets(StringPiece word, int order,
+                                  std::vector<int>* buckets) const;
+
   // Extracts the charactergram features from the token in a non-unicode-aware
   // way.
   std::vector<int> ExtractCharactergramFeaturesAscii(const Token& token) const;
@@ -106,6 +122,10 @@ class TokenFeatureExtractor {
 
  private:
   TokenFeatureExtractorOptions options_;
+
+  // The remainder by the number of hashed buckets.
+  FastModulo bucket_modulo_;
+
   std::vector<std::unique_ptr<UniLib::RegexPattern>> regex_patterns_;
   const UniLib& unilib_;
 };
@@ -16,6 +16,7 @@
 
 #include "token-feature-extractor.h"
 
+#include "util/hash/farmhash.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -398,6 +399,35 @@ TEST(TokenFeatureExtractorTest, RegexFeatures) {
 }
 #endif
 
+#ifdef LIBTEXTCLASSIFIER_TEST_ICU
+TEST(TokenFeatureExtractorTest, SetSelectionMaskFeature) {
+  TokenFeatureExtractorOptions options;
+  options.num_buckets = 1000;
+  options.chargram_orders = std::vector<int>{1, 2};
+  options.extract_case_feature = true;
+  options.extract_selection_mask_feature = true;
+  options.unicode_aware_features = false;
+  options.regexp_features.push_back("^[a-z]+$");  // all lower case.
+  CREATE_UNILIB_FOR_TESTING
+  TestingTokenFeatureExtractor extractor(options, unilib);
+  ASSERT_EQ(extractor.DenseFeaturesCount(), 3);
+
+  float dense_features[3];
+  extractor.ExtractDenseFeatures(Token{"abcde", 0, 5}, /*is_in_span=*/true,
+                                 dense_features);
+  EXPECT_THAT(dense_features, testing::ElementsAreArray({-1.0, 1.0, 1.0}));
+  EXPECT_THAT(dense_features,
+              testing::ElementsAreArray(extractor.ExtractDenseFeatures(
+                  Token{"abcde", 0, 5}, /*is_in_span=*/true)));
+
+  // Only the selection mask feature changes.
+  extractor.SetSelectionMaskFeature(/*is_in_span=*/false, dense_features);
+  EXPECT_THAT(dense_features,
+              testing::ElementsAreArray(extractor.ExtractDenseFeatures(
+                  Token{"abcde", 0, 5}, /*is_in_span=*/false)));
+}
+#endif
+
 TEST(TokenFeatureExtractorTest, ExtractTooLongWord) {
   TokenFeatureExtractorOptions options;
   options.num_buckets = 1000;
@@ -560,5 +590,38 @@ TEST(TokenFeatureExtractorTest, ExtractFiltered) {
   EXPECT_EQ(extractor.HashToken("<PAD>"), 1);
 }
 
+TEST(TokenFeatureExtractorTest, BucketsMatchFingerprint64) {
+  TokenFeatureExtractorOptions options;
+  options.num_buckets = 1234567;
+  options.chargram_orders = std::vector<int>{1, 2, 5, 8, 16, 17};
+  options.max_word_length = 200;
+  options.unicode_aware_features = false;
+  CREATE_UNILIB_FOR_TESTING
+  TestingTokenFeatureExtractor extractor(options, unilib);
+
+  // Longer than the chunks of the charactergram hashing.
+  std::string word;
+  for (int i = 0; i < 150; ++i) {
+    word.push_back(static_cast<char>(32 + (i * 37) % 95));
+  }
+  const std::string feature_word = "^" + word + "$";
+  std::vector<int> expected_features;
+  for (const int order : options.chargram_orders) {
+    const int start = order == 1 ? 1 : 0;
+    const int end = order == 1 ? feature_word.size() - 1 : feature_word.size();
+    for (int i = start; i + order <= end; ++i) {
+      expected_features.push_back(
+          tc2farmhash::Fingerprint64(feature_word.data() + i, order) %
+          options.num_buckets);
+    }
+  }
+
+  std::vector<int> sparse_features;
+  std::vector<float> dense_features;
+  extractor.Extract(Token{word, 0, 150}, false, &sparse_features,
+                    &dense_features);
+  EXPECT_EQ(sparse_features, expected_features);
+}
+
 }  // namespace
 }  // namespace libtextclassifier2
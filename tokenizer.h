@@ -34,9 +34,11 @@ const int kUnknownScript = -2;
 // configuration.
 class Tokenizer {
  public:
+  // If 'ranges_sorted' is true, 'codepoint_ranges' are known to be sorted by
+  // start, e.g. because the model says so, and are not checked.
   explicit Tokenizer(
       const std::vector<const TokenizationCodepointRange*>& codepoint_ranges,
-      bool split_on_script_change);
+      bool split_on_script_change, bool ranges_sorted = false);
 
   // Tokenizes the input string using the selected tokenization method.
   std::vector<Token> Tokenize(const std::string& text) const;
@@ -47,7 +49,7 @@ class Tokenizer {
  protected:
   // Finds the tokenization codepoint range config for given codepoint.
   // Internally uses binary search so should be O(log(# of codepoint_ranges)).
-  const TokenizationCodepointRangeT* FindTokenizationRange(int codepoint) const;
+  const TokenizationCodepointRange* FindTokenizationRange(int codepoint) const;
 
   // Finds the role and script for given codepoint. If not found, DEFAULT_ROLE
   // and kUnknownScript are assigned.
@@ -57,9 +59,9 @@ class Tokenizer {
 
  private:
   // Codepoint ranges that determine how different codepoints are tokenized.
-  // The ranges must not overlap.
-  std::vector<std::unique_ptr<const TokenizationCodepointRangeT>>
-      codepoint_ranges_;
+  // The ranges must not overlap. They point into the model, which must outlive
+  // the tokenizer, and are sorted by start.
+  std::vector<const TokenizationCodepointRange*> codepoint_ranges_;
 
   // If true, tokens will be additionally split when the codepoint's script_id
   // changes.
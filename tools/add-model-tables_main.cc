@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Writes a copy of a model with the lookup tables that are otherwise built
+// when the model is loaded, see tools/model-tables.h.
+//
+// Usage:
+//   textclassifier_add_model_tables --model=<path> --output=<path>
+//
+// Must run after any other tool that changes the datetime rules, e.g.
+// textclassifier_slim_model, which updates tables that are present itself.
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "tools/model-tables.h"
+#include "util/base/logging.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+struct Flags {
+  std::string model;
+  std::string output;
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: textclassifier_add_model_tables --model=<path> "
+          "--output=<path>\n");
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      TC_LOG(ERROR) << "Malformed argument: " << arg;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    if (name == "model") {
+      flags->model = value;
+    } else if (name == "output") {
+      flags->output = value;
+    } else {
+      TC_LOG(ERROR) << "Unknown flag: " << name;
+      return false;
+    }
+  }
+  return !flags->model.empty() && !flags->output.empty();
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::ifstream input(flags.model, std::ios::binary);
+  if (!input) {
+    TC_LOG(ERROR) << "Could not open model: " << flags.model;
+    return 1;
+  }
+  const std::string model_buffer((std::istreambuf_iterator<char>(input)), {});
+  flatbuffers::Verifier verifier(
+      reinterpret_cast<const uint8_t*>(model_buffer.data()),
+      model_buffer.size());
+  if (!VerifyModelBuffer(verifier)) {
+    TC_LOG(ERROR) << "Invalid model: " << flags.model;
+    return 1;
+  }
+
+  std::unique_ptr<ModelT> model = UnPackModel(model_buffer.data());
+  AddPrecomputedTables(model.get());
+  flatbuffers::FlatBufferBuilder builder;
+  FinishModelBuffer(builder, Model::Pack(builder, model.get()));
+
+  std::ofstream output(flags.output, std::ios::binary);
+  output.write(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+               builder.GetSize());
+  if (!output) {
+    TC_LOG(ERROR) << "Could not write model: " << flags.output;
+    return 1;
+  }
+  printf("size: %zu -> %u bytes\n", model_buffer.size(), builder.GetSize());
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
+
+int main(int argc, char** argv) { return libtextclassifier2::Run(argc, argv); }
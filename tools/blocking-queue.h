@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_BLOCKING_QUEUE_H_
+#define LIBTEXTCLASSIFIER_TOOLS_BLOCKING_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+// Bounded multi-producer multi-consumer FIFO queue. Push() blocks while the
+// queue is full, Pop() blocks while it is empty. After Close(), Push() and
+// TryPush() fail and Pop() drains the remaining items and then fails.
+template <typename T>
+class BlockingQueue {
+ public:
+  explicit BlockingQueue(int capacity) : capacity_(capacity), closed_(false) {}
+
+  // Returns false if the queue was closed.
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] {
+      return closed_ || static_cast<int>(items_.size()) < capacity_;
+    });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Like Push(), but returns false instead of waiting if the queue is full.
+  // 'item' is only moved from if it was pushed.
+  bool TryPush(T* item) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || static_cast<int>(items_.size()) >= capacity_) {
+      return false;
+    }
+    items_.push_back(std::move(*item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Returns false if the queue was closed and is empty.
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return false;
+    }
+    *item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Waits for at least one item and then pops up to 'max_items' items without
+  // further waiting. Returns false if the queue was closed and is empty.
+  bool PopAvailable(int max_items, std::vector<T>* items) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return false;
+    }
+    while (!items_.empty() && static_cast<int>(items->size()) < max_items) {
+      items->push_back(std::move(items_.front()));
+      items_.pop_front();
+    }
+    not_full_.notify_all();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+ private:
+  const int capacity_;
+  bool closed_;
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(BlockingQueue);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_BLOCKING_QUEUE_H_
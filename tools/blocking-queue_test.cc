@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/blocking-queue.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+TEST(BlockingQueueTest, FifoAndClose) {
+  BlockingQueue<int> queue(2);
+  EXPECT_TRUE(queue.Push(1));
+  EXPECT_TRUE(queue.Push(2));
+  queue.Close();
+  EXPECT_FALSE(queue.Push(3));
+
+  int value;
+  EXPECT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_FALSE(queue.Pop(&value));
+}
+
+TEST(BlockingQueueTest, TryPushDoesNotWait) {
+  BlockingQueue<std::string> queue(1);
+  std::string first = "first";
+  EXPECT_TRUE(queue.TryPush(&first));
+
+  // The queue is full, and the item stays with the caller.
+  std::string second = "second";
+  EXPECT_FALSE(queue.TryPush(&second));
+  EXPECT_EQ(second, "second");
+
+  std::string value;
+  EXPECT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(value, "first");
+  EXPECT_TRUE(queue.TryPush(&second));
+  queue.Close();
+  std::string third = "third";
+  EXPECT_FALSE(queue.TryPush(&third));
+}
+
+TEST(BlockingQueueTest, ProducersAndConsumers) {
+  BlockingQueue<int> queue(4);
+  const int kNumProducers = 4;
+  const int kItemsPerProducer = 1000;
+
+  std::vector<std::thread> producers;
+  for (int i = 0; i < kNumProducers; ++i) {
+    producers.emplace_back([&queue] {
+      for (int j = 1; j <= kItemsPerProducer; ++j) {
+        queue.Push(j);
+      }
+    });
+  }
+
+  std::vector<long> sums(2, 0);
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < sums.size(); ++i) {
+    consumers.emplace_back([&queue, &sums, i] {
+      int value;
+      while (queue.Pop(&value)) {
+        sums[i] += value;
+      }
+    });
+  }
+
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  queue.Close();
+  for (std::thread& consumer : consumers) {
+    consumer.join();
+  }
+  EXPECT_EQ(sums[0] + sums[1],
+            kNumProducers * kItemsPerProducer * (kItemsPerProducer + 1) / 2);
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Annotates a stream of JSONL documents with a pool of worker threads sharing
+// one mmapped model.
+//
+// Usage:
+//   textclassifier_bulk_annotator --model=<path> [--input=-] [--output=-]
+//       [--threads=<cores>] [--start_line=0] [--ordered=true]
+//       [--max_in_flight=<64 * threads>] [--locales=] [--reference_timezone=]
+//       [--reference_time_ms_utc=0]
+//
+// Every input line is a JSON object:
+//   {"context": "...", "locales": "en", "reference_time_ms_utc": 0,
+//    "reference_timezone": "Europe/Zurich", "id": "..."}
+// Only "context" is required; missing options fall back to the flags.
+//
+// Every output line carries the 0-based input line index:
+//   {"index": 7, "id": "...", "annotations": [{"span": [11, 29],
+//    "classification": [{"collection": "date", "score": 1,
+//    "datetime": {"time_ms_utc": 1514761200000, "granularity": "day"}}]}]}
+// Spans are in Unicode codepoints. Lines that cannot be parsed produce an
+// object with an "error" member instead of "annotations", so the output always
+// has one line per input line.
+//
+// With --ordered=true (the default) the output is in input order, so an
+// interrupted job can be resumed with --start_line=<number of output lines
+// already written>. With --ordered=false lines are written as soon as they are
+// done, and the "index" member has to be used to restore the order.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "text-classifier.h"
+#include "tools/blocking-queue.h"
+#include "tools/json.h"
+#include "util/strings/numbers.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+struct Flags {
+  std::string model;
+  std::string input = "-";
+  std::string output = "-";
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  int64 start_line = 0;
+  bool ordered = true;
+  int max_in_flight = 0;
+  AnnotationOptions default_options;
+};
+
+struct Document {
+  int64 index;
+  std::string line;
+};
+
+struct Result {
+  int64 index;
+  std::string json;
+};
+
+// Limits the number of documents that were read but whose output was not
+// written yet. This bounds both the input queue and the reordering buffer.
+class InFlightLimiter {
+ public:
+  explicit InFlightLimiter(int limit) : limit_(limit), in_flight_(0) {}
+
+  void Acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [this] { return in_flight_ < limit_; });
+    ++in_flight_;
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+    released_.notify_one();
+  }
+
+ private:
+  const int limit_;
+  int in_flight_;
+  std::mutex mutex_;
+  std::condition_variable released_;
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: textclassifier_bulk_annotator --model=<path> [--input=-] "
+          "[--output=-] [--threads=N] [--start_line=N] [--ordered=true|false] "
+          "[--max_in_flight=N] [--locales=L] [--reference_timezone=TZ] "
+          "[--reference_time_ms_utc=MS]\n");
+}
+
+bool ParseBool(const std::string& value, bool* result) {
+  if (value == "true" || value == "1") {
+    *result = true;
+  } else if (value == "false" || value == "0") {
+    *result = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      TC_LOG(ERROR) << "Malformed argument: " << arg;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    int32 int_value = 0;
+    bool ok = true;
+    if (name == "model") {
+      flags->model = value;
+    } else if (name == "input") {
+      flags->input = value;
+    } else if (name == "output") {
+      flags->output = value;
+    } else if (name == "threads") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value > 0;
+      flags->threads = int_value;
+    } else if (name == "start_line") {
+      ok = ParseInt64(value.c_str(), &flags->start_line) &&
+           flags->start_line >= 0;
+    } else if (name == "ordered") {
+      ok = ParseBool(value, &flags->ordered);
+    } else if (name == "max_in_flight") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value > 0;
+      flags->max_in_flight = int_value;
+    } else if (name == "locales") {
+      flags->default_options.locales = value;
+    } else if (name == "reference_timezone") {
+      flags->default_options.reference_timezone = value;
+    } else if (name == "reference_time_ms_utc") {
+      ok = ParseInt64(value.c_str(),
+                      &flags->default_options.reference_time_ms_utc);
+    } else {
+      TC_LOG(ERROR) << "Unknown flag: " << name;
+      return false;
+    }
+    if (!ok) {
+      TC_LOG(ERROR) << "Invalid value for --" << name << ": " << value;
+      return false;
+    }
+  }
+  if (flags->max_in_flight == 0) {
+    flags->max_in_flight = 64 * flags->threads;
+  }
+  return !flags->model.empty();
+}
+
+const char* GranularityName(DatetimeGranularity granularity) {
+  switch (granularity) {
+    case GRANULARITY_YEAR:
+      return "year";
+    case GRANULARITY_MONTH:
+      return "month";
+    case GRANULARITY_WEEK:
+      return "week";
+    case GRANULARITY_DAY:
+      return "day";
+    case GRANULARITY_HOUR:
+      return "hour";
+    case GRANULARITY_MINUTE:
+      return "minute";
+    case GRANULARITY_SECOND:
+      return "second";
+    default:
+      return "unknown";
+  }
+}
+
+void AppendAnnotationsJson(const std::vector<AnnotatedSpan>& annotations,
+                           std::string* out) {
+  char buffer[64];
+  out->append("[");
+  for (int i = 0; i < annotations.size(); ++i) {
+    const AnnotatedSpan& annotation = annotations[i];
+    if (i > 0) {
+      out->append(",");
+    }
+    snprintf(buffer, sizeof(buffer), "{\"span\":[%d,%d],\"classification\":[",
+             annotation.span.first, annotation.span.second);
+    out->append(buffer);
+    for (int j = 0; j < annotation.classification.size(); ++j) {
+      const ClassificationResult& classification = annotation.classification[j];
+      if (j > 0) {
+        out->append(",");
+      }
+      out->append("{\"collection\":");
+      AppendJsonString(classification.collection, out);
+      snprintf(buffer, sizeof(buffer), ",\"score\":%.6g", classification.score);
+      out->append(buffer);
+      if (classification.datetime_parse_result.IsSet()) {
+        snprintf(buffer, sizeof(buffer),
+                 ",\"datetime\":{\"time_ms_utc\":%lld,\"granularity\":\"%s\"}",
+                 static_cast<long long>(
+                     classification.datetime_parse_result.time_ms_utc),
+                 GranularityName(
+                     classification.datetime_parse_result.granularity));
+        out->append(buffer);
+      }
+      out->append("}");
+    }
+    out->append("]}");
+  }
+  out->append("]");
+}
+
+std::string AnnotateDocument(const TextClassifier& classifier,
+                             const Flags& flags, const Document& document) {
+  std::string json = "{\"index\":" + IntToString(document.index);
+  JsonValue input;
+  if (!ParseJson(document.line, &input) ||
+      input.Find("context") == nullptr ||
+      input.Find("context")->type() != JsonValue::STRING) {
+    json.append(",\"error\":\"malformed input\"}");
+    return json;
+  }
+
+  const JsonValue* id = input.Find("id");
+  if (id != nullptr && id->type() == JsonValue::STRING) {
+    json.append(",\"id\":");
+    AppendJsonString(id->AsString(), &json);
+  } else if (id != nullptr && id->type() == JsonValue::NUMBER) {
+    json.append(",\"id\":" + IntToString(id->AsInt64()));
+  }
+
+  AnnotationOptions options;
+  options.locales =
+      input.GetString("locales", flags.default_options.locales);
+  options.reference_timezone = input.GetString(
+      "reference_timezone", flags.default_options.reference_timezone);
+  options.reference_time_ms_utc =
+      input.GetInt64("reference_time_ms_utc",
+                     flags.default_options.reference_time_ms_utc);
+
+  json.append(",\"annotations\":");
+  AppendAnnotationsJson(
+      classifier.Annotate(input.GetString("context"), options), &json);
+  json.append("}");
+  return json;
+}
+
+void RunWorker(const TextClassifier& classifier, const Flags& flags,
+               BlockingQueue<Document>* documents,
+               BlockingQueue<Result>* results) {
+  Document document;
+  while (documents->Pop(&document)) {
+    results->Push(
+        {document.index, AnnotateDocument(classifier, flags, document)});
+  }
+}
+
+// Writes the results either in input order or as they come.
+void RunWriter(const Flags& flags, std::ostream* output,
+               BlockingQueue<Result>* results, InFlightLimiter* limiter) {
+  std::map<int64, std::string> pending;
+  int64 next_index = flags.start_line;
+  Result result;
+  while (results->Pop(&result)) {
+    if (!flags.ordered) {
+      *output << result.json << '\n';
+      limiter->Release();
+      continue;
+    }
+    pending[result.index] = std::move(result.json);
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == next_index) {
+      *output << it->second << '\n';
+      limiter->Release();
+      it = pending.erase(it);
+      ++next_index;
+    }
+  }
+  output->flush();
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(flags.model);
+  if (!classifier || !classifier->IsInitialized()) {
+    TC_LOG(ERROR) << "Could not load model: " << flags.model;
+    return 1;
+  }
+
+  std::ifstream input_file;
+  std::istream* input = &std::cin;
+  if (flags.input != "-") {
+    input_file.open(flags.input);
+    if (!input_file) {
+      TC_LOG(ERROR) << "Could not open input: " << flags.input;
+      return 1;
+    }
+    input = &input_file;
+  }
+  std::ofstream output_file;
+  std::ostream* output = &std::cout;
+  if (flags.output != "-") {
+    output_file.open(flags.output, std::ios::app);
+    if (!output_file) {
+      TC_LOG(ERROR) << "Could not open output: " << flags.output;
+      return 1;
+    }
+    output = &output_file;
+  }
+  std::ios::sync_with_stdio(false);
+
+  BlockingQueue<Document> documents(flags.max_in_flight);
+  BlockingQueue<Result> results(flags.max_in_flight);
+  InFlightLimiter limiter(flags.max_in_flight);
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < flags.threads; ++i) {
+    workers.emplace_back(RunWorker, std::cref(*classifier), std::cref(flags),
+                         &documents, &results);
+  }
+  std::thread writer(RunWriter, std::cref(flags), output, &results, &limiter);
+
+  std::string line;
+  int64 index = 0;
+  while (std::getline(*input, line)) {
+    if (index++ < flags.start_line) {
+      continue;
+    }
+    limiter.Acquire();
+    documents.Push({index - 1, std::move(line)});
+  }
+  documents.Close();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  results.Close();
+  writer.join();
+
+  if (!*output) {
+    TC_LOG(ERROR) << "Error writing output.";
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
+
+int main(int argc, char** argv) { return libtextclassifier2::Run(argc, argv); }
@@ -0,0 +1,620 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Serves selection, classification and annotation requests for one or more
+// resident models over a Unix domain socket, so that the processes on a host
+// share one copy of every model.
+//
+// Usage:
+//   textclassifier_server --socket=<path> --model=<name>:<path>
+//       [--model=<name>:<path> ...] [--threads=<cores>] [--max_batch_size=16]
+//
+// The first model is the default one, used by requests with an empty model
+// name. See tools/ipc-protocol.h for the wire format.
+//
+// One thread runs an epoll event loop that accepts connections, reads request
+// frames and writes response frames; it never runs inference or blocks.
+// Decoded requests from all clients go to one queue. Every worker takes all the
+// requests that are queued at the time it becomes free (up to
+// --max_batch_size), runs them and hands the whole batch of responses back to
+// the event loop with a single wake-up, so under load the per-request
+// synchronization cost is amortized across clients.
+//
+// While the queue is full, the event loop stops reading from the connections
+// whose requests don't fit, and resumes when the workers have taken requests.
+// A client that shuts down its side of the connection still gets the
+// responses to its requests.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "text-classifier.h"
+#include "tools/blocking-queue.h"
+#include "tools/ipc-protocol.h"
+#include "util/strings/numbers.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+volatile sig_atomic_t stop_requested = 0;
+
+void HandleStopSignal(int signal) { stop_requested = 1; }
+
+struct Flags {
+  std::string socket;
+  std::vector<std::pair<std::string, std::string>> models;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  int max_batch_size = 16;
+};
+
+// Models hosted by the server, keyed by name. Immutable once serving starts.
+class ModelRegistry {
+ public:
+  bool Load(const std::string& name, const std::string& path) {
+    std::unique_ptr<TextClassifier> classifier =
+        TextClassifier::FromPath(path);
+    if (!classifier || !classifier->IsInitialized()) {
+      TC_LOG(ERROR) << "Could not load model " << name << " from " << path;
+      return false;
+    }
+    if (default_model_.empty()) {
+      default_model_ = name;
+    }
+    models_[name] = std::move(classifier);
+    return true;
+  }
+
+  const TextClassifier* Find(const std::string& name) const {
+    const auto it = models_.find(name.empty() ? default_model_ : name);
+    return it == models_.end() ? nullptr : it->second.get();
+  }
+
+ private:
+  std::string default_model_;
+  std::map<std::string, std::unique_ptr<TextClassifier>> models_;
+};
+
+struct Task {
+  uint64 connection_id;
+  ipc::Request request;
+};
+
+struct Completion {
+  uint64 connection_id;
+  std::string frame;
+};
+
+// Responses produced by the workers, waiting to be written by the event loop.
+class CompletionQueue {
+ public:
+  explicit CompletionQueue(int event_fd) : event_fd_(event_fd) {}
+
+  void Add(std::vector<Completion>* completions) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (Completion& completion : *completions) {
+        completions_.push_back(std::move(completion));
+      }
+    }
+    const uint64 one = 1;
+    if (write(event_fd_, &one, sizeof(one)) != sizeof(one)) {
+      TC_LOG(ERROR) << "Could not signal the event loop.";
+    }
+  }
+
+  void Take(std::vector<Completion>* completions) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completions->swap(completions_);
+  }
+
+ private:
+  const int event_fd_;
+  std::mutex mutex_;
+  std::vector<Completion> completions_;
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: textclassifier_server --socket=<path> --model=<name>:<path> "
+          "[--model=<name>:<path> ...] [--threads=N] [--max_batch_size=N]\n");
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      TC_LOG(ERROR) << "Malformed argument: " << arg;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    int32 int_value = 0;
+    bool ok = true;
+    if (name == "socket") {
+      flags->socket = value;
+    } else if (name == "model") {
+      const size_t colon = value.find(':');
+      ok = colon != std::string::npos && colon > 0;
+      if (ok) {
+        flags->models.emplace_back(value.substr(0, colon),
+                                   value.substr(colon + 1));
+      }
+    } else if (name == "threads") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value > 0;
+      flags->threads = int_value;
+    } else if (name == "max_batch_size") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value > 0;
+      flags->max_batch_size = int_value;
+    } else {
+      TC_LOG(ERROR) << "Unknown flag: " << name;
+      return false;
+    }
+    if (!ok) {
+      TC_LOG(ERROR) << "Invalid value for --" << name << ": " << value;
+      return false;
+    }
+  }
+  return !flags->socket.empty() && !flags->models.empty();
+}
+
+ipc::Response Process(const ModelRegistry& registry,
+                      const ipc::Request& request) {
+  ipc::Response response;
+  response.request_id = request.request_id;
+  response.method = request.method;
+  const TextClassifier* classifier = registry.Find(request.model);
+  if (classifier == nullptr) {
+    response.status = ipc::STATUS_UNKNOWN_MODEL;
+    return response;
+  }
+  if ((request.method == ipc::METHOD_SUGGEST_SELECTION ||
+       request.method == ipc::METHOD_CLASSIFY_TEXT) &&
+      !ipc::HasValidSpan(request)) {
+    response.status = ipc::STATUS_MALFORMED_REQUEST;
+    return response;
+  }
+  switch (request.method) {
+    case ipc::METHOD_SUGGEST_SELECTION: {
+      SelectionOptions options;
+      options.locales = request.locales;
+      response.selection =
+          classifier->SuggestSelection(request.context, request.span, options);
+      break;
+    }
+    case ipc::METHOD_CLASSIFY_TEXT: {
+      ClassificationOptions options;
+      options.locales = request.locales;
+      options.reference_time_ms_utc = request.reference_time_ms_utc;
+      options.reference_timezone = request.reference_timezone;
+      response.classification =
+          classifier->ClassifyText(request.context, request.span, options);
+      break;
+    }
+    case ipc::METHOD_ANNOTATE: {
+      AnnotationOptions options;
+      options.locales = request.locales;
+      options.reference_time_ms_utc = request.reference_time_ms_utc;
+      options.reference_timezone = request.reference_timezone;
+      response.annotations = classifier->Annotate(request.context, options);
+      break;
+    }
+    default:
+      response.status = ipc::STATUS_UNKNOWN_METHOD;
+  }
+  return response;
+}
+
+void RunWorker(const ModelRegistry& registry, int max_batch_size,
+               BlockingQueue<Task>* tasks, CompletionQueue* completions) {
+  std::vector<Task> batch;
+  std::vector<Completion> done;
+  while (tasks->PopAvailable(max_batch_size, &batch)) {
+    for (const Task& task : batch) {
+      done.push_back({task.connection_id, std::string()});
+      ipc::EncodeResponse(Process(registry, task.request), &done.back().frame);
+    }
+    completions->Add(&done);
+    batch.clear();
+    done.clear();
+  }
+}
+
+class EventLoop {
+ public:
+  EventLoop(int listen_fd, int event_fd, BlockingQueue<Task>* tasks,
+            CompletionQueue* completions)
+      : listen_fd_(listen_fd),
+        event_fd_(event_fd),
+        epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+        next_connection_id_(1),
+        tasks_(tasks),
+        completions_(completions) {}
+
+  ~EventLoop() {
+    for (const auto& entry : connections_) {
+      close(entry.second.fd);
+    }
+    close(epoll_fd_);
+  }
+
+  bool Run() {
+    if (epoll_fd_ < 0 || !Watch(listen_fd_, EPOLLIN, /*add=*/true) ||
+        !Watch(event_fd_, EPOLLIN, /*add=*/true)) {
+      TC_LOG(ERROR) << "Could not set up epoll.";
+      return false;
+    }
+    const int kMaxEvents = 64;
+    epoll_event events[kMaxEvents];
+    while (!stop_requested) {
+      const int num_events =
+          epoll_wait(epoll_fd_, events, kMaxEvents, /*timeout=*/500);
+      if (num_events < 0 && errno != EINTR) {
+        TC_LOG(ERROR) << "epoll_wait failed: " << errno;
+        return false;
+      }
+      for (int i = 0; i < num_events; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == listen_fd_) {
+          AcceptConnections();
+        } else if (fd == event_fd_) {
+          WriteCompletions();
+        } else {
+          HandleConnectionEvent(fd, events[i].events);
+        }
+      }
+    }
+    return true;
+  }
+
+ private:
+  struct Connection {
+    int fd;
+    uint64 id;
+    std::string read_buffer;
+    std::string write_buffer;
+
+    // Requests in the task queue whose responses were not written yet.
+    int num_pending = 0;
+
+    // Reading is stopped because the task queue was full. The complete frames
+    // in read_buffer are queued once it has room again.
+    bool paused = false;
+
+    // The peer shut down its side. The connection is closed once all
+    // responses are written.
+    bool read_closed = false;
+
+    uint32 watched_events = 0;
+  };
+
+  bool Watch(int fd, uint32 events, bool add) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    return epoll_ctl(epoll_fd_, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd,
+                     &event) == 0;
+  }
+
+  void AcceptConnections() {
+    while (true) {
+      const int fd =
+          accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          TC_LOG(ERROR) << "accept failed: " << errno;
+        }
+        return;
+      }
+      if (!Watch(fd, EPOLLIN | EPOLLRDHUP, /*add=*/true)) {
+        close(fd);
+        continue;
+      }
+      Connection& connection = connections_[fd];
+      connection.fd = fd;
+      connection.id = next_connection_id_++;
+      connection.watched_events = EPOLLIN | EPOLLRDHUP;
+      fd_by_id_[connection.id] = fd;
+    }
+  }
+
+  void CloseConnection(int fd) {
+    const auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+      return;
+    }
+    // Responses still being computed for this connection are dropped when
+    // they complete, because the id is not reused.
+    fd_by_id_.erase(it->second.id);
+    connections_.erase(it);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+  }
+
+  void HandleConnectionEvent(int fd, uint32 events) {
+    auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+      return;
+    }
+    Connection* connection = &it->second;
+    if (events & (EPOLLHUP | EPOLLERR)) {
+      // Responses can't be delivered anymore.
+      CloseConnection(fd);
+      return;
+    }
+    if ((events & (EPOLLIN | EPOLLRDHUP)) && !ReadRequests(connection)) {
+      CloseConnection(fd);
+      return;
+    }
+    if (!Flush(connection)) {
+      CloseConnection(fd);
+    }
+  }
+
+  // Reads everything available and queues the complete request frames.
+  // Returns false if the connection should be closed.
+  bool ReadRequests(Connection* connection) {
+    if (connection->paused || connection->read_closed) {
+      return true;
+    }
+    char buffer[64 * 1024];
+    while (true) {
+      const ssize_t num_read = read(connection->fd, buffer, sizeof(buffer));
+      if (num_read > 0) {
+        connection->read_buffer.append(buffer, num_read);
+      } else if (num_read == 0) {
+        connection->read_closed = true;
+        break;
+      } else if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      } else {
+        return false;
+      }
+    }
+    return QueueRequests(connection);
+  }
+
+  // Queues the complete request frames in the read buffer, until the task
+  // queue is full. Then the connection is paused until ResumeConnections().
+  // Returns false if the connection should be closed.
+  bool QueueRequests(Connection* connection) {
+    connection->paused = false;
+    size_t offset = 0;
+    const std::string& data = connection->read_buffer;
+    while (data.size() - offset >= ipc::kFrameHeaderSize) {
+      const uint32 payload_size = ipc::DecodeFrameSize(data.data() + offset);
+      if (payload_size > ipc::kMaxPayloadSize) {
+        TC_LOG(ERROR) << "Frame too large: " << payload_size;
+        return false;
+      }
+      if (data.size() - offset - ipc::kFrameHeaderSize < payload_size) {
+        break;
+      }
+      Task task;
+      task.connection_id = connection->id;
+      if (!ipc::DecodeRequest(
+              StringPiece(data.data() + offset + ipc::kFrameHeaderSize,
+                          payload_size),
+              &task.request)) {
+        ipc::Response response;
+        response.request_id = task.request.request_id;
+        response.status = ipc::STATUS_MALFORMED_REQUEST;
+        ipc::EncodeResponse(response, &connection->write_buffer);
+      } else if (tasks_->TryPush(&task)) {
+        ++connection->num_pending;
+      } else {
+        // The frame stays in the buffer and is decoded again on resumption.
+        connection->paused = true;
+        paused_ids_.push_back(connection->id);
+        break;
+      }
+      offset += ipc::kFrameHeaderSize + payload_size;
+    }
+    connection->read_buffer.erase(0, offset);
+    return true;
+  }
+
+  // Queues the buffered requests of the paused connections, in the order in
+  // which they were paused, now that the workers have taken tasks.
+  void ResumeConnections() {
+    std::vector<uint64> paused_ids;
+    paused_ids.swap(paused_ids_);
+    for (const uint64 id : paused_ids) {
+      const auto id_it = fd_by_id_.find(id);
+      if (id_it == fd_by_id_.end()) {
+        continue;
+      }
+      Connection* connection = &connections_[id_it->second];
+      if (!QueueRequests(connection) || !Flush(connection)) {
+        CloseConnection(connection->fd);
+      }
+    }
+  }
+
+  void WriteCompletions() {
+    uint64 counter;
+    if (read(event_fd_, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+      TC_LOG(ERROR) << "Could not read the event counter.";
+    }
+    std::vector<Completion> completions;
+    completions_->Take(&completions);
+    std::vector<int> touched;
+    for (Completion& completion : completions) {
+      const auto id_it = fd_by_id_.find(completion.connection_id);
+      if (id_it == fd_by_id_.end()) {
+        continue;
+      }
+      Connection& connection = connections_[id_it->second];
+      connection.write_buffer.append(completion.frame);
+      --connection.num_pending;
+      touched.push_back(connection.fd);
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (const int fd : touched) {
+      if (!Flush(&connections_[fd])) {
+        CloseConnection(fd);
+      }
+    }
+    ResumeConnections();
+  }
+
+  // Writes as much of the pending output as the socket accepts, and watches
+  // for readability unless reading is stopped, and for writability while
+  // output remains. Returns false if the connection should be closed: on a
+  // write error, or once the peer shut down its side and got all responses.
+  bool Flush(Connection* connection) {
+    size_t offset = 0;
+    const std::string& data = connection->write_buffer;
+    while (offset < data.size()) {
+      const ssize_t written = send(connection->fd, data.data() + offset,
+                                   data.size() - offset, MSG_NOSIGNAL);
+      if (written >= 0) {
+        offset += written;
+      } else if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      } else {
+        return false;
+      }
+    }
+    connection->write_buffer.erase(0, offset);
+    const bool reading = !connection->paused && !connection->read_closed;
+    const uint32 events = (reading ? EPOLLIN | EPOLLRDHUP : 0) |
+                          (connection->write_buffer.empty() ? 0 : EPOLLOUT);
+    if (events != connection->watched_events) {
+      connection->watched_events = events;
+      if (!Watch(connection->fd, events, /*add=*/false)) {
+        return false;
+      }
+    }
+    return !connection->read_closed || connection->paused ||
+           connection->num_pending > 0 || !connection->write_buffer.empty();
+  }
+
+  const int listen_fd_;
+  const int event_fd_;
+  const int epoll_fd_;
+  uint64 next_connection_id_;
+  BlockingQueue<Task>* tasks_;
+  CompletionQueue* completions_;
+  std::unordered_map<int, Connection> connections_;
+  std::unordered_map<uint64, int> fd_by_id_;
+
+  // Connections waiting for room in the task queue.
+  std::vector<uint64> paused_ids_;
+};
+
+int CreateListeningSocket(const std::string& path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    TC_LOG(ERROR) << "Socket path too long: " << path;
+    return -1;
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  const int fd =
+      socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    TC_LOG(ERROR) << "Could not create socket: " << errno;
+    return -1;
+  }
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    TC_LOG(ERROR) << "Could not listen on " << path << ": " << errno;
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    PrintUsage();
+    return 1;
+  }
+
+  ModelRegistry registry;
+  for (const auto& model : flags.models) {
+    if (!registry.Load(model.first, model.second)) {
+      return 1;
+    }
+  }
+
+  const int listen_fd = CreateListeningSocket(flags.socket);
+  if (listen_fd < 0) {
+    return 1;
+  }
+  const int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd < 0) {
+    TC_LOG(ERROR) << "Could not create eventfd: " << errno;
+    return 1;
+  }
+
+  signal(SIGINT, HandleStopSignal);
+  signal(SIGTERM, HandleStopSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  BlockingQueue<Task> tasks(/*capacity=*/64 * flags.threads *
+                            flags.max_batch_size);
+  CompletionQueue completions(event_fd);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < flags.threads; ++i) {
+    workers.emplace_back(RunWorker, std::cref(registry), flags.max_batch_size,
+                         &tasks, &completions);
+  }
+
+  bool ok;
+  {
+    EventLoop event_loop(listen_fd, event_fd, &tasks, &completions);
+    ok = event_loop.Run();
+  }
+
+  tasks.Close();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  close(event_fd);
+  close(listen_fd);
+  unlink(flags.socket.c_str());
+  return ok ? 0 : 1;
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
+
+int main(int argc, char** argv) { return libtextclassifier2::Run(argc, argv); }
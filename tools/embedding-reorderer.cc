@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/embedding-reorderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "util/base/logging.h"
+#include "tensorflow/contrib/lite/schema/schema_generated.h"
+
+namespace libtextclassifier2 {
+
+BucketCounter::BucketCounter(const Model* model, const UniLib* unilib) {
+  for (const FeatureProcessorOptions* options :
+       {model->selection_feature_options(),
+        model->classification_feature_options()}) {
+    if (options == nullptr) {
+      continue;
+    }
+    feature_processors_.emplace_back(new FeatureProcessor(options, unilib));
+    feature_extractors_.emplace_back(new TokenFeatureExtractor(
+        internal::BuildTokenFeatureExtractorOptions(options), *unilib));
+    counts_.resize(std::max<int>(counts_.size(), options->num_buckets()));
+  }
+}
+
+void BucketCounter::AddText(const std::string& text) {
+  for (int i = 0; i < feature_processors_.size(); ++i) {
+    // Every context has padding tokens on its sides.
+    std::vector<Token> tokens = feature_processors_[i]->Tokenize(text);
+    tokens.push_back(Token());
+    for (const Token& token : tokens) {
+      for (const int bucket :
+           feature_extractors_[i]->ExtractCharactergramFeatures(token)) {
+        if (bucket >= 0 && bucket < counts_.size()) {
+          ++counts_[bucket];
+        }
+      }
+    }
+  }
+}
+
+std::vector<int32> BucketRowsByFrequency(const std::vector<int64>& counts) {
+  std::vector<int32> buckets(counts.size());
+  std::iota(buckets.begin(), buckets.end(), 0);
+  std::stable_sort(
+      buckets.begin(), buckets.end(),
+      [&counts](int32 a, int32 b) { return counts[a] > counts[b]; });
+  std::vector<int32> bucket_rows(counts.size());
+  for (int row = 0; row < buckets.size(); ++row) {
+    bucket_rows[buckets[row]] = row;
+  }
+  return bucket_rows;
+}
+
+bool ReorderEmbeddingRows(const std::vector<int32>& bucket_rows,
+                          ModelT* model) {
+  flatbuffers::Verifier verifier(model->embedding_model.data(),
+                                 model->embedding_model.size());
+  if (model->embedding_model.empty() || !tflite::VerifyModelBuffer(verifier)) {
+    TC_LOG(ERROR) << "Invalid embedding model.";
+    return false;
+  }
+  std::unique_ptr<tflite::ModelT> embedding_model =
+      tflite::UnPackModel(model->embedding_model.data());
+
+  // The embeddings are tensor 0 and the scales tensor 1, with one row per
+  // bucket.
+  if (embedding_model->subgraphs.size() != 1 ||
+      embedding_model->subgraphs[0]->tensors.size() != 2 ||
+      embedding_model->subgraphs[0]->tensors[0]->shape.size() != 2) {
+    TC_LOG(ERROR) << "Unexpected embedding model.";
+    return false;
+  }
+  const int num_buckets = embedding_model->subgraphs[0]->tensors[0]->shape[0];
+  if (bucket_rows.size() != num_buckets) {
+    TC_LOG(ERROR) << "Mismatch in the number of embedding rows.";
+    return false;
+  }
+  std::vector<bool> is_used_row(num_buckets, false);
+  for (const int32 row : bucket_rows) {
+    if (row < 0 || row >= num_buckets || is_used_row[row]) {
+      TC_LOG(ERROR) << "Invalid embedding row: " << row;
+      return false;
+    }
+    is_used_row[row] = true;
+  }
+
+  // The current row of every bucket.
+  std::vector<int32> current_rows = model->embedding_bucket_rows;
+  if (current_rows.empty()) {
+    current_rows.resize(num_buckets);
+    std::iota(current_rows.begin(), current_rows.end(), 0);
+  } else if (current_rows.size() != num_buckets) {
+    TC_LOG(ERROR) << "Mismatch in the number of embedding rows.";
+    return false;
+  }
+
+  for (const auto& tensor : embedding_model->subgraphs[0]->tensors) {
+    if (tensor->buffer >= embedding_model->buffers.size()) {
+      TC_LOG(ERROR) << "Invalid embedding buffer.";
+      return false;
+    }
+    std::vector<uint8_t>* data =
+        &embedding_model->buffers[tensor->buffer]->data;
+    if (data->size() % num_buckets != 0) {
+      TC_LOG(ERROR) << "Unexpected embedding tensor size: " << data->size();
+      return false;
+    }
+    const size_t row_size = data->size() / num_buckets;
+    std::vector<uint8_t> reordered(data->size());
+    for (int bucket = 0; bucket < num_buckets; ++bucket) {
+      memcpy(&reordered[static_cast<size_t>(bucket_rows[bucket]) * row_size],
+             &(*data)[static_cast<size_t>(current_rows[bucket]) * row_size],
+             row_size);
+    }
+    data->swap(reordered);
+  }
+
+  flatbuffers::FlatBufferBuilder builder;
+  tflite::FinishModelBuffer(
+      builder, tflite::Model::Pack(builder, embedding_model.get()));
+  model->embedding_model.assign(
+      builder.GetBufferPointer(),
+      builder.GetBufferPointer() + builder.GetSize());
+  model->embedding_bucket_rows = bucket_rows;
+  return true;
+}
+
+}  // namespace libtextclassifier2
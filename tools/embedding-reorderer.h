@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Offline reordering of the embedding table by bucket frequency.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_EMBEDDING_REORDERER_H_
+#define LIBTEXTCLASSIFIER_TOOLS_EMBEDDING_REORDERER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "feature-processor.h"
+#include "model_generated.h"
+#include "token-feature-extractor.h"
+#include "util/base/integral_types.h"
+#include "util/base/macros.h"
+#include "util/utf8/unilib.h"
+
+namespace libtextclassifier2 {
+
+// Counts how often the charactergram buckets of the embedding table are
+// looked up for a set of texts, with the features of both the selection and
+// the classification model. The model must outlive the counter.
+class BucketCounter {
+ public:
+  BucketCounter(const Model* model, const UniLib* unilib);
+
+  void AddText(const std::string& text);
+
+  // The number of lookups of every bucket.
+  const std::vector<int64>& counts() const { return counts_; }
+
+ private:
+  std::vector<std::unique_ptr<FeatureProcessor>> feature_processors_;
+  std::vector<std::unique_ptr<TokenFeatureExtractor>> feature_extractors_;
+  std::vector<int64> counts_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(BucketCounter);
+};
+
+// Returns the row of every bucket, with the rows in decreasing order of the
+// counts. Buckets with the same count keep their relative order.
+std::vector<int32> BucketRowsByFrequency(const std::vector<int64>& counts);
+
+// Moves the embedding and the scale of every bucket to the row given by
+// 'bucket_rows', in the embedding model of 'model', and stores the order in
+// the model. A previous order of the model is replaced. Returns false if the
+// embedding model or the order are invalid.
+bool ReorderEmbeddingRows(const std::vector<int32>& bucket_rows,
+                          ModelT* model);
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_EMBEDDING_REORDERER_H_
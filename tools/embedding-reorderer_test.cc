@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/embedding-reorderer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "text-classifier.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+std::string ReadFile(const std::string& file_name) {
+  std::ifstream file_stream(file_name);
+  return std::string(std::istreambuf_iterator<char>(file_stream), {});
+}
+
+std::string GetModelPath() { return LIBTEXTCLASSIFIER_TEST_DATA_DIR; }
+
+TEST(EmbeddingReordererTest, BucketRowsByFrequency) {
+  EXPECT_EQ(BucketRowsByFrequency({3, 0, 5, 3}),
+            std::vector<int32>({1, 3, 0, 2}));
+  EXPECT_EQ(BucketRowsByFrequency({0, 0, 0}), std::vector<int32>({0, 1, 2}));
+}
+
+class EmbeddingReordererModelTest
+    : public ::testing::TestWithParam<const char*> {};
+
+INSTANTIATE_TEST_CASE_P(ClickContext, EmbeddingReordererModelTest,
+                        testing::Values("test_model_cc.fb"));
+INSTANTIATE_TEST_CASE_P(BoundsSensitive, EmbeddingReordererModelTest,
+                        testing::Values("test_model.fb"));
+
+TEST_P(EmbeddingReordererModelTest, KeepsResults) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + GetParam());
+  const std::vector<std::string> texts = {
+      "Call me at (800) 123-456 today",
+      "350 Third Street, Cambridge",
+      "Visit www.google.com every today!",
+      "& saw Barack Obama today .. 350 Third Street, Cambridge"};
+
+  BucketCounter counter(GetModel(test_model.data()), &unilib);
+  for (const std::string& text : texts) {
+    counter.AddText(text);
+  }
+  const std::vector<int32> bucket_rows =
+      BucketRowsByFrequency(counter.counts());
+
+  // The most frequent bucket is in the first row.
+  const int most_frequent_bucket =
+      std::max_element(counter.counts().begin(), counter.counts().end()) -
+      counter.counts().begin();
+  EXPECT_GT(counter.counts()[most_frequent_bucket], 0);
+  EXPECT_EQ(bucket_rows[most_frequent_bucket], 0);
+
+  std::unique_ptr<ModelT> unpacked_model = UnPackModel(test_model.c_str());
+  ASSERT_TRUE(unpacked_model != nullptr);
+  ASSERT_TRUE(ReorderEmbeddingRows(bucket_rows, unpacked_model.get()));
+  // Reordering a reordered model starts from its current order.
+  std::vector<int32> reversed_rows(bucket_rows.size());
+  for (int i = 0; i < reversed_rows.size(); ++i) {
+    reversed_rows[i] = reversed_rows.size() - 1 - i;
+  }
+  ASSERT_TRUE(ReorderEmbeddingRows(reversed_rows, unpacked_model.get()));
+  ASSERT_TRUE(ReorderEmbeddingRows(bucket_rows, unpacked_model.get()));
+  EXPECT_EQ(unpacked_model->embedding_bucket_rows, bucket_rows);
+
+  // Not a permutation.
+  std::vector<int32> invalid_rows(bucket_rows.size(), 0);
+  EXPECT_FALSE(ReorderEmbeddingRows(invalid_rows, unpacked_model.get()));
+
+  flatbuffers::FlatBufferBuilder builder;
+  FinishModelBuffer(builder, Model::Pack(builder, unpacked_model.get()));
+  std::unique_ptr<TextClassifier> reordered_classifier =
+      TextClassifier::FromUnownedBuffer(
+          reinterpret_cast<const char*>(builder.GetBufferPointer()),
+          builder.GetSize(), &unilib);
+  ASSERT_TRUE(reordered_classifier);
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(test_model.data(), test_model.size(),
+                                        &unilib);
+  ASSERT_TRUE(classifier);
+
+  for (const std::string& text : texts) {
+    const std::vector<ClassificationResult> results =
+        classifier->ClassifyText(text, {0, 4});
+    const std::vector<ClassificationResult> reordered_results =
+        reordered_classifier->ClassifyText(text, {0, 4});
+    ASSERT_EQ(results.size(), reordered_results.size());
+    for (int i = 0; i < results.size(); ++i) {
+      EXPECT_EQ(results[i].collection, reordered_results[i].collection);
+      EXPECT_EQ(results[i].score, reordered_results[i].score);
+    }
+    EXPECT_EQ(classifier->SuggestSelection(text, {5, 6}),
+              reordered_classifier->SuggestSelection(text, {5, 6}));
+  }
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Generates util/utf8/char-properties-data.cc, the character property tables
+// of util/utf8/char-properties.h, from ICU.
+//
+// Usage:
+//   textclassifier_generate_char_properties > util/utf8/char-properties-data.cc
+//
+// Rerun when moving to an ICU with a new Unicode version. The generated file
+// records the Unicode version, and unilib_test checks the tables against ICU
+// for every codepoint, or only for the codepoints assigned in both Unicode
+// versions if they differ.
+
+#include <stdio.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "util/utf8/char-properties.h"
+#include "unicode/uchar.h"
+#include "unicode/uversion.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+using PropertiesKey = std::tuple<int, int, int>;
+
+PropertiesKey PropertiesOfCodepoint(char32 codepoint) {
+  int flags = 0;
+  if (u_isWhitespace(codepoint)) {
+    flags |= internal::kCharWhitespace;
+  }
+  if (u_isdigit(codepoint)) {
+    flags |= internal::kCharDigit;
+  }
+  if (u_isupper(codepoint)) {
+    flags |= internal::kCharUpper;
+  }
+  const int bracket_type =
+      u_getIntPropertyValue(codepoint, UCHAR_BIDI_PAIRED_BRACKET_TYPE);
+  if (bracket_type == U_BPT_OPEN) {
+    flags |= internal::kCharOpeningBracket;
+  } else if (bracket_type == U_BPT_CLOSE) {
+    flags |= internal::kCharClosingBracket;
+  }
+  return std::make_tuple(flags, u_tolower(codepoint) - codepoint,
+                         u_getBidiPairedBracket(codepoint) - codepoint);
+}
+
+void PrintBytes(const std::vector<int>& values) {
+  for (int i = 0; i < values.size(); ++i) {
+    printf("%s%d,", i % 12 == 0 ? "\n    " : " ", values[i]);
+  }
+  printf("\n");
+}
+
+int Main() {
+  // The properties of every codepoint, as an index into 'properties'. Index
+  // zero is the default: no flags, and the codepoint maps to itself.
+  std::vector<PropertiesKey> properties = {std::make_tuple(0, 0, 0)};
+  std::map<PropertiesKey, int> properties_index = {{properties[0], 0}};
+  std::vector<int> codepoint_properties(internal::kCharPropertiesMaxCodepoint +
+                                        1);
+  int limit = 0;
+  for (char32 codepoint = 0;
+       codepoint <= internal::kCharPropertiesMaxCodepoint; ++codepoint) {
+    const PropertiesKey key = PropertiesOfCodepoint(codepoint);
+    auto it = properties_index.find(key);
+    if (it == properties_index.end()) {
+      it = properties_index.emplace(key, properties.size()).first;
+      properties.push_back(key);
+    }
+    codepoint_properties[codepoint] = it->second;
+    if (it->second != 0) {
+      limit = codepoint + 1;
+    }
+  }
+  if (properties.size() > 256) {
+    fprintf(stderr, "Too many distinct properties: %zu\n", properties.size());
+    return 1;
+  }
+
+  // Share the blocks of codepoints that have the same properties.
+  const int block_size = 1 << internal::kCharPropertiesBlockShift;
+  limit = (limit + block_size - 1) / block_size * block_size;
+  std::vector<int> stage1;
+  std::vector<int> stage2;
+  std::map<std::vector<int>, int> block_index;
+  for (int block_start = 0; block_start < limit; block_start += block_size) {
+    const std::vector<int> block(
+        codepoint_properties.begin() + block_start,
+        codepoint_properties.begin() + block_start + block_size);
+    auto it = block_index.find(block);
+    if (it == block_index.end()) {
+      it = block_index.emplace(block, block_index.size()).first;
+      stage2.insert(stage2.end(), block.begin(), block.end());
+    }
+    stage1.push_back(it->second);
+  }
+  if (block_index.size() > 256) {
+    fprintf(stderr, "Too many distinct blocks: %zu\n", block_index.size());
+    return 1;
+  }
+
+  printf(
+      "/*\n"
+      " * Copyright (C) 2017 The Android Open Source Project\n"
+      " *\n"
+      " * Licensed under the Apache License, Version 2.0 (the \"License\");\n"
+      " * you may not use this file except in compliance with the License.\n"
+      " * You may obtain a copy of the License at\n"
+      " *\n"
+      " *      http://www.apache.org/licenses/LICENSE-2.0\n"
+      " *\n"
+      " * Unless required by applicable law or agreed to in writing, software\n"
+      " * distributed under the License is distributed on an \"AS IS\" "
+      "BASIS,\n"
+      " * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or "
+      "implied.\n"
+      " * See the License for the specific language governing permissions "
+      "and\n"
+      " * limitations under the License.\n"
+      " */\n"
+      "\n"
+      "// Generated by tools/generate-char-properties_main.cc from ICU %s\n"
+      "// (Unicode %s).\n"
+      "// Do not edit.\n"
+      "\n"
+      "#include \"util/utf8/char-properties.h\"\n"
+      "\n"
+      "namespace libtextclassifier2 {\n"
+      "namespace internal {\n"
+      "\n"
+      "const char kCharPropertiesUnicodeVersion[] = \"%s\";\n"
+      "\n",
+      U_ICU_VERSION, U_UNICODE_VERSION, U_UNICODE_VERSION);
+  printf("const int kCharPropertiesLimit = 0x%X;\n\n", limit);
+  printf("const CharProperties kCharProperties[] = {\n");
+  for (const PropertiesKey& key : properties) {
+    printf("    {%d, %d, %d},\n", std::get<1>(key), std::get<2>(key),
+           std::get<0>(key));
+  }
+  printf("};\n\n");
+  printf("const uint8 kCharPropertiesStage1[] = {");
+  PrintBytes(stage1);
+  printf("};\n\n");
+  printf("const uint8 kCharPropertiesStage2[] = {");
+  PrintBytes(stage2);
+  printf("};\n\n");
+  printf(
+      "}  // namespace internal\n"
+      "}  // namespace libtextclassifier2\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
+
+int main(int argc, char** argv) { return libtextclassifier2::Main(); }
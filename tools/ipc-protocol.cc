@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/ipc-protocol.h"
+
+#include <cstring>
+
+#include "util/utf8/unicodetext.h"
+
+namespace libtextclassifier2 {
+namespace ipc {
+namespace {
+
+class PayloadWriter {
+ public:
+  // Reserves the frame header, which is filled in by Finish().
+  explicit PayloadWriter(std::string* frame)
+      : frame_(frame), header_offset_(frame->size()) {
+    frame_->append(kFrameHeaderSize, '\0');
+  }
+
+  void WriteUint(uint64 value, int num_bytes) {
+    for (int i = 0; i < num_bytes; ++i) {
+      frame_->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+  }
+
+  void WriteUint8(uint8 value) { WriteUint(value, 1); }
+  void WriteUint32(uint32 value) { WriteUint(value, 4); }
+  void WriteInt32(int32 value) { WriteUint(static_cast<uint32>(value), 4); }
+  void WriteInt64(int64 value) { WriteUint(static_cast<uint64>(value), 8); }
+
+  void WriteFloat(float value) {
+    uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    WriteUint32(bits);
+  }
+
+  void WriteString(const std::string& value) {
+    WriteUint32(value.size());
+    frame_->append(value);
+  }
+
+  void WriteClassification(const ClassificationResult& classification) {
+    WriteString(classification.collection);
+    WriteFloat(classification.score);
+    WriteInt64(classification.datetime_parse_result.time_ms_utc);
+    WriteInt32(classification.datetime_parse_result.granularity);
+  }
+
+  void Finish() {
+    const uint32 payload_size =
+        frame_->size() - header_offset_ - kFrameHeaderSize;
+    for (int i = 0; i < kFrameHeaderSize; ++i) {
+      (*frame_)[header_offset_ + i] =
+          static_cast<char>((payload_size >> (8 * i)) & 0xFF);
+    }
+  }
+
+ private:
+  std::string* frame_;
+  const size_t header_offset_;
+};
+
+class PayloadReader {
+ public:
+  explicit PayloadReader(StringPiece payload) : payload_(payload), pos_(0) {}
+
+  bool ReadUint(int num_bytes, uint64* value) {
+    if (payload_.size() - pos_ < num_bytes) {
+      return false;
+    }
+    *value = 0;
+    for (int i = 0; i < num_bytes; ++i) {
+      *value |= static_cast<uint64>(static_cast<uint8>(payload_[pos_ + i]))
+                << (8 * i);
+    }
+    pos_ += num_bytes;
+    return true;
+  }
+
+  bool ReadUint8(int* value) {
+    uint64 result;
+    if (!ReadUint(1, &result)) {
+      return false;
+    }
+    *value = result;
+    return true;
+  }
+
+  bool ReadUint32(uint32* value) {
+    uint64 result;
+    if (!ReadUint(4, &result)) {
+      return false;
+    }
+    *value = result;
+    return true;
+  }
+
+  bool ReadInt32(int32* value) {
+    uint32 result;
+    if (!ReadUint32(&result)) {
+      return false;
+    }
+    *value = static_cast<int32>(result);
+    return true;
+  }
+
+  bool ReadInt64(int64* value) {
+    uint64 result;
+    if (!ReadUint(8, &result)) {
+      return false;
+    }
+    *value = static_cast<int64>(result);
+    return true;
+  }
+
+  bool ReadFloat(float* value) {
+    uint32 bits;
+    if (!ReadUint32(&bits)) {
+      return false;
+    }
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    uint32 size;
+    if (!ReadUint32(&size) || payload_.size() - pos_ < size) {
+      return false;
+    }
+    value->assign(payload_.data() + pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool ReadSpan(CodepointSpan* span) {
+    return ReadInt32(&span->first) && ReadInt32(&span->second);
+  }
+
+  bool ReadClassification(ClassificationResult* classification) {
+    int32 granularity;
+    if (!ReadString(&classification->collection) ||
+        !ReadFloat(&classification->score) ||
+        !ReadInt64(&classification->datetime_parse_result.time_ms_utc) ||
+        !ReadInt32(&granularity)) {
+      return false;
+    }
+    classification->datetime_parse_result.granularity =
+        static_cast<DatetimeGranularity>(granularity);
+    return true;
+  }
+
+  bool ReadClassifications(std::vector<ClassificationResult>* result) {
+    uint32 size;
+    if (!ReadUint32(&size)) {
+      return false;
+    }
+    for (uint32 i = 0; i < size; ++i) {
+      result->emplace_back();
+      if (!ReadClassification(&result->back())) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool AtEnd() const { return pos_ == payload_.size(); }
+
+ private:
+  const StringPiece payload_;
+  size_t pos_;
+};
+
+}  // namespace
+
+void EncodeRequest(const Request& request, std::string* frame) {
+  PayloadWriter writer(frame);
+  writer.WriteUint32(request.request_id);
+  writer.WriteUint8(request.method);
+  writer.WriteString(request.model);
+  writer.WriteString(request.context);
+  writer.WriteInt32(request.span.first);
+  writer.WriteInt32(request.span.second);
+  writer.WriteString(request.locales);
+  writer.WriteInt64(request.reference_time_ms_utc);
+  writer.WriteString(request.reference_timezone);
+  writer.Finish();
+}
+
+bool DecodeRequest(StringPiece payload, Request* request) {
+  PayloadReader reader(payload);
+  return reader.ReadUint32(&request->request_id) &&
+         reader.ReadUint8(&request->method) &&
+         reader.ReadString(&request->model) &&
+         reader.ReadString(&request->context) &&
+         reader.ReadSpan(&request->span) &&
+         reader.ReadString(&request->locales) &&
+         reader.ReadInt64(&request->reference_time_ms_utc) &&
+         reader.ReadString(&request->reference_timezone) && reader.AtEnd();
+}
+
+void EncodeResponse(const Response& response, std::string* frame) {
+  PayloadWriter writer(frame);
+  writer.WriteUint32(response.request_id);
+  writer.WriteUint8(response.status);
+  if (response.status == STATUS_OK) {
+    switch (response.method) {
+      case METHOD_SUGGEST_SELECTION:
+        writer.WriteInt32(response.selection.first);
+        writer.WriteInt32(response.selection.second);
+        break;
+      case METHOD_CLASSIFY_TEXT:
+        writer.WriteUint32(response.classification.size());
+        for (const ClassificationResult& classification :
+             response.classification) {
+          writer.WriteClassification(classification);
+        }
+        break;
+      case METHOD_ANNOTATE:
+        writer.WriteUint32(response.annotations.size());
+        for (const AnnotatedSpan& annotation : response.annotations) {
+          writer.WriteInt32(annotation.span.first);
+          writer.WriteInt32(annotation.span.second);
+          writer.WriteUint32(annotation.classification.size());
+          for (const ClassificationResult& classification :
+               annotation.classification) {
+            writer.WriteClassification(classification);
+          }
+        }
+        break;
+    }
+  }
+  writer.Finish();
+}
+
+bool DecodeResponse(StringPiece payload, int method, Response* response) {
+  PayloadReader reader(payload);
+  response->method = method;
+  if (!reader.ReadUint32(&response->request_id) ||
+      !reader.ReadUint8(&response->status)) {
+    return false;
+  }
+  if (response->status != STATUS_OK) {
+    return reader.AtEnd();
+  }
+  switch (method) {
+    case METHOD_SUGGEST_SELECTION:
+      if (!reader.ReadSpan(&response->selection)) {
+        return false;
+      }
+      break;
+    case METHOD_CLASSIFY_TEXT:
+      if (!reader.ReadClassifications(&response->classification)) {
+        return false;
+      }
+      break;
+    case METHOD_ANNOTATE: {
+      uint32 size;
+      if (!reader.ReadUint32(&size)) {
+        return false;
+      }
+      for (uint32 i = 0; i < size; ++i) {
+        response->annotations.emplace_back();
+        AnnotatedSpan* annotation = &response->annotations.back();
+        if (!reader.ReadSpan(&annotation->span) ||
+            !reader.ReadClassifications(&annotation->classification)) {
+          return false;
+        }
+      }
+      break;
+    }
+    default:
+      return false;
+  }
+  return reader.AtEnd();
+}
+
+bool HasValidSpan(const Request& request) {
+  const UnicodeText context =
+      UTF8ToUnicodeText(request.context, /*do_copy=*/false);
+  return context.is_valid() && request.span.first >= 0 &&
+         request.span.first < request.span.second &&
+         request.span.second <= context.size_codepoints();
+}
+
+uint32 DecodeFrameSize(const char* data) {
+  uint32 size = 0;
+  for (int i = 0; i < kFrameHeaderSize; ++i) {
+    size |= static_cast<uint32>(static_cast<uint8>(data[i])) << (8 * i);
+  }
+  return size;
+}
+
+}  // namespace ipc
+}  // namespace libtextclassifier2
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Wire format of the classification server.
+//
+// Every message is a frame: a little-endian uint32 payload size followed by the
+// payload. Payloads are sequences of little-endian fixed-size integers, IEEE
+// floats and strings (uint32 byte length followed by UTF-8 bytes):
+//
+// Request:
+//   uint32 request_id, uint8 method, string model, string context,
+//   int32 span_begin, int32 span_end, string locales,
+//   int64 reference_time_ms_utc, string reference_timezone
+//
+// Response:
+//   uint32 request_id, uint8 status, and if the status is STATUS_OK:
+//   - METHOD_SUGGEST_SELECTION: int32 begin, int32 end
+//   - METHOD_CLASSIFY_TEXT: uint32 n, n * classification
+//   - METHOD_ANNOTATE: uint32 n, n * (int32 begin, int32 end, uint32 m,
+//     m * classification)
+//   where classification is: string collection, float score,
+//   int64 datetime_time_ms_utc, int32 datetime_granularity.
+//
+// Spans are in Unicode codepoints. Responses on a connection can arrive in a
+// different order than the requests; clients match them by request_id.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_IPC_PROTOCOL_H_
+#define LIBTEXTCLASSIFIER_TOOLS_IPC_PROTOCOL_H_
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "util/base/integral_types.h"
+#include "util/strings/stringpiece.h"
+
+namespace libtextclassifier2 {
+namespace ipc {
+
+enum Method {
+  METHOD_SUGGEST_SELECTION = 1,
+  METHOD_CLASSIFY_TEXT = 2,
+  METHOD_ANNOTATE = 3,
+};
+
+enum Status {
+  STATUS_OK = 0,
+  STATUS_MALFORMED_REQUEST = 1,
+  STATUS_UNKNOWN_MODEL = 2,
+  STATUS_UNKNOWN_METHOD = 3,
+};
+
+const int kFrameHeaderSize = 4;
+
+// Frames larger than this are rejected and the connection is closed.
+const uint32 kMaxPayloadSize = 16 << 20;
+
+struct Request {
+  uint32 request_id = 0;
+  int method = 0;
+
+  // Name of the model to use. Empty selects the server's default model.
+  std::string model;
+
+  std::string context;
+  CodepointSpan span = {kInvalidIndex, kInvalidIndex};
+  std::string locales;
+  int64 reference_time_ms_utc = 0;
+  std::string reference_timezone;
+};
+
+struct Response {
+  uint32 request_id = 0;
+  int method = 0;
+  int status = STATUS_OK;
+  CodepointSpan selection = {kInvalidIndex, kInvalidIndex};
+  std::vector<ClassificationResult> classification;
+  std::vector<AnnotatedSpan> annotations;
+};
+
+// Appends a complete frame (header and payload) to 'frame'.
+void EncodeRequest(const Request& request, std::string* frame);
+void EncodeResponse(const Response& response, std::string* frame);
+
+// Decode a frame payload (without the header). Return false if the payload is
+// malformed. DecodeResponse needs to know the method of the request, which
+// the caller tracks by request id.
+bool DecodeRequest(StringPiece payload, Request* request);
+bool DecodeResponse(StringPiece payload, int method, Response* response);
+
+// Returns whether the span of the request is non-empty and lies within its
+// context, which has to be valid UTF-8. SuggestSelection and ClassifyText
+// requests with other spans are answered with STATUS_MALFORMED_REQUEST.
+bool HasValidSpan(const Request& request);
+
+// Reads the payload size from a frame header. 'data' must hold at least
+// kFrameHeaderSize bytes.
+uint32 DecodeFrameSize(const char* data);
+
+}  // namespace ipc
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_IPC_PROTOCOL_H_
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/ipc-protocol.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace ipc {
+namespace {
+
+StringPiece Payload(const std::string& frame) {
+  EXPECT_GE(frame.size(), kFrameHeaderSize);
+  EXPECT_EQ(DecodeFrameSize(frame.data()), frame.size() - kFrameHeaderSize);
+  return StringPiece(frame.data() + kFrameHeaderSize,
+                     frame.size() - kFrameHeaderSize);
+}
+
+TEST(IpcProtocolTest, RequestRoundTrip) {
+  Request request;
+  request.request_id = 0xDEADBEEF;
+  request.method = METHOD_CLASSIFY_TEXT;
+  request.model = "en";
+  request.context = "call me at (800) 123-456 today";
+  request.span = {11, 24};
+  request.locales = "en-US";
+  request.reference_time_ms_utc = -1234567890123LL;
+  request.reference_timezone = "Europe/Zurich";
+
+  std::string frame;
+  EncodeRequest(request, &frame);
+
+  Request decoded;
+  ASSERT_TRUE(DecodeRequest(Payload(frame), &decoded));
+  EXPECT_EQ(decoded.request_id, request.request_id);
+  EXPECT_EQ(decoded.method, request.method);
+  EXPECT_EQ(decoded.model, request.model);
+  EXPECT_EQ(decoded.context, request.context);
+  EXPECT_EQ(decoded.span, request.span);
+  EXPECT_EQ(decoded.locales, request.locales);
+  EXPECT_EQ(decoded.reference_time_ms_utc, request.reference_time_ms_utc);
+  EXPECT_EQ(decoded.reference_timezone, request.reference_timezone);
+
+  // Truncated payloads are rejected.
+  const StringPiece payload = Payload(frame);
+  EXPECT_FALSE(DecodeRequest(StringPiece(payload.data(), payload.size() - 1),
+                             &decoded));
+}
+
+TEST(IpcProtocolTest, AnnotateResponseRoundTrip) {
+  Response response;
+  response.request_id = 7;
+  response.method = METHOD_ANNOTATE;
+  AnnotatedSpan span;
+  span.span = {3, 9};
+  span.classification.emplace_back("date", 0.5);
+  span.classification.back().datetime_parse_result = {1514761200000LL,
+                                                      GRANULARITY_DAY};
+  response.annotations.push_back(span);
+  span.span = {12, 20};
+  span.classification = {ClassificationResult("phone", 1.0)};
+  response.annotations.push_back(span);
+
+  std::string frame;
+  EncodeResponse(response, &frame);
+
+  Response decoded;
+  ASSERT_TRUE(DecodeResponse(Payload(frame), METHOD_ANNOTATE, &decoded));
+  EXPECT_EQ(decoded.request_id, 7);
+  EXPECT_EQ(decoded.status, STATUS_OK);
+  ASSERT_EQ(decoded.annotations.size(), 2);
+  EXPECT_EQ(decoded.annotations[0].span, CodepointSpan(3, 9));
+  ASSERT_EQ(decoded.annotations[0].classification.size(), 1);
+  EXPECT_EQ(decoded.annotations[0].classification[0].collection, "date");
+  EXPECT_EQ(decoded.annotations[0].classification[0].score, 0.5);
+  EXPECT_EQ(decoded.annotations[0].classification[0].datetime_parse_result,
+            DatetimeParseResult(1514761200000LL, GRANULARITY_DAY));
+  EXPECT_EQ(decoded.annotations[1].span, CodepointSpan(12, 20));
+  EXPECT_EQ(decoded.annotations[1].classification[0].collection, "phone");
+}
+
+TEST(IpcProtocolTest, HasValidSpan) {
+  Request request;
+  request.context = "zürich 8000";
+  request.span = {0, 11};
+  EXPECT_TRUE(HasValidSpan(request));
+  request.span = {7, 11};
+  EXPECT_TRUE(HasValidSpan(request));
+
+  request.span = {-5, 3};
+  EXPECT_FALSE(HasValidSpan(request));
+  request.span = {7, 12};
+  EXPECT_FALSE(HasValidSpan(request));
+  request.span = {11, 11};
+  EXPECT_FALSE(HasValidSpan(request));
+  request.span = {3, 1};
+  EXPECT_FALSE(HasValidSpan(request));
+  request.span = {kInvalidIndex, kInvalidIndex};
+  EXPECT_FALSE(HasValidSpan(request));
+
+  request.context = "\xff 8000";
+  request.span = {0, 1};
+  EXPECT_FALSE(HasValidSpan(request));
+}
+
+TEST(IpcProtocolTest, ErrorResponseHasNoBody) {
+  Response response;
+  response.request_id = 3;
+  response.method = METHOD_SUGGEST_SELECTION;
+  response.status = STATUS_UNKNOWN_MODEL;
+
+  std::string frame;
+  EncodeResponse(response, &frame);
+  EXPECT_EQ(frame.size(), kFrameHeaderSize + 5);
+
+  Response decoded;
+  ASSERT_TRUE(
+      DecodeResponse(Payload(frame), METHOD_SUGGEST_SELECTION, &decoded));
+  EXPECT_EQ(decoded.status, STATUS_UNKNOWN_MODEL);
+}
+
+}  // namespace
+}  // namespace ipc
+}  // namespace libtextclassifier2
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/json.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/utf8/unicodetext.h"
+
+namespace libtextclassifier2 {
+
+const JsonValue* JsonValue::Find(const std::string& name) const {
+  if (type_ != OBJECT) {
+    return nullptr;
+  }
+  const auto it = object_value_.find(name);
+  if (it == object_value_.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+std::string JsonValue::GetString(const std::string& name,
+                                 const std::string& default_value) const {
+  const JsonValue* member = Find(name);
+  if (member == nullptr || member->type() != STRING) {
+    return default_value;
+  }
+  return member->AsString();
+}
+
+int64 JsonValue::GetInt64(const std::string& name, int64 default_value) const {
+  const JsonValue* member = Find(name);
+  if (member == nullptr || member->type() != NUMBER) {
+    return default_value;
+  }
+  return member->AsInt64();
+}
+
+// Recursive descent parser over a StringPiece.
+class JsonParser {
+ public:
+  explicit JsonParser(StringPiece text) : text_(text), pos_(0) {}
+
+  bool ParseDocument(JsonValue* value) {
+    if (!ParseValue(value, /*depth=*/0)) {
+      return false;
+    }
+    SkipWhitespace();
+    return pos_ == text_.size();
+  }
+
+ private:
+  static const int kMaxDepth = 64;
+
+  void SkipWhitespace() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' ||
+            text_[pos_] == '\r')) {
+      ++pos_;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  bool ConsumeLiteral(const char* literal) {
+    const size_t length = strlen(literal);
+    if (text_.size() - pos_ < length ||
+        strncmp(text_.data() + pos_, literal, length) != 0) {
+      return false;
+    }
+    pos_ += length;
+    return true;
+  }
+
+  bool ParseValue(JsonValue* value, int depth) {
+    if (depth > kMaxDepth) {
+      return false;
+    }
+    SkipWhitespace();
+    if (pos_ >= text_.size()) {
+      return false;
+    }
+    switch (text_[pos_]) {
+      case '{':
+        return ParseObject(value, depth);
+      case '[':
+        return ParseArray(value, depth);
+      case '"':
+        value->type_ = JsonValue::STRING;
+        return ParseString(&value->string_value_);
+      case 't':
+        value->type_ = JsonValue::BOOL;
+        value->bool_value_ = true;
+        return ConsumeLiteral("true");
+      case 'f':
+        value->type_ = JsonValue::BOOL;
+        value->bool_value_ = false;
+        return ConsumeLiteral("false");
+      case 'n':
+        value->type_ = JsonValue::NUL;
+        return ConsumeLiteral("null");
+      default:
+        return ParseNumber(value);
+    }
+  }
+
+  bool ParseObject(JsonValue* value, int depth) {
+    value->type_ = JsonValue::OBJECT;
+    ++pos_;
+    if (Consume('}')) {
+      return true;
+    }
+    do {
+      SkipWhitespace();
+      std::string name;
+      if (!ParseString(&name) || !Consume(':')) {
+        return false;
+      }
+      if (!ParseValue(&value->object_value_[name], depth + 1)) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  bool ParseArray(JsonValue* value, int depth) {
+    value->type_ = JsonValue::ARRAY;
+    ++pos_;
+    if (Consume(']')) {
+      return true;
+    }
+    do {
+      value->array_value_.emplace_back();
+      if (!ParseValue(&value->array_value_.back(), depth + 1)) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume(']');
+  }
+
+  bool ParseHex4(int* result) {
+    if (text_.size() - pos_ < 4) {
+      return false;
+    }
+    *result = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = text_[pos_++];
+      *result <<= 4;
+      if (c >= '0' && c <= '9') {
+        *result += c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        *result += c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        *result += c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ParseString(std::string* result) {
+    if (pos_ >= text_.size() || text_[pos_] != '"') {
+      return false;
+    }
+    ++pos_;
+    result->clear();
+    while (pos_ < text_.size()) {
+      const char c = text_[pos_++];
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        result->push_back(c);
+        continue;
+      }
+      if (pos_ >= text_.size()) {
+        return false;
+      }
+      const char escaped = text_[pos_++];
+      switch (escaped) {
+        case '"':
+        case '\\':
+        case '/':
+          result->push_back(escaped);
+          break;
+        case 'b':
+          result->push_back('\b');
+          break;
+        case 'f':
+          result->push_back('\f');
+          break;
+        case 'n':
+          result->push_back('\n');
+          break;
+        case 'r':
+          result->push_back('\r');
+          break;
+        case 't':
+          result->push_back('\t');
+          break;
+        case 'u': {
+          int codepoint;
+          if (!ParseHex4(&codepoint)) {
+            return false;
+          }
+          if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+            int low;
+            if (!ConsumeLiteral("\\u") || !ParseHex4(&low) || low < 0xDC00 ||
+                low > 0xDFFF) {
+              return false;
+            }
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+          } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+            // A low surrogate without a high surrogate before it.
+            return false;
+          }
+          UnicodeText encoded;
+          encoded.AppendCodepoint(codepoint);
+          result->append(encoded.data(), encoded.size_bytes());
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool ParseNumber(JsonValue* value) {
+    const size_t start = pos_;
+    while (pos_ < text_.size() &&
+           (isdigit(text_[pos_]) || text_[pos_] == '-' || text_[pos_] == '+' ||
+            text_[pos_] == '.' || text_[pos_] == 'e' || text_[pos_] == 'E')) {
+      ++pos_;
+    }
+    if (pos_ == start) {
+      return false;
+    }
+    const std::string number(text_.data() + start, pos_ - start);
+    char* end;
+    value->type_ = JsonValue::NUMBER;
+    value->number_value_ = strtod(number.c_str(), &end);
+    return *end == '\0';
+  }
+
+  const StringPiece text_;
+  size_t pos_;
+};
+
+bool ParseJson(StringPiece text, JsonValue* value) {
+  *value = JsonValue();
+  return JsonParser(text).ParseDocument(value);
+}
+
+void AppendJsonString(const std::string& value, std::string* out) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  out->push_back('"');
+  for (const char c : value) {
+    switch (c) {
+      case '"':
+        out->append("\\\"");
+        break;
+      case '\\':
+        out->append("\\\\");
+        break;
+      case '\n':
+        out->append("\\n");
+        break;
+      case '\r':
+        out->append("\\r");
+        break;
+      case '\t':
+        out->append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out->append("\\u00");
+          out->push_back(kHexDigits[(c >> 4) & 0xF]);
+          out->push_back(kHexDigits[c & 0xF]);
+        } else {
+          out->push_back(c);
+        }
+    }
+  }
+  out->push_back('"');
+}
+
+}  // namespace libtextclassifier2
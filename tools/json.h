@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Minimal JSON reading and writing for the command-line tools. Supports the
+// subset needed for the JSONL corpora the tools consume: objects, arrays,
+// strings (including \u escapes and surrogate pairs; unpaired surrogates are
+// rejected), numbers, booleans and null.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_JSON_H_
+#define LIBTEXTCLASSIFIER_TOOLS_JSON_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "util/base/integral_types.h"
+#include "util/strings/stringpiece.h"
+
+namespace libtextclassifier2 {
+
+class JsonValue {
+ public:
+  enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+  JsonValue() : type_(NUL), bool_value_(false), number_value_(0) {}
+
+  Type type() const { return type_; }
+  bool IsNull() const { return type_ == NUL; }
+
+  bool AsBool() const { return bool_value_; }
+  double AsDouble() const { return number_value_; }
+  int64 AsInt64() const { return static_cast<int64>(number_value_); }
+  const std::string& AsString() const { return string_value_; }
+  const std::vector<JsonValue>& AsArray() const { return array_value_; }
+  const std::map<std::string, JsonValue>& AsObject() const {
+    return object_value_;
+  }
+
+  // Returns the member with given name, or nullptr if this is not an object or
+  // the member does not exist.
+  const JsonValue* Find(const std::string& name) const;
+
+  // Convenience accessors for object members. Return 'default_value' if the
+  // member is missing or has a different type.
+  std::string GetString(const std::string& name,
+                        const std::string& default_value = "") const;
+  int64 GetInt64(const std::string& name, int64 default_value = 0) const;
+
+ private:
+  friend class JsonParser;
+
+  Type type_;
+  bool bool_value_;
+  double number_value_;
+  std::string string_value_;
+  std::vector<JsonValue> array_value_;
+  std::map<std::string, JsonValue> object_value_;
+};
+
+// Parses one JSON document from 'text'. Returns false on malformed input or
+// trailing garbage.
+bool ParseJson(StringPiece text, JsonValue* value);
+
+// Appends 'value' to 'out' as a quoted and escaped JSON string. The input is
+// expected to be valid UTF-8 and is copied through unchanged apart from the
+// characters JSON requires to be escaped.
+void AppendJsonString(const std::string& value, std::string* out);
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_JSON_H_
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/json.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+TEST(JsonTest, ParsesObject) {
+  JsonValue value;
+  ASSERT_TRUE(ParseJson(
+      R"({"context": "call me at 350 third street", "click": [11, 14],
+          "reference_time_ms_utc": 1514761200000, "flag": true, "x": null})",
+      &value));
+  EXPECT_EQ(value.type(), JsonValue::OBJECT);
+  EXPECT_EQ(value.GetString("context"), "call me at 350 third street");
+  EXPECT_EQ(value.GetInt64("reference_time_ms_utc"), 1514761200000LL);
+  EXPECT_EQ(value.GetString("missing", "default"), "default");
+  EXPECT_EQ(value.GetInt64("context", -1), -1);
+
+  const JsonValue* click = value.Find("click");
+  ASSERT_NE(click, nullptr);
+  ASSERT_EQ(click->AsArray().size(), 2);
+  EXPECT_EQ(click->AsArray()[0].AsInt64(), 11);
+  EXPECT_EQ(click->AsArray()[1].AsInt64(), 14);
+
+  EXPECT_TRUE(value.Find("flag")->AsBool());
+  EXPECT_TRUE(value.Find("x")->IsNull());
+}
+
+TEST(JsonTest, ParsesEscapes) {
+  JsonValue value;
+  ASSERT_TRUE(ParseJson(R"("a\"b\\c\ndé😀")", &value));
+  EXPECT_EQ(value.AsString(), "a\"b\\c\nd\xC3\xA9\xF0\x9F\x98\x80");
+}
+
+TEST(JsonTest, RejectsMalformed) {
+  JsonValue value;
+  EXPECT_FALSE(ParseJson("", &value));
+  EXPECT_FALSE(ParseJson("{", &value));
+  EXPECT_FALSE(ParseJson(R"({"a": 1,})", &value));
+  EXPECT_FALSE(ParseJson(R"({"a": 1} x)", &value));
+  EXPECT_FALSE(ParseJson(R"("\ud83d")", &value));
+  EXPECT_FALSE(ParseJson(R"("\udc00")", &value));
+  EXPECT_FALSE(ParseJson(R"("\ude00\ud83d")", &value));
+  EXPECT_FALSE(ParseJson("[1, 2", &value));
+}
+
+TEST(JsonTest, AppendJsonStringRoundTrips) {
+  const std::string original = "tab\there \"quoted\" \\ \x01 \xC3\xA9";
+  std::string serialized;
+  AppendJsonString(original, &serialized);
+  EXPECT_EQ(serialized, "\"tab\\there \\\"quoted\\\" \\\\ \\u0001 \xC3\xA9\"");
+
+  JsonValue value;
+  ASSERT_TRUE(ParseJson(serialized, &value));
+  EXPECT_EQ(value.AsString(), original);
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
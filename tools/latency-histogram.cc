@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/latency-histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace libtextclassifier2 {
+namespace {
+
+const int kSubBucketCount = 1 << LatencyHistogram::kSubBucketBits;
+
+// Values up to 2^63 - 1: the linear range plus one group of sub-buckets for
+// each power of two above it.
+const int kNumBuckets =
+    kSubBucketCount * (64 - LatencyHistogram::kSubBucketBits + 1);
+
+int HighestBitSet(uint64 value) {
+  int result = 0;
+  while (value >>= 1) {
+    ++result;
+  }
+  return result;
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(kNumBuckets, 0),
+      count_(0),
+      sum_(0),
+      min_(std::numeric_limits<int64>::max()),
+      max_(0) {}
+
+int LatencyHistogram::BucketIndex(int64 value) {
+  if (value < kSubBucketCount) {
+    return value;
+  }
+  // Group g >= 1 covers [2^(g + kSubBucketBits - 1), 2^(g + kSubBucketBits)),
+  // at a resolution of 2^(g - 1).
+  const int group = HighestBitSet(value) - kSubBucketBits + 1;
+  return group * kSubBucketCount +
+         static_cast<int>(value >> (group - 1)) - kSubBucketCount;
+}
+
+int64 LatencyHistogram::HighestEquivalentValue(int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  const int group = index / kSubBucketCount;
+  const int64 sub_bucket = index % kSubBucketCount + kSubBucketCount;
+  return ((sub_bucket + 1) << (group - 1)) - 1;
+}
+
+void LatencyHistogram::Record(int64 value) {
+  value = std::max<int64>(value, 0);
+  ++counts_[BucketIndex(value)];
+  ++count_;
+  sum_ += value;
+  min_ = std::min(min_, value);
+  max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (int i = 0; i < kNumBuckets; ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+int64 LatencyHistogram::ValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  const int64 target = std::max<int64>(
+      1, static_cast<int64>(std::ceil(percentile / 100.0 * count_)));
+  int64 seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += counts_[i];
+    if (seen >= target) {
+      return std::min(HighestEquivalentValue(i), max_);
+    }
+  }
+  return max_;
+}
+
+}  // namespace libtextclassifier2
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Log-linear latency histogram in the style of HdrHistogram.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_LATENCY_HISTOGRAM_H_
+#define LIBTEXTCLASSIFIER_TOOLS_LATENCY_HISTOGRAM_H_
+
+#include <vector>
+
+#include "util/base/integral_types.h"
+
+namespace libtextclassifier2 {
+
+// Records non-negative integer values (e.g. microseconds) with a bounded
+// relative error. Values below 2^kSubBucketBits are recorded exactly, larger
+// values fall into one of 2^kSubBucketBits linear sub-buckets of their power of
+// two, which bounds the relative error by 2^-kSubBucketBits (< 1%).
+// Recording is O(1) and allocation-free; histograms from several threads can
+// be merged afterwards.
+// NOTE: This class is not thread-safe, use one instance per thread.
+class LatencyHistogram {
+ public:
+  static const int kSubBucketBits = 7;
+
+  LatencyHistogram();
+
+  // Records one value. Negative values are recorded as zero.
+  void Record(int64 value);
+
+  // Adds all values recorded in 'other' to this histogram.
+  void Merge(const LatencyHistogram& other);
+
+  // Returns the smallest recorded value v such that at least 'percentile'
+  // percent of the values are <= v, up to the histogram resolution. Returns 0
+  // for an empty histogram.
+  int64 ValueAtPercentile(double percentile) const;
+
+  int64 count() const { return count_; }
+  int64 min() const { return count_ == 0 ? 0 : min_; }
+  int64 max() const { return max_; }
+  double mean() const {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+  }
+
+ private:
+  static int BucketIndex(int64 value);
+
+  // Returns the largest value that maps to the bucket with given index.
+  static int64 HighestEquivalentValue(int index);
+
+  std::vector<int64> counts_;
+  int64 count_;
+  int64 sum_;
+  int64 min_;
+  int64 max_;
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_LATENCY_HISTOGRAM_H_
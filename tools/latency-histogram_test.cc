@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/latency-histogram.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.ValueAtPercentile(50), 0);
+  EXPECT_EQ(histogram.min(), 0);
+  EXPECT_EQ(histogram.max(), 0);
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 100; ++i) {
+    histogram.Record(i);
+  }
+  EXPECT_EQ(histogram.count(), 100);
+  EXPECT_EQ(histogram.ValueAtPercentile(50), 50);
+  EXPECT_EQ(histogram.ValueAtPercentile(90), 90);
+  EXPECT_EQ(histogram.ValueAtPercentile(99), 99);
+  EXPECT_EQ(histogram.ValueAtPercentile(100), 100);
+  EXPECT_EQ(histogram.min(), 1);
+  EXPECT_EQ(histogram.max(), 100);
+  EXPECT_DOUBLE_EQ(histogram.mean(), 50.5);
+}
+
+TEST(LatencyHistogramTest, LargeValuesWithinRelativeError) {
+  LatencyHistogram spread;
+  for (int i = 0; i < 1000; ++i) {
+    spread.Record(1000000 + i * 1000);
+  }
+  const int64 p50 = spread.ValueAtPercentile(50);
+  EXPECT_GE(p50, 1499000);
+  EXPECT_LE(p50, 1499000 + 1499000 / (1 << LatencyHistogram::kSubBucketBits));
+}
+
+TEST(LatencyHistogramTest, Merge) {
+  LatencyHistogram a;
+  LatencyHistogram b;
+  for (int i = 0; i < 50; ++i) {
+    a.Record(10);
+    b.Record(20);
+  }
+  a.Merge(b);
+  EXPECT_EQ(a.count(), 100);
+  EXPECT_EQ(a.ValueAtPercentile(50), 10);
+  EXPECT_EQ(a.ValueAtPercentile(51), 20);
+  EXPECT_EQ(a.min(), 10);
+  EXPECT_EQ(a.max(), 20);
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a corpus against a model and reports throughput, latency percentiles
+// and peak memory.
+//
+// Usage:
+//   textclassifier_load_generator --model=<path> --corpus=<path.jsonl>
+//       [--threads=1] [--qps=0] [--num_requests=<corpus size>]
+//       [--duration_s=0] [--warmup_requests=0] [--mix=1:1:1]
+//       [--token_embedding_cache_size=0] [--unpack_quantized_embeddings=0]
+//       [--result_cache_size=0] [--num_init_threads=1]
+//       [--num_inference_threads=1] [--regex_time_limit=0]
+//       [--regex_stack_limit_bytes=0] [--regex_budget_ms=0]
+//       [--load_locales=<comma-separated BCP 47 tags>]
+//
+// The corpus is JSONL, one request per line:
+//   {"context": "...", "click": [begin, end], "locales": "en",
+//    "reference_time_ms_utc": 0, "reference_timezone": "Europe/Zurich"}
+// Only "context" is required. The click is a non-empty span of codepoints
+// within the context; corpora with other clicks are rejected. Entries without
+// "click" are always replayed as Annotate requests.
+//
+// --mix gives the relative weights of SuggestSelection, ClassifyText and
+// Annotate. With --qps=0 every thread issues requests back to back (closed
+// loop). With --qps>0 requests are issued on a fixed global schedule (open
+// loop), and latency is measured from the scheduled start time so that queueing
+// caused by a slow server shows up in the percentiles.
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "text-classifier.h"
+#include "tools/json.h"
+#include "tools/latency-histogram.h"
+#include "util/strings/numbers.h"
+#include "util/strings/split.h"
+#include "util/utf8/unicodetext.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+enum Operation {
+  SUGGEST_SELECTION = 0,
+  CLASSIFY_TEXT,
+  ANNOTATE,
+  NUM_OPERATIONS,
+};
+
+const char* const kOperationNames[NUM_OPERATIONS] = {
+    "SuggestSelection", "ClassifyText", "Annotate"};
+
+struct Flags {
+  std::string model;
+  std::string corpus;
+  int threads = 1;
+  double qps = 0;
+  int64 num_requests = 0;
+  double duration_s = 0;
+  int64 warmup_requests = 0;
+  double mix[NUM_OPERATIONS] = {1, 1, 1};
+  LoadOptions load_options;
+};
+
+struct CorpusEntry {
+  std::string context;
+  bool has_click = false;
+  CodepointSpan click = {kInvalidIndex, kInvalidIndex};
+  std::string locales;
+  int64 reference_time_ms_utc = 0;
+  std::string reference_timezone;
+};
+
+struct WorkerStats {
+  LatencyHistogram latency_us[NUM_OPERATIONS];
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: textclassifier_load_generator --model=<path> "
+          "--corpus=<path.jsonl> [--threads=N] [--qps=X] [--num_requests=N] "
+          "[--duration_s=X] [--warmup_requests=N] [--mix=sel:cls:ann] "
+          "[--token_embedding_cache_size=N] "
+          "[--unpack_quantized_embeddings=0|1] [--result_cache_size=N] "
+          "[--num_init_threads=N] [--num_inference_threads=N] "
+          "[--regex_time_limit=N] [--regex_stack_limit_bytes=N] "
+          "[--regex_budget_ms=N] [--load_locales=en,de]\n");
+}
+
+bool ParseMix(const std::string& value, double mix[NUM_OPERATIONS]) {
+  const std::vector<StringPiece> parts = strings::Split(value, ':');
+  if (parts.size() != NUM_OPERATIONS) {
+    return false;
+  }
+  double total = 0;
+  for (int i = 0; i < NUM_OPERATIONS; ++i) {
+    if (!ParseDouble(parts[i].ToString().c_str(), &mix[i]) || mix[i] < 0) {
+      return false;
+    }
+    total += mix[i];
+  }
+  return total > 0;
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      TC_LOG(ERROR) << "Malformed argument: " << arg;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    int32 int_value;
+    bool ok = true;
+    if (name == "model") {
+      flags->model = value;
+    } else if (name == "corpus") {
+      flags->corpus = value;
+    } else if (name == "threads") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value > 0;
+      flags->threads = int_value;
+    } else if (name == "qps") {
+      ok = ParseDouble(value.c_str(), &flags->qps) && flags->qps >= 0;
+    } else if (name == "num_requests") {
+      ok = ParseInt64(value.c_str(), &flags->num_requests) &&
+           flags->num_requests >= 0;
+    } else if (name == "duration_s") {
+      ok = ParseDouble(value.c_str(), &flags->duration_s) &&
+           flags->duration_s >= 0;
+    } else if (name == "warmup_requests") {
+      ok = ParseInt64(value.c_str(), &flags->warmup_requests) &&
+           flags->warmup_requests >= 0;
+    } else if (name == "mix") {
+      ok = ParseMix(value, flags->mix);
+    } else if (name == "token_embedding_cache_size") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value >= 0;
+      flags->load_options.token_embedding_cache_size = int_value;
+    } else if (name == "unpack_quantized_embeddings") {
+      ok = ParseInt32(value.c_str(), &int_value) &&
+           (int_value == 0 || int_value == 1);
+      flags->load_options.unpack_quantized_embeddings = int_value == 1;
+    } else if (name == "result_cache_size") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value >= 0;
+      flags->load_options.result_cache_size = int_value;
+    } else if (name == "num_init_threads") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value > 0;
+      flags->load_options.num_init_threads = int_value;
+    } else if (name == "num_inference_threads") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value > 0;
+      flags->load_options.num_inference_threads = int_value;
+    } else if (name == "regex_time_limit") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value >= 0;
+      flags->load_options.regex_time_limit = int_value;
+    } else if (name == "regex_stack_limit_bytes") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value >= 0;
+      flags->load_options.regex_stack_limit_bytes = int_value;
+    } else if (name == "regex_budget_ms") {
+      ok = ParseInt32(value.c_str(), &int_value) && int_value >= 0;
+      flags->load_options.regex_budget_ms = int_value;
+    } else if (name == "load_locales") {
+      flags->load_options.locales = value;
+    } else {
+      TC_LOG(ERROR) << "Unknown flag: " << name;
+      return false;
+    }
+    if (!ok) {
+      TC_LOG(ERROR) << "Invalid value for --" << name << ": " << value;
+      return false;
+    }
+  }
+  return !flags->model.empty() && !flags->corpus.empty();
+}
+
+bool ReadCorpus(const std::string& path, std::vector<CorpusEntry>* corpus) {
+  std::ifstream input(path);
+  if (!input) {
+    TC_LOG(ERROR) << "Could not open corpus: " << path;
+    return false;
+  }
+  std::string line;
+  int line_number = 0;
+  while (std::getline(input, line)) {
+    ++line_number;
+    if (line.empty()) {
+      continue;
+    }
+    JsonValue json;
+    if (!ParseJson(line, &json) || json.Find("context") == nullptr) {
+      TC_LOG(ERROR) << "Malformed corpus line " << line_number;
+      return false;
+    }
+    CorpusEntry entry;
+    entry.context = json.GetString("context");
+    entry.locales = json.GetString("locales");
+    entry.reference_time_ms_utc = json.GetInt64("reference_time_ms_utc");
+    entry.reference_timezone = json.GetString("reference_timezone");
+    const JsonValue* click = json.Find("click");
+    if (click != nullptr && click->type() == JsonValue::ARRAY &&
+        click->AsArray().size() == 2) {
+      const int64 begin = click->AsArray()[0].AsInt64();
+      const int64 end = click->AsArray()[1].AsInt64();
+      const UnicodeText context_unicode =
+          UTF8ToUnicodeText(entry.context, /*do_copy=*/false);
+      if (!context_unicode.is_valid() || begin < 0 || begin >= end ||
+          end > context_unicode.size_codepoints()) {
+        TC_LOG(ERROR) << "Click outside of the context on corpus line "
+                      << line_number;
+        return false;
+      }
+      entry.has_click = true;
+      entry.click = {static_cast<int>(begin), static_cast<int>(end)};
+    }
+    corpus->push_back(std::move(entry));
+  }
+  if (corpus->empty()) {
+    TC_LOG(ERROR) << "Empty corpus: " << path;
+    return false;
+  }
+  return true;
+}
+
+// Picks the operation for the given request using the configured weights.
+Operation PickOperation(const Flags& flags, const CorpusEntry& entry,
+                        std::mt19937* random) {
+  if (!entry.has_click) {
+    return ANNOTATE;
+  }
+  std::discrete_distribution<int> distribution(flags.mix,
+                                               flags.mix + NUM_OPERATIONS);
+  return static_cast<Operation>(distribution(*random));
+}
+
+// Runs one request. The results are consumed so that the work cannot be
+// optimized away; the returned value is otherwise meaningless.
+int RunRequest(const TextClassifier& classifier, const CorpusEntry& entry,
+               Operation operation) {
+  switch (operation) {
+    case SUGGEST_SELECTION: {
+      SelectionOptions options;
+      options.locales = entry.locales;
+      const CodepointSpan selection =
+          classifier.SuggestSelection(entry.context, entry.click, options);
+      return selection.second - selection.first;
+    }
+    case CLASSIFY_TEXT: {
+      ClassificationOptions options;
+      options.locales = entry.locales;
+      options.reference_time_ms_utc = entry.reference_time_ms_utc;
+      options.reference_timezone = entry.reference_timezone;
+      return classifier.ClassifyText(entry.context, entry.click, options)
+          .size();
+    }
+    case ANNOTATE: {
+      AnnotationOptions options;
+      options.locales = entry.locales;
+      options.reference_time_ms_utc = entry.reference_time_ms_utc;
+      options.reference_timezone = entry.reference_timezone;
+      return classifier.Annotate(entry.context, options).size();
+    }
+    default:
+      return 0;
+  }
+}
+
+void RunWorker(const TextClassifier& classifier,
+               const std::vector<CorpusEntry>& corpus, const Flags& flags,
+               int worker_id, int64 num_requests, Clock::time_point start,
+               Clock::time_point deadline, std::atomic<int64>* next_request,
+               std::atomic<int64>* checksum, WorkerStats* stats) {
+  std::mt19937 random(worker_id);
+  int64 local_checksum = 0;
+  while (true) {
+    const int64 request = next_request->fetch_add(1);
+    if (num_requests > 0 && request >= num_requests) {
+      break;
+    }
+
+    Clock::time_point request_start = Clock::now();
+    if (flags.qps > 0) {
+      const Clock::time_point scheduled =
+          start + std::chrono::duration_cast<Clock::duration>(
+                      std::chrono::duration<double>(request / flags.qps));
+      std::this_thread::sleep_until(scheduled);
+      request_start = scheduled;
+    }
+    if (request_start >= deadline) {
+      break;
+    }
+
+    const CorpusEntry& entry = corpus[request % corpus.size()];
+    const Operation operation = PickOperation(flags, entry, &random);
+    local_checksum += RunRequest(classifier, entry, operation);
+    const Clock::time_point request_end = Clock::now();
+    stats->latency_us[operation].Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(request_end -
+                                                              request_start)
+            .count());
+  }
+  checksum->fetch_add(local_checksum);
+}
+
+void PrintHistogram(const char* name, const LatencyHistogram& histogram) {
+  printf("%-18s %10lld %10.0f %10lld %10lld %10lld %10lld %10lld\n", name,
+         static_cast<long long>(histogram.count()), histogram.mean(),
+         static_cast<long long>(histogram.ValueAtPercentile(50)),
+         static_cast<long long>(histogram.ValueAtPercentile(90)),
+         static_cast<long long>(histogram.ValueAtPercentile(99)),
+         static_cast<long long>(histogram.ValueAtPercentile(99.9)),
+         static_cast<long long>(histogram.max()));
+}
+
+int64 PeakRssKb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return -1;
+  }
+  // Kilobytes on Linux.
+  return usage.ru_maxrss;
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::vector<CorpusEntry> corpus;
+  if (!ReadCorpus(flags.corpus, &corpus)) {
+    return 1;
+  }
+
+  const Clock::time_point load_start = Clock::now();
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromPath(flags.model, /*unilib=*/nullptr,
+                               flags.load_options);
+  if (!classifier || !classifier->IsInitialized()) {
+    TC_LOG(ERROR) << "Could not load model: " << flags.model;
+    return 1;
+  }
+  const double load_ms = std::chrono::duration<double, std::milli>(
+                             Clock::now() - load_start)
+                             .count();
+  const int64 rss_after_load_kb = PeakRssKb();
+
+  std::mt19937 warmup_random(flags.threads);
+  for (int64 i = 0; i < flags.warmup_requests; ++i) {
+    const CorpusEntry& entry = corpus[i % corpus.size()];
+    RunRequest(*classifier, entry, PickOperation(flags, entry, &warmup_random));
+  }
+
+  int64 num_requests = flags.num_requests;
+  if (num_requests == 0 && flags.duration_s == 0) {
+    num_requests = corpus.size();
+  }
+
+  std::vector<WorkerStats> stats(flags.threads);
+  std::vector<std::thread> workers;
+  std::atomic<int64> next_request(0);
+  std::atomic<int64> checksum(0);
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point deadline =
+      flags.duration_s > 0
+          ? start + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(flags.duration_s))
+          : Clock::time_point::max();
+  for (int i = 0; i < flags.threads; ++i) {
+    workers.emplace_back(RunWorker, std::cref(*classifier), std::cref(corpus),
+                         std::cref(flags), i, num_requests, start, deadline,
+                         &next_request, &checksum, &stats[i]);
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  const double elapsed_s =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  LatencyHistogram total;
+  LatencyHistogram per_operation[NUM_OPERATIONS];
+  for (const WorkerStats& worker_stats : stats) {
+    for (int i = 0; i < NUM_OPERATIONS; ++i) {
+      per_operation[i].Merge(worker_stats.latency_us[i]);
+      total.Merge(worker_stats.latency_us[i]);
+    }
+  }
+
+  printf("model:       %s (loaded in %.1f ms)\n", flags.model.c_str(), load_ms);
+  printf("corpus:      %s (%zu entries)\n", flags.corpus.c_str(),
+         corpus.size());
+  printf("mode:        %s, %d thread(s)\n",
+         flags.qps > 0 ? "open loop" : "closed loop", flags.threads);
+  if (flags.qps > 0) {
+    printf("target:      %.1f requests/s\n", flags.qps);
+  }
+  printf("throughput:  %.1f requests/s (%lld requests in %.3f s)\n",
+         total.count() / elapsed_s, static_cast<long long>(total.count()),
+         elapsed_s);
+  printf("peak RSS:    %lld KB (%lld KB after model load)\n",
+         static_cast<long long>(PeakRssKb()),
+         static_cast<long long>(rss_after_load_kb));
+  if (flags.load_options.token_embedding_cache_size > 0) {
+    const TokenEmbeddingCache::Stats cache_stats =
+        classifier->GetTokenEmbeddingCacheStats();
+    const int64 lookups = cache_stats.hits + cache_stats.misses;
+    printf("embeddings:  %.1f%% cache hits (%lld lookups, %d cached)\n",
+           lookups > 0 ? 100.0 * cache_stats.hits / lookups : 0.0,
+           static_cast<long long>(lookups), cache_stats.size);
+  }
+  if (flags.load_options.result_cache_size > 0) {
+    const ResultCache::Stats cache_stats = classifier->GetResultCacheStats();
+    const int64 lookups = cache_stats.hits + cache_stats.misses;
+    printf("results:     %.1f%% cache hits (%lld lookups, %d cached)\n",
+           lookups > 0 ? 100.0 * cache_stats.hits / lookups : 0.0,
+           static_cast<long long>(lookups), cache_stats.size);
+  }
+  if (flags.load_options.regex_time_limit > 0 ||
+      flags.load_options.regex_stack_limit_bytes > 0 ||
+      flags.load_options.regex_budget_ms > 0) {
+    const TextClassifier::RegexLimitStats regex_stats =
+        classifier->GetRegexLimitStats();
+    int64 overruns = 0;
+    for (const auto& pattern_overruns : regex_stats.regex_overruns) {
+      overruns += pattern_overruns.second;
+    }
+    for (const auto& rule_overruns : regex_stats.datetime_overruns) {
+      overruns += rule_overruns.second;
+    }
+    printf("regex:       %lld limit overruns, %lld exhausted budgets\n",
+           static_cast<long long>(overruns),
+           static_cast<long long>(regex_stats.exhausted_budgets));
+  }
+  if (flags.load_options.unpack_quantized_embeddings) {
+    printf("unpacked:    %lld KB embedding table\n",
+           static_cast<long long>(classifier->GetUnpackedEmbeddingsBytes() /
+                                  1024));
+  }
+  printf("checksum:    %lld\n\n", static_cast<long long>(checksum.load()));
+  printf("%-18s %10s %10s %10s %10s %10s %10s %10s\n", "latency (us)", "count",
+         "mean", "p50", "p90", "p99", "p99.9", "max");
+  for (int i = 0; i < NUM_OPERATIONS; ++i) {
+    if (per_operation[i].count() > 0) {
+      PrintHistogram(kOperationNames[i], per_operation[i]);
+    }
+  }
+  PrintHistogram("all", total);
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
+
+int main(int argc, char** argv) { return libtextclassifier2::Run(argc, argv); }
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/model-slimmer.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "text-classifier.h"
+#include "tools/model-tables.h"
+#include "util/base/logging.h"
+#include "util/i18n/locale.h"
+#include "zlib-utils.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+bool Contains(const std::vector<std::string>& list, const std::string& value) {
+  return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+// Returns the modes of a pattern whose results are not filtered out by the
+// output options. The classification mode is always kept: a match of a
+// filtered pattern makes ClassifyText return "other", instead of falling back
+// to the datetime model or the classification model.
+int UnfilteredModes(const OutputOptionsT* output_options,
+                    const std::string& collection, int modes) {
+  if (output_options == nullptr) {
+    return modes;
+  }
+  if (Contains(output_options->filtered_collections_annotation, collection)) {
+    modes &= ~ModeFlag_ANNOTATION;
+  }
+  if (Contains(output_options->filtered_collections_selection, collection)) {
+    modes &= ~ModeFlag_SELECTION;
+  }
+  return modes;
+}
+
+// Returns the ids of the datetime locales used by the profile, expanded in the
+// same way as in DatetimeParser::ParseAndExpandLocales.
+std::unordered_set<int> UsedLocaleIds(const DatetimeModelT& datetime_model,
+                                      const std::vector<std::string>& tags) {
+  std::unordered_set<int> result(datetime_model.default_locales.begin(),
+                                 datetime_model.default_locales.end());
+  const auto add_locale = [&datetime_model, &result](const std::string& name) {
+    for (int i = 0; i < datetime_model.locales.size(); ++i) {
+      if (datetime_model.locales[i] == name) {
+        result.insert(i);
+      }
+    }
+  };
+  for (const std::string& tag : tags) {
+    add_locale(tag);
+    const Locale locale = Locale::FromBCP47(tag);
+    if (!locale.IsValid()) {
+      continue;
+    }
+    if (!locale.Region().empty()) {
+      add_locale("*-" + locale.Region());
+    }
+    if (!locale.Script().empty()) {
+      add_locale(locale.Language() + "-" + locale.Script() + "-*");
+    }
+    if (!locale.Language().empty()) {
+      add_locale(locale.Language() + "-*");
+    }
+  }
+  return result;
+}
+
+bool UsesAnyLocale(const std::vector<int32_t>& locales,
+                   const std::unordered_set<int>& used_locale_ids) {
+  for (const int locale : locales) {
+    if (used_locale_ids.count(locale)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Finds the first compressed rule of the model, and returns whether the rules
+// are compressed, and whether they are compressed independently.
+void GetCompression(const ModelT& model, bool* compressed, bool* independent) {
+  const CompressedBufferT* buffer = nullptr;
+  if (model.regex_model != nullptr) {
+    for (const auto& pattern : model.regex_model->patterns) {
+      if (buffer == nullptr) {
+        buffer = pattern->compressed_pattern.get();
+      }
+    }
+  }
+  if (model.datetime_model != nullptr) {
+    for (const auto& pattern : model.datetime_model->patterns) {
+      for (const auto& regex : pattern->regexes) {
+        if (buffer == nullptr) {
+          buffer = regex->compressed_pattern.get();
+        }
+      }
+    }
+    for (const auto& extractor : model.datetime_model->extractors) {
+      if (buffer == nullptr) {
+        buffer = extractor->compressed_pattern.get();
+      }
+    }
+  }
+  *compressed = buffer != nullptr;
+  *independent = buffer != nullptr && buffer->independent;
+}
+
+}  // namespace
+
+bool SlimModel(const SlimmingProfile& profile, ModelT* model,
+               SlimmingStats* stats) {
+  SlimmingStats unused_stats;
+  if (stats == nullptr) {
+    stats = &unused_stats;
+  }
+
+  bool compressed;
+  bool independent;
+  GetCompression(*model, &compressed, &independent);
+  if (!DecompressModel(model)) {
+    TC_LOG(ERROR) << "Cannot decompress model.";
+    return false;
+  }
+
+  model->enabled_modes =
+      static_cast<ModeFlag>(model->enabled_modes & profile.enabled_modes);
+  const bool keep_all_collections = profile.collections.empty();
+
+  if (model->regex_model != nullptr) {
+    auto& patterns = model->regex_model->patterns;
+    for (const auto& pattern : patterns) {
+      pattern->enabled_modes = static_cast<ModeFlag>(
+          UnfilteredModes(model->output_options.get(), pattern->collection_name,
+                          pattern->enabled_modes) &
+          model->enabled_modes);
+    }
+    const auto is_unused =
+        [&profile, keep_all_collections](
+            const std::unique_ptr<RegexModel_::PatternT>& pattern) {
+          return pattern->enabled_modes == ModeFlag_NONE ||
+                 (!keep_all_collections &&
+                  !Contains(profile.collections, pattern->collection_name));
+        };
+    const auto new_end =
+        std::remove_if(patterns.begin(), patterns.end(), is_unused);
+    stats->removed_regex_patterns = patterns.end() - new_end;
+    patterns.erase(new_end, patterns.end());
+  }
+
+  if (model->datetime_model != nullptr && !keep_all_collections &&
+      !Contains(profile.collections, TextClassifier::kDateCollection)) {
+    stats->removed_datetime_patterns = model->datetime_model->patterns.size();
+    stats->removed_datetime_extractors =
+        model->datetime_model->extractors.size();
+    model->datetime_model.reset();
+  }
+
+  if (model->datetime_model != nullptr) {
+    const bool keep_all_locales = profile.locales.empty();
+    const std::unordered_set<int> used_locale_ids =
+        UsedLocaleIds(*model->datetime_model, profile.locales);
+
+    auto& patterns = model->datetime_model->patterns;
+    for (const auto& pattern : patterns) {
+      pattern->enabled_modes =
+          static_cast<ModeFlag>(pattern->enabled_modes & model->enabled_modes);
+    }
+    const auto is_unused_pattern =
+        [keep_all_locales, &used_locale_ids](
+            const std::unique_ptr<DatetimeModelPatternT>& pattern) {
+          return pattern->enabled_modes == ModeFlag_NONE ||
+                 (!keep_all_locales &&
+                  !UsesAnyLocale(pattern->locales, used_locale_ids));
+        };
+    const auto new_patterns_end =
+        std::remove_if(patterns.begin(), patterns.end(), is_unused_pattern);
+    stats->removed_datetime_patterns = patterns.end() - new_patterns_end;
+    patterns.erase(new_patterns_end, patterns.end());
+
+    // The locale ids index the list of locales, so the list is kept whole.
+    auto& extractors = model->datetime_model->extractors;
+    const auto is_unused_extractor =
+        [keep_all_locales, &used_locale_ids](
+            const std::unique_ptr<DatetimeModelExtractorT>& extractor) {
+          return !keep_all_locales &&
+                 !UsesAnyLocale(extractor->locales, used_locale_ids);
+        };
+    const auto new_extractors_end = std::remove_if(
+        extractors.begin(), extractors.end(), is_unused_extractor);
+    stats->removed_datetime_extractors = extractors.end() - new_extractors_end;
+    extractors.erase(new_extractors_end, extractors.end());
+
+    // The precomputed tables refer to the rules by their position.
+    const DatetimeModelT& datetime_model = *model->datetime_model;
+    if (!datetime_model.sorted_locale_ids.empty() ||
+        !datetime_model.locale_rules_start.empty() ||
+        !datetime_model.extractor_rules.empty()) {
+      AddDatetimeTables(model->datetime_model.get());
+    }
+  }
+
+  if (compressed && !CompressModel(model, independent)) {
+    TC_LOG(ERROR) << "Cannot compress model.";
+    return false;
+  }
+  return true;
+}
+
+std::string SerializeSlimModel(const ModelT& model) {
+  // The buffer is built from its end, so the sections are created in the
+  // reverse of their order in the buffer.
+  flatbuffers::FlatBufferBuilder builder;
+
+  // The alignment is relative to the end of the buffer, and also aligns the
+  // size of the finished buffer.
+  flatbuffers::Offset<flatbuffers::Vector<uint8_t>> embedding_model = 0;
+  if (!model.embedding_model.empty()) {
+    builder.PreAlign(model.embedding_model.size(), kEmbeddingModelAlignment);
+    embedding_model = builder.CreateVector(model.embedding_model);
+  }
+
+  // Read once, when the model is loaded.
+  const auto datetime_model =
+      model.datetime_model
+          ? CreateDatetimeModel(builder, model.datetime_model.get())
+          : 0;
+  const auto regex_model =
+      model.regex_model ? CreateRegexModel(builder, model.regex_model.get())
+                        : 0;
+
+  // Read on every request.
+  const auto classification_model =
+      model.classification_model.empty()
+          ? 0
+          : builder.CreateVector(model.classification_model);
+  const auto selection_model =
+      model.selection_model.empty()
+          ? 0
+          : builder.CreateVector(model.selection_model);
+  const auto classification_feature_options =
+      model.classification_feature_options
+          ? CreateFeatureProcessorOptions(
+                builder, model.classification_feature_options.get())
+          : 0;
+  const auto selection_feature_options =
+      model.selection_feature_options
+          ? CreateFeatureProcessorOptions(
+                builder, model.selection_feature_options.get())
+          : 0;
+  const auto output_options =
+      model.output_options
+          ? CreateOutputOptions(builder, model.output_options.get())
+          : 0;
+  const auto triggering_options =
+      model.triggering_options
+          ? CreateModelTriggeringOptions(builder,
+                                         model.triggering_options.get())
+          : 0;
+  const auto classification_options =
+      model.classification_options
+          ? CreateClassificationModelOptions(
+                builder, model.classification_options.get())
+          : 0;
+  const auto selection_options =
+      model.selection_options
+          ? CreateSelectionModelOptions(builder, model.selection_options.get())
+          : 0;
+  const auto embedding_bucket_rows =
+      model.embedding_bucket_rows.empty()
+          ? 0
+          : builder.CreateVector(model.embedding_bucket_rows);
+  const auto name = model.name.empty() ? 0 : builder.CreateString(model.name);
+  const auto locales =
+      model.locales.empty() ? 0 : builder.CreateString(model.locales);
+
+  FinishModelBuffer(
+      builder,
+      CreateModel(builder, locales, model.version, name,
+                  selection_feature_options, classification_feature_options,
+                  selection_model, classification_model, embedding_model,
+                  selection_options, classification_options, regex_model,
+                  datetime_model, triggering_options, model.enabled_modes,
+                  model.snap_whitespace_selections, output_options,
+                  embedding_bucket_rows));
+  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                     builder.GetSize());
+}
+
+}  // namespace libtextclassifier2
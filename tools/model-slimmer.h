@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Offline reduction of a model to the part a deployment actually uses.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_MODEL_SLIMMER_H_
+#define LIBTEXTCLASSIFIER_TOOLS_MODEL_SLIMMER_H_
+
+#include <string>
+#include <vector>
+
+#include "model_generated.h"
+
+namespace libtextclassifier2 {
+
+// What a deployment uses of a model, e.g. as seen in its traffic.
+struct SlimmingProfile {
+  // BCP 47 tags of the locales of the requests. They are matched against the
+  // datetime locales of the model like at inference time, so "de-CH" keeps
+  // the rules of "de-CH", "*-CH" and "de-*". Empty keeps all locales.
+  std::vector<std::string> locales;
+
+  // The collections whose results are used. Empty keeps all collections.
+  std::vector<std::string> collections;
+
+  // The modes in which the model is called.
+  ModeFlag enabled_modes = ModeFlag_ALL;
+};
+
+// Counts of the rules removed by SlimModel.
+struct SlimmingStats {
+  int removed_regex_patterns = 0;
+  int removed_datetime_patterns = 0;
+  int removed_datetime_extractors = 0;
+};
+
+// Removes from the model what can't contribute to the results of the given
+// profile:
+//  - the modes that are not in the profile,
+//  - regex patterns whose collection is not kept, or is filtered by the output
+//    options in all of their remaining modes. Filtering in the classification
+//    mode doesn't count, see the note below,
+//  - datetime patterns and extractors of locales that are not in the profile,
+//    and the whole datetime model if "date" is not kept.
+// The regex and datetime rules are compressed again in the format they were
+// in. Returns false if the rules can't be decompressed or compressed.
+//
+// NOTE: Filtered results still take part in the conflict resolution of
+// Annotate and SuggestSelection, where they can shadow overlapping results of
+// other collections. Removing their patterns can therefore make such results
+// appear. In ClassifyText, a regex match of a filtered collection returns
+// "other" without asking the datetime model or the classification model, so
+// those patterns keep their classification mode. Likewise, removing the
+// patterns of a collection that is not kept lets these fallbacks answer for
+// the texts the patterns matched.
+bool SlimModel(const SlimmingProfile& profile, ModelT* model,
+               SlimmingStats* stats = nullptr);
+
+// Serializes the model with the sections read on every request (options,
+// feature processor options, the selection and classification networks) at
+// the start of the buffer, and the embedding model at the end, starting at a
+// multiple of kEmbeddingModelAlignment from the start of the buffer. A model
+// file mapped at a page boundary thus has its embeddings on their own pages.
+std::string SerializeSlimModel(const ModelT& model);
+
+const int kEmbeddingModelAlignment = 4096;
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_MODEL_SLIMMER_H_
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/model-slimmer.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "text-classifier.h"
+#include "zlib-utils.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+std::string ReadFile(const std::string& file_name) {
+  std::ifstream file_stream(file_name);
+  return std::string(std::istreambuf_iterator<char>(file_stream), {});
+}
+
+std::string GetModelPath() { return LIBTEXTCLASSIFIER_TEST_DATA_DIR; }
+
+std::string FirstResult(const std::vector<ClassificationResult>& results) {
+  if (results.empty()) {
+    return "<INVALID RESULTS>";
+  }
+  return results[0].collection;
+}
+
+void AddRegexPattern(const std::string& collection, ModeFlag enabled_modes,
+                     ModelT* model) {
+  model->regex_model->patterns.emplace_back(new RegexModel_::PatternT);
+  model->regex_model->patterns.back()->collection_name = collection;
+  model->regex_model->patterns.back()->pattern = collection + " pattern";
+  model->regex_model->patterns.back()->enabled_modes = enabled_modes;
+}
+
+void AddDatetimePattern(const std::string& pattern,
+                        const std::vector<int>& locales, ModelT* model) {
+  model->datetime_model->patterns.emplace_back(new DatetimeModelPatternT);
+  model->datetime_model->patterns.back()->regexes.emplace_back(
+      new DatetimeModelPattern_::RegexT);
+  model->datetime_model->patterns.back()->regexes.back()->pattern = pattern;
+  model->datetime_model->patterns.back()->locales.assign(locales.begin(),
+                                                         locales.end());
+}
+
+std::unique_ptr<ModelT> CreateTestModel() {
+  std::unique_ptr<ModelT> model(new ModelT);
+  model->output_options.reset(new OutputOptionsT);
+  model->output_options->filtered_collections_annotation.push_back("flight");
+  model->output_options->filtered_collections_classification.push_back(
+      "flight");
+
+  model->regex_model.reset(new RegexModelT);
+  AddRegexPattern("phone", ModeFlag_ALL, model.get());
+  AddRegexPattern("flight", ModeFlag_ALL, model.get());
+  AddRegexPattern("flight", ModeFlag_ANNOTATION_AND_CLASSIFICATION,
+                  model.get());
+  AddRegexPattern("url", ModeFlag_ALL, model.get());
+
+  model->datetime_model.reset(new DatetimeModelT);
+  model->datetime_model->locales = {"en-*", "de-*", "*-CH", "fr-*"};
+  model->datetime_model->default_locales = {0};
+  AddDatetimePattern("english", {0}, model.get());
+  AddDatetimePattern("german", {1}, model.get());
+  AddDatetimePattern("swiss", {2}, model.get());
+  AddDatetimePattern("french", {3}, model.get());
+  model->datetime_model->extractors.emplace_back(new DatetimeModelExtractorT);
+  model->datetime_model->extractors.back()->pattern = "french extractor";
+  model->datetime_model->extractors.back()->locales = {3};
+  model->datetime_model->extractors.emplace_back(new DatetimeModelExtractorT);
+  model->datetime_model->extractors.back()->pattern = "german extractor";
+  model->datetime_model->extractors.back()->locales = {1};
+  return model;
+}
+
+TEST(ModelSlimmerTest, RemovesUnusedRules) {
+  std::unique_ptr<ModelT> model = CreateTestModel();
+  SlimmingProfile profile;
+  profile.locales = {"de-CH"};
+  profile.collections = {"phone", "flight", "date"};
+  profile.enabled_modes = ModeFlag_ANNOTATION_AND_SELECTION;
+  SlimmingStats stats;
+  ASSERT_TRUE(SlimModel(profile, model.get(), &stats));
+
+  EXPECT_EQ(model->enabled_modes, ModeFlag_ANNOTATION_AND_SELECTION);
+
+  // The second flight pattern is only enabled for annotation, where it is
+  // filtered, and for classification, which the profile disables. The url
+  // collection is not kept.
+  EXPECT_EQ(stats.removed_regex_patterns, 2);
+  ASSERT_EQ(model->regex_model->patterns.size(), 2);
+  EXPECT_EQ(model->regex_model->patterns[0]->collection_name, "phone");
+  EXPECT_EQ(model->regex_model->patterns[0]->enabled_modes,
+            ModeFlag_ANNOTATION_AND_SELECTION);
+  EXPECT_EQ(model->regex_model->patterns[1]->collection_name, "flight");
+  EXPECT_EQ(model->regex_model->patterns[1]->enabled_modes,
+            ModeFlag_SELECTION);
+
+  // The default locale and the ones de-CH expands to are kept.
+  EXPECT_EQ(stats.removed_datetime_patterns, 1);
+  ASSERT_EQ(model->datetime_model->patterns.size(), 3);
+  EXPECT_EQ(model->datetime_model->patterns[0]->regexes[0]->pattern,
+            "english");
+  EXPECT_EQ(model->datetime_model->patterns[1]->regexes[0]->pattern, "german");
+  EXPECT_EQ(model->datetime_model->patterns[2]->regexes[0]->pattern, "swiss");
+  EXPECT_EQ(stats.removed_datetime_extractors, 1);
+  ASSERT_EQ(model->datetime_model->extractors.size(), 1);
+  EXPECT_EQ(model->datetime_model->extractors[0]->pattern, "german extractor");
+  EXPECT_EQ(model->datetime_model->locales.size(), 4);
+}
+
+TEST(ModelSlimmerTest, KeepsPatternsFilteredForClassification) {
+  std::unique_ptr<ModelT> model = CreateTestModel();
+  SlimmingProfile profile;
+  profile.collections = {"phone", "flight", "date"};
+  profile.enabled_modes = ModeFlag_ANNOTATION_AND_CLASSIFICATION;
+  ASSERT_TRUE(SlimModel(profile, model.get()));
+
+  // The flight results are filtered in both modes, but a flight match still
+  // keeps ClassifyText from falling back to the other models.
+  ASSERT_EQ(model->regex_model->patterns.size(), 3);
+  EXPECT_EQ(model->regex_model->patterns[1]->collection_name, "flight");
+  EXPECT_EQ(model->regex_model->patterns[1]->enabled_modes,
+            ModeFlag_CLASSIFICATION);
+  EXPECT_EQ(model->regex_model->patterns[2]->collection_name, "flight");
+  EXPECT_EQ(model->regex_model->patterns[2]->enabled_modes,
+            ModeFlag_CLASSIFICATION);
+}
+
+TEST(ModelSlimmerTest, RemovesDatetimeModelIfDatesAreNotKept) {
+  std::unique_ptr<ModelT> model = CreateTestModel();
+  SlimmingProfile profile;
+  profile.collections = {"phone"};
+  ASSERT_TRUE(SlimModel(profile, model.get()));
+  EXPECT_EQ(model->datetime_model, nullptr);
+  ASSERT_EQ(model->regex_model->patterns.size(), 1);
+}
+
+TEST(ModelSlimmerTest, KeepsCompression) {
+  for (const bool independent : {false, true}) {
+    std::unique_ptr<ModelT> model = CreateTestModel();
+    ASSERT_TRUE(CompressModel(model.get(), independent));
+    SlimmingProfile profile;
+    profile.locales = {"fr"};
+    ASSERT_TRUE(SlimModel(profile, model.get()));
+
+    ASSERT_EQ(model->datetime_model->patterns.size(), 2);
+    const DatetimeModelPattern_::RegexT* regex =
+        model->datetime_model->patterns[1]->regexes[0].get();
+    ASSERT_NE(regex->compressed_pattern, nullptr);
+    EXPECT_EQ(regex->compressed_pattern->independent, independent);
+    EXPECT_TRUE(regex->pattern.empty());
+
+    ASSERT_TRUE(DecompressModel(model.get()));
+    EXPECT_EQ(model->datetime_model->patterns[1]->regexes[0]->pattern,
+              "french");
+    EXPECT_EQ(model->datetime_model->extractors[0]->pattern,
+              "french extractor");
+  }
+}
+
+TEST(ModelSlimmerTest, AlignsEmbeddingModel) {
+  const std::string test_model = ReadFile(GetModelPath() + "test_model_cc.fb");
+  std::unique_ptr<ModelT> unpacked_model = UnPackModel(test_model.c_str());
+  ASSERT_TRUE(unpacked_model != nullptr);
+  ASSERT_TRUE(SlimModel(SlimmingProfile(), unpacked_model.get()));
+  const std::string slim_model = SerializeSlimModel(*unpacked_model);
+
+  const Model* model = GetModel(slim_model.data());
+  ASSERT_TRUE(model->embedding_model() != nullptr);
+  EXPECT_EQ(
+      (reinterpret_cast<const char*>(model->embedding_model()->data()) -
+       slim_model.data()) %
+          kEmbeddingModelAlignment,
+      0);
+  // The embedding model is at the end of the buffer, after the networks.
+  EXPECT_LT(reinterpret_cast<const char*>(model->selection_model()->data()),
+            reinterpret_cast<const char*>(model->embedding_model()->data()));
+  EXPECT_EQ(slim_model.size() % kEmbeddingModelAlignment, 0);
+
+  CREATE_UNILIB_FOR_TESTING;
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(slim_model.data(), slim_model.size(),
+                                        &unilib);
+  ASSERT_TRUE(classifier);
+  EXPECT_EQ("phone", FirstResult(classifier->ClassifyText(
+                         "Call me at (800) 123-456 today", {11, 24})));
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/model-tables.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "datetime/parser.h"
+#include "feature-processor.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+template <typename Range>
+void SortByStart(std::vector<std::unique_ptr<Range>>* ranges) {
+  std::stable_sort(
+      ranges->begin(), ranges->end(),
+      [](const std::unique_ptr<Range>& a, const std::unique_ptr<Range>& b) {
+        return a->start < b->start;
+      });
+}
+
+}  // namespace
+
+void AddDatetimeTables(DatetimeModelT* datetime_model) {
+  datetime_model->sorted_locale_ids.clear();
+  datetime_model->locale_rules_start.clear();
+  datetime_model->locale_rules.clear();
+  datetime_model->extractor_rules.clear();
+
+  // The tables are built from the serialized model, like in the parser.
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(DatetimeModel::Pack(builder, datetime_model));
+  const DatetimeModel* model =
+      flatbuffers::GetRoot<DatetimeModel>(builder.GetBufferPointer());
+
+  if (model->locales() != nullptr) {
+    datetime_model->sorted_locale_ids =
+        internal::SortLocaleIds(*model->locales());
+  }
+
+  // All rules are loaded when the tables are used.
+  const std::function<bool(int)> is_loaded = [](int locale) {
+    return locale >= 0;
+  };
+
+  std::vector<const DatetimeModelPattern*> rule_patterns;
+  if (model->patterns() != nullptr) {
+    for (const DatetimeModelPattern* pattern : *model->patterns()) {
+      if (pattern->regexes() != nullptr) {
+        rule_patterns.insert(rule_patterns.end(), pattern->regexes()->size(),
+                             pattern);
+      }
+    }
+  }
+  internal::BuildLocaleRules(rule_patterns, is_loaded,
+                             &datetime_model->locale_rules_start,
+                             &datetime_model->locale_rules);
+
+  std::vector<const DatetimeModelExtractor*> extractors;
+  if (model->extractors() != nullptr) {
+    extractors.assign(model->extractors()->begin(),
+                      model->extractors()->end());
+  }
+  datetime_model->extractor_rules = internal::BuildExtractorRules(
+      extractors, is_loaded, datetime_model->locales.size());
+}
+
+void AddFeatureProcessorTables(FeatureProcessorOptionsT* options) {
+  options->selection_label_spans = internal::MakeSelectionLabelSpans(
+      options->max_selection_span, options->selection_reduced_output_space);
+
+  SortByStart(&options->tokenization_codepoint_config);
+  SortByStart(&options->supported_codepoint_ranges);
+  SortByStart(&options->internal_tokenizer_codepoint_ranges);
+  std::sort(options->ignored_span_boundary_codepoints.begin(),
+            options->ignored_span_boundary_codepoints.end());
+  options->sorted_codepoint_tables = true;
+}
+
+void AddPrecomputedTables(ModelT* model) {
+  if (model->datetime_model != nullptr) {
+    AddDatetimeTables(model->datetime_model.get());
+  }
+  if (model->selection_feature_options != nullptr) {
+    AddFeatureProcessorTables(model->selection_feature_options.get());
+  }
+  if (model->classification_feature_options != nullptr) {
+    AddFeatureProcessorTables(model->classification_feature_options.get());
+  }
+}
+
+}  // namespace libtextclassifier2
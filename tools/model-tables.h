@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Offline computation of the lookup tables that the model otherwise builds
+// when it is loaded.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_MODEL_TABLES_H_
+#define LIBTEXTCLASSIFIER_TOOLS_MODEL_TABLES_H_
+
+#include "model_generated.h"
+
+namespace libtextclassifier2 {
+
+// Stores the lookup tables of the datetime parser in the datetime model:
+// the locale ids sorted by name, the rules of every locale and the extractor
+// of every type and locale. Tables of a previous call are replaced, so this
+// has to run again whenever the locales, patterns or extractors change.
+void AddDatetimeTables(DatetimeModelT* datetime_model);
+
+// Stores the token spans of the selection labels in the options, and sorts
+// their codepoint tables so that they are not checked at load time.
+void AddFeatureProcessorTables(FeatureProcessorOptionsT* options);
+
+// Adds the tables of the datetime model and of both feature processor
+// options of the model, if present.
+void AddPrecomputedTables(ModelT* model);
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_MODEL_TABLES_H_
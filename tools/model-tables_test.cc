@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/model-tables.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "feature-processor.h"
+#include "text-classifier.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+std::string ReadFile(const std::string& file_name) {
+  std::ifstream file_stream(file_name);
+  return std::string(std::istreambuf_iterator<char>(file_stream), {});
+}
+
+std::string GetModelPath() { return LIBTEXTCLASSIFIER_TEST_DATA_DIR; }
+
+std::string PackModel(const ModelT& model) {
+  flatbuffers::FlatBufferBuilder builder;
+  FinishModelBuffer(builder, Model::Pack(builder, &model));
+  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                     builder.GetSize());
+}
+
+void ExpectSameResults(const TextClassifier& classifier,
+                       const TextClassifier& other_classifier) {
+  const std::vector<std::string> texts = {
+      "Call me at (800) 123-456 today",
+      "350 Third Street, Cambridge",
+      "Let's meet on January 3rd at 5pm, or tomorrow",
+      "Wir treffen uns am 3. März um 17 Uhr",
+      "& saw Barack Obama today .. 350 Third Street, Cambridge"};
+  for (const std::string& text : texts) {
+    for (const std::string& locales : {"en", "de", "en-CH,de"}) {
+      AnnotationOptions options;
+      options.locales = locales;
+      const std::vector<AnnotatedSpan> annotations =
+          classifier.Annotate(text, options);
+      const std::vector<AnnotatedSpan> other_annotations =
+          other_classifier.Annotate(text, options);
+      ASSERT_EQ(annotations.size(), other_annotations.size()) << text;
+      for (int i = 0; i < annotations.size(); ++i) {
+        EXPECT_EQ(annotations[i].span, other_annotations[i].span);
+        ASSERT_EQ(annotations[i].classification.size(),
+                  other_annotations[i].classification.size());
+        for (int j = 0; j < annotations[i].classification.size(); ++j) {
+          EXPECT_EQ(annotations[i].classification[j].collection,
+                    other_annotations[i].classification[j].collection);
+          EXPECT_EQ(annotations[i].classification[j].score,
+                    other_annotations[i].classification[j].score);
+          EXPECT_EQ(
+              annotations[i].classification[j].datetime_parse_result,
+              other_annotations[i].classification[j].datetime_parse_result);
+        }
+      }
+    }
+    EXPECT_EQ(classifier.SuggestSelection(text, {5, 6}),
+              other_classifier.SuggestSelection(text, {5, 6}));
+  }
+}
+
+TEST(ModelTablesTest, AddsTables) {
+  const std::string test_model = ReadFile(GetModelPath() + "test_model.fb");
+  std::unique_ptr<ModelT> model = UnPackModel(test_model.c_str());
+  ASSERT_TRUE(model != nullptr);
+  ASSERT_TRUE(model->datetime_model != nullptr);
+  ASSERT_TRUE(model->selection_feature_options != nullptr);
+  AddPrecomputedTables(model.get());
+
+  const DatetimeModelT& datetime_model = *model->datetime_model;
+  EXPECT_EQ(datetime_model.sorted_locale_ids.size(),
+            datetime_model.locales.size());
+  ASSERT_FALSE(datetime_model.locale_rules_start.empty());
+  EXPECT_EQ(datetime_model.locale_rules_start.front(), 0);
+  EXPECT_EQ(datetime_model.locale_rules_start.back(),
+            static_cast<int>(datetime_model.locale_rules.size()));
+  EXPECT_EQ(datetime_model.extractor_rules.size(),
+            (DatetimeExtractorType_MAX + 1) * datetime_model.locales.size());
+
+  const FeatureProcessorOptionsT& options = *model->selection_feature_options;
+  EXPECT_TRUE(options.sorted_codepoint_tables);
+  const std::string model_with_tables = PackModel(*model);
+  FeatureProcessor feature_processor(
+      GetModel(model_with_tables.data())->selection_feature_options());
+  EXPECT_EQ(static_cast<int>(options.selection_label_spans.size()),
+            2 * feature_processor.GetSelectionLabelCount());
+}
+
+class ModelTablesModelTest : public ::testing::TestWithParam<const char*> {};
+
+INSTANTIATE_TEST_CASE_P(ClickContext, ModelTablesModelTest,
+                        testing::Values("test_model_cc.fb"));
+INSTANTIATE_TEST_CASE_P(BoundsSensitive, ModelTablesModelTest,
+                        testing::Values("test_model.fb"));
+
+TEST_P(ModelTablesModelTest, KeepsResults) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + GetParam());
+  std::unique_ptr<ModelT> model = UnPackModel(test_model.c_str());
+  ASSERT_TRUE(model != nullptr);
+  AddPrecomputedTables(model.get());
+  const std::string model_with_tables = PackModel(*model);
+
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(test_model.data(), test_model.size(),
+                                        &unilib);
+  ASSERT_TRUE(classifier);
+  std::unique_ptr<TextClassifier> classifier_with_tables =
+      TextClassifier::FromUnownedBuffer(model_with_tables.data(),
+                                        model_with_tables.size(), &unilib);
+  ASSERT_TRUE(classifier_with_tables);
+  ExpectSameResults(*classifier, *classifier_with_tables);
+
+  // With only some locales loaded, the datetime tables don't apply.
+  LoadOptions load_options;
+  load_options.locales = "de";
+  std::unique_ptr<TextClassifier> german_classifier =
+      TextClassifier::FromUnownedBuffer(test_model.data(), test_model.size(),
+                                        &unilib, load_options);
+  ASSERT_TRUE(german_classifier);
+  std::unique_ptr<TextClassifier> german_classifier_with_tables =
+      TextClassifier::FromUnownedBuffer(model_with_tables.data(),
+                                        model_with_tables.size(), &unilib,
+                                        load_options);
+  ASSERT_TRUE(german_classifier_with_tables);
+  ExpectSameResults(*german_classifier, *german_classifier_with_tables);
+}
+
+TEST_P(ModelTablesModelTest, IgnoresInvalidTables) {
+  CREATE_UNILIB_FOR_TESTING;
+  const std::string test_model = ReadFile(GetModelPath() + GetParam());
+  std::unique_ptr<ModelT> model = UnPackModel(test_model.c_str());
+  ASSERT_TRUE(model != nullptr);
+  AddPrecomputedTables(model.get());
+
+  // Out of range, or of the wrong size: the tables are built at load time.
+  if (model->datetime_model != nullptr) {
+    DatetimeModelT* datetime_model = model->datetime_model.get();
+    if (!datetime_model->locale_rules.empty()) {
+      datetime_model->locale_rules.back() = 1 << 20;
+    }
+    datetime_model->extractor_rules.push_back(-1);
+    if (!datetime_model->sorted_locale_ids.empty()) {
+      datetime_model->sorted_locale_ids.back() = -1;
+    }
+  }
+  for (FeatureProcessorOptionsT* options :
+       {model->selection_feature_options.get(),
+        model->classification_feature_options.get()}) {
+    if (options != nullptr && options->selection_label_spans.size() >= 4) {
+      std::swap(options->selection_label_spans[0],
+                options->selection_label_spans[2]);
+      std::swap(options->selection_label_spans[1],
+                options->selection_label_spans[3]);
+    }
+  }
+  const std::string model_with_tables = PackModel(*model);
+
+  std::unique_ptr<TextClassifier> classifier =
+      TextClassifier::FromUnownedBuffer(test_model.data(), test_model.size(),
+                                        &unilib);
+  ASSERT_TRUE(classifier);
+  std::unique_ptr<TextClassifier> classifier_with_tables =
+      TextClassifier::FromUnownedBuffer(model_with_tables.data(),
+                                        model_with_tables.size(), &unilib);
+  ASSERT_TRUE(classifier_with_tables);
+  ExpectSameResults(*classifier, *classifier_with_tables);
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reorders the embedding table of a model by how often its buckets occur in a
+// corpus, see tools/embedding-reorderer.h.
+//
+// Usage:
+//   textclassifier_reorder_embeddings --model=<path> --corpus=<path.jsonl>
+//       --output=<path>
+//
+// The corpus has the format of the textclassifier_load_generator corpus, only
+// the "context" of every line is used. It should be a sample of the traffic
+// the model serves.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tools/embedding-reorderer.h"
+#include "tools/json.h"
+#include "util/base/logging.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+struct Flags {
+  std::string model;
+  std::string corpus;
+  std::string output;
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: textclassifier_reorder_embeddings --model=<path> "
+          "--corpus=<path.jsonl> --output=<path>\n");
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      TC_LOG(ERROR) << "Malformed argument: " << arg;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    if (name == "model") {
+      flags->model = value;
+    } else if (name == "corpus") {
+      flags->corpus = value;
+    } else if (name == "output") {
+      flags->output = value;
+    } else {
+      TC_LOG(ERROR) << "Unknown flag: " << name;
+      return false;
+    }
+  }
+  return !flags->model.empty() && !flags->corpus.empty() &&
+         !flags->output.empty();
+}
+
+bool CountBuckets(const std::string& path, BucketCounter* counter) {
+  std::ifstream input(path);
+  if (!input) {
+    TC_LOG(ERROR) << "Could not open corpus: " << path;
+    return false;
+  }
+  std::string line;
+  int line_number = 0;
+  while (std::getline(input, line)) {
+    ++line_number;
+    if (line.empty()) {
+      continue;
+    }
+    JsonValue json;
+    if (!ParseJson(line, &json) || json.Find("context") == nullptr) {
+      TC_LOG(ERROR) << "Malformed corpus line " << line_number;
+      return false;
+    }
+    counter->AddText(json.GetString("context"));
+  }
+  return true;
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::ifstream input(flags.model, std::ios::binary);
+  if (!input) {
+    TC_LOG(ERROR) << "Could not open model: " << flags.model;
+    return 1;
+  }
+  const std::string model_buffer((std::istreambuf_iterator<char>(input)), {});
+  flatbuffers::Verifier verifier(
+      reinterpret_cast<const uint8_t*>(model_buffer.data()),
+      model_buffer.size());
+  if (!VerifyModelBuffer(verifier)) {
+    TC_LOG(ERROR) << "Invalid model: " << flags.model;
+    return 1;
+  }
+
+  UniLib unilib;
+  BucketCounter counter(GetModel(model_buffer.data()), &unilib);
+  if (!CountBuckets(flags.corpus, &counter)) {
+    return 1;
+  }
+
+  std::unique_ptr<ModelT> model = UnPackModel(model_buffer.data());
+  if (!ReorderEmbeddingRows(BucketRowsByFrequency(counter.counts()),
+                            model.get())) {
+    return 1;
+  }
+  flatbuffers::FlatBufferBuilder builder;
+  FinishModelBuffer(builder, Model::Pack(builder, model.get()));
+
+  std::ofstream output(flags.output, std::ios::binary);
+  output.write(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+               builder.GetSize());
+  if (!output) {
+    TC_LOG(ERROR) << "Could not write model: " << flags.output;
+    return 1;
+  }
+
+  // The share of the lookups that go to the first rows.
+  const std::vector<int64>& counts = counter.counts();
+  std::vector<int64> sorted_counts(counts.begin(), counts.end());
+  std::sort(sorted_counts.rbegin(), sorted_counts.rend());
+  int64 total = 0;
+  for (const int64 count : sorted_counts) {
+    total += count;
+  }
+  int64 covered = 0;
+  for (int rows = 0, next_report = 1024; rows < sorted_counts.size(); ++rows) {
+    covered += sorted_counts[rows];
+    if (rows + 1 == next_report || rows + 1 == sorted_counts.size()) {
+      printf("rows %d: %.1f%% of %lld lookups\n", rows + 1,
+             total > 0 ? 100.0 * covered / total : 0.0,
+             static_cast<long long>(total));
+      next_report *= 4;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
+
+int main(int argc, char** argv) { return libtextclassifier2::Run(argc, argv); }
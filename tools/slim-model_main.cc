@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Writes a copy of a model reduced to what a deployment uses, see
+// tools/model-slimmer.h.
+//
+// Usage:
+//   textclassifier_slim_model --model=<path> --output=<path>
+//       [--locales=<comma-separated BCP 47 tags>]
+//       [--collections=<comma-separated collection names>]
+//       [--modes=annotation,classification,selection]
+//
+// Empty --locales and --collections keep all locales and collections. The
+// locales and collections can be collected from the requests and the results
+// of the deployment, e.g. with textclassifier_bulk_annotator.
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tools/model-slimmer.h"
+#include "util/base/logging.h"
+#include "util/strings/split.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+struct Flags {
+  std::string model;
+  std::string output;
+  SlimmingProfile profile;
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: textclassifier_slim_model --model=<path> --output=<path> "
+          "[--locales=en,de-CH] [--collections=phone,date] "
+          "[--modes=annotation,classification,selection]\n");
+}
+
+std::vector<std::string> SplitList(const std::string& value) {
+  std::vector<std::string> result;
+  for (const StringPiece& part : strings::Split(value, ',')) {
+    if (!part.empty()) {
+      result.push_back(part.ToString());
+    }
+  }
+  return result;
+}
+
+bool ParseModes(const std::string& value, ModeFlag* modes) {
+  int result = ModeFlag_NONE;
+  for (const std::string& mode : SplitList(value)) {
+    if (mode == "annotation") {
+      result |= ModeFlag_ANNOTATION;
+    } else if (mode == "classification") {
+      result |= ModeFlag_CLASSIFICATION;
+    } else if (mode == "selection") {
+      result |= ModeFlag_SELECTION;
+    } else {
+      return false;
+    }
+  }
+  *modes = static_cast<ModeFlag>(result);
+  return result != ModeFlag_NONE;
+}
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      TC_LOG(ERROR) << "Malformed argument: " << arg;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    bool ok = true;
+    if (name == "model") {
+      flags->model = value;
+    } else if (name == "output") {
+      flags->output = value;
+    } else if (name == "locales") {
+      flags->profile.locales = SplitList(value);
+    } else if (name == "collections") {
+      flags->profile.collections = SplitList(value);
+    } else if (name == "modes") {
+      ok = ParseModes(value, &flags->profile.enabled_modes);
+    } else {
+      TC_LOG(ERROR) << "Unknown flag: " << name;
+      return false;
+    }
+    if (!ok) {
+      TC_LOG(ERROR) << "Invalid value for --" << name << ": " << value;
+      return false;
+    }
+  }
+  return !flags->model.empty() && !flags->output.empty();
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::ifstream input(flags.model, std::ios::binary);
+  if (!input) {
+    TC_LOG(ERROR) << "Could not open model: " << flags.model;
+    return 1;
+  }
+  const std::string model_buffer((std::istreambuf_iterator<char>(input)), {});
+  flatbuffers::Verifier verifier(
+      reinterpret_cast<const uint8_t*>(model_buffer.data()),
+      model_buffer.size());
+  if (!VerifyModelBuffer(verifier)) {
+    TC_LOG(ERROR) << "Invalid model: " << flags.model;
+    return 1;
+  }
+  std::unique_ptr<ModelT> model = UnPackModel(model_buffer.data());
+
+  SlimmingStats stats;
+  if (!SlimModel(flags.profile, model.get(), &stats)) {
+    return 1;
+  }
+  const std::string slim_model = SerializeSlimModel(*model);
+
+  std::ofstream output(flags.output, std::ios::binary);
+  output.write(slim_model.data(), slim_model.size());
+  if (!output) {
+    TC_LOG(ERROR) << "Could not write model: " << flags.output;
+    return 1;
+  }
+
+  printf("removed: %d regex patterns, %d datetime patterns, "
+         "%d datetime extractors\n",
+         stats.removed_regex_patterns, stats.removed_datetime_patterns,
+         stats.removed_datetime_extractors);
+  printf("size: %zu -> %zu bytes\n", model_buffer.size(), slim_model.size());
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
+
+int main(int argc, char** argv) { return libtextclassifier2::Run(argc, argv); }
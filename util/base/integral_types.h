@@ -28,6 +28,7 @@ typedef unsigned long long uint64;
 
 #ifndef SWIG
 typedef int int32;
+typedef signed char int8;       // NOLINT
 typedef unsigned char uint8;    // NOLINT
 typedef unsigned short uint16;  // NOLINT
 
@@ -50,6 +51,7 @@ typedef long long int64;  // NOLINT
 static_assert(sizeof(int) == 4, "Our typedefs depend on int being 32 bits");
 static_assert(sizeof(uint32) == 4, "wrong size");
 static_assert(sizeof(int32) == 4, "wrong size");
+static_assert(sizeof(int8) == 1, "wrong size");
 static_assert(sizeof(uint8) == 1, "wrong size");
 static_assert(sizeof(uint16) == 2, "wrong size");
 static_assert(sizeof(char32) == 4, "wrong size");
@@ -21,8 +21,12 @@
 
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "model_generated.h"
+#include "util/base/integral_types.h"
+#include "util/base/macros.h"
 #include "flatbuffers/flatbuffers.h"
 
 namespace libtextclassifier2 {
@@ -93,6 +97,42 @@ std::string PackFlatbuffer(
                      builder.GetSize());
 }
 
+// A table of ints that is either read in place from a flatbuffer vector, or
+// owned, e.g. when it had to be computed because the model doesn't have it.
+class IntTable {
+ public:
+  IntTable() {}
+
+  // Reads 'table' in place. It must outlive this object.
+  void Reset(const flatbuffers::Vector<int32_t>* table) {
+#if FLATBUFFERS_LITTLEENDIAN
+    owned_.clear();
+    data_ = reinterpret_cast<const int32*>(table->data());
+    size_ = table->size();
+#else
+    Reset(std::vector<int32>(table->begin(), table->end()));
+#endif
+  }
+
+  void Reset(std::vector<int32> table) {
+    owned_ = std::move(table);
+    data_ = owned_.data();
+    size_ = owned_.size();
+  }
+
+  int size() const { return size_; }
+  int32 operator[](int i) const { return data_[i]; }
+  const int32* begin() const { return data_; }
+  const int32* end() const { return data_ + size_; }
+
+ private:
+  std::vector<int32> owned_;
+  const int32* data_ = nullptr;
+  int size_ = 0;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(IntTable);
+};
+
 }  // namespace libtextclassifier2
 
 #endif  // LIBTEXTCLASSIFIER_UTIL_FLATBUFFERS_H_
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Fingerprint64 of short inputs, e.g. charactergrams.
+
+#ifndef LIBTEXTCLASSIFIER_UTIL_HASH_SHORT_FINGERPRINT_H_
+#define LIBTEXTCLASSIFIER_UTIL_HASH_SHORT_FINGERPRINT_H_
+
+#include <string.h>
+
+#include "util/base/integral_types.h"
+
+namespace libtextclassifier2 {
+
+// The longest input of ShortFingerprint64.
+const int kMaxShortFingerprintSize = 16;
+
+namespace internal {
+
+// The loads are little-endian, like in farmhash.
+const uint64 kFingerprintK0 = 0xc3a5c85c97cb3127ULL;
+const uint64 kFingerprintK2 = 0x9ae16a3b2f90404fULL;
+
+inline uint64 FingerprintFetch64(const char* p) {
+  uint64 result;
+  memcpy(&result, p, sizeof(result));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  result = __builtin_bswap64(result);
+#endif
+  return result;
+}
+
+inline uint64 FingerprintFetch32(const char* p) {
+  uint32 result;
+  memcpy(&result, p, sizeof(result));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  result = __builtin_bswap32(result);
+#endif
+  return result;
+}
+
+inline uint64 FingerprintRotate(uint64 value, int shift) {
+  return (value >> shift) | (value << (64 - shift));
+}
+
+inline uint64 FingerprintHashLen16(uint64 u, uint64 v, uint64 mul) {
+  uint64 a = (u ^ v) * mul;
+  a ^= (a >> 47);
+  uint64 b = (v ^ a) * mul;
+  b ^= (b >> 47);
+  return b * mul;
+}
+
+// The hash of 8 to 16 bytes.
+inline uint64 FingerprintLen8to16(const char* s, int size, uint64 mul) {
+  const uint64 a = FingerprintFetch64(s) + kFingerprintK2;
+  const uint64 b = FingerprintFetch64(s + size - 8);
+  const uint64 c = FingerprintRotate(b, 37) * mul + a;
+  const uint64 d = (FingerprintRotate(a, 25) + b) * mul;
+  return FingerprintHashLen16(c, d, mul);
+}
+
+// The hash of 4 to 7 bytes.
+inline uint64 FingerprintLen4to7(const char* s, int size, uint64 mul) {
+  return FingerprintHashLen16(size + (FingerprintFetch32(s) << 3),
+                              FingerprintFetch32(s + size - 4), mul);
+}
+
+// The hash of 1 to 3 bytes.
+inline uint64 FingerprintLen1to3(const char* s, int size) {
+  const uint32 y = static_cast<uint8>(s[0]) +
+                   (static_cast<uint32>(static_cast<uint8>(s[size >> 1])) << 8);
+  const uint32 z =
+      size + (static_cast<uint32>(static_cast<uint8>(s[size - 1])) << 2);
+  const uint64 x = y * kFingerprintK2 ^ z * kFingerprintK0;
+  return (x ^ (x >> 47)) * kFingerprintK2;
+}
+
+}  // namespace internal
+
+// Returns tc2farmhash::Fingerprint64(s, size) for size <=
+// kMaxShortFingerprintSize. Inlined at the call site, without the dispatch on
+// the size of the general function.
+inline uint64 ShortFingerprint64(const char* s, int size) {
+  if (size >= 8) {
+    return internal::FingerprintLen8to16(
+        s, size, internal::kFingerprintK2 + size * 2);
+  }
+  if (size >= 4) {
+    return internal::FingerprintLen4to7(s, size,
+                                        internal::kFingerprintK2 + size * 2);
+  }
+  if (size > 0) {
+    return internal::FingerprintLen1to3(s, size);
+  }
+  return internal::kFingerprintK2;
+}
+
+// Writes the ShortFingerprint64 of every substring of 'window_size' bytes of
+// s[0, size) to 'fingerprints', in order of their start. 'window_size' must be
+// between 1 and kMaxShortFingerprintSize. The dispatch on the window size is
+// done once, so the loop over the windows has no branches and the hashes of
+// consecutive windows can be computed in parallel.
+inline void ShortFingerprint64Windows(const char* s, int size, int window_size,
+                                      uint64* fingerprints) {
+  const int num_windows = size - window_size + 1;
+  const uint64 mul = internal::kFingerprintK2 + window_size * 2;
+  if (window_size >= 8) {
+    for (int i = 0; i < num_windows; ++i) {
+      fingerprints[i] = internal::FingerprintLen8to16(s + i, window_size, mul);
+    }
+  } else if (window_size >= 4) {
+    for (int i = 0; i < num_windows; ++i) {
+      fingerprints[i] = internal::FingerprintLen4to7(s + i, window_size, mul);
+    }
+  } else {
+    for (int i = 0; i < num_windows; ++i) {
+      fingerprints[i] = internal::FingerprintLen1to3(s + i, window_size);
+    }
+  }
+}
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_UTIL_HASH_SHORT_FINGERPRINT_H_
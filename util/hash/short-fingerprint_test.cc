@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/hash/short-fingerprint.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "util/hash/farmhash.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+// Checks every input of up to 3 bytes, i.e. all 1-3 byte charactergrams.
+TEST(ShortFingerprintTest, MatchesFingerprint64UpTo3Bytes) {
+  char s[3] = {};
+  int num_mismatches = 0;
+  EXPECT_EQ(ShortFingerprint64(s, 0), tc2farmhash::Fingerprint64(s, 0));
+  for (int size = 1; size <= 3; ++size) {
+    const int num_inputs = 1 << (8 * size);
+    for (int input = 0; input < num_inputs; ++input) {
+      for (int i = 0; i < size; ++i) {
+        s[i] = static_cast<char>(input >> (8 * i));
+      }
+      if (ShortFingerprint64(s, size) != tc2farmhash::Fingerprint64(s, size)) {
+        ++num_mismatches;
+      }
+    }
+  }
+  EXPECT_EQ(num_mismatches, 0);
+}
+
+// Every byte of the longer inputs is read through one of two overlapping
+// loads, so every value at every position is checked, on random backgrounds.
+TEST(ShortFingerprintTest, MatchesFingerprint64UpTo16Bytes) {
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> random_byte(0, 255);
+  char s[kMaxShortFingerprintSize];
+  int num_mismatches = 0;
+  for (int size = 4; size <= kMaxShortFingerprintSize; ++size) {
+    for (int background = 0; background < 64; ++background) {
+      for (int i = 0; i < size; ++i) {
+        s[i] = static_cast<char>(random_byte(random));
+      }
+      for (int position = 0; position < size; ++position) {
+        const char original = s[position];
+        for (int value = 0; value < 256; ++value) {
+          s[position] = static_cast<char>(value);
+          if (ShortFingerprint64(s, size) !=
+              tc2farmhash::Fingerprint64(s, size)) {
+            ++num_mismatches;
+          }
+        }
+        s[position] = original;
+      }
+    }
+  }
+  EXPECT_EQ(num_mismatches, 0);
+}
+
+TEST(ShortFingerprintTest, WindowsMatchFingerprint64) {
+  std::mt19937 random(2);
+  std::uniform_int_distribution<int> random_byte(0, 255);
+  for (int size = 1; size <= 40; ++size) {
+    std::string text;
+    for (int i = 0; i < size; ++i) {
+      text.push_back(static_cast<char>(random_byte(random)));
+    }
+    for (int window_size = 1;
+         window_size <= std::min(size, kMaxShortFingerprintSize);
+         ++window_size) {
+      std::vector<uint64> fingerprints(size - window_size + 1);
+      ShortFingerprint64Windows(text.data(), size, window_size,
+                                fingerprints.data());
+      for (int i = 0; i < fingerprints.size(); ++i) {
+        EXPECT_EQ(fingerprints[i],
+                  tc2farmhash::Fingerprint64(text.data() + i, window_size))
+            << size << " " << window_size << " " << i;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
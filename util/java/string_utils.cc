@@ -17,41 +17,44 @@
 #include "util/java/string_utils.h"
 
 #include "util/base/logging.h"
+#include "util/strings/utf8.h"
 
 namespace libtextclassifier2 {
 
 bool JStringToUtf8String(JNIEnv* env, const jstring& jstr,
                          std::string* result) {
+  result->clear();
   if (jstr == nullptr) {
-    *result = std::string();
     return false;
   }
 
-  jclass string_class = env->FindClass("java/lang/String");
-  if (!string_class) {
-    TC_LOG(ERROR) << "Can't find String class";
+  // Transcodes directly from the Java string's UTF-16 storage instead of
+  // calling String.getBytes("UTF-8"), which needs a method lookup and a
+  // temporary Java byte array. No JNI calls are allowed in the critical
+  // section.
+  const jsize length = env->GetStringLength(jstr);
+  const jchar* const chars = env->GetStringCritical(jstr, nullptr);
+  if (chars == nullptr) {
+    TC_LOG(ERROR) << "Can't access string characters";
     return false;
   }
+  AppendUTF16AsUTF8(reinterpret_cast<const uint16*>(chars), length, result);
+  env->ReleaseStringCritical(jstr, chars);
 
-  jmethodID get_bytes_id =
-      env->GetMethodID(string_class, "getBytes", "(Ljava/lang/String;)[B");
-
-  jstring encoding = env->NewStringUTF("UTF-8");
-  jbyteArray array = reinterpret_cast<jbyteArray>(
-      env->CallObjectMethod(jstr, get_bytes_id, encoding));
-
-  jbyte* const array_bytes = env->GetByteArrayElements(array, JNI_FALSE);
-  int length = env->GetArrayLength(array);
-
-  *result = std::string(reinterpret_cast<char*>(array_bytes), length);
+  return true;
+}
 
-  // Release the array.
-  env->ReleaseByteArrayElements(array, array_bytes, JNI_ABORT);
-  env->DeleteLocalRef(array);
-  env->DeleteLocalRef(string_class);
-  env->DeleteLocalRef(encoding);
+bool JStringToUTF16(JNIEnv* env, const jstring& jstr,
+                    std::vector<uint16>* result) {
+  result->clear();
+  if (jstr == nullptr) {
+    return false;
+  }
 
-  return true;
+  result->resize(env->GetStringLength(jstr));
+  env->GetStringRegion(jstr, 0, result->size(),
+                       reinterpret_cast<jchar*>(result->data()));
+  return !env->ExceptionCheck();
 }
 
 }  // namespace libtextclassifier2
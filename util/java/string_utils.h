@@ -19,11 +19,18 @@
 
 #include <jni.h>
 #include <string>
+#include <vector>
+
+#include "util/base/integral_types.h"
 
 namespace libtextclassifier2 {
 
 bool JStringToUtf8String(JNIEnv* env, const jstring& jstr, std::string* result);
 
+// Copies the UTF-16 code units of the Java string to 'result'.
+bool JStringToUTF16(JNIEnv* env, const jstring& jstr,
+                    std::vector<uint16>* result);
+
 }  // namespace libtextclassifier2
 
 #endif  // LIBTEXTCLASSIFIER_UTIL_JAVA_STRING_UTILS_H_
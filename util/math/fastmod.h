@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Fast remainder by a divisor that is known in advance.
+
+#ifndef LIBTEXTCLASSIFIER_UTIL_MATH_FASTMOD_H_
+#define LIBTEXTCLASSIFIER_UTIL_MATH_FASTMOD_H_
+
+#include "util/base/integral_types.h"
+#include "util/base/logging.h"
+
+namespace libtextclassifier2 {
+
+// Computes the remainder of 64-bit values by a fixed 32-bit divisor. The
+// division is replaced by multiplications with a precomputed 128-bit inverse
+// of the divisor (D. Lemire, O. Kaser, N. Kurz, "Faster Remainder by Direct
+// Computation", 2019), which is exact for all 64-bit values since the inverse
+// has more than 64 + 32 bits. Falls back to '%' where the compiler has no
+// 128-bit integers.
+class FastModulo {
+ public:
+  explicit FastModulo(uint32 divisor) : divisor_(divisor) {
+    TC_CHECK_GT(divisor, 0);
+#ifdef __SIZEOF_INT128__
+    inverse_ = ~static_cast<unsigned __int128>(0) / divisor + 1;
+#endif
+  }
+
+  uint32 Mod(uint64 value) const {
+#ifdef __SIZEOF_INT128__
+    // The fractional part of value / divisor, times the divisor, with the
+    // 128 x 32-bit product split into two 64 x 32-bit ones.
+    const unsigned __int128 fraction = inverse_ * value;
+    const unsigned __int128 low =
+        static_cast<unsigned __int128>(static_cast<uint64>(fraction)) *
+        divisor_;
+    const unsigned __int128 high =
+        static_cast<unsigned __int128>(static_cast<uint64>(fraction >> 64)) *
+        divisor_;
+    return static_cast<uint32>(((low >> 64) + high) >> 64);
+#else
+    return value % divisor_;
+#endif
+  }
+
+  uint32 divisor() const { return divisor_; }
+
+ private:
+  uint32 divisor_;
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 inverse_;
+#endif
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_UTIL_MATH_FASTMOD_H_
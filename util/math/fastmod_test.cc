@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/math/fastmod.h"
+
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+TEST(FastModuloTest, MatchesRemainder) {
+  std::mt19937_64 random(1);
+  std::vector<uint32> divisors = {1,     2,          3,          7,
+                                  10,    1000,       1 << 20,    (1 << 20) + 1,
+                                  65521, 2147483647, 2147483648, 4294967295};
+  for (int i = 0; i < 100; ++i) {
+    divisors.push_back(static_cast<uint32>(random()) | 1);
+  }
+
+  const uint64 max = std::numeric_limits<uint64>::max();
+  for (const uint32 divisor : divisors) {
+    const FastModulo modulo(divisor);
+    std::vector<uint64> values = {0,       1,       divisor - 1ULL, divisor,
+                                  divisor + 1ULL,   max,     max - 1,
+                                  max - divisor,    max / divisor * divisor,
+                                  max / divisor * divisor - 1};
+    for (int i = 0; i < 10000; ++i) {
+      values.push_back(random());
+    }
+    for (const uint64 value : values) {
+      ASSERT_EQ(modulo.Mod(value), value % divisor)
+          << value << " % " << divisor;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
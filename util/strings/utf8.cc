@@ -39,4 +39,39 @@ bool IsValidUTF8(const char *src, int size) {
   }
   return true;
 }
+
+void AppendUTF16AsUTF8(const uint16 *utf16, int num_units,
+                       std::string *result) {
+  result->reserve(result->size() + num_units);
+  for (int i = 0; i < num_units; ++i) {
+    char32 codepoint = utf16[i];
+    if (codepoint < 0x80) {
+      result->push_back(static_cast<char>(codepoint));
+      continue;
+    }
+    if (codepoint >= 0xD800 && codepoint <= 0xDFFF) {
+      if (codepoint <= 0xDBFF && i + 1 < num_units && utf16[i + 1] >= 0xDC00 &&
+          utf16[i + 1] <= 0xDFFF) {
+        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) +
+                    (utf16[i + 1] - 0xDC00);
+        ++i;
+      } else {
+        result->push_back('?');
+        continue;
+      }
+    }
+    if (codepoint < 0x800) {
+      result->push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+    } else if (codepoint < 0x10000) {
+      result->push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+      result->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    } else {
+      result->push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+      result->push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+      result->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    }
+    result->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+}
+
 }  // namespace libtextclassifier2
@@ -17,6 +17,10 @@
 #ifndef LIBTEXTCLASSIFIER_UTIL_STRINGS_UTF8_H_
 #define LIBTEXTCLASSIFIER_UTIL_STRINGS_UTF8_H_
 
+#include <string>
+
+#include "util/base/integral_types.h"
+
 namespace libtextclassifier2 {
 
 // Returns the length (number of bytes) of the Unicode code point starting at
@@ -47,6 +51,13 @@ static inline bool IsTrailByte(char x) {
 // Returns true iff src points to a well-formed UTF-8 string.
 bool IsValidUTF8(const char *src, int size);
 
+// Converts num_units UTF-16 code units to UTF-8 and appends them to result.
+// Unpaired surrogates are replaced with '?', like Java's String.getBytes()
+// does, so that every UTF-16 code unit outside of a surrogate pair still maps
+// to exactly one codepoint.
+void AppendUTF16AsUTF8(const uint16 *utf16, int num_units,
+                       std::string *result);
+
 }  // namespace libtextclassifier2
 
 #endif  // LIBTEXTCLASSIFIER_UTIL_STRINGS_UTF8_H_
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/strings/utf8.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+std::string UTF16ToUTF8(const std::vector<uint16>& utf16) {
+  std::string result;
+  AppendUTF16AsUTF8(utf16.data(), utf16.size(), &result);
+  return result;
+}
+
+TEST(Utf8Test, AppendUTF16AsUTF8) {
+  EXPECT_EQ(UTF16ToUTF8({}), "");
+  EXPECT_EQ(UTF16ToUTF8({'h', 'i'}), "hi");
+  // 2- and 3-byte sequences.
+  EXPECT_EQ(UTF16ToUTF8({0x00E9, 0x20AC}), "\xC3\xA9\xE2\x82\xAC");
+  // Surrogate pair for U+1F601.
+  EXPECT_EQ(UTF16ToUTF8({'a', 0xD83D, 0xDE01, 'b'}), "a\xF0\x9F\x98\x81" "b");
+  // Unpaired surrogates.
+  EXPECT_EQ(UTF16ToUTF8({0xD83D, 'x'}), "?x");
+  EXPECT_EQ(UTF16ToUTF8({0xDE01, 'x'}), "?x");
+  EXPECT_EQ(UTF16ToUTF8({'x', 0xD83D}), "x?");
+
+  std::string appended = "prefix";
+  const std::vector<uint16> suffix = {0x00FC};
+  AppendUTF16AsUTF8(suffix.data(), suffix.size(), &appended);
+  EXPECT_EQ(appended, "prefix\xC3\xBC");
+}
+
+TEST(Utf8Test, AppendUTF16AsUTF8ProducesValidUTF8) {
+  std::vector<uint16> all_bmp;
+  for (int i = 1; i <= 0xFFFF; ++i) {
+    all_bmp.push_back(i);
+  }
+  const std::string utf8 = UTF16ToUTF8(all_bmp);
+  EXPECT_TRUE(IsValidUTF8(utf8.data(), utf8.size()));
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Table-based character properties, used by UniLib for the per-codepoint
+// checks instead of calling into ICU.
+
+#ifndef LIBTEXTCLASSIFIER_UTIL_UTF8_CHAR_PROPERTIES_H_
+#define LIBTEXTCLASSIFIER_UTIL_UTF8_CHAR_PROPERTIES_H_
+
+#include "util/base/integral_types.h"
+
+namespace libtextclassifier2 {
+namespace internal {
+
+enum CharPropertyFlags : uint8 {
+  kCharWhitespace = 1 << 0,
+  kCharDigit = 1 << 1,
+  kCharUpper = 1 << 2,
+  kCharOpeningBracket = 1 << 3,
+  kCharClosingBracket = 1 << 4,
+};
+
+// The properties shared by a set of codepoints. The mappings are stored as
+// offsets, so that e.g. all uppercase Latin letters share one entry.
+struct CharProperties {
+  int32 lower_offset;
+  int32 paired_bracket_offset;
+  uint8 flags;
+};
+
+const char32 kCharPropertiesMaxCodepoint = 0x10FFFF;
+const int kCharPropertiesBlockShift = 7;
+
+// The Unicode version of the generated tables, e.g. "15.0".
+extern const char kCharPropertiesUnicodeVersion[];
+
+// Generated tables, see tools/generate-char-properties_main.cc. Codepoints
+// from kCharPropertiesLimit on have the default properties, at index zero.
+// Otherwise the properties of a codepoint are at the index in its block of
+// kCharPropertiesStage2, whose block number is in kCharPropertiesStage1.
+extern const int kCharPropertiesLimit;
+extern const CharProperties kCharProperties[];
+extern const uint8 kCharPropertiesStage1[];
+extern const uint8 kCharPropertiesStage2[];
+
+inline const CharProperties& GetCharProperties(char32 codepoint) {
+  if (codepoint < 0 || codepoint >= kCharPropertiesLimit) {
+    return kCharProperties[0];
+  }
+  const int block_start =
+      kCharPropertiesStage1[codepoint >> kCharPropertiesBlockShift]
+      << kCharPropertiesBlockShift;
+  const int index_in_block =
+      codepoint & ((1 << kCharPropertiesBlockShift) - 1);
+  return kCharProperties[kCharPropertiesStage2[block_start + index_in_block]];
+}
+
+inline bool HasCharProperty(char32 codepoint, CharPropertyFlags flag) {
+  return (GetCharProperties(codepoint).flags & flag) != 0;
+}
+
+}  // namespace internal
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_UTIL_UTF8_CHAR_PROPERTIES_H_
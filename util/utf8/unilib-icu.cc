@@ -40,38 +40,21 @@ bool UniLib::ParseInt32(const UnicodeText& text, int* result) const {
   return true;
 }
 
-bool UniLib::IsOpeningBracket(char32 codepoint) const {
-  return u_getIntPropertyValue(codepoint, UCHAR_BIDI_PAIRED_BRACKET_TYPE) ==
-         U_BPT_OPEN;
-}
-
-bool UniLib::IsClosingBracket(char32 codepoint) const {
-  return u_getIntPropertyValue(codepoint, UCHAR_BIDI_PAIRED_BRACKET_TYPE) ==
-         U_BPT_CLOSE;
-}
-
-bool UniLib::IsWhitespace(char32 codepoint) const {
-  return u_isWhitespace(codepoint);
-}
-
-bool UniLib::IsDigit(char32 codepoint) const { return u_isdigit(codepoint); }
-
-bool UniLib::IsUpper(char32 codepoint) const { return u_isupper(codepoint); }
-
-char32 UniLib::ToLower(char32 codepoint) const { return u_tolower(codepoint); }
-
-char32 UniLib::GetPairedBracket(char32 codepoint) const {
-  return u_getBidiPairedBracket(codepoint);
-}
-
 UniLib::RegexMatcher::RegexMatcher(icu::RegexPattern* pattern,
-                                   icu::UnicodeString text)
+                                   icu::UnicodeString text,
+                                   const RegexLimits& limits)
     : text_(std::move(text)),
       last_find_offset_(0),
       last_find_offset_codepoints_(0),
       last_find_offset_dirty_(true) {
   UErrorCode status = U_ZERO_ERROR;
   matcher_.reset(pattern->matcher(text_, status));
+  if (U_SUCCESS(status) && limits.time_limit > 0) {
+    matcher_->setTimeLimit(limits.time_limit, status);
+  }
+  if (U_SUCCESS(status) && limits.stack_limit_bytes > 0) {
+    matcher_->setStackLimit(limits.stack_limit_bytes, status);
+  }
   if (U_FAILURE(status)) {
     matcher_.reset(nullptr);
   }
@@ -80,12 +63,26 @@ UniLib::RegexMatcher::RegexMatcher(icu::RegexPattern* pattern,
 std::unique_ptr<UniLib::RegexMatcher> UniLib::RegexPattern::Matcher(
     const UnicodeText& input) const {
   return std::unique_ptr<UniLib::RegexMatcher>(new UniLib::RegexMatcher(
-      pattern_.get(), icu::UnicodeString::fromUTF8(
-                          icu::StringPiece(input.data(), input.size_bytes()))));
+      pattern_.get(),
+      icu::UnicodeString::fromUTF8(
+          icu::StringPiece(input.data(), input.size_bytes())),
+      limits_));
 }
 
 constexpr int UniLib::RegexMatcher::kError;
 constexpr int UniLib::RegexMatcher::kNoError;
+constexpr int UniLib::RegexMatcher::kLimitExceeded;
+
+namespace {
+// Maps the status of an ICU match operation to a RegexMatcher status.
+int MatchStatus(UErrorCode icu_status) {
+  if (icu_status == U_REGEX_TIME_OUT || icu_status == U_REGEX_STACK_OVERFLOW) {
+    return UniLib::RegexMatcher::kLimitExceeded;
+  }
+  return U_FAILURE(icu_status) ? UniLib::RegexMatcher::kError
+                               : UniLib::RegexMatcher::kNoError;
+}
+}  // namespace
 
 bool UniLib::RegexMatcher::Matches(int* status) const {
   if (!matcher_) {
@@ -96,7 +93,7 @@ bool UniLib::RegexMatcher::Matches(int* status) const {
   UErrorCode icu_status = U_ZERO_ERROR;
   const bool result = matcher_->matches(/*startIndex=*/0, icu_status);
   if (U_FAILURE(icu_status)) {
-    *status = kError;
+    *status = MatchStatus(icu_status);
     return false;
   }
   *status = kNoError;
@@ -155,7 +152,7 @@ bool UniLib::RegexMatcher::Find(int* status) {
   UErrorCode icu_status = U_ZERO_ERROR;
   const bool result = matcher_->find(icu_status);
   if (U_FAILURE(icu_status)) {
-    *status = kError;
+    *status = MatchStatus(icu_status);
     return false;
   }
 
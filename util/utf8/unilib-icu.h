@@ -23,6 +23,7 @@
 #include <memory>
 
 #include "util/base/integral_types.h"
+#include "util/utf8/char-properties.h"
 #include "util/utf8/unicodetext.h"
 #include "unicode/brkiter.h"
 #include "unicode/errorcode.h"
@@ -35,22 +36,56 @@ namespace libtextclassifier2 {
 class UniLib {
  public:
   bool ParseInt32(const UnicodeText& text, int* result) const;
-  bool IsOpeningBracket(char32 codepoint) const;
-  bool IsClosingBracket(char32 codepoint) const;
-  bool IsWhitespace(char32 codepoint) const;
-  bool IsDigit(char32 codepoint) const;
-  bool IsUpper(char32 codepoint) const;
 
-  char32 ToLower(char32 codepoint) const;
-  char32 GetPairedBracket(char32 codepoint) const;
+  // The character properties are looked up in generated tables rather than
+  // in ICU, since they are needed for every codepoint. They match ICU's
+  // u_getIntPropertyValue(UCHAR_BIDI_PAIRED_BRACKET_TYPE), u_isWhitespace,
+  // u_isdigit, u_isupper, u_tolower and u_getBidiPairedBracket.
+  bool IsOpeningBracket(char32 codepoint) const {
+    return internal::HasCharProperty(codepoint, internal::kCharOpeningBracket);
+  }
+  bool IsClosingBracket(char32 codepoint) const {
+    return internal::HasCharProperty(codepoint, internal::kCharClosingBracket);
+  }
+  bool IsWhitespace(char32 codepoint) const {
+    return internal::HasCharProperty(codepoint, internal::kCharWhitespace);
+  }
+  bool IsDigit(char32 codepoint) const {
+    return internal::HasCharProperty(codepoint, internal::kCharDigit);
+  }
+  bool IsUpper(char32 codepoint) const {
+    return internal::HasCharProperty(codepoint, internal::kCharUpper);
+  }
+
+  char32 ToLower(char32 codepoint) const {
+    return codepoint + internal::GetCharProperties(codepoint).lower_offset;
+  }
+  char32 GetPairedBracket(char32 codepoint) const {
+    return codepoint +
+           internal::GetCharProperties(codepoint).paired_bracket_offset;
+  }
 
   // Forward declaration for friend.
   class RegexPattern;
 
+  // Limits of a single match operation of a RegexMatcher, which stop
+  // pathological backtracking. Zero keeps the ICU default.
+  struct RegexLimits {
+    // In steps of the match engine, which take on the order of a millisecond.
+    // See icu::RegexMatcher::setTimeLimit.
+    int32 time_limit = 0;
+
+    // Size of the backtracking stack in bytes. See
+    // icu::RegexMatcher::setStackLimit.
+    int32 stack_limit_bytes = 0;
+  };
+
   class RegexMatcher {
    public:
     static constexpr int kError = -1;
     static constexpr int kNoError = 0;
+    // The match operation ran over the RegexLimits of the pattern.
+    static constexpr int kLimitExceeded = -2;
 
     // Checks whether the input text matches the pattern exactly.
     bool Matches(int* status) const;
@@ -102,7 +137,8 @@ class UniLib {
 
    protected:
     friend class RegexPattern;
-    explicit RegexMatcher(icu::RegexPattern* pattern, icu::UnicodeString text);
+    explicit RegexMatcher(icu::RegexPattern* pattern, icu::UnicodeString text,
+                          const RegexLimits& limits);
 
    private:
     bool UpdateLastFindOffset() const;
@@ -118,6 +154,9 @@ class UniLib {
    public:
     std::unique_ptr<RegexMatcher> Matcher(const UnicodeText& input) const;
 
+    // Sets the limits of the matchers created afterwards.
+    void set_limits(const RegexLimits& limits) { limits_ = limits; }
+
    protected:
     friend class UniLib;
     explicit RegexPattern(std::unique_ptr<icu::RegexPattern> pattern)
@@ -125,6 +164,7 @@ class UniLib {
 
    private:
     std::unique_ptr<icu::RegexPattern> pattern_;
+    RegexLimits limits_;
   };
 
   class BreakIterator {
@@ -16,7 +16,10 @@
 
 #include "util/utf8/unilib.h"
 
+#include <cstring>
+
 #include "util/base/logging.h"
+#include "util/utf8/char-properties.h"
 #include "util/utf8/unicodetext.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -70,6 +73,62 @@ TEST(UniLibTest, CharacterClassesUnicode) {
 }
 #endif  // ndef LIBTEXTCLASSIFIER_UNILIB_DUMMY
 
+#ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
+TEST(UniLibTest, CharacterClassesMatchIcu) {
+  CREATE_UNILIB_FOR_TESTING;
+  // If ICU has another Unicode version than the tables, only the codepoints
+  // that are assigned in both versions are compared. Rerun
+  // tools/generate-char-properties_main.cc to update the tables then.
+  UVersionInfo tables_version;
+  u_versionFromString(tables_version, internal::kCharPropertiesUnicodeVersion);
+  UVersionInfo icu_version;
+  u_getUnicodeVersion(icu_version);
+  const int version_order =
+      memcmp(tables_version, icu_version, sizeof(UVersionInfo));
+  const uint8_t* older_version =
+      version_order < 0 ? tables_version : icu_version;
+  if (version_order != 0) {
+    TC_LOG(INFO) << "Tables of Unicode "
+                 << internal::kCharPropertiesUnicodeVersion << ", ICU has "
+                 << U_UNICODE_VERSION << ": only comparing common codepoints.";
+  }
+
+  for (char32 codepoint = -1; codepoint <= 0x110000; ++codepoint) {
+    if (version_order != 0) {
+      if (codepoint < 0 || codepoint > internal::kCharPropertiesMaxCodepoint) {
+        continue;
+      }
+      UVersionInfo age;
+      u_charAge(codepoint, age);
+      const UVersionInfo unassigned = {0, 0, 0, 0};
+      if (memcmp(age, unassigned, sizeof(UVersionInfo)) == 0 ||
+          memcmp(age, older_version, sizeof(UVersionInfo)) > 0) {
+        continue;
+      }
+    }
+    const int bracket_type =
+        u_getIntPropertyValue(codepoint, UCHAR_BIDI_PAIRED_BRACKET_TYPE);
+    ASSERT_EQ(unilib.IsOpeningBracket(codepoint), bracket_type == U_BPT_OPEN)
+        << codepoint;
+    ASSERT_EQ(unilib.IsClosingBracket(codepoint), bracket_type == U_BPT_CLOSE)
+        << codepoint;
+    ASSERT_EQ(unilib.IsWhitespace(codepoint),
+              static_cast<bool>(u_isWhitespace(codepoint)))
+        << codepoint;
+    ASSERT_EQ(unilib.IsDigit(codepoint),
+              static_cast<bool>(u_isdigit(codepoint)))
+        << codepoint;
+    ASSERT_EQ(unilib.IsUpper(codepoint),
+              static_cast<bool>(u_isupper(codepoint)))
+        << codepoint;
+    ASSERT_EQ(unilib.ToLower(codepoint), u_tolower(codepoint)) << codepoint;
+    ASSERT_EQ(unilib.GetPairedBracket(codepoint),
+              u_getBidiPairedBracket(codepoint))
+        << codepoint;
+  }
+}
+#endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
+
 TEST(UniLibTest, RegexInterface) {
   CREATE_UNILIB_FOR_TESTING;
   const UnicodeText regex_pattern =
@@ -166,6 +225,44 @@ TEST(UniLibTest, RegexGroups) {
 }
 #endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
 
+#ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
+TEST(UniLibTest, RegexLimits) {
+  CREATE_UNILIB_FOR_TESTING;
+  // Backtracks exponentially on runs of digits and spaces without an 'x'.
+  std::unique_ptr<UniLib::RegexPattern> pattern = unilib.CreateRegexPattern(
+      UTF8ToUnicodeText("(\\d+\\s?)+x", /*do_copy=*/false));
+  UniLib::RegexLimits limits;
+  limits.time_limit = 1;
+  pattern->set_limits(limits);
+  int status;
+
+  std::unique_ptr<UniLib::RegexMatcher> matcher = pattern->Matcher(
+      UTF8ToUnicodeText("1234 5678 1234 5678 1234 5678 1234 5678 1234 5678",
+                        /*do_copy=*/false));
+  EXPECT_FALSE(matcher->Find(&status));
+  EXPECT_EQ(status, UniLib::RegexMatcher::kLimitExceeded);
+
+  // Normal inputs are matched as before.
+  matcher = pattern->Matcher(UTF8ToUnicodeText("12 34x", /*do_copy=*/false));
+  EXPECT_TRUE(matcher->Find(&status));
+  EXPECT_EQ(status, UniLib::RegexMatcher::kNoError);
+
+  // The stack limit applies to Matches() as well.
+  pattern = unilib.CreateRegexPattern(
+      UTF8ToUnicodeText("(a|b)*c", /*do_copy=*/false));
+  limits = UniLib::RegexLimits();
+  limits.stack_limit_bytes = 1024;
+  pattern->set_limits(limits);
+  std::string input;
+  for (int i = 0; i < 10000; ++i) {
+    input += "ab";
+  }
+  matcher = pattern->Matcher(UTF8ToUnicodeText(input, /*do_copy=*/false));
+  EXPECT_FALSE(matcher->Matches(&status));
+  EXPECT_EQ(status, UniLib::RegexMatcher::kLimitExceeded);
+}
+#endif  // LIBTEXTCLASSIFIER_UNILIB_ICU
+
 #ifdef LIBTEXTCLASSIFIER_UNILIB_ICU
 
 TEST(UniLibTest, BreakIterator) {
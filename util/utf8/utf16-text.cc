@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/utf8/utf16-text.h"
+
+#include "util/strings/utf8.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+bool IsSurrogatePair(const uint16* utf16, int num_units, int i) {
+  return utf16[i] >= 0xD800 && utf16[i] <= 0xDBFF && i + 1 < num_units &&
+         utf16[i + 1] >= 0xDC00 && utf16[i + 1] <= 0xDFFF;
+}
+
+}  // namespace
+
+UTF16Text::UTF16Text(const uint16* utf16, int num_units) {
+  AppendUTF16AsUTF8(utf16, num_units, &utf8_);
+
+  codepoint_index_.reserve(num_units + 1);
+  utf16_index_.reserve(num_units + 1);
+  int codepoint_index = 0;
+  for (int i = 0; i < num_units; ++i, ++codepoint_index) {
+    codepoint_index_.push_back(codepoint_index);
+    utf16_index_.push_back(i);
+    if (IsSurrogatePair(utf16, num_units, i)) {
+      codepoint_index_.push_back(-1);
+      ++i;
+    }
+  }
+  codepoint_index_.push_back(codepoint_index);
+  utf16_index_.push_back(num_units);
+}
+
+int UTF16Text::ToCodepointIndex(int utf16_index) const {
+  if (utf16_index < 0 || utf16_index >= codepoint_index_.size()) {
+    return -1;
+  }
+  return codepoint_index_[utf16_index];
+}
+
+int UTF16Text::ToUTF16Index(int codepoint_index) const {
+  if (codepoint_index < 0 || codepoint_index >= utf16_index_.size()) {
+    return -1;
+  }
+  return utf16_index_[codepoint_index];
+}
+
+}  // namespace libtextclassifier2
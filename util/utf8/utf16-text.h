@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBTEXTCLASSIFIER_UTIL_UTF8_UTF16_TEXT_H_
+#define LIBTEXTCLASSIFIER_UTIL_UTF8_UTF16_TEXT_H_
+
+#include <string>
+#include <vector>
+
+#include "util/base/integral_types.h"
+#include "util/base/macros.h"
+
+namespace libtextclassifier2 {
+
+// UTF-16 text (e.g. a Java string) transcoded to UTF-8, together with tables
+// that map indices between UTF-16 code units and codepoints in constant time.
+// Unpaired surrogates become '?' (see AppendUTF16AsUTF8), so every code unit
+// outside of a surrogate pair is exactly one codepoint.
+class UTF16Text {
+ public:
+  UTF16Text(const uint16* utf16, int num_units);
+
+  const std::string& utf8() const { return utf8_; }
+
+  int num_units() const { return static_cast<int>(codepoint_index_.size()) - 1; }
+  int num_codepoints() const {
+    return static_cast<int>(utf16_index_.size()) - 1;
+  }
+
+  // Returns the codepoint index at the given UTF-16 code unit index, or -1 if
+  // the index is out of [0, num_units()] or points inside a surrogate pair.
+  int ToCodepointIndex(int utf16_index) const;
+
+  // Returns the UTF-16 code unit index at the given codepoint index, or -1 if
+  // the index is out of [0, num_codepoints()].
+  int ToUTF16Index(int codepoint_index) const;
+
+ private:
+  std::string utf8_;
+
+  // Both tables have one extra entry for the end of the text.
+  std::vector<int> codepoint_index_;
+  std::vector<int> utf16_index_;
+
+  TC_DISALLOW_COPY_AND_ASSIGN(UTF16Text);
+};
+
+}  // namespace libtextclassifier2
+
+#endif  // LIBTEXTCLASSIFIER_UTIL_UTF8_UTF16_TEXT_H_
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/utf8/utf16-text.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier2 {
+namespace {
+
+TEST(UTF16TextTest, AsciiIndicesAreIdentity) {
+  const std::vector<uint16> utf16 = {'h', 'e', 'l', 'l', 'o'};
+  const UTF16Text text(utf16.data(), utf16.size());
+  EXPECT_EQ(text.utf8(), "hello");
+  EXPECT_EQ(text.num_units(), 5);
+  EXPECT_EQ(text.num_codepoints(), 5);
+  for (int i = 0; i <= 5; ++i) {
+    EXPECT_EQ(text.ToCodepointIndex(i), i);
+    EXPECT_EQ(text.ToUTF16Index(i), i);
+  }
+  EXPECT_EQ(text.ToCodepointIndex(-1), -1);
+  EXPECT_EQ(text.ToCodepointIndex(6), -1);
+  EXPECT_EQ(text.ToUTF16Index(6), -1);
+}
+
+TEST(UTF16TextTest, SurrogatePairs) {
+  // "😁 Hell😁 World." with U+1F601 encoded as a surrogate pair.
+  const std::vector<uint16> utf16 = {0xD83D, 0xDE01, ' ',    'H', 'e',
+                                     'l',    'l',    0xD83D, 0xDE01, ' ',
+                                     'W',    'o',    'r',    'l',    'd',
+                                     '.'};
+  const UTF16Text text(utf16.data(), utf16.size());
+  EXPECT_EQ(text.utf8(), "\xF0\x9F\x98\x81 Hell\xF0\x9F\x98\x81 World.");
+  EXPECT_EQ(text.num_units(), 16);
+  EXPECT_EQ(text.num_codepoints(), 14);
+
+  EXPECT_EQ(text.ToCodepointIndex(0), 0);
+  EXPECT_EQ(text.ToCodepointIndex(1), -1);
+  EXPECT_EQ(text.ToCodepointIndex(3), 2);
+  EXPECT_EQ(text.ToCodepointIndex(9), 7);
+  EXPECT_EQ(text.ToCodepointIndex(16), 14);
+
+  EXPECT_EQ(text.ToUTF16Index(2), 3);
+  EXPECT_EQ(text.ToUTF16Index(7), 9);
+  EXPECT_EQ(text.ToUTF16Index(14), 16);
+}
+
+TEST(UTF16TextTest, UnpairedSurrogatesAreSingleCodepoints) {
+  const std::vector<uint16> utf16 = {0xDE01, 'a', 0xD83D};
+  const UTF16Text text(utf16.data(), utf16.size());
+  EXPECT_EQ(text.utf8(), "?a?");
+  EXPECT_EQ(text.num_codepoints(), 3);
+  for (int i = 0; i <= 3; ++i) {
+    EXPECT_EQ(text.ToCodepointIndex(i), i);
+    EXPECT_EQ(text.ToUTF16Index(i), i);
+  }
+}
+
+TEST(UTF16TextTest, Empty) {
+  const UTF16Text text(nullptr, 0);
+  EXPECT_EQ(text.utf8(), "");
+  EXPECT_EQ(text.ToCodepointIndex(0), 0);
+  EXPECT_EQ(text.ToUTF16Index(0), 0);
+}
+
+}  // namespace
+}  // namespace libtextclassifier2
@@ -16,22 +16,39 @@
 
 #include "zlib-utils.h"
 
+#include <algorithm>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
+#include "util/base/integral_types.h"
 #include "util/base/logging.h"
 #include "util/flatbuffers.h"
 
 namespace libtextclassifier2 {
 
-std::unique_ptr<ZlibDecompressor> ZlibDecompressor::Instance() {
-  std::unique_ptr<ZlibDecompressor> result(new ZlibDecompressor());
+std::unique_ptr<ZlibDecompressor> ZlibDecompressor::Instance(
+    const uint8_t* dictionary, int dictionary_size) {
+  std::unique_ptr<ZlibDecompressor> result(
+      new ZlibDecompressor(dictionary, dictionary_size));
   if (!result->initialized_) {
     result.reset();
   }
   return result;
 }
 
-ZlibDecompressor::ZlibDecompressor() {
+std::unique_ptr<ZlibDecompressor> ZlibDecompressor::Instance(
+    const flatbuffers::Vector<uint8_t>* dictionary) {
+  if (dictionary == nullptr) {
+    return Instance();
+  }
+  return Instance(dictionary->data(), dictionary->size());
+}
+
+ZlibDecompressor::ZlibDecompressor(const uint8_t* dictionary,
+                                   int dictionary_size)
+    : dictionary_(dictionary), dictionary_size_(dictionary_size) {
   memset(&stream_, 0, sizeof(stream_));
   stream_.zalloc = Z_NULL;
   stream_.zfree = Z_NULL;
@@ -52,14 +69,37 @@ bool ZlibDecompressor::Decompress(const CompressedBuffer* compressed_buffer,
   stream_.avail_in = compressed_buffer->buffer()->Length();
   stream_.next_out = reinterpret_cast<Bytef*>(const_cast<char*>(out->c_str()));
   stream_.avail_out = compressed_buffer->uncompressed_size();
-  return (inflate(&stream_, Z_SYNC_FLUSH) == Z_OK);
+  if (!compressed_buffer->independent()) {
+    return (inflate(&stream_, Z_SYNC_FLUSH) == Z_OK);
+  }
+
+  // An independent buffer is a complete stream, that asks for the dictionary
+  // after its header if it was compressed with one.
+  if (inflateReset(&stream_) != Z_OK) {
+    return false;
+  }
+  int status = inflate(&stream_, Z_FINISH);
+  if (status == Z_NEED_DICT) {
+    if (dictionary_ == nullptr ||
+        inflateSetDictionary(&stream_, dictionary_, dictionary_size_) !=
+            Z_OK) {
+      TC_LOG(ERROR) << "Missing or wrong compression dictionary.";
+      return false;
+    }
+    status = inflate(&stream_, Z_FINISH);
+  }
+  return status == Z_STREAM_END;
 }
 
-std::unique_ptr<ZlibCompressor> ZlibCompressor::Instance() {
+std::unique_ptr<ZlibCompressor> ZlibCompressor::Instance(
+    bool independent, const std::string& dictionary) {
   std::unique_ptr<ZlibCompressor> result(new ZlibCompressor());
   if (!result->initialized_) {
     result.reset();
+    return result;
   }
+  result->independent_ = independent;
+  result->dictionary_ = dictionary;
   return result;
 }
 
@@ -77,7 +117,16 @@ ZlibCompressor::~ZlibCompressor() { deflateEnd(&stream_); }
 void ZlibCompressor::Compress(const std::string& uncompressed_content,
                               CompressedBufferT* out) {
   out->uncompressed_size = uncompressed_content.size();
+  out->independent = independent_;
   out->buffer.clear();
+  if (independent_) {
+    deflateReset(&stream_);
+    if (!dictionary_.empty()) {
+      deflateSetDictionary(&stream_,
+                           reinterpret_cast<const Bytef*>(dictionary_.data()),
+                           dictionary_.size());
+    }
+  }
   stream_.next_in =
       reinterpret_cast<const Bytef*>(uncompressed_content.c_str());
   stream_.avail_in = uncompressed_content.size();
@@ -94,7 +143,9 @@ void ZlibCompressor::Compress(const std::string& uncompressed_content,
     // chunk wise and append the flushed content to the output string buffer.
     // As we store the uncompressed size, we do not have to do this during
     // decompression.
-    status = deflate(&stream_, Z_SYNC_FLUSH);
+    // Independent buffers are finished instead, so that they are complete
+    // streams.
+    status = deflate(&stream_, independent_ ? Z_FINISH : Z_SYNC_FLUSH);
     unsigned char* buffer_deflate_end_position =
         reinterpret_cast<unsigned char*>(stream_.next_out);
     if (buffer_deflate_end_position != buffer_deflate_start_position) {
@@ -108,8 +159,85 @@ void ZlibCompressor::Compress(const std::string& uncompressed_content,
   } while (status == Z_OK);
 }
 
+std::string BuildCompressionDictionary(
+    const std::vector<std::string>& contents) {
+  // zlib only looks back this far.
+  const int kMaxDictionarySize = 32 * 1024;
+  const int kSubstringLength = 8;
+
+  // Count the contents that contain each substring.
+  std::unordered_map<std::string, int> num_contents;
+  for (const std::string& content : contents) {
+    std::unordered_set<std::string> substrings;
+    for (int i = 0; i + kSubstringLength <= content.size(); ++i) {
+      substrings.insert(content.substr(i, kSubstringLength));
+    }
+    for (const std::string& substring : substrings) {
+      ++num_contents[substring];
+    }
+  }
+
+  // Score the contents by the number of other contents that share their
+  // substrings, on average.
+  std::vector<std::pair<double, int>> scored_contents;
+  for (int i = 0; i < contents.size(); ++i) {
+    const std::string& content = contents[i];
+    if (content.size() < kSubstringLength ||
+        content.size() > kMaxDictionarySize / 4) {
+      continue;
+    }
+    int64 num_shared = 0;
+    for (int j = 0; j + kSubstringLength <= content.size(); ++j) {
+      num_shared += num_contents[content.substr(j, kSubstringLength)] - 1;
+    }
+    const double score = static_cast<double>(num_shared) /
+                         (content.size() - kSubstringLength + 1);
+    if (score > 0) {
+      scored_contents.push_back({-score, i});
+    }
+  }
+  std::sort(scored_contents.begin(), scored_contents.end());
+
+  std::vector<int> selected;
+  std::unordered_set<std::string> selected_contents;
+  int dictionary_size = 0;
+  for (const auto& scored_content : scored_contents) {
+    const std::string& content = contents[scored_content.second];
+    if (dictionary_size + content.size() > kMaxDictionarySize ||
+        !selected_contents.insert(content).second) {
+      continue;
+    }
+    selected.push_back(scored_content.second);
+    dictionary_size += content.size();
+  }
+
+  // The best contents go last, closest to the compressed data, where matches
+  // are cheaper to encode.
+  std::string dictionary;
+  for (auto it = selected.rbegin(); it != selected.rend(); ++it) {
+    dictionary += contents[*it];
+  }
+  return dictionary;
+}
+
+namespace {
+
+// Creates a compressor for independent buffers, with a dictionary built from
+// the contents.
+std::unique_ptr<ZlibCompressor> CreateIndependentCompressor(
+    const std::vector<std::string>& contents,
+    std::vector<uint8_t>* compression_dictionary) {
+  const std::string dictionary = BuildCompressionDictionary(contents);
+  compression_dictionary->assign(dictionary.begin(), dictionary.end());
+  return ZlibCompressor::Instance(/*independent=*/true, dictionary);
+}
+
+}  // namespace
+
 // Compress rule fields in the model.
-bool CompressModel(ModelT* model) {
+bool CompressModel(ModelT* model, bool independent) {
+  // Without independent buffers, the regex and the datetime rules form a
+  // single stream.
   std::unique_ptr<ZlibCompressor> zlib_compressor = ZlibCompressor::Instance();
   if (!zlib_compressor) {
     TC_LOG(ERROR) << "Cannot compress model.";
@@ -118,6 +246,18 @@ bool CompressModel(ModelT* model) {
 
   // Compress regex rules.
   if (model->regex_model != nullptr) {
+    if (independent) {
+      std::vector<std::string> contents;
+      for (const auto& pattern : model->regex_model->patterns) {
+        contents.push_back(pattern->pattern);
+      }
+      zlib_compressor = CreateIndependentCompressor(
+          contents, &model->regex_model->compression_dictionary);
+      if (!zlib_compressor) {
+        TC_LOG(ERROR) << "Cannot compress model.";
+        return false;
+      }
+    }
     for (int i = 0; i < model->regex_model->patterns.size(); i++) {
       RegexModel_::PatternT* pattern = model->regex_model->patterns[i].get();
       pattern->compressed_pattern.reset(new CompressedBufferT);
@@ -129,6 +269,23 @@ bool CompressModel(ModelT* model) {
 
   // Compress date-time rules.
   if (model->datetime_model != nullptr) {
+    if (independent) {
+      std::vector<std::string> contents;
+      for (const auto& pattern : model->datetime_model->patterns) {
+        for (const auto& regex : pattern->regexes) {
+          contents.push_back(regex->pattern);
+        }
+      }
+      for (const auto& extractor : model->datetime_model->extractors) {
+        contents.push_back(extractor->pattern);
+      }
+      zlib_compressor = CreateIndependentCompressor(
+          contents, &model->datetime_model->compression_dictionary);
+      if (!zlib_compressor) {
+        TC_LOG(ERROR) << "Cannot compress model.";
+        return false;
+      }
+    }
     for (int i = 0; i < model->datetime_model->patterns.size(); i++) {
       DatetimeModelPatternT* pattern = model->datetime_model->patterns[i].get();
       for (int j = 0; j < pattern->regexes.size(); j++) {
@@ -153,9 +310,13 @@ bool CompressModel(ModelT* model) {
 
 namespace {
 
+// Leaves the uncompressed pattern unchanged if the rule is not compressed.
 bool DecompressBuffer(const CompressedBufferT* compressed_pattern,
                       ZlibDecompressor* zlib_decompressor,
                       std::string* uncompressed_pattern) {
+  if (compressed_pattern == nullptr) {
+    return true;
+  }
   std::string packed_pattern =
       PackFlatbuffer<CompressedBuffer>(compressed_pattern);
   if (!zlib_decompressor->Decompress(
@@ -166,6 +327,20 @@ bool DecompressBuffer(const CompressedBufferT* compressed_pattern,
   return true;
 }
 
+// Returns a new decompressor in 'dictionary_decompressor' for the rules of a
+// model with a compression dictionary, or the shared one otherwise.
+ZlibDecompressor* DecompressorForDictionary(
+    const std::vector<uint8_t>& dictionary,
+    ZlibDecompressor* shared_decompressor,
+    std::unique_ptr<ZlibDecompressor>* dictionary_decompressor) {
+  if (dictionary.empty()) {
+    return shared_decompressor;
+  }
+  *dictionary_decompressor =
+      ZlibDecompressor::Instance(dictionary.data(), dictionary.size());
+  return dictionary_decompressor->get();
+}
+
 }  // namespace
 
 bool DecompressModel(ModelT* model) {
@@ -178,25 +353,42 @@ bool DecompressModel(ModelT* model) {
 
   // Decompress regex rules.
   if (model->regex_model != nullptr) {
+    std::unique_ptr<ZlibDecompressor> dictionary_decompressor;
+    ZlibDecompressor* decompressor = DecompressorForDictionary(
+        model->regex_model->compression_dictionary, zlib_decompressor.get(),
+        &dictionary_decompressor);
+    if (decompressor == nullptr) {
+      TC_LOG(ERROR) << "Cannot initialize decompressor.";
+      return false;
+    }
     for (int i = 0; i < model->regex_model->patterns.size(); i++) {
       RegexModel_::PatternT* pattern = model->regex_model->patterns[i].get();
-      if (!DecompressBuffer(pattern->compressed_pattern.get(),
-                            zlib_decompressor.get(), &pattern->pattern)) {
+      if (!DecompressBuffer(pattern->compressed_pattern.get(), decompressor,
+                            &pattern->pattern)) {
         TC_LOG(ERROR) << "Cannot decompress pattern: " << i;
         return false;
       }
       pattern->compressed_pattern.reset(nullptr);
     }
+    model->regex_model->compression_dictionary.clear();
   }
 
   // Decompress date-time rules.
   if (model->datetime_model != nullptr) {
+    std::unique_ptr<ZlibDecompressor> dictionary_decompressor;
+    ZlibDecompressor* decompressor = DecompressorForDictionary(
+        model->datetime_model->compression_dictionary, zlib_decompressor.get(),
+        &dictionary_decompressor);
+    if (decompressor == nullptr) {
+      TC_LOG(ERROR) << "Cannot initialize decompressor.";
+      return false;
+    }
     for (int i = 0; i < model->datetime_model->patterns.size(); i++) {
       DatetimeModelPatternT* pattern = model->datetime_model->patterns[i].get();
       for (int j = 0; j < pattern->regexes.size(); j++) {
         DatetimeModelPattern_::RegexT* regex = pattern->regexes[j].get();
-        if (!DecompressBuffer(regex->compressed_pattern.get(),
-                              zlib_decompressor.get(), &regex->pattern)) {
+        if (!DecompressBuffer(regex->compressed_pattern.get(), decompressor,
+                              &regex->pattern)) {
           TC_LOG(ERROR) << "Cannot decompress pattern: " << i << " " << j;
           return false;
         }
@@ -206,21 +398,23 @@ bool DecompressModel(ModelT* model) {
     for (int i = 0; i < model->datetime_model->extractors.size(); i++) {
       DatetimeModelExtractorT* extractor =
           model->datetime_model->extractors[i].get();
-      if (!DecompressBuffer(extractor->compressed_pattern.get(),
-                            zlib_decompressor.get(), &extractor->pattern)) {
+      if (!DecompressBuffer(extractor->compressed_pattern.get(), decompressor,
+                            &extractor->pattern)) {
         TC_LOG(ERROR) << "Cannot decompress pattern: " << i;
         return false;
       }
       extractor->compressed_pattern.reset(nullptr);
     }
+    model->datetime_model->compression_dictionary.clear();
   }
   return true;
 }
 
-std::string CompressSerializedModel(const std::string& model) {
+std::string CompressSerializedModel(const std::string& model,
+                                    bool independent) {
   std::unique_ptr<ModelT> unpacked_model = UnPackModel(model.c_str());
   TC_CHECK(unpacked_model != nullptr);
-  TC_CHECK(CompressModel(unpacked_model.get()));
+  TC_CHECK(CompressModel(unpacked_model.get(), independent));
   flatbuffers::FlatBufferBuilder builder;
   FinishModelBuffer(builder, Model::Pack(builder, unpacked_model.get()));
   return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
@@ -20,6 +20,8 @@
 #define LIBTEXTCLASSIFIER_ZLIB_UTILS_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "model_generated.h"
 #include "util/utf8/unilib.h"
@@ -29,20 +31,34 @@ namespace libtextclassifier2 {
 
 class ZlibDecompressor {
  public:
-  static std::unique_ptr<ZlibDecompressor> Instance();
+  // The preset dictionary is needed for the independent buffers that were
+  // compressed with one. It is not copied and must outlive the decompressor.
+  static std::unique_ptr<ZlibDecompressor> Instance(
+      const uint8_t* dictionary = nullptr, int dictionary_size = 0);
+  static std::unique_ptr<ZlibDecompressor> Instance(
+      const flatbuffers::Vector<uint8_t>* dictionary);
   ~ZlibDecompressor();
 
+  // Decompresses the buffers of a model. The buffers that are not independent
+  // have to be decompressed in the order in which they were compressed, and
+  // can't be interleaved with independent ones.
   bool Decompress(const CompressedBuffer* compressed_buffer, std::string* out);
 
  private:
-  ZlibDecompressor();
+  ZlibDecompressor(const uint8_t* dictionary, int dictionary_size);
   z_stream stream_;
   bool initialized_;
+  const uint8_t* dictionary_;
+  int dictionary_size_;
 };
 
 class ZlibCompressor {
  public:
-  static std::unique_ptr<ZlibCompressor> Instance();
+  // If 'independent' is true, every buffer is compressed on its own, with the
+  // preset dictionary if it is not empty. Otherwise, the buffers form a single
+  // stream.
+  static std::unique_ptr<ZlibCompressor> Instance(
+      bool independent = false, const std::string& dictionary = "");
   ~ZlibCompressor();
 
   void Compress(const std::string& uncompressed_content,
@@ -57,16 +73,29 @@ class ZlibCompressor {
   std::unique_ptr<Bytef[]> buffer_;
   unsigned int buffer_size_;
   bool initialized_;
+  bool independent_ = false;
+  std::string dictionary_;
 };
 
-// Compresses regex and datetime rules in the model in place.
-bool CompressModel(ModelT* model);
+// Compresses regex and datetime rules in the model in place. If 'independent'
+// is true, every rule is compressed on its own, so that the rules can be
+// decompressed lazily, selectively or concurrently. A preset dictionary built
+// from the rules is then stored in the regex and the datetime model, to keep
+// the size close to that of a single stream.
+bool CompressModel(ModelT* model, bool independent = false);
 
-// Decompresses regex and datetime rules in the model in place.
+// Decompresses regex and datetime rules in the model in place. Both formats
+// are supported.
 bool DecompressModel(ModelT* model);
 
 // Compresses regex and datetime rules in the model.
-std::string CompressSerializedModel(const std::string& model);
+std::string CompressSerializedModel(const std::string& model,
+                                    bool independent = false);
+
+// Builds a preset dictionary for the independent compression of the contents,
+// from the contents that share the most substrings with the others.
+std::string BuildCompressionDictionary(
+    const std::vector<std::string>& contents);
 
 // Create and compile a regex pattern from optionally compressed pattern.
 std::unique_ptr<UniLib::RegexPattern> UncompressMakeRegexPattern(
@@ -95,4 +95,88 @@ TEST(ZlibUtilsTest, CompressModel) {
             "an example datetime extractor");
 }
 
+TEST(ZlibUtilsTest, CompressModelIndependently) {
+  ModelT model;
+  model.regex_model.reset(new RegexModelT);
+  model.regex_model->patterns.emplace_back(new RegexModel_::PatternT);
+  model.regex_model->patterns.back()->pattern = "this is a test pattern";
+  model.regex_model->patterns.emplace_back(new RegexModel_::PatternT);
+  model.regex_model->patterns.back()->pattern = "this is a second test pattern";
+
+  model.datetime_model.reset(new DatetimeModelT);
+  model.datetime_model->patterns.emplace_back(new DatetimeModelPatternT);
+  model.datetime_model->patterns.back()->regexes.emplace_back(
+      new DatetimeModelPattern_::RegexT);
+  model.datetime_model->patterns.back()->regexes.back()->pattern =
+      "an example datetime pattern";
+  model.datetime_model->extractors.emplace_back(new DatetimeModelExtractorT);
+  model.datetime_model->extractors.back()->pattern =
+      "an example datetime extractor";
+
+  EXPECT_TRUE(CompressModel(&model, /*independent=*/true));
+  EXPECT_FALSE(model.regex_model->compression_dictionary.empty());
+  EXPECT_FALSE(model.datetime_model->compression_dictionary.empty());
+
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(Model::Pack(builder, &model));
+  const Model* compressed_model =
+      GetModel(reinterpret_cast<const char*>(builder.GetBufferPointer()));
+  ASSERT_TRUE(compressed_model != nullptr);
+
+  // The buffers can be decompressed in any order, and with any decompressor
+  // that has the dictionary of their model.
+  std::unique_ptr<ZlibDecompressor> decompressor = ZlibDecompressor::Instance(
+      compressed_model->regex_model()->compression_dictionary());
+  ASSERT_TRUE(decompressor != nullptr);
+  std::string uncompressed_pattern;
+  EXPECT_TRUE(compressed_model->regex_model()
+                  ->patterns()
+                  ->Get(1)
+                  ->compressed_pattern()
+                  ->independent());
+  EXPECT_TRUE(decompressor->Decompress(
+      compressed_model->regex_model()->patterns()->Get(1)->compressed_pattern(),
+      &uncompressed_pattern));
+  EXPECT_EQ(uncompressed_pattern, "this is a second test pattern");
+  EXPECT_TRUE(decompressor->Decompress(
+      compressed_model->regex_model()->patterns()->Get(0)->compressed_pattern(),
+      &uncompressed_pattern));
+  EXPECT_EQ(uncompressed_pattern, "this is a test pattern");
+
+  decompressor = ZlibDecompressor::Instance(
+      compressed_model->datetime_model()->compression_dictionary());
+  ASSERT_TRUE(decompressor != nullptr);
+  EXPECT_TRUE(decompressor->Decompress(compressed_model->datetime_model()
+                                           ->extractors()
+                                           ->Get(0)
+                                           ->compressed_pattern(),
+                                       &uncompressed_pattern));
+  EXPECT_EQ(uncompressed_pattern, "an example datetime extractor");
+
+  // Without the dictionary, the buffers can't be decompressed.
+  decompressor = ZlibDecompressor::Instance();
+  ASSERT_TRUE(decompressor != nullptr);
+  EXPECT_FALSE(decompressor->Decompress(
+      compressed_model->regex_model()->patterns()->Get(0)->compressed_pattern(),
+      &uncompressed_pattern));
+
+  EXPECT_TRUE(DecompressModel(&model));
+  EXPECT_EQ(model.regex_model->patterns[0]->pattern, "this is a test pattern");
+  EXPECT_EQ(model.regex_model->patterns[1]->pattern,
+            "this is a second test pattern");
+  EXPECT_EQ(model.datetime_model->patterns[0]->regexes[0]->pattern,
+            "an example datetime pattern");
+  EXPECT_EQ(model.datetime_model->extractors[0]->pattern,
+            "an example datetime extractor");
+  EXPECT_TRUE(model.regex_model->compression_dictionary.empty());
+}
+
+TEST(ZlibUtilsTest, BuildCompressionDictionary) {
+  const std::string dictionary = BuildCompressionDictionary(
+      {"January|February", "(January|February) \\d+", "unrelated",
+       "January|February"});
+  // Shared contents are taken once, unrelated ones are left out.
+  EXPECT_EQ(dictionary, "(January|February) \\d+January|February");
+}
+
 }  // namespace libtextclassifier2